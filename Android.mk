@@ -30,6 +30,7 @@ LOCAL_SRC_FILES:= \
     src/debug.cc \
     src/descriptor_set_and_binding_parser.cc \
     src/engine.cc \
+    src/execution_plan.cc \
     src/executor.cc \
     src/float16_helper.cc \
     src/format.cc \
@@ -41,6 +42,7 @@ LOCAL_SRC_FILES:= \
     src/sampler.cc \
     src/script.cc \
     src/shader.cc \
+    src/shader_cache.cc \
     src/shader_compiler.cc \
     src/tokenizer.cc \
     src/type.cc \
@@ -61,14 +63,19 @@ LOCAL_SRC_FILES:= \
     src/vulkan/engine_vulkan.cc \
     src/vulkan/engine_vulkan_debugger.cc \
     src/vulkan/frame_buffer.cc \
+    src/vulkan/gpu_timer.cc \
     src/vulkan/graphics_pipeline.cc \
     src/vulkan/image_descriptor.cc \
     src/vulkan/index_buffer.cc \
+    src/vulkan/memory_allocator.cc \
+    src/vulkan/object_cache.cc \
     src/vulkan/pipeline.cc \
+    src/vulkan/pipeline_library_cache.cc \
     src/vulkan/push_constant.cc \
     src/vulkan/resource.cc \
     src/vulkan/sampler.cc \
     src/vulkan/sampler_descriptor.cc \
+    src/vulkan/statistics_queries.cc \
     src/vulkan/transfer_buffer.cc \
     src/vulkan/transfer_image.cc \
     src/vulkan/vertex_buffer.cc \
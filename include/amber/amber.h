@@ -18,15 +18,19 @@
 #include <stdint.h>
 
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "amber/recipe.h"
 #include "amber/result.h"
+#include "amber/shader_cache.h"
 #include "amber/value.h"
 
 namespace amber {
 
+class Engine;
+
 /// The shader map is a map from the name of a shader to the spirv-binary
 /// which is the compiled representation of that named shader.
 typedef std::map<std::string, std::vector<uint32_t> > ShaderMap;
@@ -70,6 +74,44 @@ struct BufferInfo {
   std::vector<Value> values;
 };
 
+/// Stores the GPU execution time of a command.
+struct CommandTiming {
+  CommandTiming();
+  CommandTiming(const CommandTiming&);
+  ~CommandTiming();
+
+  CommandTiming& operator=(const CommandTiming&);
+
+  /// The script line of the command
+  size_t line;
+  /// The kind of work measured: "clear", "draw", "compute" or "readback"
+  std::string type;
+  /// The time the GPU spent executing the work, in nanoseconds
+  double gpu_time_ns;
+};
+
+/// Stores the pipeline statistics counted for a draw or dispatch.
+struct CommandStatistics {
+  CommandStatistics();
+  CommandStatistics(const CommandStatistics&);
+  ~CommandStatistics();
+
+  CommandStatistics& operator=(const CommandStatistics&);
+
+  /// The script line of the command
+  size_t line;
+  /// The kind of work counted: "draw" or "compute"
+  std::string type;
+  /// The number of vertex shader invocations
+  uint64_t vertex_invocations;
+  /// The number of primitives output by the clipping stage
+  uint64_t clipping_primitives;
+  /// The number of fragment shader invocations
+  uint64_t fragment_invocations;
+  /// The number of compute shader invocations
+  uint64_t compute_invocations;
+};
+
 /// Delegate class for various hook functions
 class Delegate {
  public:
@@ -116,6 +158,45 @@ struct Options {
   bool disable_spirv_validation;
   /// Delegate implementation
   Delegate* delegate;
+  /// Serialized pipeline cache shared across executions. If not null, the
+  /// engine seeds its pipeline cache from the contents and replaces them with
+  /// the updated cache when the execution finishes. A blob created by a
+  /// different device or driver is ignored. Only supported by Vulkan.
+  /// Ownership stays with the caller.
+  std::vector<uint8_t>* pipeline_cache_data;
+  /// Cache of compiled shaders shared across executions. If not null,
+  /// shaders found in the cache are neither compiled nor validated again.
+  /// Ownership stays with the caller.
+  ShaderCache* shader_cache;
+  /// The number of threads used to compile shaders. Independent shaders are
+  /// compiled concurrently; if several fail, the error of the first failing
+  /// shader in script order is reported. 0 uses one thread per hardware
+  /// thread. Default 1.
+  uint32_t shader_compile_threads;
+  /// The number of threads creating the device pipelines of the upcoming
+  /// draws and dispatches in the background, while earlier commands execute.
+  /// Only pipelines whose state no command of the script changes are created
+  /// ahead. 0 creates every device pipeline on first use. Default 0.
+  uint32_t pipeline_compile_threads;
+  /// If true, consecutive RUN and CLEAR commands may be recorded into a single
+  /// submission which is only submitted once a command needs the results on
+  /// the host, e.g. an EXPECT, a COPY or the buffer extraction at the end.
+  bool batch_commands;
+  /// If not null, the GPU execution time of every clear, draw, dispatch and
+  /// readback of buffer contents is measured with timestamp queries and
+  /// appended to |command_timings|. Commands inside a REPEAT add one entry per
+  /// iteration. Only supported by Vulkan. Ownership stays with the caller.
+  std::vector<CommandTiming>* command_timings;
+  /// If not null, the pipeline statistics of every draw and dispatch on a
+  /// pipeline declaring PIPELINE_STATISTICS are appended to
+  /// |command_statistics|. Commands inside a REPEAT add one entry per
+  /// iteration. Only supported by Vulkan. Ownership stays with the caller.
+  std::vector<CommandStatistics>* command_statistics;
+  /// If true, the execution plan the commands are lowered into is logged
+  /// through |delegate| before it is executed. The plan shows which commands
+  /// were dropped, merged or moved out of a REPEAT, and which commands wait
+  /// for the results of the previous ones on the host.
+  bool dump_execution_plan;
 };
 
 /// Main interface to the Amber environment.
@@ -147,6 +228,49 @@ class Amber {
                                       const ShaderMap& shader_data);
 };
 
+
+/// Executes many recipes on a single engine, so the engine and device setup
+/// is only done once instead of for every recipe. The engine is initialized
+/// with a fixed set of features and extensions, each recipe executed must
+/// only require a subset of them. Everything a recipe creates on the engine
+/// is released once it finished executing.
+class Session {
+ public:
+  Session();
+  ~Session();
+
+  /// Creates the engine selected in |opts| and initializes it with the
+  /// |features|, |instance_extensions| and |device_extensions|. The engine
+  /// type, config, delegate and pipeline cache data of |opts| are used for the
+  /// whole session and must outlive it.
+  amber::Result Initialize(Options* opts,
+                           const std::vector<std::string>& features,
+                           const std::vector<std::string>& instance_extensions,
+                           const std::vector<std::string>& device_extensions);
+
+  /// Determines whether the session was initialized with all features and
+  /// extensions required by the |recipe|.
+  amber::Result AreAllRequirementsSupported(const amber::Recipe* recipe) const;
+
+  /// Executes the given |recipe| with the provided |opts| on the session's
+  /// engine. Modifies the |recipe| by applying some of the |opts| to the
+  /// recipe's internal state.
+  amber::Result Execute(const amber::Recipe* recipe, Options* opts);
+
+  /// Executes the given |recipe| with the provided |opts| on the session's
+  /// engine. Will use |shader_map| to lookup shader data before attempting
+  /// to compile the shader if possible.
+  amber::Result ExecuteWithShaderData(const amber::Recipe* recipe,
+                                      Options* opts,
+                                      const ShaderMap& shader_data);
+
+ private:
+  std::unique_ptr<Engine> engine_;
+  std::vector<std::string> features_;
+  std::vector<std::string> instance_extensions_;
+  std::vector<std::string> device_extensions_;
+};
+
 }  // namespace amber
 
 #endif  // AMBER_AMBER_H_
@@ -0,0 +1,76 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef AMBER_SHADER_CACHE_H_
+#define AMBER_SHADER_CACHE_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace amber {
+
+/// Caches compiled SPIR-V binaries so identical shaders are only compiled
+/// and validated once. Entries are addressed by a key describing everything
+/// that influences the compilation: the shader source, type and format, the
+/// target environment, the compile options and the optimization passes.
+///
+/// A cache can be shared by any number of executions and is safe to use from
+/// multiple threads. If a directory is given, entries are also persisted to
+/// disk so they survive across processes. Entry files are replaced
+/// atomically and checked for truncation and corruption when read.
+class ShaderCache {
+ public:
+  /// Creates an in-memory cache.
+  ShaderCache();
+  /// Creates a cache which also stores entries in |directory|. The directory
+  /// must already exist.
+  explicit ShaderCache(const std::string& directory);
+  ~ShaderCache();
+
+  /// Looks up the binary stored for |key|. Returns true and copies the binary
+  /// into |data| on a hit, returns false otherwise.
+  bool Find(const std::string& key, std::vector<uint32_t>* data);
+
+  /// Stores |data| as the binary for |key|.
+  void Insert(const std::string& key, const std::vector<uint32_t>& data);
+
+  /// Returns the number of lookups which found a binary.
+  uint64_t GetHitCount() const;
+  /// Returns the number of lookups which did not find a binary.
+  uint64_t GetMissCount() const;
+  /// Returns the total size, in bytes, of the binaries returned by lookups
+  /// which found a binary.
+  uint64_t GetBytesSaved() const;
+
+ private:
+  std::string GetFilePath(const std::string& key) const;
+  bool ReadFile(const std::string& key, std::vector<uint32_t>* data) const;
+  void WriteFile(const std::string& key,
+                 const std::vector<uint32_t>& data) const;
+
+  std::string directory_;
+  mutable std::mutex mutex_;
+  std::map<std::string, std::vector<uint32_t>> entries_;
+  uint64_t hit_count_ = 0;
+  uint64_t miss_count_ = 0;
+  uint64_t bytes_saved_ = 0;
+};
+
+}  // namespace amber
+
+#endif  // AMBER_SHADER_CACHE_H_
@@ -15,12 +15,18 @@
 #include "amber/amber.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <condition_variable>
 #include <cstdlib>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <iterator>
+#include <mutex>
 #include <set>
+#include <sstream>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -54,6 +60,8 @@ struct Options {
   uint32_t engine_minor = 0;
   int32_t fence_timeout = -1;
   int32_t selected_device = -1;
+  uint32_t jobs = 1;
+  uint32_t pipeline_threads = 0;
   bool parse_only = false;
   bool pipeline_create_only = false;
   bool disable_validation_layer = false;
@@ -64,7 +72,12 @@ struct Options {
   bool log_graphics_calls_time = false;
   bool log_execute_calls = false;
   bool disable_spirv_validation = false;
+  bool batch_commands = false;
+  bool dump_execution_plan = false;
   std::string shader_filename;
+  std::string pipeline_cache_filename;
+  std::string shader_cache_dir;
+  std::string timing_report_filename;
   amber::EngineType engine = amber::kEngineTypeVulkan;
   std::string spv_env;
 };
@@ -78,6 +91,8 @@ const char kUsage[] = R"(Usage: amber [options] SCRIPT [SCRIPTS...]
   -d                        -- Disable validation layers.
   -D <ID>                   -- ID of device to run with (Vulkan only).
   -f <value>                -- Sets the fence timeout value to |value|
+  -j <count>                -- Execute up to <count> scripts in parallel. Every thread creates a
+                               device of its own. Output stays in script order. Default 1.
   -t <spirv_env>            -- The target SPIR-V environment e.g., spv1.3, vulkan1.1, vulkan1.2.
                                If a SPIR-V environment, assume the lowest version of Vulkan that
                                requires support of that version of SPIR-V.
@@ -99,6 +114,18 @@ const char kUsage[] = R"(Usage: amber [options] SCRIPT [SCRIPTS...]
   --log-graphics-calls-time -- Log timing of graphics API calls timing (Vulkan only).
   --log-execute-calls       -- Log each execute call before run.
   --disable-spirv-val       -- Disable SPIR-V validation.
+  --batch-commands          -- Submit consecutive RUN and CLEAR commands together (Vulkan only).
+  --dump-plan               -- Log the execution plan of each script before it is executed.
+  --pipeline-cache <file>   -- Load the pipeline cache from <file> and write it back on exit.
+                               The file is created if it does not exist (Vulkan only).
+  --pipeline-threads <n>    -- Create the device pipelines of upcoming draws and dispatches on
+                               <n> background threads while earlier ones execute. Default 0
+                               creates them on first use (Vulkan only).
+  --shader-cache <dir>      -- Store compiled shaders in the existing directory <dir> and reuse
+                               them across runs. Prints cache statistics unless -q is given.
+  --timing-report <file>    -- Measure the GPU time of each command and write a JSON report to
+                               <file>, which also holds the statistics of pipelines declaring
+                               PIPELINE_STATISTICS (Vulkan only).
   -h                        -- This help text.
 )";
 
@@ -189,6 +216,20 @@ bool ParseArgs(const std::vector<std::string>& args, Options* opts) {
       }
       opts->fence_timeout = val;
 
+    } else if (arg == "-j") {
+      ++i;
+      if (i >= args.size()) {
+        std::cerr << "Missing value for -j argument." << std::endl;
+        return false;
+      }
+
+      int32_t val = std::stoi(std::string(args[i]));
+      if (val < 1) {
+        std::cerr << "Job count must be positive" << std::endl;
+        return false;
+      }
+      opts->jobs = static_cast<uint32_t>(val);
+
     } else if (arg == "-t") {
       ++i;
       if (i >= args.size()) {
@@ -243,6 +284,47 @@ bool ParseArgs(const std::vector<std::string>& args, Options* opts) {
       opts->log_execute_calls = true;
     } else if (arg == "--disable-spirv-val") {
       opts->disable_spirv_validation = true;
+    } else if (arg == "--batch-commands") {
+      opts->batch_commands = true;
+    } else if (arg == "--dump-plan") {
+      opts->dump_execution_plan = true;
+    } else if (arg == "--pipeline-cache") {
+      ++i;
+      if (i >= args.size()) {
+        std::cerr << "Missing value for --pipeline-cache argument."
+                  << std::endl;
+        return false;
+      }
+      opts->pipeline_cache_filename = args[i];
+    } else if (arg == "--pipeline-threads") {
+      ++i;
+      if (i >= args.size()) {
+        std::cerr << "Missing value for --pipeline-threads argument."
+                  << std::endl;
+        return false;
+      }
+
+      int32_t val = std::stoi(std::string(args[i]));
+      if (val < 0) {
+        std::cerr << "Pipeline thread count must not be negative" << std::endl;
+        return false;
+      }
+      opts->pipeline_threads = static_cast<uint32_t>(val);
+    } else if (arg == "--shader-cache") {
+      ++i;
+      if (i >= args.size()) {
+        std::cerr << "Missing value for --shader-cache argument." << std::endl;
+        return false;
+      }
+      opts->shader_cache_dir = args[i];
+    } else if (arg == "--timing-report") {
+      ++i;
+      if (i >= args.size()) {
+        std::cerr << "Missing value for --timing-report argument."
+                  << std::endl;
+        return false;
+      }
+      opts->timing_report_filename = args[i];
     } else if (arg.size() > 0 && arg[0] == '-') {
       std::cerr << "Unrecognized option " << arg << std::endl;
       return false;
@@ -290,12 +372,130 @@ std::string ReadFile(const std::string& input_file) {
   return std::string(data.begin(), data.end());
 }
 
+std::vector<uint8_t> ReadPipelineCache(const std::string& filename) {
+  // A missing cache file is expected on the first run.
+  std::ifstream file(filename, std::ios::in | std::ios::binary);
+  if (!file.is_open())
+    return {};
+
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                              std::istreambuf_iterator<char>());
+}
+
+void WritePipelineCache(const std::string& filename,
+                        const std::vector<uint8_t>& data) {
+  std::ofstream file(filename, std::ios::out | std::ios::binary);
+  if (!file.is_open()) {
+    std::cerr << "Cannot open file for pipeline cache: " << filename
+              << std::endl;
+    return;
+  }
+  file.write(reinterpret_cast<const char*>(data.data()),
+             static_cast<std::streamsize>(data.size()));
+}
+
+// The GPU times and pipeline statistics measured while executing a script.
+struct ScriptTimings {
+  std::string file;
+  std::vector<amber::CommandTiming> timings;
+  std::vector<amber::CommandStatistics> statistics;
+};
+
+std::string EscapeJson(const std::string& str) {
+  std::ostringstream out;
+  for (char c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+          << static_cast<int>(c) << std::dec;
+    } else {
+      out << c;
+    }
+  }
+  return out.str();
+}
+
+// Writes the GPU times and pipeline statistics of |scripts| to |filename|.
+// Commands executed several times, e.g. inside a REPEAT, are reported once
+// with their total, minimum and maximum time.
+void WriteTimingReport(const std::string& filename,
+                       const std::vector<ScriptTimings>& scripts) {
+  std::ofstream file(filename, std::ios::out);
+  if (!file.is_open()) {
+    std::cerr << "Cannot open file for timing report: " << filename
+              << std::endl;
+    return;
+  }
+
+  struct Entry {
+    size_t line;
+    std::string type;
+    uint32_t count;
+    double total_ns;
+    double min_ns;
+    double max_ns;
+  };
+
+  file << std::fixed << std::setprecision(1);
+  file << "{\n  \"scripts\": [";
+  for (size_t i = 0; i < scripts.size(); ++i) {
+    std::vector<Entry> entries;
+    for (const auto& timing : scripts[i].timings) {
+      auto it = std::find_if(entries.begin(), entries.end(),
+                             [&timing](const Entry& entry) {
+                               return entry.line == timing.line &&
+                                      entry.type == timing.type;
+                             });
+      if (it == entries.end()) {
+        entries.push_back({timing.line, timing.type, 1, timing.gpu_time_ns,
+                           timing.gpu_time_ns, timing.gpu_time_ns});
+        continue;
+      }
+      ++it->count;
+      it->total_ns += timing.gpu_time_ns;
+      it->min_ns = std::min(it->min_ns, timing.gpu_time_ns);
+      it->max_ns = std::max(it->max_ns, timing.gpu_time_ns);
+    }
+
+    file << (i == 0 ? "" : ",") << "\n    {\n      \"file\": \""
+         << EscapeJson(scripts[i].file) << "\",\n      \"commands\": [";
+    for (size_t j = 0; j < entries.size(); ++j) {
+      const auto& entry = entries[j];
+      file << (j == 0 ? "" : ",") << "\n        {\"line\": " << entry.line
+           << ", \"type\": \"" << entry.type << "\", \"count\": "
+           << entry.count << ", \"total_ns\": " << entry.total_ns
+           << ", \"min_ns\": " << entry.min_ns
+           << ", \"max_ns\": " << entry.max_ns << "}";
+    }
+    file << (entries.empty() ? "" : "\n      ")
+         << "],\n      \"statistics\": [";
+
+    // Statistics are reported for every execution of a command.
+    const auto& statistics = scripts[i].statistics;
+    for (size_t j = 0; j < statistics.size(); ++j) {
+      const auto& stats = statistics[j];
+      file << (j == 0 ? "" : ",") << "\n        {\"line\": " << stats.line
+           << ", \"type\": \"" << stats.type
+           << "\", \"vertex_invocations\": " << stats.vertex_invocations
+           << ", \"clipping_primitives\": " << stats.clipping_primitives
+           << ", \"fragment_invocations\": " << stats.fragment_invocations
+           << ", \"compute_invocations\": " << stats.compute_invocations
+           << "}";
+    }
+    file << (statistics.empty() ? "" : "\n      ") << "]\n    }";
+  }
+  file << (scripts.empty() ? "" : "\n  ") << "]\n}\n";
+}
+
 class SampleDelegate : public amber::Delegate {
  public:
   SampleDelegate() = default;
   ~SampleDelegate() override = default;
 
   void Log(const std::string& message) override {
+    // Scripts executed in parallel share the delegate.
+    std::lock_guard<std::mutex> lock(log_mutex_);
     std::cout << message << std::endl;
   }
 
@@ -328,6 +528,26 @@ class SampleDelegate : public amber::Delegate {
   bool log_graphics_calls_ = false;
   bool log_graphics_calls_time_ = false;
   bool log_execute_calls_ = false;
+  std::mutex log_mutex_;
+};
+
+// The state of one thread executing scripts. Every worker has a device, and
+// with it a queue and command pool, of its own, so workers never wait for
+// each other while executing.
+struct Worker {
+  sample::ConfigHelper config_helper;
+  std::unique_ptr<amber::EngineConfig> config;
+  std::vector<uint8_t> pipeline_cache;
+  amber::Options options;
+  amber::Session session;
+  bool use_session = false;
+};
+
+// The outcome of executing a script, reported once all earlier scripts were.
+struct ScriptRun {
+  amber::Result result;
+  std::vector<amber::BufferInfo> extractions;
+  bool done = false;
 };
 
 std::string disassemble(const std::string& env,
@@ -457,6 +677,20 @@ int main(int argc, const char** argv) {
                                      : amber::ExecutionType::kExecute;
   amber_options.delegate = &delegate;
   amber_options.disable_spirv_validation = options.disable_spirv_validation;
+  amber_options.batch_commands = options.batch_commands;
+  amber_options.dump_execution_plan = options.dump_execution_plan;
+  amber_options.pipeline_compile_threads = options.pipeline_threads;
+
+  std::vector<uint8_t> pipeline_cache;
+  if (!options.pipeline_cache_filename.empty()) {
+    pipeline_cache = ReadPipelineCache(options.pipeline_cache_filename);
+    amber_options.pipeline_cache_data = &pipeline_cache;
+  }
+
+  // Shaders shared between scripts are only compiled once, even when no
+  // cache directory was requested.
+  amber::ShaderCache shader_cache(options.shader_cache_dir);
+  amber_options.shader_cache = &shader_cache;
 
   std::set<std::string> required_features;
   std::set<std::string> required_device_extensions;
@@ -476,26 +710,12 @@ int main(int argc, const char** argv) {
                                         inst_extensions.end());
   }
 
-  sample::ConfigHelper config_helper;
-  std::unique_ptr<amber::EngineConfig> config;
-
-  amber::Result r = config_helper.CreateConfig(
-      amber_options.engine, options.engine_major, options.engine_minor,
-      options.selected_device,
-      std::vector<std::string>(required_features.begin(),
-                               required_features.end()),
-      std::vector<std::string>(required_instance_extensions.begin(),
-                               required_instance_extensions.end()),
-      std::vector<std::string>(required_device_extensions.begin(),
-                               required_device_extensions.end()),
-      options.disable_validation_layer, options.show_version_info, &config);
-
-  if (!r.IsSuccess()) {
-    std::cout << r.Error() << std::endl;
-    return 1;
-  }
-
-  amber_options.config = config.get();
+  const std::vector<std::string> features(required_features.begin(),
+                                          required_features.end());
+  const std::vector<std::string> instance_extensions(
+      required_instance_extensions.begin(), required_instance_extensions.end());
+  const std::vector<std::string> device_extensions(
+      required_device_extensions.begin(), required_device_extensions.end());
 
   if (!options.buffer_filename.empty()) {
     // Have a filename to dump, but no explicit buffer, set the default of 0:0.
@@ -527,12 +747,106 @@ int main(int argc, const char** argv) {
     amber_options.extractions.push_back(buffer_info);
   }
 
-  for (const auto& recipe_data_elem : recipe_data) {
-    const auto* recipe = recipe_data_elem.recipe.get();
-    const auto& file = recipe_data_elem.file;
+  const size_t worker_count =
+      std::max<size_t>(std::min<size_t>(options.jobs, recipe_data.size()), 1);
+  std::vector<std::unique_ptr<Worker>> workers;
+  for (size_t i = 0; i < worker_count; ++i) {
+    auto worker = amber::MakeUnique<Worker>();
+    worker->options = amber_options;
+    if (!options.pipeline_cache_filename.empty()) {
+      worker->pipeline_cache = pipeline_cache;
+      worker->options.pipeline_cache_data = &worker->pipeline_cache;
+    }
 
-    amber::Amber am;
-    result = am.Execute(recipe, &amber_options);
+    amber::Result r = worker->config_helper.CreateConfig(
+        amber_options.engine, options.engine_major, options.engine_minor,
+        options.selected_device, features, instance_extensions,
+        device_extensions, options.disable_validation_layer,
+        options.show_version_info && i == 0, &worker->config);
+
+    if (!r.IsSuccess()) {
+      std::cout << r.Error() << std::endl;
+      return 1;
+    }
+
+    worker->options.config = worker->config.get();
+
+    // The device was created with the requirements of all recipes, so they
+    // can share a single engine. If it cannot be initialized with all of them
+    // at once, every recipe gets an engine of its own.
+    worker->use_session = worker->session
+                              .Initialize(&worker->options, features,
+                                          instance_extensions,
+                                          device_extensions)
+                              .IsSuccess();
+    workers.push_back(std::move(worker));
+  }
+
+  std::vector<ScriptTimings> script_timings;
+  if (!options.timing_report_filename.empty()) {
+    script_timings.resize(recipe_data.size());
+    for (size_t i = 0; i < recipe_data.size(); ++i)
+      script_timings[i].file = recipe_data[i].file;
+  }
+
+  std::vector<ScriptRun> runs(recipe_data.size());
+  std::mutex runs_mutex;
+  std::condition_variable run_done;
+  auto execute = [&](Worker* worker, size_t index) {
+    // Every script extracts into its own copy of the requested buffers.
+    amber::Options script_options = worker->options;
+    if (!script_timings.empty()) {
+      script_options.command_timings = &script_timings[index].timings;
+      script_options.command_statistics = &script_timings[index].statistics;
+    }
+
+    const auto* recipe = recipe_data[index].recipe.get();
+    amber::Result script_result;
+    if (worker->use_session) {
+      script_result = worker->session.Execute(recipe, &script_options);
+    } else {
+      amber::Amber am;
+      script_result = am.Execute(recipe, &script_options);
+    }
+
+    std::lock_guard<std::mutex> lock(runs_mutex);
+    runs[index].result = script_result;
+    runs[index].extractions = std::move(script_options.extractions);
+    runs[index].done = true;
+    run_done.notify_all();
+  };
+
+  // With a single worker the scripts are executed on this thread, between
+  // the reports of the previous ones.
+  std::atomic<size_t> next_script(0);
+  std::vector<std::thread> threads;
+  if (workers.size() > 1) {
+    for (auto& worker : workers) {
+      threads.emplace_back([&execute, &next_script, &recipe_data, &worker]() {
+        for (size_t i = next_script++; i < recipe_data.size();
+             i = next_script++) {
+          execute(worker.get(), i);
+        }
+      });
+    }
+  }
+
+  for (size_t script_index = 0; script_index < recipe_data.size();
+       ++script_index) {
+    const auto& file = recipe_data[script_index].file;
+
+    if (threads.empty()) {
+      execute(workers[0].get(), script_index);
+    } else {
+      std::unique_lock<std::mutex> lock(runs_mutex);
+      run_done.wait(lock, [&runs, script_index]() {
+        return runs[script_index].done;
+      });
+    }
+    const std::vector<amber::BufferInfo>& extractions =
+        runs[script_index].extractions;
+
+    result = runs[script_index].result;
     if (!result.IsSuccess()) {
       std::cerr << file << ": " << result.Error() << std::endl;
       failures.push_back(file);
@@ -549,7 +863,7 @@ int main(int argc, const char** argv) {
         std::cerr << "Cannot open file for shader dump: ";
         std::cerr << options.shader_filename << std::endl;
       } else {
-        auto info = recipe->GetShaderInfo();
+        auto info = recipe_data[script_index].recipe->GetShaderInfo();
         for (const auto& sh : info) {
           shader_file << ";;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;"
                       << std::endl;
@@ -569,7 +883,7 @@ int main(int argc, const char** argv) {
       auto pos = image_filename.find_last_of('.');
       bool usePNG =
           pos != std::string::npos && image_filename.substr(pos + 1) == "png";
-      for (const amber::BufferInfo& buffer_info : amber_options.extractions) {
+      for (const amber::BufferInfo& buffer_info : extractions) {
         if (buffer_info.buffer_name == options.fb_names[i]) {
           if (buffer_info.values.size() !=
               (buffer_info.width * buffer_info.height)) {
@@ -624,7 +938,7 @@ int main(int argc, const char** argv) {
         std::cerr << "Cannot open file for buffer dump: ";
         std::cerr << options.buffer_filename << std::endl;
       } else {
-        for (const amber::BufferInfo& buffer_info : amber_options.extractions) {
+        for (const amber::BufferInfo& buffer_info : extractions) {
           // Skip frame buffers.
           if (std::any_of(options.fb_names.begin(), options.fb_names.end(),
                           [&](std::string s) {
@@ -647,8 +961,27 @@ int main(int argc, const char** argv) {
         buffer_file.close();
       }
     }
+
+    runs[script_index].extractions.clear();
+  }
+
+  for (auto& thread : threads)
+    thread.join();
+
+  if (!options.pipeline_cache_filename.empty()) {
+    // Every worker filled a cache of its own, keep the largest one.
+    pipeline_cache = workers[0]->pipeline_cache;
+    for (const auto& worker : workers) {
+      if (worker->pipeline_cache.size() > pipeline_cache.size())
+        pipeline_cache = worker->pipeline_cache;
+    }
+    if (!pipeline_cache.empty())
+      WritePipelineCache(options.pipeline_cache_filename, pipeline_cache);
   }
 
+  if (!options.timing_report_filename.empty())
+    WriteTimingReport(options.timing_report_filename, script_timings);
+
   if (!options.quiet) {
     if (!failures.empty()) {
       std::cout << "\nSummary of Failures:" << std::endl;
@@ -657,6 +990,13 @@ int main(int argc, const char** argv) {
         std::cout << "  " << failure << std::endl;
     }
 
+    if (!options.shader_cache_dir.empty()) {
+      std::cout << "\nShader cache: " << shader_cache.GetHitCount()
+                << " hits, " << shader_cache.GetMissCount() << " misses, "
+                << shader_cache.GetBytesSaved() << " bytes reused"
+                << std::endl;
+    }
+
     std::cout << "\nSummary: "
               << (options.input_filenames.size() - failures.size()) << " pass, "
               << failures.size() << " fail" << std::endl;
@@ -617,7 +617,13 @@ ConfigHelperVulkan::ConfigHelperVulkan()
       variable_pointers_feature_(VkPhysicalDeviceVariablePointerFeaturesKHR()),
       float16_int8_feature_(VkPhysicalDeviceFloat16Int8FeaturesKHR()),
       storage_8bit_feature_(VkPhysicalDevice8BitStorageFeaturesKHR()),
-      storage_16bit_feature_(VkPhysicalDevice16BitStorageFeaturesKHR()) {}
+      storage_16bit_feature_(VkPhysicalDevice16BitStorageFeaturesKHR()),
+      extended_dynamic_state_feature_(
+          VkPhysicalDeviceExtendedDynamicStateFeaturesEXT()),
+      extended_dynamic_state2_feature_(
+          VkPhysicalDeviceExtendedDynamicState2FeaturesEXT()),
+      graphics_pipeline_library_feature_(
+          VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT()) {}
 
 ConfigHelperVulkan::~ConfigHelperVulkan() {
   if (vulkan_device_)
@@ -799,6 +805,12 @@ amber::Result ConfigHelperVulkan::CheckVulkanPhysicalDeviceRequirements(
       supports_shader_8bit_storage_ = true;
     else if (ext == "VK_KHR_16bit_storage")
       supports_shader_16bit_storage_ = true;
+    else if (ext == "VK_EXT_extended_dynamic_state")
+      supports_extended_dynamic_state_ = true;
+    else if (ext == "VK_EXT_extended_dynamic_state2")
+      supports_extended_dynamic_state2_ = true;
+    else if (ext == "VK_EXT_graphics_pipeline_library")
+      supports_graphics_pipeline_library_ = true;
   }
 
   vulkan_queue_family_index_ = ChooseQueueFamilyIndex(physical_device);
@@ -877,6 +889,26 @@ amber::Result ConfigHelperVulkan::CreateVulkanDevice(
       std::back_inserter(required_extensions_in_char),
       [](const std::string& ext) -> const char* { return ext.c_str(); });
 
+  // The extended dynamic state and pipeline library extensions are not
+  // required by any script but let the engine share pipelines and their parts
+  // between draws, so enable them whenever their features can be queried.
+  if (supports_get_physical_device_properties2_) {
+    const char* const optional_extensions[] = {
+        "VK_EXT_extended_dynamic_state", "VK_EXT_extended_dynamic_state2",
+        "VK_KHR_pipeline_library", "VK_EXT_graphics_pipeline_library"};
+    const bool supported[] = {
+        supports_extended_dynamic_state_, supports_extended_dynamic_state2_,
+        supports_graphics_pipeline_library_,
+        supports_graphics_pipeline_library_};
+    for (size_t i = 0; i < 4; ++i) {
+      if (supported[i] &&
+          std::find(required_extensions.begin(), required_extensions.end(),
+                    optional_extensions[i]) == required_extensions.end()) {
+        required_extensions_in_char.push_back(optional_extensions[i]);
+      }
+    }
+  }
+
   VkDeviceCreateInfo info = VkDeviceCreateInfo();
   info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   info.pQueueCreateInfos = &queue_info;
@@ -940,6 +972,9 @@ amber::Result ConfigHelperVulkan::CreateDeviceWithFeatures2(
     next_ptr = &storage_16bit_feature_.pNext;
   }
 
+  next_ptr = ChainExtendedDynamicStateFeatures(next_ptr);
+  next_ptr = ChainGraphicsPipelineLibraryFeatures(next_ptr);
+
   available_features2_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
   available_features2_.pNext = &variable_pointers_feature_;
 
@@ -989,6 +1024,74 @@ amber::Result ConfigHelperVulkan::CreateDeviceWithFeatures2(
   return DoCreateDevice(info);
 }
 
+void** ConfigHelperVulkan::ChainExtendedDynamicStateFeatures(void** next_ptr) {
+  extended_dynamic_state_feature_.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  extended_dynamic_state_feature_.pNext = nullptr;
+
+  extended_dynamic_state2_feature_.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+  extended_dynamic_state2_feature_.pNext = nullptr;
+
+  if (!supports_extended_dynamic_state_)
+    return next_ptr;
+
+  auto vkGetPhysicalDeviceFeatures2KHR =
+      reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+          vkGetInstanceProcAddr(vulkan_instance_,
+                                "vkGetPhysicalDeviceFeatures2KHR"));
+  if (!vkGetPhysicalDeviceFeatures2KHR)
+    return next_ptr;
+
+  // Enable whatever the device supports, the engine falls back to static
+  // pipeline state for anything left disabled.
+  VkPhysicalDeviceFeatures2KHR features2 = VkPhysicalDeviceFeatures2KHR();
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+  features2.pNext = &extended_dynamic_state_feature_;
+  if (supports_extended_dynamic_state2_) {
+    extended_dynamic_state_feature_.pNext = &extended_dynamic_state2_feature_;
+  }
+  vkGetPhysicalDeviceFeatures2KHR(vulkan_physical_device_, &features2);
+
+  // Only the base feature of each extension is used.
+  extended_dynamic_state2_feature_.extendedDynamicState2LogicOp = VK_FALSE;
+  extended_dynamic_state2_feature_.extendedDynamicState2PatchControlPoints =
+      VK_FALSE;
+
+  *next_ptr = &extended_dynamic_state_feature_;
+  next_ptr = &extended_dynamic_state_feature_.pNext;
+  if (supports_extended_dynamic_state2_) {
+    *next_ptr = &extended_dynamic_state2_feature_;
+    next_ptr = &extended_dynamic_state2_feature_.pNext;
+  }
+  return next_ptr;
+}
+
+void** ConfigHelperVulkan::ChainGraphicsPipelineLibraryFeatures(
+    void** next_ptr) {
+  graphics_pipeline_library_feature_.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+  graphics_pipeline_library_feature_.pNext = nullptr;
+
+  if (!supports_graphics_pipeline_library_)
+    return next_ptr;
+
+  auto vkGetPhysicalDeviceFeatures2KHR =
+      reinterpret_cast<PFN_vkGetPhysicalDeviceFeatures2KHR>(
+          vkGetInstanceProcAddr(vulkan_instance_,
+                                "vkGetPhysicalDeviceFeatures2KHR"));
+  if (!vkGetPhysicalDeviceFeatures2KHR)
+    return next_ptr;
+
+  VkPhysicalDeviceFeatures2KHR features2 = VkPhysicalDeviceFeatures2KHR();
+  features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR;
+  features2.pNext = &graphics_pipeline_library_feature_;
+  vkGetPhysicalDeviceFeatures2KHR(vulkan_physical_device_, &features2);
+
+  *next_ptr = &graphics_pipeline_library_feature_;
+  return &graphics_pipeline_library_feature_.pNext;
+}
+
 amber::Result ConfigHelperVulkan::DoCreateDevice(VkDeviceCreateInfo* info) {
   if (vkCreateDevice(vulkan_physical_device_, info, nullptr, &vulkan_device_) !=
       VK_SUCCESS) {
@@ -94,6 +94,15 @@ class ConfigHelperVulkan : public ConfigHelperImpl {
       const std::vector<std::string>& required_features,
       VkDeviceCreateInfo* info);
 
+  /// Queries the extended dynamic state features of the device and links the
+  /// supported ones at |next_ptr|. Returns the pNext pointer of the last
+  /// structure linked.
+  void** ChainExtendedDynamicStateFeatures(void** next_ptr);
+  /// Queries the graphics pipeline library feature of the device and links
+  /// it at |next_ptr| if supported. Returns the pNext pointer of the last
+  /// structure linked.
+  void** ChainGraphicsPipelineLibraryFeatures(void** next_ptr);
+
   /// Creates the physical device given the device |info|.
   amber::Result DoCreateDevice(VkDeviceCreateInfo* info);
 
@@ -113,12 +122,21 @@ class ConfigHelperVulkan : public ConfigHelperImpl {
   bool supports_shader_float16_int8_ = false;
   bool supports_shader_8bit_storage_ = false;
   bool supports_shader_16bit_storage_ = false;
+  bool supports_extended_dynamic_state_ = false;
+  bool supports_extended_dynamic_state2_ = false;
+  bool supports_graphics_pipeline_library_ = false;
   VkPhysicalDeviceFeatures available_features_;
   VkPhysicalDeviceFeatures2KHR available_features2_;
   VkPhysicalDeviceVariablePointerFeaturesKHR variable_pointers_feature_;
   VkPhysicalDeviceFloat16Int8FeaturesKHR float16_int8_feature_;
   VkPhysicalDevice8BitStorageFeaturesKHR storage_8bit_feature_;
   VkPhysicalDevice16BitStorageFeaturesKHR storage_16bit_feature_;
+  VkPhysicalDeviceExtendedDynamicStateFeaturesEXT
+      extended_dynamic_state_feature_;
+  VkPhysicalDeviceExtendedDynamicState2FeaturesEXT
+      extended_dynamic_state2_feature_;
+  VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT
+      graphics_pipeline_library_feature_;
 };
 
 }  // namespace sample
@@ -14,10 +14,12 @@
 
 #include "amber/amber.h"
 
+#include <algorithm>
 #include <cctype>
 #include <cstdlib>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "src/amberscript/parser.h"
 #include "src/descriptor_set_and_binding_parser.h"
@@ -60,6 +62,21 @@ Result GetFrameBuffer(Buffer* buffer, std::vector<Value>* values) {
   return {};
 }
 
+// Returns a failure naming the first of |required| which is not in
+// |available|.
+Result CheckSubset(const std::string& kind,
+                   const std::vector<std::string>& required,
+                   const std::vector<std::string>& available) {
+  for (const auto& name : required) {
+    if (std::find(available.begin(), available.end(), name) ==
+        available.end()) {
+      return Result("Session was not initialized with required " + kind +
+                    ": " + name);
+    }
+  }
+  return {};
+}
+
 }  // namespace
 
 EngineConfig::~EngineConfig() = default;
@@ -69,7 +86,15 @@ Options::Options()
       config(nullptr),
       execution_type(ExecutionType::kExecute),
       disable_spirv_validation(false),
-      delegate(nullptr) {}
+      delegate(nullptr),
+      pipeline_cache_data(nullptr),
+      shader_cache(nullptr),
+      shader_compile_threads(1),
+      pipeline_compile_threads(0),
+      batch_commands(false),
+      command_timings(nullptr),
+      command_statistics(nullptr),
+      dump_execution_plan(false) {}
 
 Options::~Options() = default;
 
@@ -81,6 +106,28 @@ BufferInfo::~BufferInfo() = default;
 
 BufferInfo& BufferInfo::operator=(const BufferInfo&) = default;
 
+CommandTiming::CommandTiming() : line(0), gpu_time_ns(0) {}
+
+CommandTiming::CommandTiming(const CommandTiming&) = default;
+
+CommandTiming::~CommandTiming() = default;
+
+CommandTiming& CommandTiming::operator=(const CommandTiming&) = default;
+
+CommandStatistics::CommandStatistics()
+    : line(0),
+      vertex_invocations(0),
+      clipping_primitives(0),
+      fragment_invocations(0),
+      compute_invocations(0) {}
+
+CommandStatistics::CommandStatistics(const CommandStatistics&) = default;
+
+CommandStatistics::~CommandStatistics() = default;
+
+CommandStatistics& CommandStatistics::operator=(const CommandStatistics&) =
+    default;
+
 Delegate::~Delegate() = default;
 
 Amber::Amber() = default;
@@ -129,6 +176,10 @@ Result CreateEngineAndCheckRequirements(const Recipe* recipe,
     return Result("Failed to create engine");
   }
 
+  engine->SetPipelineCacheData(opts->pipeline_cache_data);
+  engine->SetCommandTimings(opts->command_timings);
+  engine->SetCommandStatistics(opts->command_statistics);
+
   // Engine initialization checks requirements.  Current backends don't do
   // much else.  Refactor this if they end up doing to much here.
   Result r = engine->Initialize(opts->config, opts->delegate,
@@ -158,19 +209,17 @@ amber::Result Amber::Execute(const amber::Recipe* recipe, Options* opts) {
   return ExecuteWithShaderData(recipe, opts, map);
 }
 
-amber::Result Amber::ExecuteWithShaderData(const amber::Recipe* recipe,
-                                           Options* opts,
-                                           const ShaderMap& shader_data) {
-  std::unique_ptr<Engine> engine;
-  Script* script = nullptr;
-  Result r = CreateEngineAndCheckRequirements(recipe, opts, &engine, &script);
-  if (!r.IsSuccess())
-    return r;
-  script->SetSpvTargetEnv(opts->spv_env);
+namespace {
 
+// Executes |script| on the initialized |engine| and performs the extractions
+// requested in |opts|.
+Result ExecuteScript(Engine* engine,
+                     Script* script,
+                     Options* opts,
+                     const ShaderMap& shader_data) {
+  Result r;
   Executor executor;
-  Result executor_result =
-      executor.Execute(engine.get(), script, shader_data, opts);
+  Result executor_result = executor.Execute(engine, script, shader_data, opts);
   // Hold the executor result until the extractions are complete. This will let
   // us dump any buffers requested even on failure.
 
@@ -181,12 +230,20 @@ amber::Result Amber::ExecuteWithShaderData(const amber::Recipe* recipe,
   }
 
   // Try to perform each extraction, copying the buffer data into |buffer_info|.
-  // We do not overwrite |executor_result| if extraction fails.
+  // We do not overwrite |executor_result| if extraction fails. The first
+  // buffer which can not be read back is reported after it.
+  Result readback_result;
   for (BufferInfo& buffer_info : opts->extractions) {
     if (buffer_info.is_image_buffer) {
       auto* buffer = script->GetBuffer(buffer_info.buffer_name);
       if (!buffer)
         continue;
+      Result readback = engine->ReadbackBuffer(buffer);
+      if (!readback.IsSuccess()) {
+        if (readback_result.IsSuccess())
+          readback_result = readback;
+        continue;
+      }
 
       buffer_info.width = buffer->GetWidth();
       buffer_info.height = buffer->GetHeight();
@@ -207,10 +264,16 @@ amber::Result Amber::ExecuteWithShaderData(const amber::Recipe* recipe,
     else
       pipeline = script->GetPipelines()[0].get();
 
-    const auto* buffer =
+    auto* buffer =
         pipeline->GetBufferForBinding(p.GetDescriptorSet(), p.GetBinding());
     if (!buffer)
       continue;
+    Result readback = engine->ReadbackBuffer(buffer);
+    if (!readback.IsSuccess()) {
+      if (readback_result.IsSuccess())
+        readback_result = readback;
+      continue;
+    }
 
     const uint8_t* ptr = buffer->ValuePtr()->data();
     auto& values = buffer_info.values;
@@ -223,10 +286,104 @@ amber::Result Amber::ExecuteWithShaderData(const amber::Recipe* recipe,
 
   if (!executor_result.IsSuccess())
     return executor_result;
+  if (!readback_result.IsSuccess())
+    return readback_result;
   if (!r.IsSuccess())
     return r;
 
   return {};
 }
 
+}  // namespace
+
+amber::Result Amber::ExecuteWithShaderData(const amber::Recipe* recipe,
+                                           Options* opts,
+                                           const ShaderMap& shader_data) {
+  std::unique_ptr<Engine> engine;
+  Script* script = nullptr;
+  Result r = CreateEngineAndCheckRequirements(recipe, opts, &engine, &script);
+  if (!r.IsSuccess())
+    return r;
+  script->SetSpvTargetEnv(opts->spv_env);
+
+  return ExecuteScript(engine.get(), script, opts, shader_data);
+}
+
+Session::Session() = default;
+
+Session::~Session() = default;
+
+amber::Result Session::Initialize(
+    Options* opts,
+    const std::vector<std::string>& features,
+    const std::vector<std::string>& instance_extensions,
+    const std::vector<std::string>& device_extensions) {
+  if (engine_)
+    return Result("Session is already initialized");
+
+  auto engine = Engine::Create(opts->engine);
+  if (!engine)
+    return Result("Failed to create engine");
+
+  engine->SetPipelineCacheData(opts->pipeline_cache_data);
+  Result r = engine->Initialize(opts->config, opts->delegate, features,
+                                instance_extensions, device_extensions);
+  if (!r.IsSuccess())
+    return r;
+
+  engine_ = std::move(engine);
+  features_ = features;
+  instance_extensions_ = instance_extensions;
+  device_extensions_ = device_extensions;
+  return {};
+}
+
+amber::Result Session::AreAllRequirementsSupported(
+    const amber::Recipe* recipe) const {
+  if (!recipe)
+    return Result("Attempting to check an invalid recipe");
+
+  Result r = CheckSubset("feature", recipe->GetRequiredFeatures(), features_);
+  if (!r.IsSuccess())
+    return r;
+  r = CheckSubset("instance extension",
+                  recipe->GetRequiredInstanceExtensions(),
+                  instance_extensions_);
+  if (!r.IsSuccess())
+    return r;
+  return CheckSubset("device extension", recipe->GetRequiredDeviceExtensions(),
+                     device_extensions_);
+}
+
+amber::Result Session::Execute(const amber::Recipe* recipe, Options* opts) {
+  ShaderMap map;
+  return ExecuteWithShaderData(recipe, opts, map);
+}
+
+amber::Result Session::ExecuteWithShaderData(const amber::Recipe* recipe,
+                                             Options* opts,
+                                             const ShaderMap& shader_data) {
+  if (!engine_)
+    return Result("Session must be initialized before executing recipes");
+
+  Result r = AreAllRequirementsSupported(recipe);
+  if (!r.IsSuccess())
+    return r;
+
+  Script* script = static_cast<Script*>(recipe->GetImpl());
+  if (!script)
+    return Result("Recipe must contain a parsed script");
+
+  script->SetSpvTargetEnv(opts->spv_env);
+  engine_->SetCommandTimings(opts->command_timings);
+  engine_->SetCommandStatistics(opts->command_statistics);
+
+  r = ExecuteScript(engine_.get(), script, opts, shader_data);
+
+  // The engine must not keep anything referring to |script|, which may be
+  // destroyed before the next recipe is executed.
+  Result reset_result = engine_->Reset();
+  return r.IsSuccess() ? reset_result : r;
+}
+
 }  // namespace amber
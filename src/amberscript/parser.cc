@@ -14,6 +14,7 @@
 
 #include "src/amberscript/parser.h"
 
+#include <algorithm>
 #include <cassert>
 #include <limits>
 #include <map>
@@ -316,6 +317,19 @@ Result Parser::ToPipelineType(const std::string& str, PipelineType* type) {
   return {};
 }
 
+Result Parser::ToMemoryPlacement(const std::string& str,
+                                 MemoryPlacement* placement) {
+  assert(placement);
+
+  if (str == "HOST_VISIBLE")
+    *placement = MemoryPlacement::kHostVisible;
+  else if (str == "DEVICE_LOCAL")
+    *placement = MemoryPlacement::kDeviceLocal;
+  else
+    return Result("unknown memory placement: " + str);
+  return {};
+}
+
 Result Parser::ValidateEndOfStatement(const std::string& name) {
   auto token = tokenizer_->NextToken();
   if (token->IsEOL() || token->IsEOS())
@@ -448,6 +462,8 @@ Result Parser::ParsePipelineBody(const std::string& cmd_name,
       r = ParsePipelineShaderCompileOptions(pipeline.get());
     } else if (tok == "POLYGON_MODE") {
       r = ParsePipelinePolygonMode(pipeline.get());
+    } else if (tok == "PIPELINE_STATISTICS") {
+      r = ParsePipelineStatistics(pipeline.get());
     } else {
       r = Result("unknown token in pipeline block: " + tok);
     }
@@ -1069,6 +1085,18 @@ Result Parser::ParsePipelinePolygonMode(Pipeline* pipeline) {
   return ValidateEndOfStatement("POLYGON_MODE command");
 }
 
+Result Parser::ParsePipelineStatistics(Pipeline* pipeline) {
+  pipeline->SetPipelineStatisticsEnabled(true);
+
+  // The queries can only be used if the device enables the feature.
+  const std::string feature = "pipelineStatisticsQuery";
+  const auto features = script_->GetRequiredFeatures();
+  if (std::find(features.begin(), features.end(), feature) == features.end())
+    script_->AddRequiredFeature(feature);
+
+  return ValidateEndOfStatement("PIPELINE_STATISTICS command");
+}
+
 Result Parser::ParseStruct() {
   auto token = tokenizer_->NextToken();
   if (!token->IsIdentifier())
@@ -1200,6 +1228,24 @@ Result Parser::ParseBuffer() {
   if (!token->IsIdentifier())
     return Result("invalid BUFFER command provided");
 
+  MemoryPlacement placement = MemoryPlacement::kDefault;
+  if (token->AsString() == "MEMORY") {
+    token = tokenizer_->NextToken();
+    if (token->IsEOS() || token->IsEOL())
+      return Result("BUFFER missing MEMORY placement");
+
+    if (!token->IsIdentifier())
+      return Result("invalid BUFFER MEMORY placement");
+
+    Result r = ToMemoryPlacement(token->AsString(), &placement);
+    if (!r.IsSuccess())
+      return r;
+
+    token = tokenizer_->NextToken();
+    if (!token->IsIdentifier())
+      return Result("invalid BUFFER command provided");
+  }
+
   std::unique_ptr<Buffer> buffer;
   auto& cmd = token->AsString();
   if (cmd == "DATA_TYPE") {
@@ -1237,6 +1283,7 @@ Result Parser::ParseBuffer() {
     return Result("unknown BUFFER command provided: " + cmd);
   }
   buffer->SetName(name);
+  buffer->SetMemoryPlacement(placement);
 
   Result r = script_->AddBuffer(std::move(buffer));
   if (!r.IsSuccess())
@@ -1496,15 +1543,17 @@ Result Parser::ParseBufferInitializerFill(Buffer* buffer,
   // Inflate the size because our items are multi-dimensional.
   size_in_items = size_in_items * fmt->InputNeededPerElement();
 
-  std::vector<Value> values;
-  values.resize(size_in_items);
-  for (size_t i = 0; i < size_in_items; ++i) {
-    if (is_double_data)
-      values[i].SetDoubleValue(token->AsDouble());
-    else
-      values[i].SetIntValue(token->AsUint64());
-  }
-  Result r = buffer->SetData(std::move(values));
+  Value value;
+  if (is_double_data)
+    value.SetDoubleValue(token->AsDouble());
+  else
+    value.SetIntValue(token->AsUint64());
+
+  BufferWriter writer(buffer, size_in_items);
+  for (size_t i = 0; i < size_in_items; ++i)
+    writer.Write(value);
+
+  Result r = writer.Finish();
   if (!r.IsSuccess())
     return r;
 
@@ -1547,21 +1596,17 @@ Result Parser::ParseBufferInitializerSeries(Buffer* buffer,
   if (!token->IsInteger() && !token->IsDouble())
     return Result("invalid BUFFER series_from inc_by value");
 
-  std::vector<Value> values;
-  values.resize(size_in_items);
+  BufferWriter writer(buffer, size_in_items);
   for (size_t i = 0; i < size_in_items; ++i) {
+    writer.Write(counter);
     if (type::Type::IsFloat32(mode, num_bits) ||
         type::Type::IsFloat64(mode, num_bits)) {
-      double value = counter.AsDouble();
-      values[i].SetDoubleValue(value);
-      counter.SetDoubleValue(value + token->AsDouble());
+      counter.SetDoubleValue(counter.AsDouble() + token->AsDouble());
     } else {
-      uint64_t value = counter.AsUint64();
-      values[i].SetIntValue(value);
-      counter.SetIntValue(value + token->AsUint64());
+      counter.SetIntValue(counter.AsUint64() + token->AsUint64());
     }
   }
-  Result r = buffer->SetData(std::move(values));
+  Result r = writer.Finish();
   if (!r.IsSuccess())
     return r;
 
@@ -1574,7 +1619,7 @@ Result Parser::ParseBufferInitializerData(Buffer* buffer) {
   size_t seg_idx = 0;
   uint32_t value_count = 0;
 
-  std::vector<Value> values;
+  BufferWriter writer(buffer, 0);
   for (auto token = tokenizer_->NextToken();; token = tokenizer_->NextToken()) {
     if (token->IsEOL())
       continue;
@@ -1613,7 +1658,7 @@ Result Parser::ParseBufferInitializerData(Buffer* buffer) {
     if (seg_idx >= segs.size())
       seg_idx = 0;
 
-    values.emplace_back(v);
+    writer.Write(v);
   }
   // Write final padding bytes
   while (segs[seg_idx].IsPadding()) {
@@ -1623,7 +1668,7 @@ Result Parser::ParseBufferInitializerData(Buffer* buffer) {
   }
 
   buffer->SetValueCount(value_count);
-  Result r = buffer->SetData(std::move(values));
+  Result r = writer.Finish();
   if (!r.IsSuccess())
     return r;
 
@@ -2199,9 +2244,14 @@ Result Parser::ParseExpect() {
 
   size_t line = tokenizer_->GetCurrentLine();
   auto* buffer = script_->GetBuffer(token->AsString());
-  if (!buffer)
+  if (!buffer) {
+    auto* pipeline = script_->GetPipeline(token->AsString());
+    if (pipeline)
+      return ParseExpectStatistics(pipeline);
+
     return Result("unknown buffer name for EXPECT command: " +
                   token->AsString());
+  }
 
   token = tokenizer_->NextToken();
 
@@ -2456,6 +2506,60 @@ Result Parser::ParseExpect() {
   return {};
 }
 
+Result Parser::ParseExpectStatistics(Pipeline* pipeline) {
+  size_t line = tokenizer_->GetCurrentLine();
+
+  auto token = tokenizer_->NextToken();
+  if (!token->IsIdentifier() || token->AsString() != "STATISTICS")
+    return Result("missing STATISTICS in EXPECT command for pipeline");
+
+  if (!pipeline->IsPipelineStatisticsEnabled()) {
+    return Result(
+        "EXPECT STATISTICS requires PIPELINE_STATISTICS on pipeline: " +
+        pipeline->GetName());
+  }
+
+  token = tokenizer_->NextToken();
+  if (!token->IsIdentifier())
+    return Result("missing counter in EXPECT STATISTICS command");
+
+  auto cmd = MakeUnique<ExpectStatisticsCommand>(pipeline);
+  cmd->SetLine(line);
+
+  const std::string counter = token->AsString();
+  bool is_compute_counter = false;
+  if (counter == "vertex_invocations") {
+    cmd->SetCounter(ExpectStatisticsCommand::Counter::kVertexInvocations);
+  } else if (counter == "clipping_primitives") {
+    cmd->SetCounter(ExpectStatisticsCommand::Counter::kClippingPrimitives);
+  } else if (counter == "fragment_invocations") {
+    cmd->SetCounter(ExpectStatisticsCommand::Counter::kFragmentInvocations);
+  } else if (counter == "compute_invocations") {
+    cmd->SetCounter(ExpectStatisticsCommand::Counter::kComputeInvocations);
+    is_compute_counter = true;
+  } else {
+    return Result("unknown counter in EXPECT STATISTICS command: " + counter);
+  }
+  if (is_compute_counter != pipeline->IsCompute()) {
+    return Result("counter " + counter +
+                  " is not available for the pipeline type in EXPECT "
+                  "STATISTICS command");
+  }
+
+  token = tokenizer_->NextToken();
+  if (!token->IsIdentifier() || !IsComparator(token->AsString()))
+    return Result("invalid comparator in EXPECT STATISTICS command");
+  cmd->SetComparator(ToComparator(token->AsString()));
+
+  token = tokenizer_->NextToken();
+  if (!token->IsInteger() || token->AsInt64() < 0)
+    return Result("invalid value in EXPECT STATISTICS command");
+  cmd->SetValue(token->AsUint64());
+
+  command_list_.push_back(std::move(cmd));
+  return ValidateEndOfStatement("EXPECT STATISTICS command");
+}
+
 Result Parser::ParseCopy() {
   auto token = tokenizer_->NextToken();
   if (token->IsEOL() || token->IsEOS())
@@ -2587,6 +2691,8 @@ Result Parser::ParseDeviceFeature() {
 }
 
 Result Parser::ParseRepeat() {
+  size_t line = tokenizer_->GetCurrentLine();
+
   auto token = tokenizer_->NextToken();
   if (token->IsEOL() || token->IsEOL())
     return Result("missing count parameter for REPEAT command");
@@ -2623,6 +2729,7 @@ Result Parser::ParseRepeat() {
     return Result("missing END for REPEAT command");
 
   auto cmd = MakeUnique<RepeatCommand>(count);
+  cmd->SetLine(line);
   cmd->SetCommands(std::move(command_list_));
 
   std::swap(cur_commands, command_list_);
@@ -2702,6 +2809,23 @@ Result Parser::ParseSet() {
   if (!token->IsIdentifier())
     return Result("SET invalid variable to set: " + token->ToOriginalString());
 
+  if (token->AsString() == "buffer_memory") {
+    token = tokenizer_->NextToken();
+    if (token->IsEOS() || token->IsEOL())
+      return Result("SET missing value for buffer_memory");
+
+    if (!token->IsIdentifier())
+      return Result("SET invalid value for buffer_memory");
+
+    MemoryPlacement placement = MemoryPlacement::kDefault;
+    Result r = ToMemoryPlacement(token->AsString(), &placement);
+    if (!r.IsSuccess())
+      return r;
+
+    script_->GetEngineData().buffer_memory = placement;
+    return ValidateEndOfStatement("SET command");
+  }
+
   if (token->AsString() != "fence_timeout_ms")
     return Result("SET unknown variable provided: " + token->AsString());
 
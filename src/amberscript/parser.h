@@ -46,6 +46,7 @@ class Parser : public amber::Parser {
   Result ToBufferType(const std::string& str, BufferType* type);
   Result ToShaderFormat(const std::string& str, ShaderFormat* fmt);
   Result ToPipelineType(const std::string& str, PipelineType* type);
+  Result ToMemoryPlacement(const std::string& str, MemoryPlacement* placement);
   Result ValidateEndOfStatement(const std::string& name);
 
   Result ParseStruct();
@@ -67,6 +68,7 @@ class Parser : public amber::Parser {
   Result ParsePipelineIndexData(Pipeline*);
   Result ParsePipelineSet(Pipeline*);
   Result ParsePipelinePolygonMode(Pipeline*);
+  Result ParsePipelineStatistics(Pipeline*);
   Result ParseRun();
   Result ParseDebug();
   Result ParseDebugThread(debug::Events*);
@@ -74,6 +76,7 @@ class Parser : public amber::Parser {
   Result ParseClear();
   Result ParseClearColor();
   Result ParseExpect();
+  Result ParseExpectStatistics(Pipeline*);
   Result ParseCopy();
   Result ParseDeviceFeature();
   Result ParseDeviceExtension();
@@ -574,6 +574,25 @@ TEST_F(AmberScriptParserTest, BufferFormat) {
   }
 }
 
+TEST_F(AmberScriptParserTest, BufferMemoryPlacement) {
+  std::string in = R"(
+BUFFER host_buf MEMORY HOST_VISIBLE DATA_TYPE uint32 SIZE 4 FILL 0
+BUFFER device_buf MEMORY DEVICE_LOCAL FORMAT R32G32B32A32_SFLOAT
+BUFFER default_buf DATA_TYPE uint32 SIZE 4 FILL 0)";
+
+  Parser parser;
+  Result r = parser.Parse(in);
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+
+  auto script = parser.GetScript();
+  const auto& buffers = script->GetBuffers();
+  ASSERT_EQ(3U, buffers.size());
+  EXPECT_EQ(MemoryPlacement::kHostVisible, buffers[0]->GetMemoryPlacement());
+  EXPECT_EQ(MemoryPlacement::kDeviceLocal, buffers[1]->GetMemoryPlacement());
+  EXPECT_EQ(MemoryPlacement::kDefault, buffers[2]->GetMemoryPlacement());
+  EXPECT_EQ(4U, buffers[0]->ElementCount());
+}
+
 struct BufferParseError {
   const char* in;
   const char* err;
@@ -610,6 +629,14 @@ INSTANTIATE_TEST_SUITE_P(
                          "1: invalid BUFFER command provided"},
         BufferParseError{"BUFFER my_buf INVALID",
                          "1: unknown BUFFER command provided: INVALID"},
+        BufferParseError{"BUFFER my_buf MEMORY",
+                         "1: BUFFER missing MEMORY placement"},
+        BufferParseError{"BUFFER my_buf MEMORY 1 DATA_TYPE uint8 SIZE 5 FILL 5",
+                         "1: invalid BUFFER MEMORY placement"},
+        BufferParseError{"BUFFER my_buf MEMORY CACHED DATA_TYPE uint8",
+                         "1: unknown memory placement: CACHED"},
+        BufferParseError{"BUFFER my_buf MEMORY DEVICE_LOCAL",
+                         "1: invalid BUFFER command provided"},
         BufferParseError{"BUFFER my_buf DATA_TYPE uint8 SIZE INVALID FILL 5",
                          "1: BUFFER size invalid"},
         BufferParseError{"BUFFER my_buf DATA_TYPE uint8 SIZE FILL 5",
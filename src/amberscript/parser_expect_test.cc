@@ -1278,5 +1278,160 @@ EXPECT buf_1 RMSE_BUFFER buf_2)";
       r.Error());
 }
 
+TEST_F(AmberScriptParserTest, ExpectStatistics) {
+  std::string in = R"(
+SHADER vertex my_shader PASSTHROUGH
+SHADER fragment my_fragment GLSL
+# GLSL Shader
+END
+
+PIPELINE graphics my_pipeline
+  ATTACH my_shader
+  ATTACH my_fragment
+  PIPELINE_STATISTICS
+END
+
+RUN my_pipeline DRAW_RECT POS 0 0 SIZE 10 10
+EXPECT my_pipeline STATISTICS fragment_invocations LT 200)";
+
+  Parser parser;
+  Result r = parser.Parse(in);
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+
+  auto script = parser.GetScript();
+  const auto& commands = script->GetCommands();
+  ASSERT_EQ(2U, commands.size());
+  ASSERT_TRUE(commands[1]->IsExpectStatistics());
+
+  auto* cmd = commands[1]->AsExpectStatistics();
+  EXPECT_EQ(script->GetPipeline("my_pipeline"), cmd->GetPipeline());
+  EXPECT_EQ(ExpectStatisticsCommand::Counter::kFragmentInvocations,
+            cmd->GetCounter());
+  EXPECT_EQ(ProbeSSBOCommand::Comparator::kLess, cmd->GetComparator());
+  EXPECT_EQ(200U, cmd->GetValue());
+  EXPECT_EQ(14U, cmd->GetLine());
+}
+
+TEST_F(AmberScriptParserTest, ExpectStatisticsCounters) {
+  struct {
+    const char* name;
+    ExpectStatisticsCommand::Counter counter;
+  } counters[] = {
+      {"vertex_invocations",
+       ExpectStatisticsCommand::Counter::kVertexInvocations},
+      {"clipping_primitives",
+       ExpectStatisticsCommand::Counter::kClippingPrimitives},
+      {"fragment_invocations",
+       ExpectStatisticsCommand::Counter::kFragmentInvocations},
+  };
+
+  for (const auto& data : counters) {
+    std::string in = R"(
+SHADER vertex my_shader PASSTHROUGH
+SHADER fragment my_fragment GLSL
+# GLSL Shader
+END
+
+PIPELINE graphics my_pipeline
+  ATTACH my_shader
+  ATTACH my_fragment
+  PIPELINE_STATISTICS
+END
+
+EXPECT my_pipeline STATISTICS )" +
+                     std::string(data.name) + " EQ 4";
+
+    Parser parser;
+    Result r = parser.Parse(in);
+    ASSERT_TRUE(r.IsSuccess()) << data.name << ": " << r.Error();
+
+    auto script = parser.GetScript();
+    const auto& commands = script->GetCommands();
+    ASSERT_EQ(1U, commands.size());
+    ASSERT_TRUE(commands[0]->IsExpectStatistics());
+    EXPECT_EQ(data.counter, commands[0]->AsExpectStatistics()->GetCounter());
+  }
+}
+
+TEST_F(AmberScriptParserTest, ExpectStatisticsCompute) {
+  std::string in = R"(
+SHADER compute my_shader GLSL
+# GLSL Shader
+END
+
+PIPELINE compute my_pipeline
+  ATTACH my_shader
+  PIPELINE_STATISTICS
+END
+
+EXPECT my_pipeline STATISTICS compute_invocations GE 64)";
+
+  Parser parser;
+  Result r = parser.Parse(in);
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+
+  auto script = parser.GetScript();
+  const auto& commands = script->GetCommands();
+  ASSERT_EQ(1U, commands.size());
+  ASSERT_TRUE(commands[0]->IsExpectStatistics());
+
+  auto* cmd = commands[0]->AsExpectStatistics();
+  EXPECT_EQ(ExpectStatisticsCommand::Counter::kComputeInvocations,
+            cmd->GetCounter());
+  EXPECT_EQ(ProbeSSBOCommand::Comparator::kGreaterOrEqual,
+            cmd->GetComparator());
+  EXPECT_EQ(64U, cmd->GetValue());
+}
+
+TEST_F(AmberScriptParserTest, ExpectStatisticsInvalid) {
+  struct {
+    const char* expect;
+    const char* error;
+  } tests[] = {
+      {"EXPECT my_pipeline IDX 0 EQ 1",
+       "missing STATISTICS in EXPECT command for pipeline"},
+      {"EXPECT my_pipeline STATISTICS",
+       "missing counter in EXPECT STATISTICS command"},
+      {"EXPECT my_pipeline STATISTICS vertex_invocations EQ 1",
+       "counter vertex_invocations is not available for the pipeline type in "
+       "EXPECT STATISTICS command"},
+      {"EXPECT my_pipeline STATISTICS unknown EQ 1",
+       "unknown counter in EXPECT STATISTICS command: unknown"},
+      {"EXPECT my_pipeline STATISTICS compute_invocations EQ_RGB 1",
+       "invalid comparator in EXPECT STATISTICS command"},
+      {"EXPECT my_pipeline STATISTICS compute_invocations EQ -1",
+       "invalid value in EXPECT STATISTICS command"},
+      {"EXPECT my_pipeline STATISTICS compute_invocations EQ 1.5",
+       "invalid value in EXPECT STATISTICS command"},
+      {"EXPECT my_pipeline STATISTICS compute_invocations EQ 1 2",
+       "extra parameters after EXPECT STATISTICS command: 2"},
+      {"EXPECT other_pipeline STATISTICS compute_invocations EQ 1",
+       "EXPECT STATISTICS requires PIPELINE_STATISTICS on pipeline: "
+       "other_pipeline"},
+  };
+
+  for (const auto& test : tests) {
+    std::string in = R"(
+SHADER compute my_shader GLSL
+# GLSL Shader
+END
+
+PIPELINE compute my_pipeline
+  ATTACH my_shader
+  PIPELINE_STATISTICS
+END
+PIPELINE compute other_pipeline
+  ATTACH my_shader
+END
+
+)" + std::string(test.expect);
+
+    Parser parser;
+    Result r = parser.Parse(in);
+    ASSERT_FALSE(r.IsSuccess()) << test.expect;
+    EXPECT_EQ("14: " + std::string(test.error), r.Error()) << test.expect;
+  }
+}
+
 }  // namespace amberscript
 }  // namespace amber
@@ -541,5 +541,52 @@ END
   EXPECT_EQ(4, s2[0].GetSpecialization().at(3));
 }
 
+TEST_F(AmberScriptParserTest, PipelineStatistics) {
+  std::string in = R"(
+SHADER compute my_shader GLSL
+# GLSL Shader
+END
+
+PIPELINE compute my_pipeline
+  ATTACH my_shader
+  PIPELINE_STATISTICS
+END
+PIPELINE compute other_pipeline
+  ATTACH my_shader
+END)";
+
+  Parser parser;
+  Result r = parser.Parse(in);
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+
+  auto script = parser.GetScript();
+  const auto& pipelines = script->GetPipelines();
+  ASSERT_EQ(2U, pipelines.size());
+  EXPECT_TRUE(pipelines[0]->IsPipelineStatisticsEnabled());
+  EXPECT_FALSE(pipelines[1]->IsPipelineStatisticsEnabled());
+
+  const auto features = script->GetRequiredFeatures();
+  ASSERT_EQ(1U, features.size());
+  EXPECT_EQ("pipelineStatisticsQuery", features[0]);
+}
+
+TEST_F(AmberScriptParserTest, PipelineStatisticsExtraParameter) {
+  std::string in = R"(
+SHADER compute my_shader GLSL
+# GLSL Shader
+END
+
+PIPELINE compute my_pipeline
+  ATTACH my_shader
+  PIPELINE_STATISTICS on
+END)";
+
+  Parser parser;
+  Result r = parser.Parse(in);
+  ASSERT_FALSE(r.IsSuccess());
+  EXPECT_EQ("8: extra parameters after PIPELINE_STATISTICS command: on",
+            r.Error());
+}
+
 }  // namespace amberscript
 }  // namespace amber
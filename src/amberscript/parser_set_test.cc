@@ -97,5 +97,63 @@ TEST_F(AmberScriptParserTest, SetFenceTimeoutExtraParams) {
   EXPECT_EQ("1: extra parameters after SET command: EXTRA", r.Error());
 }
 
+TEST_F(AmberScriptParserTest, SetBufferMemory) {
+  std::string in = "SET ENGINE_DATA buffer_memory HOST_VISIBLE";
+
+  Parser parser;
+  Result r = parser.Parse(in);
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+
+  auto script = parser.GetScript();
+  EXPECT_EQ(MemoryPlacement::kHostVisible,
+            script->GetEngineData().buffer_memory);
+}
+
+TEST_F(AmberScriptParserTest, SetBufferMemoryDefault) {
+  Parser parser;
+  Result r = parser.Parse("");
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+
+  auto script = parser.GetScript();
+  EXPECT_EQ(MemoryPlacement::kDeviceLocal,
+            script->GetEngineData().buffer_memory);
+}
+
+TEST_F(AmberScriptParserTest, SetBufferMemoryMissingValue) {
+  std::string in = "SET ENGINE_DATA buffer_memory";
+
+  Parser parser;
+  Result r = parser.Parse(in);
+  ASSERT_FALSE(r.IsSuccess());
+  EXPECT_EQ("1: SET missing value for buffer_memory", r.Error());
+}
+
+TEST_F(AmberScriptParserTest, SetBufferMemoryInvalidValue) {
+  std::string in = "SET ENGINE_DATA buffer_memory 5";
+
+  Parser parser;
+  Result r = parser.Parse(in);
+  ASSERT_FALSE(r.IsSuccess());
+  EXPECT_EQ("1: SET invalid value for buffer_memory", r.Error());
+}
+
+TEST_F(AmberScriptParserTest, SetBufferMemoryUnknownValue) {
+  std::string in = "SET ENGINE_DATA buffer_memory CACHED";
+
+  Parser parser;
+  Result r = parser.Parse(in);
+  ASSERT_FALSE(r.IsSuccess());
+  EXPECT_EQ("1: unknown memory placement: CACHED", r.Error());
+}
+
+TEST_F(AmberScriptParserTest, SetBufferMemoryExtraParams) {
+  std::string in = "SET ENGINE_DATA buffer_memory DEVICE_LOCAL EXTRA";
+
+  Parser parser;
+  Result r = parser.Parse(in);
+  ASSERT_FALSE(r.IsSuccess());
+  EXPECT_EQ("1: extra parameters after SET command: EXTRA", r.Error());
+}
+
 }  // namespace amberscript
 }  // namespace amber
@@ -84,6 +84,7 @@ Result Buffer::CopyTo(Buffer* buffer) const {
   if (buffer->element_count_ != element_count_)
     return Result("Buffer::CopyBaseFields() buffers have a different size");
   buffer->bytes_ = bytes_;
+  buffer->MarkDirty(0, static_cast<uint32_t>(bytes_.size()));
   return {};
 }
 
@@ -298,8 +299,11 @@ Result Buffer::SetDataWithOffset(const std::vector<Value>& data,
   // The buffer should only be resized to become bigger. This means that if a
   // command was run to set the buffer size we'll honour that size until a
   // request happens to make the buffer bigger.
-  if (value_count > ValueCount())
+  if (value_count > ValueCount()) {
     SetValueCount(value_count);
+    // All of a grown buffer has to be uploaded again.
+    MarkDirty(0, GetSizeInBytes());
+  }
 
   // Even if the value count doesn't change, the buffer is still resized because
   // this maybe the first time data is set into the buffer.
@@ -317,7 +321,8 @@ Result Buffer::SetDataWithOffset(const std::vector<Value>& data,
   if (data.size() > (ElementCount() * format_->InputNeededPerElement()))
     return Result("Mismatched number of items in buffer");
 
-  uint8_t* ptr = bytes_.data() + offset;
+  uint8_t* const start = bytes_.data() + offset;
+  uint8_t* ptr = start;
   const auto& segments = format_->GetSegments();
   for (uint32_t i = 0; i < data.size();) {
     for (const auto& seg : segments) {
@@ -333,9 +338,34 @@ Result Buffer::SetDataWithOffset(const std::vector<Value>& data,
         break;
     }
   }
+  MarkDirty(offset, std::max(new_space, static_cast<uint32_t>(ptr - start)));
   return {};
 }
 
+void Buffer::MarkDirty(uint32_t offset, uint32_t size) {
+  if (size == 0)
+    return;
+
+  uint32_t end = offset + size;
+  auto it = dirty_ranges_.begin();
+  while (it != dirty_ranges_.end() && it->offset + it->size < offset)
+    ++it;
+
+  // Swallow all ranges overlapping or touching the new one.
+  auto last = it;
+  while (last != dirty_ranges_.end() && last->offset <= end) {
+    offset = std::min(offset, last->offset);
+    end = std::max(end, last->offset + last->size);
+    ++last;
+  }
+  it = dirty_ranges_.erase(it, last);
+
+  BufferRange range;
+  range.offset = offset;
+  range.size = end - offset;
+  dirty_ranges_.insert(it, range);
+}
+
 uint32_t Buffer::WriteValueFromComponent(const Value& value,
                                          FormatMode mode,
                                          uint32_t num_bits,
@@ -390,15 +420,76 @@ uint32_t Buffer::WriteValueFromComponent(const Value& value,
   return 0;
 }
 
+BufferWriter::BufferWriter(Buffer* buffer, uint32_t value_count)
+    : buffer_(buffer), segments_(&buffer->GetFormat()->GetSegments()) {
+  const Format* fmt = buffer_->GetFormat();
+  uint32_t element_count = value_count;
+  if (!fmt->IsPacked()) {
+    element_count = (value_count + fmt->InputNeededPerElement() - 1) /
+                    fmt->InputNeededPerElement();
+  }
+  buffer_->bytes_.reserve(element_count * fmt->SizeInBytes());
+}
+
+BufferWriter::~BufferWriter() = default;
+
+void BufferWriter::Write(const Value& value) {
+  auto& bytes = buffer_->bytes_;
+
+  // Grow the storage a whole element at a time, the new bytes are zeroed
+  // which takes care of any padding.
+  const size_t element_end = offset_ + buffer_->GetElementStride();
+  if (segment_idx_ == 0 && bytes.size() < element_end)
+    bytes.resize(element_end);
+
+  while ((*segments_)[segment_idx_].IsPadding()) {
+    offset_ += (*segments_)[segment_idx_].PaddingBytes();
+    ++segment_idx_;
+  }
+
+  const auto& seg = (*segments_)[segment_idx_];
+  offset_ += buffer_->WriteValueFromComponent(
+      value, seg.GetFormatMode(), seg.GetNumBits(), bytes.data() + offset_);
+  ++value_count_;
+
+  // Skip the padding at the end of the element, so the next value starts a
+  // new element.
+  ++segment_idx_;
+  while (segment_idx_ < segments_->size() &&
+         (*segments_)[segment_idx_].IsPadding()) {
+    offset_ += (*segments_)[segment_idx_].PaddingBytes();
+    ++segment_idx_;
+  }
+  if (segment_idx_ >= segments_->size())
+    segment_idx_ = 0;
+}
+
+Result BufferWriter::Finish() {
+  // The buffer is only resized to become bigger, matching Buffer::SetData().
+  if (value_count_ > buffer_->ValueCount())
+    buffer_->SetValueCount(value_count_);
+
+  buffer_->bytes_.resize(buffer_->GetSizeInBytes());
+  buffer_->MarkDirty(0, buffer_->GetSizeInBytes());
+
+  if (value_count_ > buffer_->ElementCount() *
+                         buffer_->GetFormat()->InputNeededPerElement()) {
+    return Result("Mismatched number of items in buffer");
+  }
+  return {};
+}
+
 void Buffer::SetSizeInElements(uint32_t element_count) {
   element_count_ = element_count;
   bytes_.resize(element_count * format_->SizeInBytes());
+  MarkDirty(0, GetSizeInBytes());
 }
 
 void Buffer::SetSizeInBytes(uint32_t size_in_bytes) {
   assert(size_in_bytes % format_->SizeInBytes() == 0);
   element_count_ = size_in_bytes / format_->SizeInBytes();
   bytes_.resize(size_in_bytes);
+  MarkDirty(0, size_in_bytes);
 }
 
 void Buffer::SetMaxSizeInBytes(uint32_t max_size_in_bytes) {
@@ -417,6 +508,7 @@ Result Buffer::SetDataFromBuffer(const Buffer* src, uint32_t offset) {
     bytes_.resize(offset + src->bytes_.size());
 
   std::memcpy(bytes_.data() + offset, src->bytes_.data(), src->bytes_.size());
+  MarkDirty(offset, static_cast<uint32_t>(src->bytes_.size()));
   element_count_ =
       static_cast<uint32_t>(bytes_.size()) / format_->SizeInBytes();
   return {};
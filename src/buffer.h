@@ -15,8 +15,10 @@
 #ifndef SRC_BUFFER_H_
 #define SRC_BUFFER_H_
 
+#include <cstddef>
 #include <cstdint>
 #include <memory>
+#include <new>
 #include <string>
 #include <utility>
 #include <vector>
@@ -56,6 +58,93 @@ enum class BufferType : int8_t {
   kStorageImage
 };
 
+/// Where the engine places the memory backing a buffer.
+enum class MemoryPlacement : int8_t {
+  /// Use the placement set for the script in the engine data.
+  kDefault = 0,
+  /// Memory the host can access directly.
+  kHostVisible,
+  /// Memory local to the device. Data is transferred through a host visible
+  /// staging buffer.
+  kDeviceLocal
+};
+
+/// Storage of at least this many bytes is aligned for import by the engine.
+const size_t kBufferStorageImportThreshold = 1024 * 1024;
+/// The alignment, and padding, of storage large enough to be imported.
+const size_t kBufferStorageImportAlignment = 64 * 1024;
+
+/// Allocates the storage of buffers. Allocations of at least
+/// |kBufferStorageImportThreshold| bytes start on a
+/// |kBufferStorageImportAlignment| boundary and are padded to a multiple of
+/// it, so an engine can use the storage directly as device memory instead of
+/// copying it in and out of device memory on every run.
+template <typename T>
+class BufferStorageAllocator {
+ public:
+  using value_type = T;
+
+  BufferStorageAllocator() = default;
+  template <typename U>
+  BufferStorageAllocator(const BufferStorageAllocator<U>&) {}
+
+  /// Returns the number of bytes usable from the start of an allocation of
+  /// |n| elements.
+  static size_t GetPaddedSize(size_t n) {
+    const size_t bytes = n * sizeof(T);
+    if (bytes < kBufferStorageImportThreshold)
+      return bytes;
+    return (bytes + kBufferStorageImportAlignment - 1) /
+           kBufferStorageImportAlignment * kBufferStorageImportAlignment;
+  }
+
+  T* allocate(size_t n) {
+    const size_t bytes = n * sizeof(T);
+    if (bytes < kBufferStorageImportThreshold)
+      return static_cast<T*>(::operator new(bytes));
+
+    // Over-allocate so the aligned start can be moved forward, and keep the
+    // pointer to the real allocation just in front of it.
+    uint8_t* raw = static_cast<uint8_t*>(::operator new(
+        GetPaddedSize(n) + kBufferStorageImportAlignment + sizeof(void*)));
+    const uintptr_t start = reinterpret_cast<uintptr_t>(raw) + sizeof(void*);
+    const uintptr_t aligned =
+        (start + kBufferStorageImportAlignment - 1) &
+        ~static_cast<uintptr_t>(kBufferStorageImportAlignment - 1);
+    reinterpret_cast<void**>(aligned)[-1] = raw;
+    return reinterpret_cast<T*>(aligned);
+  }
+
+  void deallocate(T* ptr, size_t n) {
+    if (n * sizeof(T) < kBufferStorageImportThreshold) {
+      ::operator delete(ptr);
+      return;
+    }
+    ::operator delete(reinterpret_cast<void**>(ptr)[-1]);
+  }
+};
+
+template <typename T, typename U>
+bool operator==(const BufferStorageAllocator<T>&,
+                const BufferStorageAllocator<U>&) {
+  return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const BufferStorageAllocator<T>&,
+                const BufferStorageAllocator<U>&) {
+  return false;
+}
+
+/// The storage of a buffer.
+using BufferStorage = std::vector<uint8_t, BufferStorageAllocator<uint8_t>>;
+
+/// A range of bytes in a buffer.
+struct BufferRange {
+  uint32_t offset = 0;
+  uint32_t size = 0;
+};
+
 /// A buffer stores data. The buffer maybe provided from the input script, or
 /// maybe created as needed. A buffer must have a unique name.
 class Buffer {
@@ -196,10 +285,17 @@ class Buffer {
   /// Returns the number of mip levels.
   uint32_t GetMipLevels() { return mip_levels_; }
 
+  /// Sets where the engine places the memory of the buffer.
+  void SetMemoryPlacement(MemoryPlacement placement) {
+    memory_placement_ = placement;
+  }
+  /// Returns where the engine places the memory of the buffer.
+  MemoryPlacement GetMemoryPlacement() const { return memory_placement_; }
+
   /// Returns a pointer to the internal storage of the buffer.
-  std::vector<uint8_t>* ValuePtr() { return &bytes_; }
+  BufferStorage* ValuePtr() { return &bytes_; }
   /// Returns a pointer to the internal storage of the buffer.
-  const std::vector<uint8_t>* ValuePtr() const { return &bytes_; }
+  const BufferStorage* ValuePtr() const { return &bytes_; }
 
   /// Returns a casted pointer to the internal storage of the buffer.
   template <typename T>
@@ -207,6 +303,18 @@ class Buffer {
     return reinterpret_cast<const T*>(bytes_.data());
   }
 
+  /// Records that |size| bytes at |offset| were modified on the host. The
+  /// dirty ranges are kept sorted, and overlapping or adjacent ranges are
+  /// merged.
+  void MarkDirty(uint32_t offset, uint32_t size);
+  /// Returns the ranges modified on the host since ClearDirtyRanges() was
+  /// last called, so an engine can upload only those.
+  const std::vector<BufferRange>& GetDirtyRanges() const {
+    return dirty_ranges_;
+  }
+  /// Called by an engine once it uploaded the dirty ranges.
+  void ClearDirtyRanges() { dirty_ranges_.clear(); }
+
   /// Copies the buffer values to an other one
   Result CopyTo(Buffer* buffer) const;
 
@@ -229,6 +337,8 @@ class Buffer {
   Result CompareHistogramEMD(Buffer* buffer, float tolerance) const;
 
  private:
+  friend class BufferWriter;
+
   uint32_t WriteValueFromComponent(const Value& value,
                                    FormatMode mode,
                                    uint32_t num_bits,
@@ -248,10 +358,40 @@ class Buffer {
   uint32_t depth_ = 1;
   uint32_t mip_levels_ = 1;
   bool format_is_default_ = false;
-  std::vector<uint8_t> bytes_;
+  BufferStorage bytes_;
   Format* format_ = nullptr;
   Sampler* sampler_ = nullptr;
   ImageDimension image_dim_ = ImageDimension::kUnknown;
+  MemoryPlacement memory_placement_ = MemoryPlacement::kDefault;
+  std::vector<BufferRange> dirty_ranges_;
+};
+
+/// Writes values into a buffer one at a time, encoding each one directly into
+/// the buffer storage according to the buffer format. This avoids holding all
+/// the values in a std::vector<Value> before Buffer::SetData() packs them, so
+/// the memory needed is about the final size of the buffer. The buffer format
+/// must be set and must not change while writing.
+class BufferWriter {
+ public:
+  /// Starts writing at the beginning of |buffer|. If known, |value_count| is
+  /// the number of values which will be written, so the storage is only
+  /// allocated once.
+  BufferWriter(Buffer* buffer, uint32_t value_count);
+  ~BufferWriter();
+
+  /// Writes |value| as the next component of the buffer.
+  void Write(const Value& value);
+
+  /// Updates the size of the buffer to the values written. Fails if the
+  /// values do not fill whole elements, like Buffer::SetData().
+  Result Finish();
+
+ private:
+  Buffer* buffer_ = nullptr;
+  const std::vector<Format::Segment>* segments_ = nullptr;
+  size_t segment_idx_ = 0;
+  size_t offset_ = 0;
+  uint32_t value_count_ = 0;
 };
 
 }  // namespace amber
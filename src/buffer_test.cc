@@ -318,4 +318,129 @@ TEST_F(BufferTest, SetFloat16) {
   EXPECT_EQ(float16::FloatToHexFloat16(1234.567f), v[1]);
 }
 
+TEST_F(BufferTest, BufferWriterMatchesSetData) {
+  TypeParser parser;
+  auto type = parser.Parse("R32G32B32_SINT");
+  type->SetColumnCount(3);
+  Format fmt(type.get());
+
+  std::vector<Value> values;
+  values.resize(18);
+  for (size_t i = 0; i < values.size(); ++i)
+    values[i].SetIntValue(i + 1);
+
+  Buffer expected;
+  expected.SetFormat(&fmt);
+  ASSERT_TRUE(expected.SetData(values).IsSuccess());
+
+  Buffer b;
+  b.SetFormat(&fmt);
+  BufferWriter writer(&b, static_cast<uint32_t>(values.size()));
+  for (const auto& value : values)
+    writer.Write(value);
+  ASSERT_TRUE(writer.Finish().IsSuccess());
+
+  EXPECT_EQ(2U, b.ElementCount());
+  EXPECT_EQ(18U, b.ValueCount());
+  EXPECT_EQ(*expected.ValuePtr(), *b.ValuePtr());
+}
+
+TEST_F(BufferTest, BufferWriterMismatchedItems) {
+  TypeParser parser;
+  auto type = parser.Parse("R32G32B32_SFLOAT");
+  Format fmt(type.get());
+
+  Buffer b;
+  b.SetFormat(&fmt);
+  BufferWriter writer(&b, 0);
+  Value value;
+  value.SetDoubleValue(1.0);
+  for (uint32_t i = 0; i < 4; ++i)
+    writer.Write(value);
+
+  Result r = writer.Finish();
+  ASSERT_FALSE(r.IsSuccess());
+  EXPECT_EQ("Mismatched number of items in buffer", r.Error());
+}
+
+TEST_F(BufferTest, MarkDirtyCoalescesRanges) {
+  Buffer b;
+  b.MarkDirty(32, 8);
+  b.MarkDirty(0, 4);
+  b.MarkDirty(16, 4);
+  // Touches the range at 16 and overlaps the one at 32.
+  b.MarkDirty(20, 14);
+  b.MarkDirty(64, 0);
+
+  const auto& ranges = b.GetDirtyRanges();
+  ASSERT_EQ(2U, ranges.size());
+  EXPECT_EQ(0U, ranges[0].offset);
+  EXPECT_EQ(4U, ranges[0].size);
+  EXPECT_EQ(16U, ranges[1].offset);
+  EXPECT_EQ(24U, ranges[1].size);
+
+  b.ClearDirtyRanges();
+  EXPECT_TRUE(b.GetDirtyRanges().empty());
+}
+
+TEST_F(BufferTest, SetDataWithOffsetMarksWrittenRange) {
+  TypeParser parser;
+  auto type = parser.Parse("R32_SINT");
+  Format fmt(type.get());
+
+  Buffer b;
+  b.SetFormat(&fmt);
+  b.SetSizeInElements(16);
+  b.ClearDirtyRanges();
+
+  std::vector<Value> values(2);
+  values[0].SetIntValue(1);
+  values[1].SetIntValue(2);
+  ASSERT_TRUE(b.SetDataWithOffset(values, 8).IsSuccess());
+
+  const auto& ranges = b.GetDirtyRanges();
+  ASSERT_EQ(1U, ranges.size());
+  EXPECT_EQ(8U, ranges[0].offset);
+  EXPECT_EQ(8U, ranges[0].size);
+}
+
+TEST_F(BufferTest, SetDataWithOffsetMarksGrownBuffer) {
+  TypeParser parser;
+  auto type = parser.Parse("R32_SINT");
+  Format fmt(type.get());
+
+  Buffer b;
+  b.SetFormat(&fmt);
+  b.SetSizeInElements(2);
+  b.ClearDirtyRanges();
+
+  std::vector<Value> values(2);
+  ASSERT_TRUE(b.SetDataWithOffset(values, 8).IsSuccess());
+
+  const auto& ranges = b.GetDirtyRanges();
+  ASSERT_EQ(1U, ranges.size());
+  EXPECT_EQ(0U, ranges[0].offset);
+  EXPECT_EQ(16U, ranges[0].size);
+}
+
+TEST_F(BufferTest, LargeStorageIsAlignedForImport) {
+  Buffer b;
+  BufferStorage* storage = b.ValuePtr();
+  storage->resize(kBufferStorageImportThreshold + 3);
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(storage->data()) %
+                    kBufferStorageImportAlignment);
+  EXPECT_EQ(kBufferStorageImportThreshold + kBufferStorageImportAlignment,
+            BufferStorageAllocator<uint8_t>::GetPaddedSize(
+                kBufferStorageImportThreshold + 3));
+
+  // Copies are aligned as well.
+  BufferStorage copy = *storage;
+  EXPECT_EQ(0U, reinterpret_cast<uintptr_t>(copy.data()) %
+                    kBufferStorageImportAlignment);
+}
+
+TEST_F(BufferTest, SmallStorageIsNotPadded) {
+  EXPECT_EQ(16U, BufferStorageAllocator<uint8_t>::GetPaddedSize(16));
+}
+
 }  // namespace amber
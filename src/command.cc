@@ -66,6 +66,10 @@ EntryPointCommand* Command::AsEntryPoint() {
   return static_cast<EntryPointCommand*>(this);
 }
 
+ExpectStatisticsCommand* Command::AsExpectStatistics() {
+  return static_cast<ExpectStatisticsCommand*>(this);
+}
+
 PatchParameterVerticesCommand* Command::AsPatchParameterVertices() {
   return static_cast<PatchParameterVerticesCommand*>(this);
 }
@@ -129,6 +133,11 @@ ProbeSSBOCommand::ProbeSSBOCommand(Buffer* buffer)
 
 ProbeSSBOCommand::~ProbeSSBOCommand() = default;
 
+ExpectStatisticsCommand::ExpectStatisticsCommand(Pipeline* pipeline)
+    : PipelineCommand(Type::kExpectStatistics, pipeline) {}
+
+ExpectStatisticsCommand::~ExpectStatisticsCommand() = default;
+
 BindableResourceCommand::BindableResourceCommand(Type type, Pipeline* pipeline)
     : PipelineCommand(type, pipeline) {}
 
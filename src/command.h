@@ -43,6 +43,7 @@ class DrawArraysCommand;
 class DrawRectCommand;
 class DrawGridCommand;
 class EntryPointCommand;
+class ExpectStatisticsCommand;
 class PatchParameterVerticesCommand;
 class Pipeline;
 class ProbeCommand;
@@ -64,6 +65,7 @@ class Command {
     kDrawRect,
     kDrawGrid,
     kEntryPoint,
+    kExpectStatistics,
     kPatchParameterVertices,
     kPipelineProperties,
     kProbe,
@@ -94,6 +96,9 @@ class Command {
     return command_type_ == Type::kPatchParameterVertices;
   }
   bool IsEntryPoint() const { return command_type_ == Type::kEntryPoint; }
+  bool IsExpectStatistics() const {
+    return command_type_ == Type::kExpectStatistics;
+  }
   bool IsRepeat() { return command_type_ == Type::kRepeat; }
 
   ClearCommand* AsClear();
@@ -107,6 +112,7 @@ class Command {
   DrawRectCommand* AsDrawRect();
   DrawGridCommand* AsDrawGrid();
   EntryPointCommand* AsEntryPoint();
+  ExpectStatisticsCommand* AsExpectStatistics();
   PatchParameterVerticesCommand* AsPatchParameterVertices();
   ProbeCommand* AsProbe();
   ProbeSSBOCommand* AsProbeSSBO();
@@ -472,6 +478,39 @@ class ProbeSSBOCommand : public Probe {
   std::vector<Value> values_;
 };
 
+/// Command to check a pipeline statistics counter of the last draw or
+/// dispatch executed on a pipeline.
+class ExpectStatisticsCommand : public PipelineCommand {
+ public:
+  enum class Counter {
+    kVertexInvocations,
+    kClippingPrimitives,
+    kFragmentInvocations,
+    kComputeInvocations
+  };
+
+  explicit ExpectStatisticsCommand(Pipeline* pipeline);
+  ~ExpectStatisticsCommand() override;
+
+  void SetCounter(Counter counter) { counter_ = counter; }
+  Counter GetCounter() const { return counter_; }
+
+  /// Sets the comparator, kFuzzyEqual is not supported.
+  void SetComparator(ProbeSSBOCommand::Comparator comp) { comparator_ = comp; }
+  ProbeSSBOCommand::Comparator GetComparator() const { return comparator_; }
+
+  void SetValue(uint64_t value) { value_ = value; }
+  uint64_t GetValue() const { return value_; }
+
+  std::string ToString() const override { return "ExpectStatisticsCommand"; }
+
+ private:
+  Counter counter_ = Counter::kVertexInvocations;
+  ProbeSSBOCommand::Comparator comparator_ =
+      ProbeSSBOCommand::Comparator::kEqual;
+  uint64_t value_ = 0;
+};
+
 /// Base class for BufferCommand and SamplerCommand to handle binding.
 class BindableResourceCommand : public PipelineCommand {
  public:
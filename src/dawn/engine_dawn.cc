@@ -791,6 +791,17 @@ Result EngineDawn::Initialize(EngineConfig* config,
   return {};
 }
 
+Result EngineDawn::Reset() {
+  if (!device_)
+    return Result("Dawn::Reset engine is not initialized");
+
+  pipeline_map_.clear();
+  texture_views_.clear();
+  textures_.clear();
+  depth_stencil_texture_ = ::dawn::Texture();
+  return {};
+}
+
 Result EngineDawn::CreatePipeline(::amber::Pipeline* pipeline) {
   if (!device_) {
     return Result("Dawn::CreatePipeline: device is not created");
@@ -1500,8 +1511,18 @@ Result EngineDawn::DoBuffer(const BufferCommand* command) {
   if (amber_buffer) {
     amber_buffer->SetDataWithOffset(command->GetValues(), command->GetOffset());
 
-    dawn_buffer->SetSubData(0, amber_buffer->GetMaxSizeInBytes(),
-                            amber_buffer->ValuePtr()->data());
+    // Only upload the ranges written since the buffer was last uploaded.
+    const uint32_t size = std::min(
+        amber_buffer->GetMaxSizeInBytes(),
+        static_cast<uint32_t>(amber_buffer->ValuePtr()->size()));
+    for (const auto& range : amber_buffer->GetDirtyRanges()) {
+      if (range.offset >= size)
+        break;
+      dawn_buffer->SetSubData(range.offset,
+                              std::min(range.size, size - range.offset),
+                              amber_buffer->ValuePtr()->data() + range.offset);
+    }
+    amber_buffer->ClearDirtyRanges();
   }
 
   return {};
@@ -1648,6 +1669,7 @@ Result EngineDawn::AttachBuffersAndTextures(
                              buf_info.buffer->GetMaxSizeInBytes(),
                              bufferUsage | ::dawn::BufferUsage::CopySrc |
                                  ::dawn::BufferUsage::CopyDst));
+    buf_info.buffer->ClearDirtyRanges();
 
     render_pipeline->buffer_map[{buf_info.descriptor_set, buf_info.binding}] =
         render_pipeline->buffers.size() - 1;
@@ -1747,6 +1769,7 @@ Result EngineDawn::AttachBuffers(ComputePipelineInfo* compute_pipeline) {
                              buf_info.buffer->GetMaxSizeInBytes(),
                              bufferUsage | ::dawn::BufferUsage::CopySrc |
                                  ::dawn::BufferUsage::CopyDst));
+    buf_info.buffer->ClearDirtyRanges();
 
     compute_pipeline->buffer_map[{buf_info.descriptor_set, buf_info.binding}] =
         compute_pipeline->buffers.size() - 1;
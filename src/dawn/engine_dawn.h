@@ -48,7 +48,11 @@ class EngineDawn : public Engine {
   // later.  Assumes necessary shader modules have been created.  A compute
   // pipeline requires a compute shader.  A graphics pipeline requires a vertex
   // and a fragment shader.
+  Result Reset() override;
   Result CreatePipeline(::amber::Pipeline*) override;
+  Result PrecompilePipelines(const std::vector<Command*>&, uint32_t) override {
+    return {};
+  }
 
   Result DoClearColor(const ClearColorCommand* cmd) override;
   Result DoClearStencil(const ClearStencilCommand* cmd) override;
@@ -62,6 +66,13 @@ class EngineDawn : public Engine {
   Result DoPatchParameterVertices(
       const PatchParameterVerticesCommand* cmd) override;
   Result DoBuffer(const BufferCommand* cmd) override;
+  Result SubmitPendingCommands() override { return {}; }
+  Result ReadbackBuffer(Buffer*) override { return {}; }
+  bool BeginRepeat(Pipeline*) override { return false; }
+  Result EndRepeat(uint32_t) override { return {}; }
+  Result GetPipelineStatistics(Pipeline*, CommandStatistics*) override {
+    return Result("Dawn does not currently support pipeline statistics");
+  }
 
   std::pair<Debugger*, Result> GetDebugger() override {
     return {nullptr, Result("Dawn does not currently support a debugger")};
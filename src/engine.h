@@ -33,6 +33,12 @@ namespace amber {
 struct EngineData {
   /// The timeout to use for fences, in milliseconds.
   uint32_t fence_timeout_ms = 10000;
+  /// If true, the engine may record consecutive RUN and CLEAR commands into a
+  /// single submission. Their results are only guaranteed to reach the device
+  /// after SubmitPendingCommands().
+  bool batch_commands = false;
+  /// Where buffers without a placement of their own are placed.
+  MemoryPlacement buffer_memory = MemoryPlacement::kDeviceLocal;
 };
 
 /// Abstract class which describes a backing engine for Amber.
@@ -51,7 +57,9 @@ struct EngineData {
 ///  4. Engine::Do* is called for each command.
 ///     Note, it is assumed that the amber::Buffers are updated at the end of
 ///     each Do* command and can be used immediately for comparisons.
-///  5. Engine destructor is called.
+///  5. Optionally, Engine::Reset is called and the engine continues at step 3
+///     with the next script.
+///  6. Engine destructor is called.
 class Engine {
  public:
   /// Debugger is the interface to the engine's shader debugger.
@@ -81,9 +89,23 @@ class Engine {
       const std::vector<std::string>& instance_extensions,
       const std::vector<std::string>& device_extensions) = 0;
 
+  /// Releases everything created for the executed script, e.g. the
+  /// pipelines and their resources, so another script can be executed on the
+  /// initialized device. Pending commands are submitted first.
+  virtual Result Reset() = 0;
+
   /// Create graphics pipeline.
   virtual Result CreatePipeline(Pipeline* pipeline) = 0;
 
+  /// Starts creating the device pipelines the draws and dispatches in
+  /// |commands| need on up to |thread_count| background threads, so they are
+  /// ready by the time the commands execute. Only called after all pipelines
+  /// were created, and only with commands whose pipelines no other command
+  /// of the script changes. Failures are not reported here, the command
+  /// reports them when it executes.
+  virtual Result PrecompilePipelines(const std::vector<Command*>& commands,
+                                     uint32_t thread_count) = 0;
+
   /// Execute the clear color command
   virtual Result DoClearColor(const ClearColorCommand* cmd) = 0;
 
@@ -120,6 +142,34 @@ class Engine {
   /// This covers both Vulkan buffers and images.
   virtual Result DoBuffer(const BufferCommand* cmd) = 0;
 
+  /// Submits all commands which were recorded but not submitted yet and waits
+  /// for them to complete. Engines may submit commands without waiting for
+  /// them, this also waits for those.
+  virtual Result SubmitPendingCommands() = 0;
+
+  /// Copies the results of the executed commands into |buffer|. Engines may
+  /// keep results on the device until they are needed on the host, so this
+  /// must be called before the contents of |buffer| are accessed.
+  virtual Result ReadbackBuffer(Buffer* buffer) = 0;
+
+  /// Starts recording the draws, dispatches and clears executed on |pipeline|
+  /// so they can be executed several times by EndRepeat() without recording
+  /// them again. No commands may be pending. Returns false if the engine can
+  /// not replay commands, the commands are then executed as usual.
+  virtual bool BeginRepeat(Pipeline* pipeline) = 0;
+
+  /// Executes the commands recorded since BeginRepeat() |count| times, each
+  /// execution seeing the results of the previous one, and waits for them to
+  /// complete. A |count| of 0 drops the recorded commands.
+  virtual Result EndRepeat(uint32_t count) = 0;
+
+  /// Retrieves the pipeline statistics of the last draw or dispatch executed
+  /// on |pipeline| into |statistics|. The |pipeline| must have pipeline
+  /// statistics enabled. If the engine does not support pipeline statistics
+  /// then the Result will be a failure.
+  virtual Result GetPipelineStatistics(Pipeline* pipeline,
+                                       CommandStatistics* statistics) = 0;
+
   /// GetDebugger returns the shader debugger from the engine.
   /// If the engine does not support a shader debugger then the Result will be a
   /// failure.
@@ -128,14 +178,66 @@ class Engine {
   /// Sets the engine data to use.
   void SetEngineData(const EngineData& data) { engine_data_ = data; }
 
+  /// Sets the serialized pipeline cache to use. Must be called before
+  /// Initialize(). Engines supporting pipeline caches seed their cache from
+  /// |data| and write the updated cache back into |data| when destroyed.
+  /// The |data| is _not_ owned by the engine.
+  void SetPipelineCacheData(std::vector<uint8_t>* data) {
+    pipeline_cache_data_ = data;
+  }
+
+  /// Sets the list GPU execution times are appended to. Must be called
+  /// before Initialize() or before a script following Reset(). Engines which
+  /// cannot measure GPU time leave |timings| untouched. The |timings| are
+  /// _not_ owned by the engine.
+  void SetCommandTimings(std::vector<CommandTiming>* timings) {
+    command_timings_ = timings;
+  }
+
+  /// Sets the list the pipeline statistics of draws and dispatches are
+  /// appended to. Must be called before Initialize() or before a script
+  /// following Reset(). Only pipelines with pipeline statistics enabled
+  /// report them. The |statistics| are _not_ owned by the engine.
+  void SetCommandStatistics(std::vector<CommandStatistics>* statistics) {
+    command_statistics_ = statistics;
+  }
+
+  /// Sets the script line of the command being executed. Work done for the
+  /// command, including reading back its results, is attributed to |line|.
+  void SetCurrentLine(size_t line) { current_line_ = line; }
+
  protected:
   Engine();
 
   /// Retrieves the engine data.
   const EngineData& GetEngineData() const { return engine_data_; }
 
+  /// Retrieves the serialized pipeline cache, or nullptr if none was set.
+  std::vector<uint8_t>* GetPipelineCacheData() const {
+    return pipeline_cache_data_;
+  }
+
+  /// Retrieves the list of GPU execution times, or nullptr if GPU time is not
+  /// measured.
+  std::vector<CommandTiming>* GetCommandTimings() const {
+    return command_timings_;
+  }
+
+  /// Retrieves the list of pipeline statistics, or nullptr if statistics are
+  /// not reported.
+  std::vector<CommandStatistics>* GetCommandStatistics() const {
+    return command_statistics_;
+  }
+
+  /// Retrieves the script line of the command being executed.
+  size_t GetCurrentLine() const { return current_line_; }
+
  private:
   EngineData engine_data_;
+  std::vector<uint8_t>* pipeline_cache_data_ = nullptr;
+  std::vector<CommandTiming>* command_timings_ = nullptr;
+  std::vector<CommandStatistics>* command_statistics_ = nullptr;
+  size_t current_line_ = 0;
 };
 
 }  // namespace amber
@@ -0,0 +1,363 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/execution_plan.h"
+
+#include <iterator>
+#include <sstream>
+#include <utility>
+
+#include "src/make_unique.h"
+#include "src/script.h"
+
+namespace amber {
+namespace {
+
+// Only RUN and CLEAR commands run without the results of the previous
+// commands on the host, every other command either needs them or changes
+// state they depend on. A REPEAT is decided by the commands it contains.
+bool NeedsHostSync(Command* cmd) {
+  return !(cmd->IsClear() || cmd->IsClearColor() || cmd->IsClearDepth() ||
+           cmd->IsClearStencil() || cmd->IsDrawRect() || cmd->IsDrawGrid() ||
+           cmd->IsDrawArrays() || cmd->IsCompute() || cmd->IsRepeat());
+}
+
+bool IsClearValue(Command* cmd) {
+  return cmd->IsClearColor() || cmd->IsClearDepth() || cmd->IsClearStencil();
+}
+
+// Returns the pipeline of a CLEAR, CLEAR_COLOR, CLEAR_DEPTH or CLEAR_STENCIL
+// command, nullptr for any other command.
+Pipeline* GetClearPipeline(Command* cmd) {
+  if (cmd->IsClear())
+    return cmd->AsClear()->GetPipeline();
+  if (cmd->IsClearColor())
+    return cmd->AsClearColor()->GetPipeline();
+  if (cmd->IsClearDepth())
+    return cmd->AsClearDepth()->GetPipeline();
+  if (cmd->IsClearStencil())
+    return cmd->AsClearStencil()->GetPipeline();
+  return nullptr;
+}
+
+// Returns true if the clear value or CLEAR at |index| is overridden by a
+// later command of |steps| before anything uses it.
+bool IsOverridden(const std::vector<PlanStep>& steps, size_t index) {
+  Command* cmd = steps[index].command;
+  Pipeline* pipeline = GetClearPipeline(cmd);
+  for (size_t i = index + 1; i < steps.size(); ++i) {
+    Command* next = steps[i].command;
+    Pipeline* next_pipeline = GetClearPipeline(next);
+    if (!next_pipeline)
+      return false;
+
+    if (next->IsClear()) {
+      // A CLEAR uses the clear values of its pipeline. Pipelines may share
+      // attachments, so a CLEAR of another pipeline ends the search for
+      // CLEARs overriding each other.
+      if (next_pipeline == pipeline)
+        return cmd->IsClear();
+      if (cmd->IsClear())
+        return false;
+      continue;
+    }
+    if (!cmd->IsClear() && next->GetType() == cmd->GetType() &&
+        next_pipeline == pipeline) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if |step| or any step it repeats references |buffer|.
+bool ReferencesBuffer(const PlanStep& step, const Buffer* buffer) {
+  Command* cmd = step.command;
+  if (cmd->IsBuffer() && cmd->AsBuffer()->GetBuffer() == buffer)
+    return true;
+  if (cmd->IsCopy() && (cmd->AsCopy()->GetBufferFrom() == buffer ||
+                        cmd->AsCopy()->GetBufferTo() == buffer)) {
+    return true;
+  }
+  for (const auto& child : step.steps) {
+    if (ReferencesBuffer(child, buffer))
+      return true;
+  }
+  return false;
+}
+
+// Returns true if a command of |cmds| binds |buffer| as anything but a
+// uniform buffer.
+bool IsBoundWritable(const std::vector<std::unique_ptr<Command>>& cmds,
+                     const Buffer* buffer) {
+  for (const auto& cmd : cmds) {
+    if (cmd->IsBuffer() && cmd->AsBuffer()->GetBuffer() == buffer &&
+        !cmd->AsBuffer()->IsUniform()) {
+      return true;
+    }
+    if (cmd->IsRepeat() &&
+        IsBoundWritable(cmd->AsRepeat()->GetCommands(), buffer)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns true if no pipeline of |script| can write to |buffer|.
+bool IsReadOnlyOnDevice(const Script* script, const Buffer* buffer) {
+  for (const auto& pipeline : script->GetPipelines()) {
+    for (const auto& info : pipeline->GetBuffers()) {
+      if (info.buffer == buffer && info.type != BufferType::kUniform)
+        return false;
+    }
+    for (const auto& info : pipeline->GetColorAttachments()) {
+      if (info.buffer == buffer)
+        return false;
+    }
+    if (pipeline->GetDepthBuffer().buffer == buffer)
+      return false;
+  }
+  return !IsBoundWritable(script->GetCommands(), buffer);
+}
+
+void AppendSteps(const std::vector<PlanStep>& steps,
+                 const std::string& indent,
+                 std::ostringstream* out) {
+  for (const auto& step : steps) {
+    *out << indent << step.command->GetLine() << ": "
+         << step.command->ToString();
+    if (step.command->IsRepeat())
+      *out << " x" << step.command->AsRepeat()->GetCount();
+    if (step.needs_host_sync)
+      *out << " [host sync]";
+    *out << "\n";
+    AppendSteps(step.steps, indent + "  ", out);
+  }
+}
+
+}  // namespace
+
+ExecutionPlan::ExecutionPlan() = default;
+
+ExecutionPlan::~ExecutionPlan() = default;
+
+void ExecutionPlan::Build(const Script* script, bool optimize) {
+  script_ = script;
+  steps_ = Lower(script->GetCommands());
+  if (optimize)
+    Optimize(&steps_);
+}
+
+std::string ExecutionPlan::ToString() const {
+  std::ostringstream out;
+  out << "Execution plan: " << dropped_count_ << " dropped, " << merged_count_
+      << " merged, " << hoisted_count_ << " hoisted\n";
+  AppendSteps(steps_, "  ", &out);
+  return out.str();
+}
+
+std::vector<PlanStep> ExecutionPlan::Lower(
+    const std::vector<std::unique_ptr<Command>>& commands) {
+  std::vector<PlanStep> steps;
+  for (const auto& cmd : commands) {
+    steps.emplace_back();
+    steps.back().command = cmd.get();
+    steps.back().needs_host_sync = NeedsHostSync(cmd.get());
+    if (cmd->IsRepeat())
+      steps.back().steps = Lower(cmd->AsRepeat()->GetCommands());
+  }
+  return steps;
+}
+
+void ExecutionPlan::Optimize(std::vector<PlanStep>* steps) {
+  for (auto& step : *steps)
+    Optimize(&step.steps);
+
+  // Hoisted commands may make commands before the REPEAT redundant.
+  HoistRepeatInvariants(steps);
+  DropRedundantClears(steps);
+  MergeBufferUpdates(steps);
+}
+
+void ExecutionPlan::DropRedundantClears(std::vector<PlanStep>* steps) {
+  // Dropping a CLEAR can leave the clear values it used overridden.
+  bool dropped = true;
+  while (dropped) {
+    dropped = false;
+    for (size_t i = 0; i < steps->size();) {
+      Command* cmd = (*steps)[i].command;
+      if (!GetClearPipeline(cmd) || cmd->GetDebugScript() ||
+          !IsOverridden(*steps, i)) {
+        ++i;
+        continue;
+      }
+      steps->erase(steps->begin() + static_cast<std::ptrdiff_t>(i));
+      ++dropped_count_;
+      dropped = true;
+    }
+  }
+}
+
+void ExecutionPlan::MergeBufferUpdates(std::vector<PlanStep>* steps) {
+  for (size_t i = 0; i + 1 < steps->size();) {
+    Command* first = (*steps)[i].command;
+    Command* second = (*steps)[i + 1].command;
+    std::unique_ptr<BufferCommand> merged;
+    if (first->IsBuffer() && second->IsBuffer() && !first->GetDebugScript() &&
+        !second->GetDebugScript()) {
+      merged = MergeBufferCommands(first->AsBuffer(), second->AsBuffer());
+    }
+    if (!merged) {
+      ++i;
+      continue;
+    }
+
+    // The merged command may be merged with the next one again.
+    (*steps)[i].command = merged.get();
+    owned_commands_.push_back(std::move(merged));
+    steps->erase(steps->begin() + static_cast<std::ptrdiff_t>(i + 1));
+    ++merged_count_;
+  }
+}
+
+void ExecutionPlan::HoistRepeatInvariants(std::vector<PlanStep>* steps) {
+  for (size_t i = 0; i < steps->size(); ++i) {
+    PlanStep& step = (*steps)[i];
+    if (!step.command->IsRepeat() || step.command->AsRepeat()->GetCount() == 0)
+      continue;
+
+    // Only the start of the body is hoisted, so no command of the first
+    // iteration sees the state before it was set.
+    size_t count = 0;
+    while (count < step.steps.size() && IsRepeatInvariant(step.steps, count))
+      ++count;
+    if (count == 0)
+      continue;
+
+    const auto end = step.steps.begin() + static_cast<std::ptrdiff_t>(count);
+    std::vector<PlanStep> hoisted(std::make_move_iterator(step.steps.begin()),
+                                  std::make_move_iterator(end));
+    step.steps.erase(step.steps.begin(), end);
+    steps->insert(steps->begin() + static_cast<std::ptrdiff_t>(i),
+                  std::make_move_iterator(hoisted.begin()),
+                  std::make_move_iterator(hoisted.end()));
+    hoisted_count_ += static_cast<uint32_t>(count);
+    i += count;
+  }
+}
+
+bool ExecutionPlan::IsRepeatInvariant(const std::vector<PlanStep>& body,
+                                      size_t index) const {
+  Command* cmd = body[index].command;
+  if (cmd->GetDebugScript())
+    return false;
+
+  if (IsClearValue(cmd)) {
+    Pipeline* pipeline = GetClearPipeline(cmd);
+    for (size_t i = 0; i < body.size(); ++i) {
+      if (i != index && body[i].command->GetType() == cmd->GetType() &&
+          GetClearPipeline(body[i].command) == pipeline) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Shaders can not write to uniform buffers, so their contents only change
+  // through commands.
+  if (cmd->IsBuffer()) {
+    BufferCommand* buffer_cmd = cmd->AsBuffer();
+    const Buffer* buffer = buffer_cmd->GetBuffer();
+    if (!buffer_cmd->IsUniform() || buffer_cmd->GetValues().empty() ||
+        !buffer || !IsReadOnlyOnDevice(script_, buffer)) {
+      return false;
+    }
+    for (size_t i = 0; i < body.size(); ++i) {
+      if (i != index && ReferencesBuffer(body[i], buffer))
+        return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+std::unique_ptr<BufferCommand> ExecutionPlan::MergeBufferCommands(
+    const BufferCommand* first,
+    const BufferCommand* second) const {
+  const bool same_type = (first->IsSSBO() && second->IsSSBO()) ||
+                         (first->IsUniform() && second->IsUniform());
+  if (!same_type || first->GetPipeline() != second->GetPipeline() ||
+      first->GetDescriptorSet() != second->GetDescriptorSet() ||
+      first->GetBinding() != second->GetBinding() ||
+      first->GetBuffer() != second->GetBuffer() ||
+      first->IsSubdata() != second->IsSubdata() ||
+      first->GetBaseMipLevel() != second->GetBaseMipLevel() ||
+      first->GetValues().empty() || second->GetValues().empty() ||
+      !first->GetBuffer()) {
+    return nullptr;
+  }
+
+  // The written range follows from the format, the same way
+  // Buffer::SetDataWithOffset() computes it.
+  const Format* fmt = first->GetBuffer()->GetFormat();
+  if (!fmt || fmt->SizeInBytes() == 0 || fmt->InputNeededPerElement() == 0)
+    return nullptr;
+  const uint32_t values_per_element = fmt->InputNeededPerElement();
+  const uint32_t element_size = fmt->SizeInBytes();
+  if (first->GetValues().size() % values_per_element != 0 ||
+      second->GetValues().size() % values_per_element != 0 ||
+      first->GetOffset() % element_size != 0 ||
+      second->GetOffset() % element_size != 0) {
+    return nullptr;
+  }
+  const uint32_t first_end =
+      first->GetOffset() +
+      static_cast<uint32_t>(first->GetValues().size()) / values_per_element *
+          element_size;
+  const uint32_t second_end =
+      second->GetOffset() +
+      static_cast<uint32_t>(second->GetValues().size()) / values_per_element *
+          element_size;
+
+  std::vector<Value> values;
+  uint32_t offset = 0;
+  if (second->GetOffset() <= first->GetOffset() && second_end >= first_end) {
+    // The second write overwrites all of the first one.
+    values = second->GetValues();
+    offset = second->GetOffset();
+  } else if (second->GetOffset() == first_end) {
+    values = first->GetValues();
+    values.insert(values.end(), second->GetValues().begin(),
+                  second->GetValues().end());
+    offset = first->GetOffset();
+  } else {
+    return nullptr;
+  }
+
+  auto merged = MakeUnique<BufferCommand>(
+      first->IsSSBO() ? BufferCommand::BufferType::kSSBO
+                      : BufferCommand::BufferType::kUniform,
+      first->GetPipeline());
+  merged->SetDescriptorSet(first->GetDescriptorSet());
+  merged->SetBinding(first->GetBinding());
+  merged->SetBuffer(first->GetBuffer());
+  if (first->IsSubdata())
+    merged->SetIsSubdata();
+  merged->SetBaseMipLevel(first->GetBaseMipLevel());
+  merged->SetOffset(offset);
+  merged->SetValues(std::move(values));
+  merged->SetLine(first->GetLine());
+  return merged;
+}
+
+}  // namespace amber
@@ -0,0 +1,100 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_EXECUTION_PLAN_H_
+#define SRC_EXECUTION_PLAN_H_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/command.h"
+
+namespace amber {
+
+class Script;
+
+/// A command executed by an ExecutionPlan.
+struct PlanStep {
+  /// The command to execute.
+  Command* command = nullptr;
+  /// True if the commands executed before |command| must have completed on
+  /// the device first, because |command| needs their results on the host or
+  /// changes state they depend on.
+  bool needs_host_sync = false;
+  /// If |command| is a REPEAT, the steps executed for each iteration.
+  std::vector<PlanStep> steps;
+};
+
+/// The commands of a script lowered into the steps the executor runs. If
+/// optimized, the plan leaves out work which can not change the results:
+///  * CLEAR_COLOR, CLEAR_DEPTH and CLEAR_STENCIL commands overridden by the
+///    same command for the same pipeline before any CLEAR uses them.
+///  * CLEAR commands followed by another CLEAR of the same pipeline with only
+///    clear values set in between.
+///  * BUFFER commands writing values to a binding directly followed by
+///    another one writing the adjacent range, or all of the range, of the
+///    same binding. The writes are merged into a single command.
+///  * Commands at the start of a REPEAT body which set a clear value or
+///    uniform buffer contents no other command of the body changes. These
+///    execute once before the REPEAT.
+class ExecutionPlan {
+ public:
+  ExecutionPlan();
+  ~ExecutionPlan();
+
+  /// Lowers the commands of |script|. If |optimize| is false, every command
+  /// is executed as written.
+  void Build(const Script* script, bool optimize);
+
+  const std::vector<PlanStep>& GetSteps() const { return steps_; }
+
+  /// Returns the number of commands left out of the plan.
+  uint32_t GetDroppedCommandCount() const { return dropped_count_; }
+  /// Returns the number of BUFFER commands merged into another one.
+  uint32_t GetMergedCommandCount() const { return merged_count_; }
+  /// Returns the number of commands moved out of a REPEAT body.
+  uint32_t GetHoistedCommandCount() const { return hoisted_count_; }
+
+  /// Returns a description of the plan, one step per line.
+  std::string ToString() const;
+
+ private:
+  std::vector<PlanStep> Lower(
+      const std::vector<std::unique_ptr<Command>>& commands);
+  void Optimize(std::vector<PlanStep>* steps);
+  void DropRedundantClears(std::vector<PlanStep>* steps);
+  void MergeBufferUpdates(std::vector<PlanStep>* steps);
+  void HoistRepeatInvariants(std::vector<PlanStep>* steps);
+  /// Returns true if the |index|th step of |body| sets state no other step
+  /// of |body| changes.
+  bool IsRepeatInvariant(const std::vector<PlanStep>& body, size_t index) const;
+  /// Returns a command writing the values of |first| and then |second|, or
+  /// nullptr if the writes can not be merged.
+  std::unique_ptr<BufferCommand> MergeBufferCommands(
+      const BufferCommand* first,
+      const BufferCommand* second) const;
+
+  const Script* script_ = nullptr;
+  std::vector<PlanStep> steps_;
+  // Commands created by merging commands of the script.
+  std::vector<std::unique_ptr<Command>> owned_commands_;
+  uint32_t dropped_count_ = 0;
+  uint32_t merged_count_ = 0;
+  uint32_t hoisted_count_ = 0;
+};
+
+}  // namespace amber
+
+#endif  // SRC_EXECUTION_PLAN_H_
@@ -0,0 +1,368 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/execution_plan.h"
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "src/amberscript/parser.h"
+#include "src/make_unique.h"
+#include "src/vkscript/parser.h"
+
+namespace amber {
+namespace {
+
+const char kGraphicsHeader[] = R"(
+SHADER vertex my_shader PASSTHROUGH
+SHADER fragment my_fragment GLSL
+# GLSL Shader
+END
+BUFFER my_fb FORMAT R8G8B8A8_UNORM
+
+PIPELINE graphics my_pipeline
+  ATTACH my_shader
+  ATTACH my_fragment
+  BIND BUFFER my_fb AS color LOCATION 0
+END
+)";
+
+const char kUniformPipeline[] = R"(
+BUFFER my_ubo DATA_TYPE uint32 SIZE 4 FILL 0
+BUFFER other_buf DATA_TYPE uint32 SIZE 4 FILL 0
+
+PIPELINE graphics ubo_pipeline
+  ATTACH my_shader
+  ATTACH my_fragment
+  BIND BUFFER my_fb AS color LOCATION 0
+  BIND BUFFER my_ubo AS uniform DESCRIPTOR_SET 0 BINDING 0
+END
+)";
+
+class ExecutionPlanTest : public testing::Test {
+ public:
+  std::unique_ptr<Script> ParseAmberScript(const std::string& commands) {
+    amberscript::Parser parser;
+    Result r = parser.Parse(kGraphicsHeader + commands);
+    EXPECT_TRUE(r.IsSuccess()) << r.Error();
+    return parser.GetScript();
+  }
+
+  std::unique_ptr<BufferCommand> MakeBufferUpdate(
+      BufferCommand::BufferType type,
+      Pipeline* pipeline,
+      Buffer* buffer) {
+    auto cmd = MakeUnique<BufferCommand>(type, pipeline);
+    cmd->SetBuffer(buffer);
+    cmd->SetIsSubdata();
+    std::vector<Value> values(1);
+    values[0].SetIntValue(1);
+    cmd->SetValues(std::move(values));
+    return cmd;
+  }
+
+  // Sets |cmds| followed by a REPEAT of |body| as the commands of |script|.
+  // Uniform buffer updates are only parsed from VkScript, which has no
+  // REPEAT, so the tests build them.
+  void SetCommands(Script* script,
+                   std::vector<std::unique_ptr<Command>> cmds,
+                   std::vector<std::unique_ptr<Command>> body) {
+    auto repeat = MakeUnique<RepeatCommand>(3);
+    repeat->SetCommands(std::move(body));
+    cmds.push_back(std::move(repeat));
+    script->SetCommands(std::move(cmds));
+  }
+};
+
+TEST_F(ExecutionPlanTest, KeepsCommandsWithoutOptimization) {
+  auto script = ParseAmberScript(R"(
+CLEAR_COLOR my_pipeline 255 0 0 255
+CLEAR_COLOR my_pipeline 0 255 0 255
+CLEAR my_pipeline)");
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), false);
+  ASSERT_EQ(3U, plan.GetSteps().size());
+  EXPECT_EQ(0U, plan.GetDroppedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, DropsOverriddenClearColor) {
+  auto script = ParseAmberScript(R"(
+CLEAR_COLOR my_pipeline 255 0 0 255
+CLEAR_COLOR my_pipeline 0 255 0 255
+CLEAR my_pipeline)");
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  const auto& steps = plan.GetSteps();
+  ASSERT_EQ(2U, steps.size());
+  EXPECT_EQ(script->GetCommands()[1].get(), steps[0].command);
+  EXPECT_EQ(script->GetCommands()[2].get(), steps[1].command);
+  EXPECT_EQ(1U, plan.GetDroppedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, DropsOverwrittenClear) {
+  auto script = ParseAmberScript(R"(
+CLEAR_COLOR my_pipeline 255 0 0 255
+CLEAR my_pipeline
+CLEAR_COLOR my_pipeline 0 255 0 255
+CLEAR my_pipeline)");
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  const auto& steps = plan.GetSteps();
+  ASSERT_EQ(2U, steps.size());
+  EXPECT_EQ(script->GetCommands()[2].get(), steps[0].command);
+  EXPECT_EQ(script->GetCommands()[3].get(), steps[1].command);
+  EXPECT_EQ(2U, plan.GetDroppedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, KeepsClearUsedByDraw) {
+  auto script = ParseAmberScript(R"(
+CLEAR my_pipeline
+RUN my_pipeline DRAW_RECT POS 0 0 SIZE 10 10
+CLEAR my_pipeline)");
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  EXPECT_EQ(3U, plan.GetSteps().size());
+  EXPECT_EQ(0U, plan.GetDroppedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, HoistsClearColorOutOfRepeat) {
+  auto script = ParseAmberScript(R"(
+REPEAT 3
+  CLEAR_COLOR my_pipeline 255 0 0 255
+  CLEAR my_pipeline
+  RUN my_pipeline DRAW_RECT POS 0 0 SIZE 10 10
+END)");
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  const auto& steps = plan.GetSteps();
+  ASSERT_EQ(2U, steps.size());
+  EXPECT_TRUE(steps[0].command->IsClearColor());
+  ASSERT_TRUE(steps[1].command->IsRepeat());
+  ASSERT_EQ(2U, steps[1].steps.size());
+  EXPECT_TRUE(steps[1].steps[0].command->IsClear());
+  EXPECT_EQ(1U, plan.GetHoistedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, DoesNotHoistStateUsedBeforeItIsSet) {
+  auto script = ParseAmberScript(R"(
+REPEAT 3
+  CLEAR my_pipeline
+  CLEAR_COLOR my_pipeline 255 0 0 255
+END)");
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  const auto& steps = plan.GetSteps();
+  ASSERT_EQ(1U, steps.size());
+  EXPECT_EQ(2U, steps[0].steps.size());
+  EXPECT_EQ(0U, plan.GetHoistedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, HoistsUniformBufferUpdateOutOfRepeat) {
+  auto script = ParseAmberScript(kUniformPipeline);
+  Pipeline* pipeline = script->GetPipeline("ubo_pipeline");
+  Buffer* ubo = script->GetBuffer("my_ubo");
+
+  std::vector<std::unique_ptr<Command>> body;
+  body.push_back(MakeBufferUpdate(BufferCommand::BufferType::kUniform,
+                                  pipeline, ubo));
+  body.push_back(MakeUnique<ClearCommand>(pipeline));
+  SetCommands(script.get(), {}, std::move(body));
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  const auto& steps = plan.GetSteps();
+  ASSERT_EQ(2U, steps.size());
+  EXPECT_TRUE(steps[0].command->IsBuffer());
+  ASSERT_TRUE(steps[1].command->IsRepeat());
+  ASSERT_EQ(1U, steps[1].steps.size());
+  EXPECT_TRUE(steps[1].steps[0].command->IsClear());
+  EXPECT_EQ(1U, plan.GetHoistedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, DoesNotHoistUniformBufferBoundAsStorage) {
+  auto script = ParseAmberScript(std::string(kUniformPipeline) + R"(
+PIPELINE graphics ssbo_pipeline
+  ATTACH my_shader
+  ATTACH my_fragment
+  BIND BUFFER my_fb AS color LOCATION 0
+  BIND BUFFER my_ubo AS storage DESCRIPTOR_SET 0 BINDING 0
+END
+)");
+  Pipeline* pipeline = script->GetPipeline("ubo_pipeline");
+  Buffer* ubo = script->GetBuffer("my_ubo");
+
+  std::vector<std::unique_ptr<Command>> body;
+  body.push_back(MakeBufferUpdate(BufferCommand::BufferType::kUniform,
+                                  pipeline, ubo));
+  body.push_back(MakeUnique<ClearCommand>(pipeline));
+  SetCommands(script.get(), {}, std::move(body));
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  const auto& steps = plan.GetSteps();
+  ASSERT_EQ(1U, steps.size());
+  EXPECT_EQ(2U, steps[0].steps.size());
+  EXPECT_EQ(0U, plan.GetHoistedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, DoesNotHoistUniformBufferUpdatedAsStorage) {
+  auto script = ParseAmberScript(kUniformPipeline);
+  Pipeline* pipeline = script->GetPipeline("ubo_pipeline");
+  Buffer* ubo = script->GetBuffer("my_ubo");
+
+  std::vector<std::unique_ptr<Command>> cmds;
+  cmds.push_back(
+      MakeBufferUpdate(BufferCommand::BufferType::kSSBO, pipeline, ubo));
+  std::vector<std::unique_ptr<Command>> body;
+  body.push_back(MakeBufferUpdate(BufferCommand::BufferType::kUniform,
+                                  pipeline, ubo));
+  body.push_back(MakeUnique<ClearCommand>(pipeline));
+  SetCommands(script.get(), std::move(cmds), std::move(body));
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  const auto& steps = plan.GetSteps();
+  ASSERT_EQ(2U, steps.size());
+  EXPECT_EQ(2U, steps[1].steps.size());
+  EXPECT_EQ(0U, plan.GetHoistedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, DoesNotHoistUniformBufferUpdatedInRepeat) {
+  auto script = ParseAmberScript(kUniformPipeline);
+  Pipeline* pipeline = script->GetPipeline("ubo_pipeline");
+  Buffer* ubo = script->GetBuffer("my_ubo");
+
+  std::vector<std::unique_ptr<Command>> body;
+  body.push_back(MakeBufferUpdate(BufferCommand::BufferType::kUniform,
+                                  pipeline, ubo));
+  body.push_back(MakeUnique<ClearCommand>(pipeline));
+  body.push_back(MakeBufferUpdate(BufferCommand::BufferType::kUniform,
+                                  pipeline, ubo));
+  SetCommands(script.get(), {}, std::move(body));
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  const auto& steps = plan.GetSteps();
+  ASSERT_EQ(1U, steps.size());
+  EXPECT_EQ(3U, steps[0].steps.size());
+  EXPECT_EQ(0U, plan.GetHoistedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, DoesNotHoistUniformBufferCopiedInRepeat) {
+  auto script = ParseAmberScript(kUniformPipeline);
+  Pipeline* pipeline = script->GetPipeline("ubo_pipeline");
+  Buffer* ubo = script->GetBuffer("my_ubo");
+
+  std::vector<std::unique_ptr<Command>> body;
+  body.push_back(MakeBufferUpdate(BufferCommand::BufferType::kUniform,
+                                  pipeline, ubo));
+  body.push_back(MakeUnique<ClearCommand>(pipeline));
+  body.push_back(
+      MakeUnique<CopyCommand>(script->GetBuffer("other_buf"), ubo));
+  SetCommands(script.get(), {}, std::move(body));
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  const auto& steps = plan.GetSteps();
+  ASSERT_EQ(1U, steps.size());
+  EXPECT_EQ(3U, steps[0].steps.size());
+  EXPECT_EQ(0U, plan.GetHoistedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, MergesAdjacentBufferUpdates) {
+  std::string input = R"(
+[test]
+ssbo 0 subdata int 0 1 2
+ssbo 0 subdata int 8 3 4
+ssbo 0 subdata int 16 5)";
+
+  vkscript::Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+  auto script = parser.GetScript();
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  const auto& steps = plan.GetSteps();
+  ASSERT_EQ(1U, steps.size());
+  ASSERT_TRUE(steps[0].command->IsBuffer());
+  EXPECT_TRUE(steps[0].needs_host_sync);
+
+  auto* cmd = steps[0].command->AsBuffer();
+  EXPECT_EQ(0U, cmd->GetOffset());
+  ASSERT_EQ(5U, cmd->GetValues().size());
+  EXPECT_EQ(5U, cmd->GetValues()[4].AsUint32());
+  EXPECT_EQ(2U, plan.GetMergedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, DoesNotMergeDisjointBufferUpdates) {
+  std::string input = R"(
+[test]
+ssbo 0 subdata int 0 1 2
+ssbo 0 subdata int 16 3 4)";
+
+  vkscript::Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+  auto script = parser.GetScript();
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  EXPECT_EQ(2U, plan.GetSteps().size());
+  EXPECT_EQ(0U, plan.GetMergedCommandCount());
+}
+
+TEST_F(ExecutionPlanTest, MarksHostSync) {
+  auto script = ParseAmberScript(R"(
+CLEAR my_pipeline
+RUN my_pipeline DRAW_RECT POS 0 0 SIZE 10 10
+EXPECT my_fb IDX 0 0 SIZE 1 1 EQ_RGBA 0 0 0 0)");
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  const auto& steps = plan.GetSteps();
+  ASSERT_EQ(3U, steps.size());
+  EXPECT_FALSE(steps[0].needs_host_sync);
+  EXPECT_FALSE(steps[1].needs_host_sync);
+  EXPECT_TRUE(steps[2].needs_host_sync);
+}
+
+TEST_F(ExecutionPlanTest, ToString) {
+  auto script = ParseAmberScript(R"(
+REPEAT 2
+  CLEAR_COLOR my_pipeline 255 0 0 255
+  CLEAR my_pipeline
+END)");
+
+  ExecutionPlan plan;
+  plan.Build(script.get(), true);
+  EXPECT_EQ(
+      "Execution plan: 0 dropped, 0 merged, 1 hoisted\n"
+      "  15: ClearColorCommand\n"
+      "  14: RepeatCommand x2\n"
+      "    16: ClearCommand\n",
+      plan.ToString());
+}
+
+}  // namespace
+}  // namespace amber
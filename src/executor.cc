@@ -14,7 +14,12 @@
 
 #include "src/executor.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <set>
+#include <thread>
+#include <tuple>
 #include <utility>
 #include <vector>
 
@@ -24,6 +29,63 @@
 #include "src/shader_compiler.h"
 
 namespace amber {
+namespace {
+
+// Returns the pipeline all commands of |steps| run on if the commands only
+// draw, dispatch or clear, so executing them again needs nothing from the
+// host. Returns nullptr otherwise. The geometry of DrawRect and DrawGrid is
+// cached by the engine, so once uploaded it is reused by the replays.
+Pipeline* GetReplayablePipeline(const std::vector<PlanStep>& steps) {
+  Pipeline* pipeline = nullptr;
+  for (const auto& step : steps) {
+    Command* cmd = step.command;
+    Pipeline* cmd_pipeline = nullptr;
+    if (cmd->IsClear())
+      cmd_pipeline = cmd->AsClear()->GetPipeline();
+    else if (cmd->IsDrawRect())
+      cmd_pipeline = cmd->AsDrawRect()->GetPipeline();
+    else if (cmd->IsDrawGrid())
+      cmd_pipeline = cmd->AsDrawGrid()->GetPipeline();
+    else if (cmd->IsCompute())
+      cmd_pipeline = cmd->AsCompute()->GetPipeline();
+    else if (cmd->IsDrawArrays())
+      cmd_pipeline = cmd->AsDrawArrays()->GetPipeline();
+
+    if (!cmd_pipeline || (pipeline && pipeline != cmd_pipeline))
+      return nullptr;
+    pipeline = cmd_pipeline;
+  }
+  return pipeline;
+}
+
+// Adds the draws and dispatches of |steps|, including the ones in REPEAT
+// bodies, with their pipelines to |draws|, and the pipelines whose state
+// other commands change to |changed|.
+void CollectPipelineCommands(const std::vector<PlanStep>& steps,
+                             std::vector<std::pair<Command*, Pipeline*>>* draws,
+                             std::set<Pipeline*>* changed) {
+  for (const auto& step : steps) {
+    Command* cmd = step.command;
+    if (cmd->IsDrawRect())
+      draws->emplace_back(cmd, cmd->AsDrawRect()->GetPipeline());
+    else if (cmd->IsDrawGrid())
+      draws->emplace_back(cmd, cmd->AsDrawGrid()->GetPipeline());
+    else if (cmd->IsDrawArrays())
+      draws->emplace_back(cmd, cmd->AsDrawArrays()->GetPipeline());
+    else if (cmd->IsCompute())
+      draws->emplace_back(cmd, cmd->AsCompute()->GetPipeline());
+    else if (cmd->IsBuffer())
+      changed->insert(cmd->AsBuffer()->GetPipeline());
+    else if (cmd->IsEntryPoint())
+      changed->insert(cmd->AsEntryPoint()->GetPipeline());
+    else if (cmd->IsPatchParameterVertices())
+      changed->insert(cmd->AsPatchParameterVertices()->GetPipeline());
+    else if (cmd->IsRepeat())
+      CollectPipelineCommands(step.steps, draws, changed);
+  }
+}
+
+}  // namespace
 
 Executor::Executor() = default;
 
@@ -32,28 +94,96 @@ Executor::~Executor() = default;
 Result Executor::CompileShaders(const amber::Script* script,
                                 const ShaderMap& shader_map,
                                 Options* options) {
+  struct CompileJob {
+    Pipeline* pipeline;
+    Pipeline::ShaderInfo* shader_info;
+    Result result;
+    std::vector<uint32_t> data;
+  };
+
+  std::vector<CompileJob> jobs;
+  // Compiling OPENCL-C shaders updates the pipeline, so those are never
+  // compiled concurrently.
+  bool has_opencl_shaders = false;
   for (auto& pipeline : script->GetPipelines()) {
     for (auto& shader_info : pipeline->GetShaders()) {
+      jobs.push_back({pipeline.get(), &shader_info, {}, {}});
+      if (shader_info.GetShader()->GetFormat() == kShaderFormatOpenCLC)
+        has_opencl_shaders = true;
+    }
+  }
+
+  std::atomic<size_t> next_job(0);
+  auto compile = [&jobs, &next_job, &shader_map, script, options]() {
+    for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
       ShaderCompiler sc(script->GetSpvTargetEnv(),
-                        options->disable_spirv_validation);
+                        options->disable_spirv_validation,
+                        options->shader_cache);
+      std::tie(jobs[i].result, jobs[i].data) =
+          sc.Compile(jobs[i].pipeline, jobs[i].shader_info, shader_map);
+    }
+  };
 
-      Result r;
-      std::vector<uint32_t> data;
-      std::tie(r, data) = sc.Compile(pipeline.get(), &shader_info, shader_map);
-      if (!r.IsSuccess())
-        return r;
+  size_t thread_count = options->shader_compile_threads;
+  if (thread_count == 0)
+    thread_count = std::max(std::thread::hardware_concurrency(), 1U);
+  if (has_opencl_shaders)
+    thread_count = 1;
+  thread_count = std::min(thread_count, jobs.size());
 
-      shader_info.SetData(std::move(data));
-    }
+  // The calling thread compiles as well, so only start the extra workers.
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < thread_count; ++i)
+    workers.emplace_back(compile);
+  compile();
+  for (auto& worker : workers)
+    worker.join();
+
+  for (auto& job : jobs) {
+    if (!job.result.IsSuccess())
+      return job.result;
+
+    job.shader_info->SetData(std::move(job.data));
   }
   return {};
 }
 
+Result Executor::PrecompilePipelines(Engine* engine,
+                                     const ExecutionPlan& plan,
+                                     Options* options) {
+  // Logged graphics calls must stay in the order of the commands.
+  if (options->pipeline_compile_threads == 0 ||
+      (options->delegate && options->delegate->LogGraphicsCalls())) {
+    return {};
+  }
+
+  std::vector<std::pair<Command*, Pipeline*>> draws;
+  std::set<Pipeline*> changed;
+  CollectPipelineCommands(plan.GetSteps(), &draws, &changed);
+
+  // The device pipelines of a pipeline are only known ahead if no command
+  // changes the descriptors, push constants or shaders they are created with.
+  std::vector<Command*> commands;
+  for (const auto& draw : draws) {
+    if (changed.count(draw.second) == 0)
+      commands.push_back(draw.first);
+  }
+  if (commands.empty())
+    return {};
+
+  return engine->PrecompilePipelines(commands,
+                                     options->pipeline_compile_threads);
+}
+
 Result Executor::Execute(Engine* engine,
                          const amber::Script* script,
                          const ShaderMap& shader_map,
                          Options* options) {
-  engine->SetEngineData(script->GetEngineData());
+  batch_commands_ = options->batch_commands;
+
+  EngineData engine_data = script->GetEngineData();
+  engine_data.batch_commands = batch_commands_;
+  engine->SetEngineData(engine_data);
 
   if (!script->GetPipelines().empty()) {
     Result r = CompileShaders(script, shader_map, options);
@@ -86,10 +216,21 @@ Result Executor::Execute(Engine* engine,
   if (options->execution_type == ExecutionType::kPipelineCreateOnly)
     return {};
 
+  // Timings are reported per command, so every command has to execute.
+  ExecutionPlan plan;
+  plan.Build(script, options->command_timings == nullptr);
+  if (options->dump_execution_plan && options->delegate)
+    options->delegate->Log(plan.ToString());
+
+  Result r = PrecompilePipelines(engine, plan, options);
+  if (!r.IsSuccess())
+    return r;
+
   Engine::Debugger* debugger = nullptr;
 
   // Process Commands
-  for (const auto& cmd : script->GetCommands()) {
+  for (const auto& step : plan.GetSteps()) {
+    Command* cmd = step.command;
     if (options->delegate && options->delegate->LogExecuteCalls()) {
       options->delegate->Log(std::to_string(cmd->GetLine()) + ": " +
                              cmd->ToString());
@@ -110,25 +251,65 @@ Result Executor::Execute(Engine* engine,
       dbg_script->Run(debugger);
     }
 
-    Result r = ExecuteCommand(engine, cmd.get());
-    if (!r.IsSuccess())
+    Result r = ExecuteCommand(engine, step);
+    if (!r.IsSuccess()) {
+      // Submit what was recorded so far, the buffers may still be extracted
+      // to help debugging the failure.
+      SubmitPendingCommands(engine);
       return r;
+    }
 
     if (debugger != nullptr) {
+      // The debugged commands must have executed before collecting the
+      // debugger test results.
+      r = engine->SubmitPendingCommands();
+      if (!r.IsSuccess())
+        return r;
+
       // Collect the debugger test results.
       r = debugger->Flush();
       if (!r.IsSuccess())
         return r;
     }
   }
-  return {};
+  // Even unbatched commands may still be executing, their failures are only
+  // reported once they completed.
+  return engine->SubmitPendingCommands();
+}
+
+Result Executor::ReadbackBuffers(Engine* engine,
+                                 Buffer* buffer_1,
+                                 Buffer* buffer_2) {
+  Result r = engine->ReadbackBuffer(buffer_1);
+  if (!r.IsSuccess())
+    return r;
+  return engine->ReadbackBuffer(buffer_2);
 }
 
-Result Executor::ExecuteCommand(Engine* engine, Command* cmd) {
+Result Executor::SubmitPendingCommands(Engine* engine) {
+  if (!batch_commands_)
+    return {};
+  return engine->SubmitPendingCommands();
+}
+
+Result Executor::ExecuteCommand(Engine* engine, const PlanStep& step) {
+  Command* cmd = step.command;
+  engine->SetCurrentLine(cmd->GetLine());
+
+  if (step.needs_host_sync) {
+    Result r = SubmitPendingCommands(engine);
+    if (!r.IsSuccess())
+      return r;
+  }
+
   if (cmd->IsProbe()) {
     auto* buffer = cmd->AsProbe()->GetBuffer();
     assert(buffer);
 
+    Result r = engine->ReadbackBuffer(buffer);
+    if (!r.IsSuccess())
+      return r;
+
     Format* fmt = buffer->GetFormat();
     return verifier_.Probe(cmd->AsProbe(), fmt, buffer->GetElementStride(),
                            buffer->GetRowStride(), buffer->GetWidth(),
@@ -137,12 +318,26 @@ Result Executor::ExecuteCommand(Engine* engine, Command* cmd) {
   if (cmd->IsProbeSSBO()) {
     auto probe_ssbo = cmd->AsProbeSSBO();
 
-    const auto* buffer = cmd->AsProbe()->GetBuffer();
+    auto* buffer = cmd->AsProbe()->GetBuffer();
     assert(buffer);
 
+    Result r = engine->ReadbackBuffer(buffer);
+    if (!r.IsSuccess())
+      return r;
+
     return verifier_.ProbeSSBO(probe_ssbo, buffer->ElementCount(),
                                buffer->ValuePtr()->data());
   }
+  if (cmd->IsExpectStatistics()) {
+    auto* expect = cmd->AsExpectStatistics();
+    CommandStatistics statistics;
+    Result r =
+        engine->GetPipelineStatistics(expect->GetPipeline(), &statistics);
+    if (!r.IsSuccess())
+      return r;
+
+    return verifier_.ProbeStatistics(expect, statistics);
+  }
   if (cmd->IsClear())
     return engine->DoClear(cmd->AsClear());
   if (cmd->IsClearColor())
@@ -155,6 +350,10 @@ Result Executor::ExecuteCommand(Engine* engine, Command* cmd) {
     auto compare = cmd->AsCompareBuffer();
     auto buffer_1 = compare->GetBuffer1();
     auto buffer_2 = compare->GetBuffer2();
+    Result r = ReadbackBuffers(engine, buffer_1, buffer_2);
+    if (!r.IsSuccess())
+      return r;
+
     switch (compare->GetComparator()) {
       case CompareBufferCommand::Comparator::kRmse:
         return buffer_1->CompareRMSE(buffer_2, compare->GetTolerance());
@@ -168,6 +367,12 @@ Result Executor::ExecuteCommand(Engine* engine, Command* cmd) {
     auto copy = cmd->AsCopy();
     auto buffer_from = copy->GetBufferFrom();
     auto buffer_to = copy->GetBufferTo();
+    // The destination is read back too, so its contents on the host are the
+    // latest ones and are uploaded again by the next command using it.
+    Result r = ReadbackBuffers(engine, buffer_from, buffer_to);
+    if (!r.IsSuccess())
+      return r;
+
     return buffer_from->CopyTo(buffer_to);
   }
   if (cmd->IsDrawRect())
@@ -184,18 +389,51 @@ Result Executor::ExecuteCommand(Engine* engine, Command* cmd) {
     return engine->DoPatchParameterVertices(cmd->AsPatchParameterVertices());
   if (cmd->IsBuffer())
     return engine->DoBuffer(cmd->AsBuffer());
-  if (cmd->IsRepeat()) {
-    for (uint32_t i = 0; i < cmd->AsRepeat()->GetCount(); ++i) {
-      for (const auto& sub_cmd : cmd->AsRepeat()->GetCommands()) {
-        Result r = ExecuteCommand(engine, sub_cmd.get());
-        if (!r.IsSuccess())
+  if (cmd->IsRepeat())
+    return ExecuteRepeat(engine, step);
+  return Result("Unknown command type: " +
+                std::to_string(static_cast<uint32_t>(cmd->GetType())));
+}
+
+Result Executor::ExecuteRepeat(Engine* engine, const PlanStep& step) {
+  const uint32_t count = step.command->AsRepeat()->GetCount();
+  Pipeline* pipeline = count > 1 ? GetReplayablePipeline(step.steps) : nullptr;
+
+  uint32_t i = 0;
+  if (pipeline) {
+    // The first iteration uploads the data the commands need. Once it is on
+    // the device the remaining iterations only have to be recorded once.
+    for (const auto& sub_step : step.steps) {
+      Result r = ExecuteCommand(engine, sub_step);
+      if (!r.IsSuccess())
+        return r;
+    }
+    ++i;
+
+    Result r = engine->SubmitPendingCommands();
+    if (!r.IsSuccess())
+      return r;
+
+    if (engine->BeginRepeat(pipeline)) {
+      for (const auto& sub_step : step.steps) {
+        r = ExecuteCommand(engine, sub_step);
+        if (!r.IsSuccess()) {
+          engine->EndRepeat(0);
           return r;
+        }
       }
+      return engine->EndRepeat(count - i);
     }
-    return {};
   }
-  return Result("Unknown command type: " +
-                std::to_string(static_cast<uint32_t>(cmd->GetType())));
+
+  for (; i < count; ++i) {
+    for (const auto& sub_step : step.steps) {
+      Result r = ExecuteCommand(engine, sub_step);
+      if (!r.IsSuccess())
+        return r;
+    }
+  }
+  return {};
 }
 
 }  // namespace amber
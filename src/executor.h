@@ -18,6 +18,7 @@
 #include "amber/amber.h"
 #include "amber/result.h"
 #include "src/engine.h"
+#include "src/execution_plan.h"
 #include "src/script.h"
 #include "src/verifier.h"
 
@@ -42,9 +43,23 @@ class Executor {
   Result CompileShaders(const Script* script,
                         const ShaderMap& shader_map,
                         Options* options);
-  Result ExecuteCommand(Engine* engine, Command* cmd);
+  /// Hands the draws and dispatches of |plan| to the engine to create their
+  /// device pipelines in the background, if requested in |options|.
+  Result PrecompilePipelines(Engine* engine,
+                             const ExecutionPlan& plan,
+                             Options* options);
+  Result ExecuteCommand(Engine* engine, const PlanStep& step);
+  /// Executes the steps of the REPEAT |step| the requested number of times.
+  /// Bodies which only run commands on the device are recorded once and
+  /// replayed by the engine if it supports it.
+  Result ExecuteRepeat(Engine* engine, const PlanStep& step);
+  /// Submits the commands the engine batched, if batching is enabled.
+  Result SubmitPendingCommands(Engine* engine);
+  /// Copies the results the engine holds for both buffers back to the host.
+  Result ReadbackBuffers(Engine* engine, Buffer* buffer_1, Buffer* buffer_2);
 
   Verifier verifier_;
+  bool batch_commands_ = false;
 };
 
 }  // namespace amber
@@ -51,8 +51,20 @@ class EngineStub : public Engine {
   }
   uint32_t GetFenceTimeoutMs() { return GetEngineData().fence_timeout_ms; }
 
+  Result Reset() override { return {}; }
   Result CreatePipeline(Pipeline*) override { return {}; }
 
+  Result PrecompilePipelines(const std::vector<Command*>& commands,
+                             uint32_t thread_count) override {
+    precompiled_commands_ = commands;
+    precompile_thread_count_ = thread_count;
+    return {};
+  }
+  const std::vector<Command*>& GetPrecompiledCommands() const {
+    return precompiled_commands_;
+  }
+  uint32_t GetPrecompileThreadCount() const { return precompile_thread_count_; }
+
   void FailClearColorCommand() { fail_clear_color_command_ = true; }
   bool DidClearColorCommand() { return did_clear_color_command_ = true; }
   ClearColorCommand* GetLastClearColorCommand() { return last_clear_color_; }
@@ -128,8 +140,11 @@ class EngineStub : public Engine {
 
   void FailComputeCommand() { fail_compute_command_ = true; }
   bool DidComputeCommand() const { return did_compute_command_; }
+  size_t GetComputeCommandLine() const { return compute_command_line_; }
   Result DoCompute(const ComputeCommand*) override {
     did_compute_command_ = true;
+    ++compute_command_count_;
+    compute_command_line_ = GetCurrentLine();
 
     if (fail_compute_command_)
       return Result("compute command failed");
@@ -167,6 +182,46 @@ class EngineStub : public Engine {
     return {};
   }
 
+  Result SubmitPendingCommands() override {
+    ++submit_pending_commands_count_;
+    return {};
+  }
+  uint32_t GetSubmitPendingCommandsCount() const {
+    return submit_pending_commands_count_;
+  }
+
+  Result ReadbackBuffer(Buffer* buffer) override {
+    readback_buffers_.push_back(buffer);
+    return {};
+  }
+  const std::vector<Buffer*>& GetReadbackBuffers() const {
+    return readback_buffers_;
+  }
+
+  void SupportRepeat() { support_repeat_ = true; }
+  bool BeginRepeat(Pipeline*) override {
+    ++begin_repeat_count_;
+    return support_repeat_;
+  }
+  Result EndRepeat(uint32_t count) override {
+    end_repeat_counts_.push_back(count);
+    return {};
+  }
+  uint32_t GetBeginRepeatCount() const { return begin_repeat_count_; }
+  const std::vector<uint32_t>& GetEndRepeatCounts() const {
+    return end_repeat_counts_;
+  }
+  uint32_t GetComputeCommandCount() const { return compute_command_count_; }
+
+  void SetPipelineStatistics(const CommandStatistics& statistics) {
+    statistics_ = statistics;
+  }
+  Result GetPipelineStatistics(Pipeline*,
+                               CommandStatistics* statistics) override {
+    *statistics = statistics_;
+    return {};
+  }
+
   std::pair<Debugger*, Result> GetDebugger() override {
     return {nullptr,
             Result("EngineStub does not currently support a debugger")};
@@ -197,6 +252,17 @@ class EngineStub : public Engine {
   bool did_patch_command_ = false;
   bool did_buffer_command_ = false;
 
+  uint32_t submit_pending_commands_count_ = 0;
+  uint32_t compute_command_count_ = 0;
+  bool support_repeat_ = false;
+  uint32_t begin_repeat_count_ = 0;
+  std::vector<uint32_t> end_repeat_counts_;
+  std::vector<Buffer*> readback_buffers_;
+  size_t compute_command_line_ = 0;
+  CommandStatistics statistics_;
+  std::vector<Command*> precompiled_commands_;
+  uint32_t precompile_thread_count_ = 0;
+
   std::vector<std::string> features_;
   std::vector<std::string> instance_extensions_;
   std::vector<std::string> device_extensions_;
@@ -222,6 +288,25 @@ class VkScriptExecutorTest : public testing::Test {
   EngineStub* ToStub(Engine* engine) {
     return static_cast<EngineStub*>(engine);
   }
+
+  /// Replaces the commands of |script| with a REPEAT of |count| iterations
+  /// of two dispatches on its pipeline, followed by |extra| if given.
+  void SetRepeatCommands(Script* script,
+                         uint32_t count,
+                         std::unique_ptr<Command> extra) {
+    Pipeline* pipeline = script->GetPipelines()[0].get();
+    std::vector<std::unique_ptr<Command>> body;
+    body.push_back(MakeUnique<ComputeCommand>(pipeline));
+    body.push_back(MakeUnique<ComputeCommand>(pipeline));
+    if (extra)
+      body.push_back(std::move(extra));
+
+    auto repeat = MakeUnique<RepeatCommand>(count);
+    repeat->SetCommands(std::move(body));
+    std::vector<std::unique_ptr<Command>> cmds;
+    cmds.push_back(std::move(repeat));
+    script->SetCommands(std::move(cmds));
+  }
 };
 
 }  // namespace
@@ -377,6 +462,82 @@ fence_timeout 12345)";
   EXPECT_EQ(12345U, ToStub(engine.get())->GetFenceTimeoutMs());
 }
 
+TEST_F(VkScriptExecutorTest, CompilesShadersOnMultipleThreads) {
+  std::string input = R"(
+[vertex shader spirv hex]
+0x03 0x02 0x23 0x07 0x00 0x00 0x01 0x00
+
+[fragment shader spirv hex]
+0x03 0x02 0x23 0x07 0x00 0x03 0x01 0x00 0x07 0x00 0x08 0x00
+)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  auto script = parser.GetScript();
+
+  Options options;
+  options.disable_spirv_validation = true;
+  options.shader_compile_threads = 0;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+
+  ASSERT_EQ(1U, script->GetPipelines().size());
+  const auto& shaders = script->GetPipelines()[0]->GetShaders();
+  ASSERT_EQ(2U, shaders.size());
+  EXPECT_EQ(std::vector<uint32_t>({0x07230203, 0x00010000}),
+            shaders[0].GetData());
+  EXPECT_EQ(std::vector<uint32_t>({0x07230203, 0x00010300, 0x00080007}),
+            shaders[1].GetData());
+}
+
+TEST_F(VkScriptExecutorTest, CompileReportsFirstFailingShader) {
+  struct ShaderDesc {
+    ShaderType type;
+    ShaderFormat format;
+    const char* data;
+  };
+  const ShaderDesc descs[] = {
+      {kShaderTypeVertex, kShaderFormatSpirvHex, "0x03 0x02 0x23 0x07"},
+      {kShaderTypeFragment, kShaderFormatText, "not a shader"},
+      {kShaderTypeGeometry, kShaderFormatSpirvHex, "0x03 0x02 0x23 0x07"},
+      {kShaderTypeTessellationControl, kShaderFormatHlsl, "not a shader"},
+      {kShaderTypeTessellationEvaluation, kShaderFormatText, "not a shader"},
+  };
+
+  Script script;
+  auto pipeline = MakeUnique<Pipeline>(PipelineType::kGraphics);
+  for (const auto& desc : descs) {
+    auto shader = MakeUnique<Shader>(desc.type);
+    shader->SetName("shader" + std::to_string(desc.type));
+    shader->SetFormat(desc.format);
+    shader->SetData(desc.data);
+    ASSERT_TRUE(pipeline->AddShader(shader.get(), desc.type).IsSuccess());
+    ASSERT_TRUE(script.AddShader(std::move(shader)).IsSuccess());
+  }
+  ASSERT_TRUE(script.AddPipeline(std::move(pipeline)).IsSuccess());
+
+  auto engine = MakeEngine();
+
+  Options options;
+  options.disable_spirv_validation = true;
+  options.shader_compile_threads = 4;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), &script, ShaderMap(), &options);
+  ASSERT_FALSE(r.IsSuccess());
+  EXPECT_EQ("Invalid shader format", r.Error());
+
+  // Results are applied in script order up to the first failure, whichever
+  // shader finished compiling first.
+  const auto& shaders = script.GetPipelines()[0]->GetShaders();
+  ASSERT_EQ(5U, shaders.size());
+  EXPECT_EQ(std::vector<uint32_t>({0x07230203}), shaders[0].GetData());
+  EXPECT_TRUE(shaders[2].GetData().empty());
+}
+
 TEST_F(VkScriptExecutorTest, ClearCommand) {
   std::string input = R"(
 [test]
@@ -639,6 +800,244 @@ compute 2 3 4)";
   ASSERT_TRUE(ToStub(engine.get())->DidComputeCommand());
 }
 
+TEST_F(VkScriptExecutorTest, BatchCommandsSubmitsOnce) {
+  std::string input = R"(
+[test]
+compute 2 3 4
+compute 2 3 4
+compute 2 3 4)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  auto script = parser.GetScript();
+
+  Options options;
+  options.batch_commands = true;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess());
+  EXPECT_EQ(1U, ToStub(engine.get())->GetSubmitPendingCommandsCount());
+}
+
+TEST_F(VkScriptExecutorTest, BatchCommandsSubmitsBeforeOtherCommands) {
+  std::string input = R"(
+[test]
+compute 2 3 4
+compute 2 3 4
+vertex entrypoint main
+compute 2 3 4)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  auto script = parser.GetScript();
+
+  Options options;
+  options.batch_commands = true;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess());
+  EXPECT_EQ(2U, ToStub(engine.get())->GetSubmitPendingCommandsCount());
+}
+
+TEST_F(VkScriptExecutorTest, DoesNotSubmitPendingCommandsWithoutBatching) {
+  std::string input = R"(
+[test]
+compute 2 3 4
+vertex entrypoint main
+compute 2 3 4)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  auto script = parser.GetScript();
+
+  Options options;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess());
+  // Only the commands still in flight at the end are waited for.
+  EXPECT_EQ(1U, ToStub(engine.get())->GetSubmitPendingCommandsCount());
+}
+
+TEST_F(VkScriptExecutorTest, RepeatReplaysDeviceOnlyCommands) {
+  std::string input = R"(
+[test]
+compute 2 3 4)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  ToStub(engine.get())->SupportRepeat();
+  auto script = parser.GetScript();
+  SetRepeatCommands(script.get(), 5, nullptr);
+
+  Options options;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess());
+
+  // The first iteration executes as usual, the second one is recorded and
+  // replayed for all remaining iterations.
+  EXPECT_EQ(4U, ToStub(engine.get())->GetComputeCommandCount());
+  EXPECT_EQ(1U, ToStub(engine.get())->GetBeginRepeatCount());
+  EXPECT_EQ(std::vector<uint32_t>{4U},
+            ToStub(engine.get())->GetEndRepeatCounts());
+}
+
+TEST_F(VkScriptExecutorTest, RepeatReplaysDrawRect) {
+  std::string input = R"(
+[test]
+draw rect 2 4 10 20)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  ToStub(engine.get())->SupportRepeat();
+  auto script = parser.GetScript();
+
+  Pipeline* pipeline = script->GetPipelines()[0].get();
+  std::vector<std::unique_ptr<Command>> body;
+  body.push_back(MakeUnique<DrawRectCommand>(pipeline, PipelineData()));
+  auto repeat = MakeUnique<RepeatCommand>(3);
+  repeat->SetCommands(std::move(body));
+  std::vector<std::unique_ptr<Command>> cmds;
+  cmds.push_back(std::move(repeat));
+  script->SetCommands(std::move(cmds));
+
+  Options options;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess());
+  EXPECT_TRUE(ToStub(engine.get())->DidDrawRectCommand());
+  EXPECT_EQ(1U, ToStub(engine.get())->GetBeginRepeatCount());
+  EXPECT_EQ(std::vector<uint32_t>{2U},
+            ToStub(engine.get())->GetEndRepeatCounts());
+}
+
+TEST_F(VkScriptExecutorTest, RepeatWithoutEngineReplay) {
+  std::string input = R"(
+[test]
+compute 2 3 4)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  auto script = parser.GetScript();
+  SetRepeatCommands(script.get(), 5, nullptr);
+
+  Options options;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess());
+  EXPECT_EQ(10U, ToStub(engine.get())->GetComputeCommandCount());
+  EXPECT_EQ(1U, ToStub(engine.get())->GetBeginRepeatCount());
+  EXPECT_TRUE(ToStub(engine.get())->GetEndRepeatCounts().empty());
+}
+
+TEST_F(VkScriptExecutorTest, RepeatWithHostCommandsIsNotReplayed) {
+  std::string input = R"(
+[test]
+compute 2 3 4)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  ToStub(engine.get())->SupportRepeat();
+  auto script = parser.GetScript();
+  SetRepeatCommands(
+      script.get(), 5,
+      MakeUnique<EntryPointCommand>(script->GetPipelines()[0].get()));
+
+  Options options;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess());
+  EXPECT_EQ(10U, ToStub(engine.get())->GetComputeCommandCount());
+  EXPECT_EQ(0U, ToStub(engine.get())->GetBeginRepeatCount());
+}
+
+TEST_F(VkScriptExecutorTest, PrecompilesPipelinesOfDispatches) {
+  std::string input = R"(
+[test]
+compute 2 3 4
+compute 5 6 7)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  auto script = parser.GetScript();
+
+  Options options;
+  options.pipeline_compile_threads = 3;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess());
+
+  const auto& commands = ToStub(engine.get())->GetPrecompiledCommands();
+  ASSERT_EQ(2U, commands.size());
+  EXPECT_EQ(script->GetCommands()[0].get(), commands[0]);
+  EXPECT_EQ(script->GetCommands()[1].get(), commands[1]);
+  EXPECT_EQ(3U, ToStub(engine.get())->GetPrecompileThreadCount());
+}
+
+TEST_F(VkScriptExecutorTest, DoesNotPrecompileChangedPipelines) {
+  std::string input = R"(
+[test]
+ssbo 0 subdata float 0 1.0
+compute 1 1 1)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  auto script = parser.GetScript();
+
+  Options options;
+  options.pipeline_compile_threads = 2;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess());
+  EXPECT_TRUE(ToStub(engine.get())->GetPrecompiledCommands().empty());
+}
+
+TEST_F(VkScriptExecutorTest, DoesNotPrecompilePipelinesByDefault) {
+  std::string input = R"(
+[test]
+compute 2 3 4)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  auto script = parser.GetScript();
+
+  Options options;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess());
+  EXPECT_TRUE(ToStub(engine.get())->GetPrecompiledCommands().empty());
+}
+
 TEST_F(VkScriptExecutorTest, ComputeCommandFailure) {
   std::string input = R"(
 [test]
@@ -831,6 +1230,103 @@ probe ssbo vec3 0 2 <= 2 3 4)";
   // ASSERT_TRUE(ToStub(engine.get())->DidProbeSSBOCommand());
 }
 
+TEST_F(VkScriptExecutorTest, ProbeSSBOCommandReadsBackBuffer) {
+  std::string input = R"(
+[test]
+ssbo 0 subdata float 0 1.0
+compute 1 1 1
+probe ssbo float 0 0 == 1.0)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  auto script = parser.GetScript();
+
+  Options options;
+  Executor ex;
+  ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+
+  // The stub engine does not fill the buffer, so only check the probed buffer
+  // was read back and nothing else was.
+  auto* buffer = script->GetPipelines()[0]->GetBufferForBinding(0, 0);
+  ASSERT_TRUE(buffer != nullptr);
+
+  const auto& readbacks = ToStub(engine.get())->GetReadbackBuffers();
+  ASSERT_EQ(1U, readbacks.size());
+  EXPECT_EQ(buffer, readbacks[0]);
+}
+
+TEST_F(VkScriptExecutorTest, SetsCurrentLineOfCommands) {
+  std::string input = R"(
+[test]
+ssbo 0 subdata float 0 1.0
+compute 1 1 1
+clear)";
+
+  Parser parser;
+  parser.SkipValidationForTest();
+  ASSERT_TRUE(parser.Parse(input).IsSuccess());
+
+  auto engine = MakeEngine();
+  auto script = parser.GetScript();
+
+  Options options;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+
+  size_t compute_line = 0;
+  for (const auto& cmd : script->GetCommands()) {
+    if (cmd->IsCompute())
+      compute_line = cmd->GetLine();
+  }
+  ASSERT_NE(0U, compute_line);
+  EXPECT_EQ(compute_line, ToStub(engine.get())->GetComputeCommandLine());
+}
+
+TEST_F(VkScriptExecutorTest, ExpectStatisticsCommand) {
+  auto script = MakeUnique<Script>();
+  auto pipeline = MakeUnique<Pipeline>(PipelineType::kGraphics);
+  pipeline->SetName("my_pipeline");
+  pipeline->SetPipelineStatisticsEnabled(true);
+  Pipeline* pipeline_ptr = pipeline.get();
+  ASSERT_TRUE(script->AddPipeline(std::move(pipeline)).IsSuccess());
+
+  auto expect = MakeUnique<ExpectStatisticsCommand>(pipeline_ptr);
+  expect->SetLine(7);
+  expect->SetCounter(ExpectStatisticsCommand::Counter::kFragmentInvocations);
+  expect->SetComparator(ProbeSSBOCommand::Comparator::kLess);
+  expect->SetValue(100);
+  std::vector<std::unique_ptr<Command>> commands;
+  commands.push_back(std::move(expect));
+  script->SetCommands(std::move(commands));
+
+  CommandStatistics statistics;
+  statistics.line = 5;
+  statistics.type = "draw";
+  statistics.fragment_invocations = 99;
+
+  auto engine = MakeEngine();
+  ToStub(engine.get())->SetPipelineStatistics(statistics);
+
+  Options options;
+  Executor ex;
+  Result r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  EXPECT_TRUE(r.IsSuccess()) << r.Error();
+
+  statistics.fragment_invocations = 100;
+  ToStub(engine.get())->SetPipelineStatistics(statistics);
+
+  r = ex.Execute(engine.get(), script.get(), ShaderMap(), &options);
+  ASSERT_FALSE(r.IsSuccess());
+  EXPECT_EQ(
+      "Line 7: Verifier failed: fragment_invocations 100 < 100, for the "
+      "command at line 5",
+      r.Error());
+}
+
 TEST_F(VkScriptExecutorTest, DISABLED_ProbeSSBOCommandFailure) {
   std::string input = R"(
 [test]
@@ -70,6 +70,7 @@ std::unique_ptr<Pipeline> Pipeline::Clone() const {
   clone->fb_width_ = fb_width_;
   clone->fb_height_ = fb_height_;
   clone->set_arg_values_ = set_arg_values_;
+  clone->pipeline_statistics_enabled_ = pipeline_statistics_enabled_;
 
   if (!opencl_pod_buffers_.empty()) {
     // Generate specific buffers for the clone.
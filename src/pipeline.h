@@ -308,6 +308,15 @@ class Pipeline {
   Result SetPolygonMode(PolygonMode mode);
   PolygonMode GetPolygonMode() const { return polygon_mode_; }
 
+  /// Sets if the pipeline statistics of the draws or dispatches executed on
+  /// the pipeline are collected.
+  void SetPipelineStatisticsEnabled(bool enabled) {
+    pipeline_statistics_enabled_ = enabled;
+  }
+  bool IsPipelineStatisticsEnabled() const {
+    return pipeline_statistics_enabled_;
+  }
+
   /// Validates that the pipeline has been created correctly.
   Result Validate() const;
 
@@ -360,6 +369,7 @@ class Pipeline {
   BufferInfo push_constant_buffer_;
   Buffer* index_buffer_ = nullptr;
   PolygonMode polygon_mode_ = PolygonMode::kFill;
+  bool pipeline_statistics_enabled_ = false;
 
   uint32_t fb_width_ = 250;
   uint32_t fb_height_ = 250;
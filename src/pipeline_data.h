@@ -28,6 +28,13 @@ class PipelineData {
   ~PipelineData();
   PipelineData(const PipelineData&);
 
+  PipelineData& operator=(const PipelineData&);
+
+  /// Returns true if all of the pipeline state in |other| matches this
+  /// pipeline state.
+  bool operator==(const PipelineData& other) const;
+  bool operator!=(const PipelineData& other) const { return !(*this == other); }
+
   void SetTopology(Topology topo) { topology_ = topo; }
   Topology GetTopology() const { return topology_; }
 
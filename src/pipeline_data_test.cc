@@ -0,0 +1,73 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/pipeline_data.h"
+
+#include "gtest/gtest.h"
+
+namespace amber {
+
+using PipelineDataTest = testing::Test;
+
+TEST_F(PipelineDataTest, DefaultsAreEqual) {
+  PipelineData a;
+  PipelineData b;
+  EXPECT_TRUE(a == b);
+  EXPECT_FALSE(a != b);
+}
+
+TEST_F(PipelineDataTest, CopyIsEqual) {
+  PipelineData a;
+  a.SetTopology(Topology::kLineList);
+  a.SetEnableDepthTest(true);
+  a.SetDepthCompareOp(CompareOp::kLess);
+  a.SetLineWidth(2.5f);
+
+  PipelineData b(a);
+  EXPECT_TRUE(a == b);
+}
+
+TEST_F(PipelineDataTest, EnumStateDiffers) {
+  PipelineData a;
+  PipelineData b;
+  b.SetCullMode(CullMode::kBack);
+  EXPECT_FALSE(a == b);
+  EXPECT_TRUE(a != b);
+}
+
+TEST_F(PipelineDataTest, BoolStateDiffers) {
+  PipelineData a;
+  PipelineData b;
+  b.SetEnableBlend(true);
+  EXPECT_TRUE(a != b);
+}
+
+TEST_F(PipelineDataTest, MaskStateDiffers) {
+  PipelineData a;
+  PipelineData b;
+  b.SetBackWriteMask(0xff);
+  EXPECT_TRUE(a != b);
+}
+
+TEST_F(PipelineDataTest, FloatStateDiffers) {
+  PipelineData a;
+  PipelineData b;
+  b.SetMaxDepthBounds(0.5f);
+  EXPECT_TRUE(a != b);
+
+  a.SetMaxDepthBounds(0.5f);
+  EXPECT_TRUE(a == b);
+}
+
+}  // namespace amber
@@ -0,0 +1,199 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "amber/shader_cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <utility>
+
+namespace amber {
+namespace {
+
+// Marks a file as a shader cache entry, 'AMSC' in little endian.
+const uint32_t kFileMagic = 0x43534d41;
+// Bumped whenever the layout of the file changes. Version 2 added the
+// payload word count and checksum.
+const uint32_t kFileVersion = 2;
+
+// The header of an entry file. It is followed by the key and the payload.
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t key_size;
+  uint32_t word_count;
+  uint32_t checksum;
+};
+
+uint64_t HashKey(const std::string& key) {
+  // 64-bit FNV-1a.
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (char c : key) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+// 32-bit FNV-1a over the bytes of |words|.
+uint32_t Checksum(const std::vector<uint32_t>& words) {
+  uint32_t hash = 0x811c9dc5U;
+  for (uint32_t word : words) {
+    for (uint32_t i = 0; i < 4; ++i) {
+      hash ^= (word >> (i * 8)) & 0xff;
+      hash *= 0x01000193U;
+    }
+  }
+  return hash;
+}
+
+}  // namespace
+
+ShaderCache::ShaderCache() = default;
+
+ShaderCache::ShaderCache(const std::string& directory)
+    : directory_(directory) {}
+
+ShaderCache::~ShaderCache() = default;
+
+bool ShaderCache::Find(const std::string& key, std::vector<uint32_t>* data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it != entries_.end()) {
+    *data = it->second;
+  } else if (ReadFile(key, data)) {
+    entries_[key] = *data;
+  } else {
+    ++miss_count_;
+    return false;
+  }
+
+  ++hit_count_;
+  bytes_saved_ += data->size() * sizeof(uint32_t);
+  return true;
+}
+
+void ShaderCache::Insert(const std::string& key,
+                         const std::vector<uint32_t>& data) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_[key] = data;
+  WriteFile(key, data);
+}
+
+uint64_t ShaderCache::GetHitCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hit_count_;
+}
+
+uint64_t ShaderCache::GetMissCount() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return miss_count_;
+}
+
+uint64_t ShaderCache::GetBytesSaved() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return bytes_saved_;
+}
+
+std::string ShaderCache::GetFilePath(const std::string& key) const {
+  std::ostringstream path;
+  path << directory_ << "/" << std::hex << std::setfill('0') << std::setw(16)
+       << HashKey(key) << ".spvcache";
+  return path.str();
+}
+
+bool ShaderCache::ReadFile(const std::string& key,
+                           std::vector<uint32_t>* data) const {
+  if (directory_.empty())
+    return false;
+
+  std::ifstream file(GetFilePath(key), std::ios::in | std::ios::binary);
+  if (!file.is_open())
+    return false;
+
+  FileHeader header = {};
+  if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      header.magic != kFileMagic || header.version != kFileVersion ||
+      header.key_size != key.size() || header.word_count == 0) {
+    return false;
+  }
+
+  // The file name is only a hash of the key, so make sure the entry really
+  // belongs to |key| before using it.
+  std::string stored_key(header.key_size, '\0');
+  if (!file.read(&stored_key[0],
+                 static_cast<std::streamsize>(header.key_size)) ||
+      stored_key != key) {
+    return false;
+  }
+
+  // A file cut short or holding trailing data is not a complete entry.
+  std::vector<uint32_t> words(header.word_count);
+  if (!file.read(reinterpret_cast<char*>(words.data()),
+                 static_cast<std::streamsize>(words.size() *
+                                              sizeof(uint32_t))) ||
+      file.peek() != std::ifstream::traits_type::eof() ||
+      Checksum(words) != header.checksum) {
+    return false;
+  }
+
+  *data = std::move(words);
+  return true;
+}
+
+void ShaderCache::WriteFile(const std::string& key,
+                            const std::vector<uint32_t>& data) const {
+  if (directory_.empty())
+    return;
+
+  // The entry is written to a file of its own and renamed into place, so
+  // readers, including other processes sharing the directory, never see a
+  // partially written entry.
+  const std::string path = GetFilePath(key);
+  std::ostringstream temp_path;
+  std::random_device random;
+  temp_path << path << ".tmp" << std::hex << random() << random();
+
+  // Failing to persist an entry is not an error, the binary is still cached
+  // in memory.
+  {
+    std::ofstream file(temp_path.str(), std::ios::out | std::ios::binary);
+    if (!file.is_open())
+      return;
+
+    const FileHeader header = {kFileMagic, kFileVersion,
+                               static_cast<uint32_t>(key.size()),
+                               static_cast<uint32_t>(data.size()),
+                               Checksum(data)};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(key.data(), static_cast<std::streamsize>(key.size()));
+    file.write(reinterpret_cast<const char*>(data.data()),
+               static_cast<std::streamsize>(data.size() * sizeof(uint32_t)));
+    file.close();
+    if (!file) {
+      std::remove(temp_path.str().c_str());
+      return;
+    }
+  }
+
+  // Where renaming does not replace an existing file, the entry written by
+  // another process is kept.
+  if (std::rename(temp_path.str().c_str(), path.c_str()) != 0)
+    std::remove(temp_path.str().c_str());
+}
+
+}  // namespace amber
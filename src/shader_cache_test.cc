@@ -0,0 +1,164 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "amber/shader_cache.h"
+
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace amber {
+
+using ShaderCacheTest = testing::Test;
+
+namespace {
+
+std::string GetCacheDirectory() {
+  std::string dir = testing::TempDir();
+  // Drop the trailing separator gtest adds.
+  if (!dir.empty() && (dir.back() == '/' || dir.back() == '\\'))
+    dir.pop_back();
+  return dir;
+}
+
+// The file the cache in |dir| persists the entry for |key| in, named after
+// the 64-bit FNV-1a hash of the key.
+std::string GetEntryPath(const std::string& dir, const std::string& key) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (char c : key) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 0x100000001b3ULL;
+  }
+  std::ostringstream path;
+  path << dir << "/" << std::hex << std::setfill('0') << std::setw(16) << hash
+       << ".spvcache";
+  return path.str();
+}
+
+std::string ReadBytes(const std::string& path) {
+  std::ifstream file(path, std::ios::in | std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+void WriteBytes(const std::string& path, const std::string& bytes) {
+  std::ofstream file(path, std::ios::out | std::ios::binary);
+  file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+}
+
+}  // namespace
+
+TEST_F(ShaderCacheTest, MissOnEmptyCache) {
+  ShaderCache cache;
+  std::vector<uint32_t> data;
+  EXPECT_FALSE(cache.Find("key", &data));
+  EXPECT_TRUE(data.empty());
+  EXPECT_EQ(0U, cache.GetHitCount());
+  EXPECT_EQ(1U, cache.GetMissCount());
+  EXPECT_EQ(0U, cache.GetBytesSaved());
+}
+
+TEST_F(ShaderCacheTest, HitAfterInsert) {
+  ShaderCache cache;
+  std::vector<uint32_t> binary = {0x07230203, 1, 2, 3};
+  cache.Insert("key", binary);
+
+  std::vector<uint32_t> data;
+  ASSERT_TRUE(cache.Find("key", &data));
+  EXPECT_EQ(binary, data);
+  EXPECT_EQ(1U, cache.GetHitCount());
+  EXPECT_EQ(0U, cache.GetMissCount());
+  EXPECT_EQ(binary.size() * sizeof(uint32_t), cache.GetBytesSaved());
+
+  EXPECT_FALSE(cache.Find("other key", &data));
+  EXPECT_EQ(1U, cache.GetMissCount());
+}
+
+TEST_F(ShaderCacheTest, InsertReplacesEntry) {
+  ShaderCache cache;
+  cache.Insert("key", {1, 2, 3});
+  cache.Insert("key", {4, 5});
+
+  std::vector<uint32_t> data;
+  ASSERT_TRUE(cache.Find("key", &data));
+  EXPECT_EQ(std::vector<uint32_t>({4, 5}), data);
+}
+
+TEST_F(ShaderCacheTest, PersistsToDirectory) {
+  const std::string dir = GetCacheDirectory();
+  const std::string key = "ShaderCacheTest.PersistsToDirectory";
+  std::vector<uint32_t> binary = {0x07230203, 0x00010000, 42};
+  {
+    ShaderCache cache(dir);
+    cache.Insert(key, binary);
+  }
+
+  ShaderCache cache(dir);
+  std::vector<uint32_t> data;
+  ASSERT_TRUE(cache.Find(key, &data));
+  EXPECT_EQ(binary, data);
+  EXPECT_EQ(1U, cache.GetHitCount());
+
+  EXPECT_FALSE(cache.Find(key + " with a different suffix", &data));
+}
+
+TEST_F(ShaderCacheTest, RejectsTruncatedFile) {
+  const std::string dir = GetCacheDirectory();
+  const std::string key = "ShaderCacheTest.RejectsTruncatedFile";
+  const std::string path = GetEntryPath(dir, key);
+  {
+    ShaderCache cache(dir);
+    cache.Insert(key, {0x07230203, 0x00010000, 42});
+  }
+
+  // Drop the last word, the file still ends on a word boundary.
+  std::string bytes = ReadBytes(path);
+  ASSERT_GT(bytes.size(), sizeof(uint32_t));
+  bytes.resize(bytes.size() - sizeof(uint32_t));
+  WriteBytes(path, bytes);
+
+  ShaderCache cache(dir);
+  std::vector<uint32_t> data;
+  EXPECT_FALSE(cache.Find(key, &data));
+  EXPECT_EQ(1U, cache.GetMissCount());
+}
+
+TEST_F(ShaderCacheTest, RejectsCorruptedFile) {
+  const std::string dir = GetCacheDirectory();
+  const std::string key = "ShaderCacheTest.RejectsCorruptedFile";
+  const std::string path = GetEntryPath(dir, key);
+  {
+    ShaderCache cache(dir);
+    cache.Insert(key, {0x07230203, 0x00010000, 42});
+  }
+
+  // Flip a bit in the last payload word.
+  std::string bytes = ReadBytes(path);
+  ASSERT_FALSE(bytes.empty());
+  bytes.back() = static_cast<char>(bytes.back() ^ 1);
+  WriteBytes(path, bytes);
+
+  ShaderCache cache(dir);
+  std::vector<uint32_t> data;
+  EXPECT_FALSE(cache.Find(key, &data));
+  EXPECT_EQ(1U, cache.GetMissCount());
+}
+
+}  // namespace amber
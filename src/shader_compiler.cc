@@ -44,6 +44,36 @@
 #endif  // AMBER_ENABLE_CLSPV
 
 namespace amber {
+namespace {
+
+// Bumped whenever the way amber itself produces binaries changes, so stale
+// entries in a persistent shader cache are not reused.
+const char kShaderCacheKeyVersion[] = "amber-1";
+
+// Returns a string identifying the compilers linked into amber. Binaries
+// built by a different toolchain must not share cache entries.
+std::string GetToolchainVersion() {
+  std::string version = kShaderCacheKeyVersion;
+#if AMBER_ENABLE_SPIRV_TOOLS
+  version += std::string(" spirv-tools:") + spvSoftwareVersionDetailsString();
+#endif  // AMBER_ENABLE_SPIRV_TOOLS
+#if AMBER_ENABLE_SHADERC
+  unsigned int spv_version = 0;
+  unsigned int spv_revision = 0;
+  shaderc_get_spv_version(&spv_version, &spv_revision);
+  version += " shaderc:" + std::to_string(spv_version) + "." +
+             std::to_string(spv_revision);
+#endif  // AMBER_ENABLE_SHADERC
+#if AMBER_ENABLE_DXC
+  version += " dxc";
+#endif  // AMBER_ENABLE_DXC
+#ifdef AMBER_ENABLE_CLSPV
+  version += " clspv";
+#endif  // AMBER_ENABLE_CLSPV
+  return version;
+}
+
+}  // namespace
 
 ShaderCompiler::ShaderCompiler() = default;
 
@@ -51,6 +81,13 @@ ShaderCompiler::ShaderCompiler(const std::string& env,
                                bool disable_spirv_validation)
     : spv_env_(env), disable_spirv_validation_(disable_spirv_validation) {}
 
+ShaderCompiler::ShaderCompiler(const std::string& env,
+                               bool disable_spirv_validation,
+                               ShaderCache* shader_cache)
+    : spv_env_(env),
+      disable_spirv_validation_(disable_spirv_validation),
+      shader_cache_(shader_cache) {}
+
 ShaderCompiler::~ShaderCompiler() = default;
 
 std::pair<Result, std::vector<uint32_t>> ShaderCompiler::Compile(
@@ -74,6 +111,14 @@ std::pair<Result, std::vector<uint32_t>> ShaderCompiler::Compile(
     return {{}, it->second};
   }
 
+  std::string cache_key;
+  if (shader_cache_ && shader->GetFormat() != kShaderFormatOpenCLC) {
+    cache_key = GetShaderCacheKey(shader_info);
+    std::vector<uint32_t> cached;
+    if (shader_cache_->Find(cache_key, &cached))
+      return {{}, cached};
+  }
+
 #if AMBER_ENABLE_SPIRV_TOOLS
   std::string spv_errors;
 
@@ -175,9 +220,42 @@ std::pair<Result, std::vector<uint32_t>> ShaderCompiler::Compile(
   }
 #endif  // AMBER_ENABLE_SPIRV_TOOLS
 
+  if (!cache_key.empty())
+    shader_cache_->Insert(cache_key, results);
+
   return {{}, results};
 }
 
+std::string ShaderCompiler::GetShaderCacheKey(
+    const Pipeline::ShaderInfo* shader_info) const {
+  // Each string is prefixed with its length so that different inputs can
+  // never produce the same key.
+  std::string key;
+  auto append = [&key](const std::string& str) {
+    key += std::to_string(str.size()) + ":" + str;
+  };
+
+  static const std::string toolchain_version = GetToolchainVersion();
+  append(toolchain_version);
+
+  const auto shader = shader_info->GetShader();
+  append(std::to_string(shader->GetType()));
+  append(std::to_string(shader->GetFormat()));
+  append(spv_env_);
+  append(disable_spirv_validation_ ? "noval" : "val");
+  append(shader->GetData());
+
+  append(std::to_string(shader_info->GetCompileOptions().size()));
+  for (const auto& option : shader_info->GetCompileOptions())
+    append(option);
+
+  append(std::to_string(shader_info->GetShaderOptimizations().size()));
+  for (const auto& pass : shader_info->GetShaderOptimizations())
+    append(pass);
+
+  return key;
+}
+
 Result ShaderCompiler::ParseHex(const std::string& data,
                                 std::vector<uint32_t>* result) const {
   size_t used = 0;
@@ -21,6 +21,7 @@
 
 #include "amber/amber.h"
 #include "amber/result.h"
+#include "amber/shader_cache.h"
 #include "src/pipeline.h"
 #include "src/shader.h"
 
@@ -31,6 +32,12 @@ class ShaderCompiler {
  public:
   ShaderCompiler();
   ShaderCompiler(const std::string& env, bool disable_spirv_validation);
+  /// Creates a compiler which looks up and stores compiled binaries in
+  /// |shader_cache|. The |shader_cache| is _not_ owned by the compiler and may
+  /// be nullptr.
+  ShaderCompiler(const std::string& env,
+                 bool disable_spirv_validation,
+                 ShaderCache* shader_cache);
   ~ShaderCompiler();
 
   /// Returns a result code and a compilation of the given shader.
@@ -42,6 +49,11 @@ class ShaderCompiler {
   /// entry in |shader_map| for that shader, then the SPIRV-Tools optimizer will
   /// be invoked to produce the shader binary.
   ///
+  /// If a shader cache was provided, a binary previously compiled from the
+  /// same inputs is returned from the cache without compiling or validating
+  /// the shader again. OPENCL-C shaders are never cached as compiling them
+  /// also updates |pipeline|.
+  ///
   /// |pipeline| is the pipeline containing |shader_info|. The name is used to
   /// prefix shaders used in multiple pipelines with different optimization
   /// flags. The pipeline is used in OPENCL-C compiles to create the literal
@@ -52,6 +64,7 @@ class ShaderCompiler {
       const ShaderMap& shader_map) const;
 
  private:
+  std::string GetShaderCacheKey(const Pipeline::ShaderInfo* shader_info) const;
   Result ParseHex(const std::string& data, std::vector<uint32_t>* result) const;
   Result CompileGlsl(const Shader* shader, std::vector<uint32_t>* result) const;
   Result CompileHlsl(const Shader* shader, std::vector<uint32_t>* result) const;
@@ -61,6 +74,7 @@ class ShaderCompiler {
 
   std::string spv_env_;
   bool disable_spirv_validation_ = false;
+  ShaderCache* shader_cache_ = nullptr;
 };
 
 // Parses the SPIR-V environment string, and returns the corresponding
@@ -293,6 +293,63 @@ TEST_F(ShaderCompilerTest, ReturnsCachedShader) {
   }
 }
 
+TEST_F(ShaderCompilerTest, UsesShaderCache) {
+  Shader shader(kShaderTypeVertex);
+  shader.SetName("TestShader");
+  shader.SetFormat(kShaderFormatSpirvHex);
+  shader.SetData(kHexShader);
+
+  ShaderCache cache;
+  ShaderCompiler sc("", false, &cache);
+  Result r;
+  std::vector<uint32_t> binary;
+  Pipeline::ShaderInfo shader_info(&shader, kShaderTypeCompute);
+  Pipeline pipeline(PipelineType::kCompute);
+  std::tie(r, binary) = sc.Compile(&pipeline, &shader_info, ShaderMap());
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+  EXPECT_EQ(0U, cache.GetHitCount());
+  EXPECT_EQ(1U, cache.GetMissCount());
+
+  std::vector<uint32_t> cached_binary;
+  std::tie(r, cached_binary) = sc.Compile(&pipeline, &shader_info, ShaderMap());
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+  EXPECT_EQ(binary, cached_binary);
+  EXPECT_EQ(1U, cache.GetHitCount());
+  EXPECT_EQ(1U, cache.GetMissCount());
+  EXPECT_EQ(binary.size() * sizeof(uint32_t), cache.GetBytesSaved());
+}
+
+TEST_F(ShaderCompilerTest, ShaderCacheKeyIncludesCompileInputs) {
+  Shader shader(kShaderTypeVertex);
+  shader.SetName("TestShader");
+  shader.SetFormat(kShaderFormatSpirvHex);
+  shader.SetData(kHexShader);
+
+  ShaderCache cache;
+  Result r;
+  std::vector<uint32_t> binary;
+  Pipeline pipeline(PipelineType::kCompute);
+  Pipeline::ShaderInfo shader_info(&shader, kShaderTypeCompute);
+
+  ShaderCompiler sc("", false, &cache);
+  std::tie(r, binary) = sc.Compile(&pipeline, &shader_info, ShaderMap());
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+
+  // Disabling validation must not reuse a binary stored by a validating
+  // compiler, and vice versa.
+  ShaderCompiler no_val_sc("", true, &cache);
+  std::tie(r, binary) = no_val_sc.Compile(&pipeline, &shader_info, ShaderMap());
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+
+  Pipeline::ShaderInfo optimized(&shader, kShaderTypeCompute);
+  optimized.SetShaderOptimizations({"--eliminate-dead-code-aggressive"});
+  std::tie(r, binary) = sc.Compile(&pipeline, &optimized, ShaderMap());
+  ASSERT_TRUE(r.IsSuccess()) << r.Error();
+
+  EXPECT_EQ(0U, cache.GetHitCount());
+  EXPECT_EQ(3U, cache.GetMissCount());
+}
+
 #if AMBER_ENABLE_CLSPV
 TEST_F(ShaderCompilerTest, ClspvCompile) {
   Shader shader(kShaderTypeCompute);
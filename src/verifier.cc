@@ -14,6 +14,7 @@
 
 #include "src/verifier.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstring>
@@ -385,6 +386,400 @@ std::vector<double> GetTexelInRGBA(const std::vector<double>& texel,
   return texel_in_rgba;
 }
 
+// Four component texel layouts which Verifier::Probe decodes with a loop
+// specialized for the layout instead of walking the format segments of
+// every texel.
+enum class FastTexelKind { kNone = 0, kUNorm8, kFloat16, kFloat32 };
+
+/// State shared by all rows of a probe using the fast path. Component
+/// arrays are in memory order, not RGBA order.
+struct FastProbe {
+  FastTexelKind kind = FastTexelKind::kNone;
+  bool check[4] = {false, false, false, false};
+  double expected[4] = {0, 0, 0, 0};
+  double tolerance[4] = {0, 0, 0, 0};
+  bool is_tolerance_percent[4] = {false, false, false, false};
+  /// For kUNorm8, whether each of the 256 possible values of a component
+  /// is within tolerance.
+  bool unorm8_pass[4][256];
+};
+
+FastTexelKind GetFastTexelKind(const Format* fmt) {
+  const auto& segs = fmt->GetSegments();
+  if (segs.size() != 4 || segs[0].IsPadding())
+    return FastTexelKind::kNone;
+
+  const FormatMode mode = segs[0].GetFormatMode();
+  const uint32_t num_bits = segs[0].GetNumBits();
+  FastTexelKind kind = FastTexelKind::kNone;
+  if (mode == FormatMode::kUNorm && num_bits == 8)
+    kind = FastTexelKind::kUNorm8;
+  else if (type::Type::IsFloat16(mode, num_bits))
+    kind = FastTexelKind::kFloat16;
+  else if (type::Type::IsFloat32(mode, num_bits))
+    kind = FastTexelKind::kFloat32;
+  else
+    return FastTexelKind::kNone;
+
+  bool seen[4] = {false, false, false, false};
+  for (const auto& seg : segs) {
+    if (seg.IsPadding() || seg.GetFormatMode() != mode ||
+        seg.GetNumBits() != num_bits) {
+      return FastTexelKind::kNone;
+    }
+
+    size_t rgba_index = 0;
+    switch (seg.GetName()) {
+      case FormatComponentType::kR:
+        rgba_index = 0;
+        break;
+      case FormatComponentType::kG:
+        rgba_index = 1;
+        break;
+      case FormatComponentType::kB:
+        rgba_index = 2;
+        break;
+      case FormatComponentType::kA:
+        rgba_index = 3;
+        break;
+      default:
+        return FastTexelKind::kNone;
+    }
+    if (seen[rgba_index])
+      return FastTexelKind::kNone;
+    seen[rgba_index] = true;
+  }
+  return kind;
+}
+
+// Returns false if |fmt| has no fast path, otherwise fills |probe| with the
+// expected values and tolerances of |command| in the component order of
+// |fmt|.
+bool SetupFastProbe(const ProbeCommand* command,
+                    const Format* fmt,
+                    const double* tolerance,
+                    const bool* is_tolerance_percent,
+                    FastProbe* probe) {
+  probe->kind = GetFastTexelKind(fmt);
+  if (probe->kind == FastTexelKind::kNone)
+    return false;
+
+  const double expected[4] = {static_cast<double>(command->GetR()),
+                              static_cast<double>(command->GetG()),
+                              static_cast<double>(command->GetB()),
+                              static_cast<double>(command->GetA())};
+  const auto& segs = fmt->GetSegments();
+  for (size_t i = 0; i < segs.size(); ++i) {
+    size_t rgba_index = 0;
+    switch (segs[i].GetName()) {
+      case FormatComponentType::kG:
+        rgba_index = 1;
+        break;
+      case FormatComponentType::kB:
+        rgba_index = 2;
+        break;
+      case FormatComponentType::kA:
+        rgba_index = 3;
+        break;
+      default:
+        break;
+    }
+    probe->check[i] = rgba_index != 3 || command->IsRGBA();
+    probe->expected[i] = expected[rgba_index];
+    probe->tolerance[i] = tolerance[rgba_index];
+    probe->is_tolerance_percent[i] = is_tolerance_percent[rgba_index];
+  }
+
+  if (probe->kind == FastTexelKind::kUNorm8) {
+    // There are only 256 possible values per component, so compare each of
+    // them once up front and turn the per texel check into table lookups.
+    for (size_t i = 0; i < 4; ++i) {
+      for (uint32_t v = 0; v < 256; ++v) {
+        probe->unorm8_pass[i][v] =
+            !probe->check[i] ||
+            IsEqualWithTolerance(probe->expected[i],
+                                 static_cast<double>(v) / 255.0,
+                                 probe->tolerance[i],
+                                 probe->is_tolerance_percent[i]);
+      }
+    }
+  }
+  return true;
+}
+
+bool IsComponentEqual(const FastProbe& probe, size_t i, double actual) {
+  return !probe.check[i] ||
+         IsEqualWithTolerance(probe.expected[i], actual, probe.tolerance[i],
+                              probe.is_tolerance_percent[i]);
+}
+
+// Counts the texels of the |width| texels starting at |row| for which
+// |is_texel_equal| returns false, and stores the index of the first of them
+// in |first_failure|.
+template <typename TexelTest>
+uint32_t CountFailures(const uint8_t* row,
+                       uint32_t width,
+                       uint32_t texel_stride,
+                       uint32_t* first_failure,
+                       TexelTest is_texel_equal) {
+  uint32_t failures = 0;
+  for (uint32_t i = 0; i < width; ++i) {
+    if (is_texel_equal(row + static_cast<size_t>(texel_stride) * i))
+      continue;
+
+    if (!failures)
+      *first_failure = i;
+    ++failures;
+  }
+  return failures;
+}
+
+uint32_t CountRowFailures(const FastProbe& probe,
+                          const uint8_t* row,
+                          uint32_t width,
+                          uint32_t texel_stride,
+                          uint32_t* first_failure) {
+  switch (probe.kind) {
+    case FastTexelKind::kUNorm8:
+      return CountFailures(row, width, texel_stride, first_failure,
+                           [&probe](const uint8_t* texel) {
+                             return probe.unorm8_pass[0][texel[0]] &&
+                                    probe.unorm8_pass[1][texel[1]] &&
+                                    probe.unorm8_pass[2][texel[2]] &&
+                                    probe.unorm8_pass[3][texel[3]];
+                           });
+    case FastTexelKind::kFloat16:
+      return CountFailures(
+          row, width, texel_stride, first_failure,
+          [&probe](const uint8_t* texel) {
+            for (size_t i = 0; i < 4; ++i) {
+              float value = float16::HexFloatToFloat(texel + 2 * i, 16);
+              if (!IsComponentEqual(probe, i, static_cast<double>(value)))
+                return false;
+            }
+            return true;
+          });
+    case FastTexelKind::kFloat32:
+      return CountFailures(
+          row, width, texel_stride, first_failure,
+          [&probe](const uint8_t* texel) {
+            for (size_t i = 0; i < 4; ++i) {
+              float value = 0;
+              std::memcpy(&value, texel + sizeof(float) * i, sizeof(float));
+              if (!IsComponentEqual(probe, i, static_cast<double>(value)))
+                return false;
+            }
+            return true;
+          });
+    case FastTexelKind::kNone:
+      break;
+  }
+  assert(false && "Fast probe without a texel kind");
+  return 0;
+}
+
+// The number of mismatching indices listed by Verifier::ProbeSSBO.
+const size_t kMaxReportedMismatches = 8;
+
+// Mismatches found by Verifier::ProbeSSBO.
+struct MismatchReport {
+  uint64_t count = 0;
+  // The first kMaxReportedMismatches mismatching value indices.
+  std::vector<size_t> indices;
+  // Describes the first mismatch.
+  std::string first_error;
+
+  void Add(size_t index) {
+    if (indices.size() < kMaxReportedMismatches)
+      indices.push_back(index);
+    ++count;
+  }
+};
+
+// Compares the values of type T tightly packed at |data| against
+// |expected| with |is_equal|. The values are checked in blocks whose
+// mismatches are only counted, so the loop has no branches on the result
+// and can be vectorized. Blocks which contain mismatches are scanned again
+// to collect the reported indices.
+template <typename T, typename Compare>
+void FindMismatches(const uint8_t* data,
+                    const std::vector<T>& expected,
+                    Compare is_equal,
+                    MismatchReport* report) {
+  const size_t kBlockSize = 256;
+  for (size_t start = 0; start < expected.size(); start += kBlockSize) {
+    const size_t end = std::min(start + kBlockSize, expected.size());
+    uint64_t block_mismatches = 0;
+    for (size_t i = start; i < end; ++i) {
+      T actual;
+      std::memcpy(&actual, data + sizeof(T) * i, sizeof(T));
+      block_mismatches += is_equal(actual, expected[i]) ? 0U : 1U;
+    }
+    if (block_mismatches == 0)
+      continue;
+
+    if (report->indices.size() >= kMaxReportedMismatches) {
+      report->count += block_mismatches;
+      continue;
+    }
+    for (size_t i = start; i < end; ++i) {
+      T actual;
+      std::memcpy(&actual, data + sizeof(T) * i, sizeof(T));
+      if (!is_equal(actual, expected[i]))
+        report->Add(i);
+    }
+  }
+}
+
+// Checks the values of |command| against the tightly packed values of type
+// T at |data|, with the comparator resolved once for all values.
+// |is_integer| tells if all expected values are integers.
+template <typename T>
+void ProbeSSBOValues(const ProbeSSBOCommand* command,
+                     const uint8_t* data,
+                     bool is_integer,
+                     MismatchReport* report) {
+  const auto& values = command->GetValues();
+  std::vector<T> expected(values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    expected[i] = is_integer ? static_cast<T>(values[i].AsUint64())
+                             : static_cast<T>(values[i].AsDouble());
+  }
+
+  switch (command->GetComparator()) {
+    case ProbeSSBOCommand::Comparator::kEqual:
+      if (is_integer) {
+        FindMismatches(data, expected,
+                       [](T actual, T val) {
+                         return static_cast<uint64_t>(actual) ==
+                                static_cast<uint64_t>(val);
+                       },
+                       report);
+      } else {
+        FindMismatches(data, expected,
+                       [](T actual, T val) {
+                         return IsEqualWithTolerance(
+                             static_cast<double>(actual),
+                             static_cast<double>(val), kEpsilon);
+                       },
+                       report);
+      }
+      break;
+    case ProbeSSBOCommand::Comparator::kNotEqual:
+      if (is_integer) {
+        FindMismatches(data, expected,
+                       [](T actual, T val) {
+                         return static_cast<uint64_t>(actual) !=
+                                static_cast<uint64_t>(val);
+                       },
+                       report);
+      } else {
+        FindMismatches(data, expected,
+                       [](T actual, T val) {
+                         return !IsEqualWithTolerance(
+                             static_cast<double>(actual),
+                             static_cast<double>(val), kEpsilon);
+                       },
+                       report);
+      }
+      break;
+    case ProbeSSBOCommand::Comparator::kFuzzyEqual: {
+      const double tolerance = command->HasTolerances()
+                                   ? command->GetTolerances()[0].value
+                                   : kEpsilon;
+      const bool is_percent = command->HasTolerances()
+                                  ? command->GetTolerances()[0].is_percent
+                                  : true;
+      FindMismatches(data, expected,
+                     [tolerance, is_percent](T actual, T val) {
+                       return IsEqualWithTolerance(
+                           static_cast<double>(actual),
+                           static_cast<double>(val), tolerance, is_percent);
+                     },
+                     report);
+      break;
+    }
+    // The orderings are checked as the negation of the failure condition of
+    // CheckActualValue, so a NaN passes them like it does there.
+    case ProbeSSBOCommand::Comparator::kLess:
+      FindMismatches(data, expected,
+                     [](T actual, T val) { return !(actual >= val); }, report);
+      break;
+    case ProbeSSBOCommand::Comparator::kLessOrEqual:
+      FindMismatches(data, expected,
+                     [](T actual, T val) { return !(actual > val); }, report);
+      break;
+    case ProbeSSBOCommand::Comparator::kGreater:
+      FindMismatches(data, expected,
+                     [](T actual, T val) { return !(actual <= val); }, report);
+      break;
+    case ProbeSSBOCommand::Comparator::kGreaterOrEqual:
+      FindMismatches(data, expected,
+                     [](T actual, T val) { return !(actual < val); }, report);
+      break;
+  }
+
+  if (report->count > 0) {
+    const size_t index = report->indices[0];
+    T actual;
+    std::memcpy(&actual, data + sizeof(T) * index, sizeof(T));
+    report->first_error =
+        CheckActualValue<T>(command, actual, values[index]).Error();
+  }
+}
+
+// Checks |command| against |data| with a loop specialized for the element
+// type. Returns false, without checking anything, if the format has padding
+// or mixes component types, if the expected values mix integers and floats,
+// or if the components are half floats.
+bool ProbeSSBOPacked(const ProbeSSBOCommand* command,
+                     const uint8_t* data,
+                     MismatchReport* report) {
+  const auto& values = command->GetValues();
+  const auto& segments = command->GetFormat()->GetSegments();
+  if (values.empty() || segments.empty() || segments[0].IsPadding())
+    return false;
+
+  const FormatMode mode = segments[0].GetFormatMode();
+  const uint32_t num_bits = segments[0].GetNumBits();
+  for (const auto& segment : segments) {
+    if (segment.IsPadding() || segment.GetFormatMode() != mode ||
+        segment.GetNumBits() != num_bits) {
+      return false;
+    }
+  }
+
+  const bool is_integer = values[0].IsInteger();
+  for (const auto& value : values) {
+    if (value.IsInteger() != is_integer)
+      return false;
+  }
+
+  if (type::Type::IsInt8(mode, num_bits))
+    ProbeSSBOValues<int8_t>(command, data, is_integer, report);
+  else if (type::Type::IsUint8(mode, num_bits))
+    ProbeSSBOValues<uint8_t>(command, data, is_integer, report);
+  else if (type::Type::IsInt16(mode, num_bits))
+    ProbeSSBOValues<int16_t>(command, data, is_integer, report);
+  else if (type::Type::IsUint16(mode, num_bits))
+    ProbeSSBOValues<uint16_t>(command, data, is_integer, report);
+  else if (type::Type::IsInt32(mode, num_bits))
+    ProbeSSBOValues<int32_t>(command, data, is_integer, report);
+  else if (type::Type::IsUint32(mode, num_bits))
+    ProbeSSBOValues<uint32_t>(command, data, is_integer, report);
+  else if (type::Type::IsInt64(mode, num_bits))
+    ProbeSSBOValues<int64_t>(command, data, is_integer, report);
+  else if (type::Type::IsUint64(mode, num_bits))
+    ProbeSSBOValues<uint64_t>(command, data, is_integer, report);
+  else if (type::Type::IsFloat32(mode, num_bits))
+    ProbeSSBOValues<float>(command, data, is_integer, report);
+  else if (type::Type::IsFloat64(mode, num_bits))
+    ProbeSSBOValues<double>(command, data, is_integer, report);
+  else
+    return false;
+  return true;
+}
+
 }  // namespace
 
 Verifier::Verifier() = default;
@@ -456,20 +851,41 @@ Result Verifier::Probe(const ProbeCommand* command,
   uint32_t first_invalid_i = 0;
   uint32_t first_invalid_j = 0;
   std::vector<double> failure_values;
-  for (uint32_t j = 0; j < height; ++j) {
-    const uint8_t* p = ptr + row_stride * (j + y) + texel_stride * x;
-    for (uint32_t i = 0; i < width; ++i) {
-      auto actual_texel_values =
-          GetActualValuesFromTexel(p + texel_stride * i, fmt);
-      ScaleTexelValuesIfNeeded(&actual_texel_values, fmt);
-      if (!IsTexelEqualToExpected(actual_texel_values, fmt, command, tolerance,
-                                  is_tolerance_percent)) {
-        if (!count_of_invalid_pixels) {
-          failure_values = GetTexelInRGBA(actual_texel_values, fmt);
-          first_invalid_i = i;
-          first_invalid_j = j;
+
+  FastProbe fast_probe;
+  if (SetupFastProbe(command, fmt, tolerance, is_tolerance_percent,
+                     &fast_probe)) {
+    for (uint32_t j = 0; j < height; ++j) {
+      const uint8_t* p = ptr + row_stride * (j + y) + texel_stride * x;
+      uint32_t first_failure = 0;
+      uint32_t row_failures =
+          CountRowFailures(fast_probe, p, width, texel_stride, &first_failure);
+      if (row_failures && !count_of_invalid_pixels) {
+        auto actual_texel_values =
+            GetActualValuesFromTexel(p + texel_stride * first_failure, fmt);
+        ScaleTexelValuesIfNeeded(&actual_texel_values, fmt);
+        failure_values = GetTexelInRGBA(actual_texel_values, fmt);
+        first_invalid_i = first_failure;
+        first_invalid_j = j;
+      }
+      count_of_invalid_pixels += row_failures;
+    }
+  } else {
+    for (uint32_t j = 0; j < height; ++j) {
+      const uint8_t* p = ptr + row_stride * (j + y) + texel_stride * x;
+      for (uint32_t i = 0; i < width; ++i) {
+        auto actual_texel_values =
+            GetActualValuesFromTexel(p + texel_stride * i, fmt);
+        ScaleTexelValuesIfNeeded(&actual_texel_values, fmt);
+        if (!IsTexelEqualToExpected(actual_texel_values, fmt, command,
+                                    tolerance, is_tolerance_percent)) {
+          if (!count_of_invalid_pixels) {
+            failure_values = GetTexelInRGBA(actual_texel_values, fmt);
+            first_invalid_i = i;
+            first_invalid_j = j;
+          }
+          ++count_of_invalid_pixels;
         }
-        ++count_of_invalid_pixels;
       }
     }
   }
@@ -540,65 +956,143 @@ Result Verifier::ProbeSSBO(const ProbeSSBOCommand* command,
                   std::to_string(fmt->SizeInBytes()) + ")");
   }
 
-  auto& segments = fmt->GetSegments();
-
   const uint8_t* ptr = static_cast<const uint8_t*>(buffer) + offset;
-  for (size_t i = 0, k = 0; i < values.size(); ++i, ++k) {
-    if (k >= segments.size())
-      k = 0;
-
-    const auto& value = values[i];
-    auto segment = segments[k];
-    // Skip over any padding bytes.
-    while (segment.IsPadding()) {
-      ptr += segment.PaddingBytes();
-      ++k;
+  MismatchReport report;
+  if (!ProbeSSBOPacked(command, ptr, &report)) {
+    auto& segments = fmt->GetSegments();
+    for (size_t i = 0, k = 0; i < values.size(); ++i, ++k) {
       if (k >= segments.size())
         k = 0;
 
-      segment = segments[k];
-    }
+      const auto& value = values[i];
+      auto segment = segments[k];
+      // Skip over any padding bytes.
+      while (segment.IsPadding()) {
+        ptr += segment.PaddingBytes();
+        ++k;
+        if (k >= segments.size())
+          k = 0;
 
-    Result r;
-    FormatMode mode = segment.GetFormatMode();
-    uint32_t num_bits = segment.GetNumBits();
-    if (type::Type::IsInt8(mode, num_bits)) {
-      r = CheckValue<int8_t>(command, ptr, value);
-    } else if (type::Type::IsUint8(mode, num_bits)) {
-      r = CheckValue<uint8_t>(command, ptr, value);
-    } else if (type::Type::IsInt16(mode, num_bits)) {
-      r = CheckValue<int16_t>(command, ptr, value);
-    } else if (type::Type::IsUint16(mode, num_bits)) {
-      r = CheckValue<uint16_t>(command, ptr, value);
-    } else if (type::Type::IsInt32(mode, num_bits)) {
-      r = CheckValue<int32_t>(command, ptr, value);
-    } else if (type::Type::IsUint32(mode, num_bits)) {
-      r = CheckValue<uint32_t>(command, ptr, value);
-    } else if (type::Type::IsInt64(mode, num_bits)) {
-      r = CheckValue<int64_t>(command, ptr, value);
-    } else if (type::Type::IsUint64(mode, num_bits)) {
-      r = CheckValue<uint64_t>(command, ptr, value);
-    } else if (type::Type::IsFloat16(mode, num_bits)) {
-      r = CheckActualValue<float>(command, float16::HexFloatToFloat(ptr, 16),
-                                  value);
-    } else if (type::Type::IsFloat32(mode, num_bits)) {
-      r = CheckValue<float>(command, ptr, value);
-    } else if (type::Type::IsFloat64(mode, num_bits)) {
-      r = CheckValue<double>(command, ptr, value);
-    } else {
-      return Result("Unknown datum type");
-    }
+        segment = segments[k];
+      }
 
-    if (!r.IsSuccess()) {
-      return Result("Line " + std::to_string(command->GetLine()) +
-                    ": Verifier failed: " + r.Error() + ", at index " +
-                    std::to_string(i));
+      Result r;
+      FormatMode mode = segment.GetFormatMode();
+      uint32_t num_bits = segment.GetNumBits();
+      if (type::Type::IsInt8(mode, num_bits)) {
+        r = CheckValue<int8_t>(command, ptr, value);
+      } else if (type::Type::IsUint8(mode, num_bits)) {
+        r = CheckValue<uint8_t>(command, ptr, value);
+      } else if (type::Type::IsInt16(mode, num_bits)) {
+        r = CheckValue<int16_t>(command, ptr, value);
+      } else if (type::Type::IsUint16(mode, num_bits)) {
+        r = CheckValue<uint16_t>(command, ptr, value);
+      } else if (type::Type::IsInt32(mode, num_bits)) {
+        r = CheckValue<int32_t>(command, ptr, value);
+      } else if (type::Type::IsUint32(mode, num_bits)) {
+        r = CheckValue<uint32_t>(command, ptr, value);
+      } else if (type::Type::IsInt64(mode, num_bits)) {
+        r = CheckValue<int64_t>(command, ptr, value);
+      } else if (type::Type::IsUint64(mode, num_bits)) {
+        r = CheckValue<uint64_t>(command, ptr, value);
+      } else if (type::Type::IsFloat16(mode, num_bits)) {
+        r = CheckActualValue<float>(command, float16::HexFloatToFloat(ptr, 16),
+                                    value);
+      } else if (type::Type::IsFloat32(mode, num_bits)) {
+        r = CheckValue<float>(command, ptr, value);
+      } else if (type::Type::IsFloat64(mode, num_bits)) {
+        r = CheckValue<double>(command, ptr, value);
+      } else {
+        return Result("Unknown datum type");
+      }
+
+      if (!r.IsSuccess()) {
+        if (report.count == 0)
+          report.first_error = r.Error();
+        report.Add(i);
+      }
+
+      ptr += segment.SizeInBytes();
     }
+  }
+
+  if (report.count == 0)
+    return {};
 
-    ptr += segment.SizeInBytes();
+  std::string reason = "Line " + std::to_string(command->GetLine()) +
+                       ": Verifier failed: " + report.first_error +
+                       ", at index " + std::to_string(report.indices[0]);
+  if (report.count > 1) {
+    reason += "\nVerifier failed for " + std::to_string(report.count) +
+              " of " + std::to_string(values.size()) + " values, at indices";
+    for (size_t i = 0; i < report.indices.size(); ++i)
+      reason += (i == 0 ? " " : ", ") + std::to_string(report.indices[i]);
+    if (report.count > report.indices.size())
+      reason += ", ...";
   }
+  return Result(reason);
+}
 
-  return {};
+Result Verifier::ProbeStatistics(const ExpectStatisticsCommand* command,
+                                 const CommandStatistics& statistics) {
+  uint64_t actual = 0;
+  std::string name;
+  switch (command->GetCounter()) {
+    case ExpectStatisticsCommand::Counter::kVertexInvocations:
+      actual = statistics.vertex_invocations;
+      name = "vertex_invocations";
+      break;
+    case ExpectStatisticsCommand::Counter::kClippingPrimitives:
+      actual = statistics.clipping_primitives;
+      name = "clipping_primitives";
+      break;
+    case ExpectStatisticsCommand::Counter::kFragmentInvocations:
+      actual = statistics.fragment_invocations;
+      name = "fragment_invocations";
+      break;
+    case ExpectStatisticsCommand::Counter::kComputeInvocations:
+      actual = statistics.compute_invocations;
+      name = "compute_invocations";
+      break;
+  }
+
+  const uint64_t expected = command->GetValue();
+  bool passed = false;
+  std::string op;
+  switch (command->GetComparator()) {
+    case ProbeSSBOCommand::Comparator::kEqual:
+    case ProbeSSBOCommand::Comparator::kFuzzyEqual:
+      passed = actual == expected;
+      op = " == ";
+      break;
+    case ProbeSSBOCommand::Comparator::kNotEqual:
+      passed = actual != expected;
+      op = " != ";
+      break;
+    case ProbeSSBOCommand::Comparator::kLess:
+      passed = actual < expected;
+      op = " < ";
+      break;
+    case ProbeSSBOCommand::Comparator::kLessOrEqual:
+      passed = actual <= expected;
+      op = " <= ";
+      break;
+    case ProbeSSBOCommand::Comparator::kGreater:
+      passed = actual > expected;
+      op = " > ";
+      break;
+    case ProbeSSBOCommand::Comparator::kGreaterOrEqual:
+      passed = actual >= expected;
+      op = " >= ";
+      break;
+  }
+  if (passed)
+    return {};
+
+  return Result("Line " + std::to_string(command->GetLine()) +
+                ": Verifier failed: " + name + " " + std::to_string(actual) +
+                op + std::to_string(expected) + ", for the command at line " +
+                std::to_string(statistics.line));
 }
 
 }  // namespace amber
@@ -17,6 +17,7 @@
 
 #include <vector>
 
+#include "amber/amber.h"
 #include "amber/result.h"
 #include "src/command.h"
 #include "src/format.h"
@@ -45,6 +46,12 @@ class Verifier {
   Result ProbeSSBO(const ProbeSSBOCommand* command,
                    uint32_t buffer_element_count,
                    const void* buffer);
+
+  /// Check |command| against the |statistics| of the last draw or dispatch
+  /// of its pipeline. The result will be success if the counter compares
+  /// correctly.
+  Result ProbeStatistics(const ExpectStatisticsCommand* command,
+                         const CommandStatistics& statistics);
 };
 
 }  // namespace amber
@@ -14,6 +14,7 @@
 
 #include "src/verifier.h"
 
+#include <limits>
 #include <memory>
 #include <utility>
 #include <vector>
@@ -427,6 +428,80 @@ TEST_F(VerifierTest, ProbeFrameBufferFloat32) {
   EXPECT_TRUE(r.IsSuccess());
 }
 
+TEST_F(VerifierTest, ProbeFrameBufferFloat16) {
+  Pipeline pipeline(PipelineType::kGraphics);
+  auto color_buf = pipeline.GenerateDefaultColorAttachmentBuffer();
+
+  ProbeCommand probe(color_buf.get());
+  probe.SetWholeWindow();
+  probe.SetProbeRect();
+  probe.SetIsRGBA();
+  probe.SetR(-6.0f);
+  probe.SetG(14.0f);
+  probe.SetB(0.1171875f);
+  probe.SetA(0.5f);
+
+  uint16_t frame_buffer[2][2][4];
+  for (uint32_t y = 0; y < 2; ++y) {
+    for (uint32_t x = 0; x < 2; ++x) {
+      frame_buffer[y][x][0] = float16::FloatToHexFloat16(-6.0f);
+      frame_buffer[y][x][1] = float16::FloatToHexFloat16(14.0f);
+      frame_buffer[y][x][2] = float16::FloatToHexFloat16(0.1171875f);
+      frame_buffer[y][x][3] = float16::FloatToHexFloat16(0.5f);
+    }
+  }
+
+  TypeParser parser;
+  auto type = parser.Parse("R16G16B16A16_SFLOAT");
+  Format fmt(type.get());
+
+  Verifier verifier;
+  Result r = verifier.Probe(&probe, &fmt, 8, 16, 2, 2,
+                            static_cast<const void*>(frame_buffer));
+  EXPECT_TRUE(r.IsSuccess()) << r.Error();
+}
+
+TEST_F(VerifierTest, ProbeFrameBufferRGBA8CountsFailures) {
+  Pipeline pipeline(PipelineType::kGraphics);
+  auto color_buf = pipeline.GenerateDefaultColorAttachmentBuffer();
+
+  ProbeCommand probe(color_buf.get());
+  probe.SetWholeWindow();
+  probe.SetProbeRect();
+  probe.SetIsRGBA();
+  probe.SetR(1.0f);
+  probe.SetG(0.0f);
+  probe.SetB(0.0f);
+  probe.SetA(1.0f);
+
+  uint8_t frame_buffer[2][4][4];
+  for (uint32_t y = 0; y < 2; ++y) {
+    for (uint32_t x = 0; x < 4; ++x) {
+      frame_buffer[y][x][0] = 255;
+      frame_buffer[y][x][1] = 0;
+      frame_buffer[y][x][2] = 0;
+      frame_buffer[y][x][3] = 255;
+    }
+  }
+  frame_buffer[1][2][0] = 0;
+  frame_buffer[1][2][1] = 255;
+  frame_buffer[1][3][3] = 0;
+
+  TypeParser parser;
+  auto type = parser.Parse("R8G8B8A8_UNORM");
+  Format fmt(type.get());
+
+  Verifier verifier;
+  Result r = verifier.Probe(&probe, &fmt, 4, 16, 4, 2,
+                            static_cast<const void*>(frame_buffer));
+  EXPECT_FALSE(r.IsSuccess());
+  EXPECT_EQ(
+      "Line 1: Probe failed at: 2, 1\n  Expected: 255.000000, 0.000000, "
+      "0.000000, 255.000000\n    Actual: 0.000000, 255.000000, 0.000000, "
+      "255.000000\nProbe failed in 2 pixels",
+      r.Error());
+}
+
 TEST_F(VerifierTest, ProbeFrameBufferFloat64) {
   Pipeline pipeline(PipelineType::kGraphics);
   auto color_buf = pipeline.GenerateDefaultColorAttachmentBuffer();
@@ -1026,8 +1101,10 @@ TEST_F(VerifierTest, ProbeSSBOEqualFail) {
   Verifier verifier;
   Result r = verifier.ProbeSSBO(&probe_ssbo, 4, ssbo);
   EXPECT_FALSE(r.IsSuccess());
-  EXPECT_EQ("Line 1: Verifier failed: 2.800000 == 2.900000, at index 0",
-            r.Error());
+  EXPECT_EQ(
+      "Line 1: Verifier failed: 2.800000 == 2.900000, at index 0\n"
+      "Verifier failed for 4 of 4 values, at indices 0, 1, 2, 3",
+      r.Error());
 }
 
 TEST_F(VerifierTest, ProbeSSBOFuzzyEqualWithAbsoluteTolerance) {
@@ -1097,8 +1174,10 @@ TEST_F(VerifierTest, ProbeSSBOFuzzyEqualWithAbsoluteToleranceFail) {
   Verifier verifier;
   Result r = verifier.ProbeSSBO(&probe_ssbo, 4, ssbo);
   EXPECT_FALSE(r.IsSuccess());
-  EXPECT_EQ("Line 1: Verifier failed: 3.001000 ~= 2.900000, at index 0",
-            r.Error());
+  EXPECT_EQ(
+      "Line 1: Verifier failed: 3.001000 ~= 2.900000, at index 0\n"
+      "Verifier failed for 4 of 4 values, at indices 0, 1, 2, 3",
+      r.Error());
 }
 
 TEST_F(VerifierTest, ProbeSSBOFuzzyEqualWithRelativeTolerance) {
@@ -1168,8 +1247,10 @@ TEST_F(VerifierTest, ProbeSSBOFuzzyEqualWithRelativeToleranceFail) {
   Verifier verifier;
   Result r = verifier.ProbeSSBO(&probe_ssbo, 4, ssbo);
   EXPECT_FALSE(r.IsSuccess());
-  EXPECT_EQ("Line 1: Verifier failed: 2.903000 ~= 2.900000, at index 0",
-            r.Error());
+  EXPECT_EQ(
+      "Line 1: Verifier failed: 2.903000 ~= 2.900000, at index 0\n"
+      "Verifier failed for 4 of 4 values, at indices 0, 1, 2, 3",
+      r.Error());
 }
 
 TEST_F(VerifierTest, ProbeSSBONotEqual) {
@@ -1226,8 +1307,10 @@ TEST_F(VerifierTest, ProbeSSBONotEqualFail) {
   Verifier verifier;
   Result r = verifier.ProbeSSBO(&probe_ssbo, 4, ssbo);
   EXPECT_FALSE(r.IsSuccess());
-  EXPECT_EQ("Line 1: Verifier failed: 2.900000 != 2.900000, at index 0",
-            r.Error());
+  EXPECT_EQ(
+      "Line 1: Verifier failed: 2.900000 != 2.900000, at index 0\n"
+      "Verifier failed for 4 of 4 values, at indices 0, 1, 2, 3",
+      r.Error());
 }
 
 TEST_F(VerifierTest, ProbeSSBOLess) {
@@ -1284,8 +1367,10 @@ TEST_F(VerifierTest, ProbeSSBOLessFail) {
   Verifier verifier;
   Result r = verifier.ProbeSSBO(&probe_ssbo, 4, ssbo);
   EXPECT_FALSE(r.IsSuccess());
-  EXPECT_EQ("Line 1: Verifier failed: 3.900000 < 2.900000, at index 0",
-            r.Error());
+  EXPECT_EQ(
+      "Line 1: Verifier failed: 3.900000 < 2.900000, at index 0\n"
+      "Verifier failed for 4 of 4 values, at indices 0, 1, 2, 3",
+      r.Error());
 }
 
 TEST_F(VerifierTest, ProbeSSBOLessOrEqual) {
@@ -1490,6 +1575,83 @@ TEST_F(VerifierTest, CheckRGBAOrderForFailure) {
       r.Error());
 }
 
+TEST_F(VerifierTest, ProbeSSBOReportsAllMismatches) {
+  Pipeline pipeline(PipelineType::kGraphics);
+  auto color_buf = pipeline.GenerateDefaultColorAttachmentBuffer();
+
+  ProbeSSBOCommand probe_ssbo(color_buf.get());
+
+  TypeParser parser;
+  auto type = parser.Parse("R32_UINT");
+  Format fmt(type.get());
+
+  probe_ssbo.SetFormat(&fmt);
+  probe_ssbo.SetComparator(ProbeSSBOCommand::Comparator::kEqual);
+
+  std::vector<Value> values;
+  values.resize(1000);
+  std::vector<uint32_t> ssbo(values.size());
+  for (size_t i = 0; i < values.size(); ++i) {
+    values[i].SetIntValue(i);
+    ssbo[i] = static_cast<uint32_t>(i % 100 == 7 ? i + 1 : i);
+  }
+  probe_ssbo.SetValues(std::move(values));
+
+  Verifier verifier;
+  Result r = verifier.ProbeSSBO(&probe_ssbo, 1000,
+                                static_cast<const void*>(ssbo.data()));
+  EXPECT_FALSE(r.IsSuccess());
+  EXPECT_EQ(
+      "Line 1: Verifier failed: 8 == 7, at index 7\n"
+      "Verifier failed for 10 of 1000 values, at indices 7, 107, 207, 307, "
+      "407, 507, 607, 707, ...",
+      r.Error());
+}
+
+TEST_F(VerifierTest, ProbeSSBOOrderingWithNaN) {
+  Pipeline pipeline(PipelineType::kGraphics);
+  auto color_buf = pipeline.GenerateDefaultColorAttachmentBuffer();
+
+  TypeParser parser;
+  auto type = parser.Parse("R32_SFLOAT");
+  Format fmt(type.get());
+
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  const float ssbo[2] = {nan, nan};
+
+  const ProbeSSBOCommand::Comparator comparators[] = {
+      ProbeSSBOCommand::Comparator::kLess,
+      ProbeSSBOCommand::Comparator::kLessOrEqual,
+      ProbeSSBOCommand::Comparator::kGreater,
+      ProbeSSBOCommand::Comparator::kGreaterOrEqual,
+  };
+  for (auto comparator : comparators) {
+    // Float expected values are checked by the packed loop, mixing in an
+    // integer makes the verifier check each value on its own.
+    ProbeSSBOCommand packed_probe(color_buf.get());
+    packed_probe.SetFormat(&fmt);
+    packed_probe.SetComparator(comparator);
+    std::vector<Value> packed_values(2);
+    packed_values[0].SetDoubleValue(1.0);
+    packed_values[1].SetDoubleValue(2.0);
+    packed_probe.SetValues(std::move(packed_values));
+
+    ProbeSSBOCommand generic_probe(color_buf.get());
+    generic_probe.SetFormat(&fmt);
+    generic_probe.SetComparator(comparator);
+    std::vector<Value> generic_values(2);
+    generic_values[0].SetDoubleValue(1.0);
+    generic_values[1].SetIntValue(2);
+    generic_probe.SetValues(std::move(generic_values));
+
+    Verifier verifier;
+    Result packed = verifier.ProbeSSBO(&packed_probe, 2, ssbo);
+    Result generic = verifier.ProbeSSBO(&generic_probe, 2, ssbo);
+    EXPECT_TRUE(generic.IsSuccess()) << generic.Error();
+    EXPECT_EQ(generic.IsSuccess(), packed.IsSuccess()) << packed.Error();
+  }
+}
+
 TEST_F(VerifierTest, ProbeSSBOWithPadding) {
   Pipeline pipeline(PipelineType::kGraphics);
   auto color_buf = pipeline.GenerateDefaultColorAttachmentBuffer();
@@ -1552,4 +1714,54 @@ TEST_F(VerifierTest, ProbeSSBOHexFloat) {
   EXPECT_TRUE(r.IsSuccess()) << r.Error();
 }
 
+TEST_F(VerifierTest, ProbeStatistics) {
+  Pipeline pipeline(PipelineType::kCompute);
+  ExpectStatisticsCommand expect(&pipeline);
+  expect.SetLine(3);
+  expect.SetCounter(ExpectStatisticsCommand::Counter::kComputeInvocations);
+
+  CommandStatistics statistics;
+  statistics.line = 2;
+  statistics.type = "compute";
+  statistics.compute_invocations = 64;
+  statistics.vertex_invocations = 1000;
+
+  struct {
+    ProbeSSBOCommand::Comparator comparator;
+    uint64_t value;
+    bool passes;
+  } tests[] = {
+      {ProbeSSBOCommand::Comparator::kEqual, 64, true},
+      {ProbeSSBOCommand::Comparator::kEqual, 63, false},
+      {ProbeSSBOCommand::Comparator::kNotEqual, 63, true},
+      {ProbeSSBOCommand::Comparator::kNotEqual, 64, false},
+      {ProbeSSBOCommand::Comparator::kLess, 65, true},
+      {ProbeSSBOCommand::Comparator::kLess, 64, false},
+      {ProbeSSBOCommand::Comparator::kLessOrEqual, 64, true},
+      {ProbeSSBOCommand::Comparator::kLessOrEqual, 63, false},
+      {ProbeSSBOCommand::Comparator::kGreater, 63, true},
+      {ProbeSSBOCommand::Comparator::kGreater, 64, false},
+      {ProbeSSBOCommand::Comparator::kGreaterOrEqual, 64, true},
+      {ProbeSSBOCommand::Comparator::kGreaterOrEqual, 65, false},
+  };
+
+  Verifier verifier;
+  for (const auto& test : tests) {
+    expect.SetComparator(test.comparator);
+    expect.SetValue(test.value);
+    Result r = verifier.ProbeStatistics(&expect, statistics);
+    EXPECT_EQ(test.passes, r.IsSuccess())
+        << static_cast<int>(test.comparator) << " " << test.value;
+  }
+
+  expect.SetComparator(ProbeSSBOCommand::Comparator::kGreater);
+  expect.SetValue(64);
+  Result r = verifier.ProbeStatistics(&expect, statistics);
+  ASSERT_FALSE(r.IsSuccess());
+  EXPECT_EQ(
+      "Line 3: Verifier failed: compute_invocations 64 > 64, for the command "
+      "at line 2",
+      r.Error());
+}
+
 }  // namespace amber
@@ -36,12 +36,35 @@ void BufferBackedDescriptor::RecordCopyDataToResourceIfNeeded(
   if (!GetResource())
     return;
 
+  // The resource is kept until its contents are read back, so if the host
+  // side buffer is empty the device already holds the latest contents. The
+  // buffer is also empty if the resource imported its storage. It is only
+  // emptied by ReleaseUploadedHostData(), once every descriptor bound to it
+  // copied the contents.
   if (amber_buffer_ && !amber_buffer_->ValuePtr()->empty()) {
-    GetResource()->UpdateMemoryWithRawData(*amber_buffer_->ValuePtr());
-    amber_buffer_->ValuePtr()->clear();
+    if (is_readback_needed_) {
+      // The host only holds the ranges written since the device got the
+      // latest contents.
+      GetResource()->UpdateMemoryWithRawData(*amber_buffer_->ValuePtr(),
+                                             amber_buffer_->GetDirtyRanges());
+      GetResource()->CopyRangesToDevice(command,
+                                        amber_buffer_->GetDirtyRanges());
+    } else {
+      GetResource()->UpdateMemoryWithRawData(*amber_buffer_->ValuePtr());
+      GetResource()->CopyToDevice(command);
+    }
+  } else if (!is_readback_needed_) {
+    GetResource()->CopyToDevice(command);
   }
+  is_readback_needed_ = true;
+}
+
+void BufferBackedDescriptor::ReleaseUploadedHostData() {
+  if (!GetResource() || !amber_buffer_)
+    return;
 
-  GetResource()->CopyToDevice(command);
+  amber_buffer_->ValuePtr()->clear();
+  amber_buffer_->ClearDirtyRanges();
 }
 
 Result BufferBackedDescriptor::RecordCopyDataToHost(CommandBuffer* command) {
@@ -73,20 +96,27 @@ Result BufferBackedDescriptor::MoveResourceToBufferOutput() {
           "no host accessible memory pointer");
     }
 
+    // Ranges written on the host since the last upload are newer than the
+    // contents read back from the device.
     if (!amber_buffer_->ValuePtr()->empty()) {
-      return Result(
-          "Vulkan: BufferBackedDescriptor::MoveResourceToBufferOutput() "
-          "output buffer is not empty");
+      GetResource()->UpdateMemoryWithRawData(*amber_buffer_->ValuePtr(),
+                                             amber_buffer_->GetDirtyRanges());
+      amber_buffer_->ValuePtr()->clear();
     }
+    amber_buffer_->ClearDirtyRanges();
 
     auto size_in_bytes = GetResource()->GetSizeInBytes();
     amber_buffer_->SetElementCount(size_in_bytes /
                                    amber_buffer_->GetFormat()->SizeInBytes());
-    amber_buffer_->ValuePtr()->resize(size_in_bytes);
-    std::memcpy(amber_buffer_->ValuePtr()->data(), resource_memory_ptr,
-                size_in_bytes);
+    // Imported storage goes back to the buffer without a copy.
+    if (!GetResource()->ReleaseHostStorage(amber_buffer_->ValuePtr())) {
+      amber_buffer_->ValuePtr()->resize(size_in_bytes);
+      std::memcpy(amber_buffer_->ValuePtr()->data(), resource_memory_ptr,
+                  size_in_bytes);
+    }
   }
 
+  is_readback_needed_ = false;
   return {};
 }
 
@@ -40,8 +40,12 @@ class BufferBackedDescriptor : public Descriptor {
 
   Result CreateResourceIfNeeded() override { return {}; }
   void RecordCopyDataToResourceIfNeeded(CommandBuffer* command) override;
+  void ReleaseUploadedHostData() override;
   Result RecordCopyDataToHost(CommandBuffer* command) override;
   Result MoveResourceToBufferOutput() override;
+  bool IsReadbackNeeded(const Buffer* buffer) const override {
+    return is_readback_needed_ && amber_buffer_ && buffer == amber_buffer_;
+  }
   virtual Resource* GetResource() = 0;
 
   Result SetSizeInElements(uint32_t element_count) override;
@@ -52,6 +56,9 @@ class BufferBackedDescriptor : public Descriptor {
 
  private:
   Buffer* amber_buffer_ = nullptr;
+  // Set once commands using the resource were recorded, the resource then
+  // holds the latest contents until they are moved back to |amber_buffer_|.
+  bool is_readback_needed_ = false;
 };
 
 }  // namespace vulkan
@@ -33,11 +33,9 @@ BufferDescriptor::BufferDescriptor(Buffer* buffer,
 BufferDescriptor::~BufferDescriptor() = default;
 
 Result BufferDescriptor::CreateResourceIfNeeded() {
-  if (transfer_buffer_) {
-    return Result(
-        "Vulkan: BufferDescriptor::CreateResourceIfNeeded() must be called "
-        "only when |transfer_buffer| is empty");
-  }
+  // The resource still holds the results of previous commands.
+  if (transfer_buffer_)
+    return {};
 
   auto amber_buffer = getAmberBuffer();
 
@@ -52,7 +50,10 @@ Result BufferDescriptor::CreateResourceIfNeeded() {
   Result r = transfer_buffer_->Initialize(
       (IsStorageBuffer() ? VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
                          : VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) |
-      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+          VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      device_local_,
+      amber_buffer && !host_storage_shared_ ? amber_buffer->ValuePtr()
+                                            : nullptr);
   if (!r.IsSuccess())
     return r;
 
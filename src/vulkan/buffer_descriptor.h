@@ -46,12 +46,23 @@ class BufferDescriptor : public BufferBackedDescriptor {
   void UpdateDescriptorSetIfNeeded(VkDescriptorSet descriptor_set) override;
   Result CreateResourceIfNeeded() override;
   Result MoveResourceToBufferOutput() override;
+  bool CanUploadRanges() const override { return true; }
+
+  /// Sets if the buffer is placed in device local memory.
+  void SetDeviceLocal(bool device_local) { device_local_ = device_local; }
+
+  /// Sets if other descriptors are bound to the same buffer. The storage of
+  /// the buffer is then never imported, as that would leave the buffer empty
+  /// for the other descriptors.
+  void SetHostStorageShared(bool shared) { host_storage_shared_ = shared; }
 
  protected:
   Resource* GetResource() override { return transfer_buffer_.get(); }
 
  private:
   std::unique_ptr<TransferBuffer> transfer_buffer_;
+  bool device_local_ = false;
+  bool host_storage_shared_ = false;
 };
 
 }  // namespace vulkan
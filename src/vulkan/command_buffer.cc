@@ -14,13 +14,25 @@
 
 #include "src/vulkan/command_buffer.h"
 
+#include <algorithm>
 #include <cassert>
+#include <limits>
+#include <vector>
 
 #include "src/vulkan/command_pool.h"
 #include "src/vulkan/device.h"
 
 namespace amber {
 namespace vulkan {
+namespace {
+
+// A single submission replays a command buffer at most this many times, so
+// a hang is still detected without waiting for all replays.
+const uint32_t kMaxReplaysPerSubmit = 256;
+
+const uint64_t kNanosecondsPerMillisecond = 1000ULL * 1000ULL;
+
+}  // namespace
 
 CommandBuffer::CommandBuffer(Device* device, CommandPool* pool)
     : device_(device), pool_(pool) {}
@@ -59,10 +71,12 @@ Result CommandBuffer::Initialize() {
   return {};
 }
 
-Result CommandBuffer::BeginRecording() {
+Result CommandBuffer::BeginRecording(bool reusable) {
   VkCommandBufferBeginInfo command_begin_info = VkCommandBufferBeginInfo();
   command_begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-  command_begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  command_begin_info.flags = reusable
+                                 ? VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT
+                                 : VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
   if (device_->GetPtrs()->vkBeginCommandBuffer(command_, &command_begin_info) !=
       VK_SUCCESS) {
     return Result("Vulkan::Calling vkBeginCommandBuffer Fail");
@@ -72,10 +86,68 @@ Result CommandBuffer::BeginRecording() {
   return {};
 }
 
-Result CommandBuffer::SubmitAndReset(uint32_t timeout_ms) {
+Result CommandBuffer::SubmitAndReset(uint32_t timeout_ms, uint32_t count) {
+  if (device_->GetPtrs()->vkEndCommandBuffer(command_) != VK_SUCCESS)
+    return Result("Vulkan::Calling vkEndCommandBuffer Fail");
+
+  guarded_ = false;
+
+  // Listing the command buffer repeatedly in one submission replays it, the
+  // commands of each replay execute after those of the previous one.
+  const std::vector<VkCommandBuffer> commands(
+      std::min(std::max(count, 1U), kMaxReplaysPerSubmit), command_);
+  uint32_t submitted = 0;
+  do {
+    const uint32_t n = std::min(count - submitted,
+                                static_cast<uint32_t>(commands.size()));
+    Result r = QueueSubmit(commands.data(), n);
+    if (!r.IsSuccess())
+      return r;
+    submitted += n;
+
+    // The fence timeout applies to each replay, not to the whole submission.
+    r = WaitForFence(static_cast<uint64_t>(timeout_ms) * n);
+    if (!r.IsSuccess())
+      return r;
+  } while (submitted < count);
+
+  if (device_->GetPtrs()->vkResetCommandBuffer(command_, 0) != VK_SUCCESS)
+    return Result("Vulkan::Calling vkResetCommandBuffer Fail");
+
+  return {};
+}
+
+Result CommandBuffer::SubmitWithoutWaiting() {
   if (device_->GetPtrs()->vkEndCommandBuffer(command_) != VK_SUCCESS)
     return Result("Vulkan::Calling vkEndCommandBuffer Fail");
 
+  guarded_ = false;
+
+  Result r = QueueSubmit(&command_, 1);
+  if (!r.IsSuccess())
+    return r;
+
+  in_flight_ = true;
+  return {};
+}
+
+Result CommandBuffer::WaitAndReset(uint32_t timeout_ms) {
+  if (!in_flight_)
+    return {};
+
+  Result r = WaitForFence(timeout_ms);
+  if (!r.IsSuccess())
+    return r;
+
+  in_flight_ = false;
+  if (device_->GetPtrs()->vkResetCommandBuffer(command_, 0) != VK_SUCCESS)
+    return Result("Vulkan::Calling vkResetCommandBuffer Fail");
+
+  return {};
+}
+
+Result CommandBuffer::QueueSubmit(const VkCommandBuffer* commands,
+                                  uint32_t count) {
   if (device_->GetPtrs()->vkResetFences(device_->GetVkDevice(), 1, &fence_) !=
       VK_SUCCESS) {
     return Result("Vulkan::Calling vkResetFences Fail");
@@ -83,26 +155,27 @@ Result CommandBuffer::SubmitAndReset(uint32_t timeout_ms) {
 
   VkSubmitInfo submit_info = VkSubmitInfo();
   submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-  submit_info.commandBufferCount = 1;
-  submit_info.pCommandBuffers = &command_;
+  submit_info.commandBufferCount = count;
+  submit_info.pCommandBuffers = commands;
   if (device_->GetPtrs()->vkQueueSubmit(device_->GetVkQueue(), 1, &submit_info,
                                         fence_) != VK_SUCCESS) {
     return Result("Vulkan::Calling vkQueueSubmit Fail");
   }
+  return {};
+}
 
-  guarded_ = false;
-
+Result CommandBuffer::WaitForFence(uint64_t timeout_ms) {
+  const uint64_t timeout_ns =
+      timeout_ms > std::numeric_limits<uint64_t>::max() /
+                       kNanosecondsPerMillisecond
+          ? std::numeric_limits<uint64_t>::max()
+          : timeout_ms * kNanosecondsPerMillisecond;
   VkResult r = device_->GetPtrs()->vkWaitForFences(
-      device_->GetVkDevice(), 1, &fence_, VK_TRUE,
-      static_cast<uint64_t>(timeout_ms) * 1000ULL * 1000ULL /* nanosecond */);
+      device_->GetVkDevice(), 1, &fence_, VK_TRUE, timeout_ns);
   if (r == VK_TIMEOUT)
     return Result("Vulkan::Calling vkWaitForFences Timeout");
   if (r != VK_SUCCESS)
     return Result("Vulkan::Calling vkWaitForFences Fail");
-
-  if (device_->GetPtrs()->vkResetCommandBuffer(command_, 0) != VK_SUCCESS)
-    return Result("Vulkan::Calling vkResetCommandBuffer Fail");
-
   return {};
 }
 
@@ -115,9 +188,12 @@ void CommandBuffer::Reset() {
 }
 
 CommandBufferGuard::CommandBufferGuard(CommandBuffer* buffer)
-    : buffer_(buffer) {
+    : CommandBufferGuard(buffer, false) {}
+
+CommandBufferGuard::CommandBufferGuard(CommandBuffer* buffer, bool reusable)
+    : buffer_(buffer), reusable_(reusable) {
   assert(!buffer_->guarded_);
-  result_ = buffer_->BeginRecording();
+  result_ = buffer_->BeginRecording(reusable_);
 }
 
 CommandBufferGuard::~CommandBufferGuard() {
@@ -127,7 +203,19 @@ CommandBufferGuard::~CommandBufferGuard() {
 
 Result CommandBufferGuard::Submit(uint32_t timeout_ms) {
   assert(buffer_->guarded_);
-  return buffer_->SubmitAndReset(timeout_ms);
+  return buffer_->SubmitAndReset(timeout_ms, 1);
+}
+
+Result CommandBufferGuard::SubmitRepeatedly(uint32_t count,
+                                            uint32_t timeout_ms) {
+  assert(buffer_->guarded_);
+  assert(reusable_ || count == 1);
+  return buffer_->SubmitAndReset(timeout_ms, count);
+}
+
+Result CommandBufferGuard::SubmitWithoutWaiting() {
+  assert(buffer_->guarded_);
+  return buffer_->SubmitWithoutWaiting();
 }
 
 }  // namespace vulkan
@@ -44,14 +44,32 @@ class CommandBuffer {
   Result Initialize();
   VkCommandBuffer GetVkCommandBuffer() const { return command_; }
 
+  /// Returns true if the command buffer was submitted without waiting and
+  /// WaitAndReset() was not called yet.
+  bool IsInFlight() const { return in_flight_; }
+  /// Waits for the commands submitted without waiting to complete and resets
+  /// the command buffer so it can be recorded again.
+  Result WaitAndReset(uint32_t timeout_ms);
+
  private:
   friend CommandBufferGuard;
 
-  Result BeginRecording();
-  Result SubmitAndReset(uint32_t timeout_ms);
+  /// Starts recording. If |reusable| is true the recorded commands can be
+  /// submitted more than once, and more than once in a single submission.
+  Result BeginRecording(bool reusable);
+  /// Submits the recorded commands |count| times and waits for them to
+  /// complete, allowing |timeout_ms| for each time, then resets the command
+  /// buffer.
+  Result SubmitAndReset(uint32_t timeout_ms, uint32_t count);
+  /// Submits the recorded commands once without waiting for them.
+  Result SubmitWithoutWaiting();
+  Result QueueSubmit(const VkCommandBuffer* commands, uint32_t count);
+  /// Waits at most |timeout_ms|, clamped to the longest wait Vulkan allows.
+  Result WaitForFence(uint64_t timeout_ms);
   void Reset();
 
   bool guarded_ = false;
+  bool in_flight_ = false;
 
   Device* device_ = nullptr;
   CommandPool* pool_ = nullptr;
@@ -75,6 +93,10 @@ class CommandBufferGuard {
  public:
   /// Creates a command buffer guard and sets the command buffer to recording.
   explicit CommandBufferGuard(CommandBuffer* buffer);
+  /// Creates a command buffer guard and sets the command buffer to recording.
+  /// If |reusable| is true the commands can be submitted with
+  /// SubmitRepeatedly().
+  CommandBufferGuard(CommandBuffer* buffer, bool reusable);
   ~CommandBufferGuard();
 
   /// Returns true if the command buffer was successfully set to recording.
@@ -84,10 +106,18 @@ class CommandBufferGuard {
 
   /// Submits and resets the internal command buffer.
   Result Submit(uint32_t timeout_ms);
+  /// Submits the commands |count| times, in as few submissions as the
+  /// fence timeout allows, and resets the internal command buffer. The
+  /// recording must have been started as reusable.
+  Result SubmitRepeatedly(uint32_t count, uint32_t timeout_ms);
+  /// Submits the internal command buffer without waiting for it. The command
+  /// buffer can only be recorded again after CommandBuffer::WaitAndReset().
+  Result SubmitWithoutWaiting();
 
  private:
   Result result_;
   CommandBuffer* buffer_;
+  bool reusable_ = false;
 };
 
 }  // namespace vulkan
@@ -29,12 +29,25 @@ ComputePipeline::ComputePipeline(
                fence_timeout_ms,
                shader_stage_info) {}
 
-ComputePipeline::~ComputePipeline() = default;
+ComputePipeline::~ComputePipeline() {
+  DiscardPendingCommands();
+  DestroyCachedVkPipelines();
+}
 
 Result ComputePipeline::Initialize(CommandPool* pool) {
   return Pipeline::Initialize(pool);
 }
 
+void ComputePipeline::DestroyCachedVkPipelines() {
+  std::lock_guard<std::mutex> lock(vk_pipeline_mutex_);
+  if (pipeline_ == VK_NULL_HANDLE)
+    return;
+
+  device_->GetPtrs()->vkDestroyPipeline(device_->GetVkDevice(), pipeline_,
+                                        nullptr);
+  pipeline_ = VK_NULL_HANDLE;
+}
+
 Result ComputePipeline::CreateVkComputePipeline(
     const VkPipelineLayout& pipeline_layout,
     VkPipeline* pipeline) {
@@ -56,26 +69,64 @@ Result ComputePipeline::CreateVkComputePipeline(
   pipeline_info.layout = pipeline_layout;
 
   if (device_->GetPtrs()->vkCreateComputePipelines(
-          device_->GetVkDevice(), VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
-          pipeline) != VK_SUCCESS) {
+          device_->GetVkDevice(), device_->GetVkPipelineCache(), 1,
+          &pipeline_info, nullptr, pipeline) != VK_SUCCESS) {
     return Result("Vulkan::Calling vkCreateComputePipelines Fail");
   }
 
   return {};
 }
 
-Result ComputePipeline::Compute(uint32_t x, uint32_t y, uint32_t z) {
-  Result r = SendDescriptorDataToDeviceIfNeeded();
+Result ComputePipeline::GetVkComputePipeline(VkPipelineLayout pipeline_layout,
+                                             VkPipeline* pipeline) {
+  // Waits for the pipeline if it is being created on another thread.
+  std::lock_guard<std::mutex> lock(vk_pipeline_mutex_);
+  if (pipeline_ == VK_NULL_HANDLE) {
+    Result r = CreateVkComputePipeline(pipeline_layout, &pipeline_);
+    if (!r.IsSuccess())
+      return r;
+
+    RecordPipelineCacheMiss();
+  } else {
+    RecordPipelineCacheHit();
+  }
+
+  *pipeline = pipeline_;
+  return {};
+}
+
+Result ComputePipeline::PrepareVkComputePipeline(
+    std::function<Result()>* job) {
+  // The layout is created here, creating the VkPipeline only reads it.
+  VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+  Result r = GetVkPipelineLayout(&pipeline_layout);
   if (!r.IsSuccess())
     return r;
 
+  *job = [this, pipeline_layout]() {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    return GetVkComputePipeline(pipeline_layout, &pipeline);
+  };
+  return {};
+}
+
+Result ComputePipeline::Compute(uint32_t x, uint32_t y, uint32_t z) {
+  // Descriptor resources stay alive while commands are pending, so they only
+  // need to be created for the first command.
+  Result r;
+  if (!HasPendingCommands()) {
+    r = CreateDescriptorResourcesIfNeeded();
+    if (!r.IsSuccess())
+      return r;
+  }
+
   VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
-  r = CreateVkPipelineLayout(&pipeline_layout);
+  r = GetVkPipelineLayout(&pipeline_layout);
   if (!r.IsSuccess())
     return r;
 
   VkPipeline pipeline = VK_NULL_HANDLE;
-  r = CreateVkComputePipeline(pipeline_layout, &pipeline);
+  r = GetVkComputePipeline(pipeline_layout, &pipeline);
   if (!r.IsSuccess())
     return r;
 
@@ -84,36 +135,30 @@ Result ComputePipeline::Compute(uint32_t x, uint32_t y, uint32_t z) {
   // while updating it is not safe.
   UpdateDescriptorSetsIfNeeded();
 
-  {
-    CommandBufferGuard guard(GetCommandBuffer());
-    if (!guard.IsRecording())
-      return guard.GetResult();
-
-    BindVkDescriptorSets(pipeline_layout);
-
-    r = RecordPushConstant(pipeline_layout);
-    if (!r.IsSuccess())
-      return r;
+  r = StartRecordingCommand();
+  if (!r.IsSuccess())
+    return r;
 
-    device_->GetPtrs()->vkCmdBindPipeline(command_->GetVkCommandBuffer(),
-                                          VK_PIPELINE_BIND_POINT_COMPUTE,
-                                          pipeline);
-    device_->GetPtrs()->vkCmdDispatch(command_->GetVkCommandBuffer(), x, y, z);
+  BindVkDescriptorSets(pipeline_layout);
 
-    r = guard.Submit(GetFenceTimeout());
-    if (!r.IsSuccess())
-      return r;
+  r = RecordPushConstant(pipeline_layout);
+  if (!r.IsSuccess()) {
+    DiscardPendingCommands();
+    return r;
   }
 
-  r = ReadbackDescriptorsToHostDataQueue();
-  if (!r.IsSuccess())
+  r = BeginStatisticsQuery();
+  if (!r.IsSuccess()) {
+    DiscardPendingCommands();
     return r;
+  }
 
-  device_->GetPtrs()->vkDestroyPipeline(device_->GetVkDevice(), pipeline,
-                                        nullptr);
-  device_->GetPtrs()->vkDestroyPipelineLayout(device_->GetVkDevice(),
-                                              pipeline_layout, nullptr);
-
+  device_->GetPtrs()->vkCmdBindPipeline(command_->GetVkCommandBuffer(),
+                                        VK_PIPELINE_BIND_POINT_COMPUTE,
+                                        pipeline);
+  device_->GetPtrs()->vkCmdDispatch(command_->GetVkCommandBuffer(), x, y, z);
+  EndStatisticsQuery("compute");
+  StopGpuTimer("compute");
   return {};
 }
 
@@ -15,6 +15,7 @@
 #ifndef SRC_VULKAN_COMPUTE_PIPELINE_H_
 #define SRC_VULKAN_COMPUTE_PIPELINE_H_
 
+#include <functional>
 #include <vector>
 
 #include "amber/result.h"
@@ -35,11 +36,29 @@ class ComputePipeline : public Pipeline {
 
   Result Initialize(CommandPool* pool);
 
+  /// Records a dispatch of |x|, |y|, |z| workgroups. The dispatch stays
+  /// pending until SubmitPendingCommands() is called.
   Result Compute(uint32_t x, uint32_t y, uint32_t z);
 
+  /// Prepares creating the VkPipeline of the dispatches. Returns in |job| the
+  /// creation, which may run on another thread as long as the layout and the
+  /// entry point do not change. Compute() waits for a running |job|.
+  Result PrepareVkComputePipeline(std::function<Result()>* job);
+
+ protected:
+  void DestroyCachedVkPipelines() override;
+
  private:
+  /// Returns the VkPipeline created with |pipeline_layout| in |pipeline|,
+  /// creating it if it does not exist yet.
+  Result GetVkComputePipeline(VkPipelineLayout pipeline_layout,
+                              VkPipeline* pipeline);
   Result CreateVkComputePipeline(const VkPipelineLayout& pipeline_layout,
                                  VkPipeline* pipeline);
+
+  // The compute pipeline has no per dispatch state, so a single VkPipeline
+  // serves every dispatch until the layout or the entry point changes.
+  VkPipeline pipeline_ = VK_NULL_HANDLE;
 };
 
 }  // namespace vulkan
@@ -51,8 +51,18 @@ class Descriptor {
   virtual void UpdateDescriptorSetIfNeeded(VkDescriptorSet descriptor_set) = 0;
   virtual Result CreateResourceIfNeeded() = 0;
   virtual void RecordCopyDataToResourceIfNeeded(CommandBuffer*) {}
+  /// Drops the host side contents copied by
+  /// RecordCopyDataToResourceIfNeeded(). Called once all descriptors copied
+  /// theirs, as several descriptors may be bound to the same buffer.
+  virtual void ReleaseUploadedHostData() {}
   virtual Result RecordCopyDataToHost(CommandBuffer*) { return {}; }
   virtual Result MoveResourceToBufferOutput() { return {}; }
+  /// Returns true if the device holds contents for |buffer| which were not
+  /// copied back into it yet.
+  virtual bool IsReadbackNeeded(const Buffer*) const { return false; }
+  /// Returns true if values written on the host can be uploaded on top of
+  /// the contents the device holds, by copying only the modified ranges.
+  virtual bool CanUploadRanges() const { return false; }
   virtual Result SetSizeInElements(uint32_t) { return {}; }
   virtual Result AddToBuffer(const std::vector<Value>&, uint32_t) { return {}; }
   uint32_t GetDescriptorSet() const { return descriptor_set_; }
@@ -371,7 +371,43 @@ Device::Device(VkInstance instance,
       queue_(queue),
       queue_family_index_(queue_family_index) {}
 
-Device::~Device() = default;
+Device::~Device() {
+  if (memory_allocator_ && delegate_ && delegate_->LogGraphicsCalls()) {
+    const auto stats = memory_allocator_->GetStats();
+    delegate_->Log(
+        "Memory allocator: " + std::to_string(stats.block_count) +
+        " blocks, " + std::to_string(stats.block_bytes) + " bytes in blocks, " +
+        std::to_string(stats.peak_used_bytes) + " bytes peak usage, " +
+        std::to_string(stats.free_range_count) + " free ranges, " +
+        std::to_string(stats.GetFragmentationPercent()) + "% fragmentation");
+  }
+  if (object_cache_ && delegate_ && delegate_->LogGraphicsCalls()) {
+    const auto& stats = object_cache_->GetStats();
+    delegate_->Log("Object cache: " + std::to_string(stats.created_count) +
+                   " shader modules and samplers created, " +
+                   std::to_string(stats.reused_count) + " reused");
+  }
+  if (pipeline_library_cache_ && delegate_ && delegate_->LogGraphicsCalls()) {
+    const auto& stats = pipeline_library_cache_->GetStats();
+    const auto to_ms = [](uint64_t ns) {
+      return std::to_string(static_cast<double>(ns) / 1000000.0);
+    };
+    delegate_->Log(
+        "Pipeline libraries: " + std::to_string(stats.library_count) +
+        " libraries created in " + to_ms(stats.library_ns) + " ms, " +
+        std::to_string(stats.linked_count) + " pipelines linked in " +
+        to_ms(stats.link_ns) + " ms, " + std::to_string(stats.compiled_count) +
+        " pipelines compiled in full in " + to_ms(stats.compile_ns) + " ms");
+  }
+  // Released before the object cache, which tells it about destroyed shader
+  // modules.
+  pipeline_library_cache_ = nullptr;
+  object_cache_ = nullptr;
+  memory_allocator_ = nullptr;
+
+  if (pipeline_cache_ != VK_NULL_HANDLE)
+    ptrs_.vkDestroyPipelineCache(device_, pipeline_cache_, nullptr);
+}
 
 Result Device::LoadVulkanPointers(PFN_vkGetInstanceProcAddr getInstanceProcAddr,
                                   Delegate* delegate) {
@@ -547,6 +583,20 @@ Result Device::Initialize(
   ptrs_.vkGetPhysicalDeviceMemoryProperties(physical_device_,
                                             &physical_memory_properties_);
 
+  for (const auto& ext : required_extensions) {
+    if (ext == "VK_EXT_external_memory_host")
+      InitializeExternalMemoryHost(getInstanceProcAddr);
+  }
+  InitializeExtendedDynamicState(getInstanceProcAddr, available_features2);
+  supports_graphics_pipeline_library_ =
+      IsGraphicsPipelineLibraryEnabled(available_features2);
+
+  delegate_ = delegate;
+  memory_allocator_ =
+      MakeUnique<MemoryAllocator>(this, MemoryAllocator::kDefaultBlockSize);
+  object_cache_ = MakeUnique<ObjectCache>(this);
+  pipeline_library_cache_ = MakeUnique<PipelineLibraryCache>(this, delegate);
+
   return {};
 }
 
@@ -603,10 +653,214 @@ bool Device::IsMemoryHostCoherent(uint32_t memory_type_index) const {
                         VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 }
 
+void Device::InitializeExternalMemoryHost(
+    PFN_vkGetInstanceProcAddr getInstanceProcAddr) {
+  // Vulkan 1.1 has the properties query in core, older instances need
+  // VK_KHR_get_physical_device_properties2.
+  PFN_vkGetPhysicalDeviceProperties2KHR get_properties2 =
+      reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+          getInstanceProcAddr(instance_, "vkGetPhysicalDeviceProperties2"));
+  if (!get_properties2) {
+    get_properties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceProperties2KHR>(
+        getInstanceProcAddr(instance_, "vkGetPhysicalDeviceProperties2KHR"));
+  }
+  get_memory_host_pointer_properties_ =
+      reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(
+          getInstanceProcAddr(instance_,
+                              "vkGetMemoryHostPointerPropertiesEXT"));
+  if (!get_properties2 || !get_memory_host_pointer_properties_)
+    return;
+
+  VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_properties =
+      VkPhysicalDeviceExternalMemoryHostPropertiesEXT();
+  host_properties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+
+  VkPhysicalDeviceProperties2KHR properties2 = VkPhysicalDeviceProperties2KHR();
+  properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2_KHR;
+  properties2.pNext = &host_properties;
+  get_properties2(physical_device_, &properties2);
+
+  min_imported_host_pointer_alignment_ =
+      host_properties.minImportedHostPointerAlignment;
+}
+
+bool Device::IsGraphicsPipelineLibraryEnabled(
+    const VkPhysicalDeviceFeatures2KHR& enabled_features2) const {
+  const VkStructureType library_type =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT;
+
+  void* ptr = enabled_features2.pNext;
+  while (ptr != nullptr) {
+    BaseOutStructure* s = static_cast<BaseOutStructure*>(ptr);
+    if (s->sType == library_type) {
+      auto* features =
+          static_cast<VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT*>(
+              ptr);
+      return features->graphicsPipelineLibrary == VK_TRUE;
+    }
+    ptr = s->pNext;
+  }
+  return false;
+}
+
+void Device::InitializeExtendedDynamicState(
+    PFN_vkGetInstanceProcAddr getInstanceProcAddr,
+    const VkPhysicalDeviceFeatures2KHR& enabled_features2) {
+  // The features can only be enabled together with their extensions, so the
+  // feature structures tell if the extensions are usable.
+  const VkStructureType state1_type =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+  const VkStructureType state2_type =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT;
+
+  bool state1 = false;
+  bool state2 = false;
+  void* ptr = enabled_features2.pNext;
+  while (ptr != nullptr) {
+    BaseOutStructure* s = static_cast<BaseOutStructure*>(ptr);
+    if (s->sType == state1_type) {
+      auto* features =
+          static_cast<VkPhysicalDeviceExtendedDynamicStateFeaturesEXT*>(ptr);
+      state1 = features->extendedDynamicState == VK_TRUE;
+    } else if (s->sType == state2_type) {
+      auto* features =
+          static_cast<VkPhysicalDeviceExtendedDynamicState2FeaturesEXT*>(ptr);
+      state2 = features->extendedDynamicState2 == VK_TRUE;
+    }
+    ptr = s->pNext;
+  }
+
+  auto& p = dynamic_state_ptrs_;
+#define AMBER_LOAD_DYNAMIC_STATE_FUNC(name) \
+  p.name = reinterpret_cast<PFN_##name>(getInstanceProcAddr(instance_, #name))
+
+  if (state1) {
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetCullModeEXT);
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetFrontFaceEXT);
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetPrimitiveTopologyEXT);
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetDepthTestEnableEXT);
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetDepthWriteEnableEXT);
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetDepthCompareOpEXT);
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetDepthBoundsTestEnableEXT);
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetStencilTestEnableEXT);
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetStencilOpEXT);
+    supports_extended_dynamic_state_ =
+        p.vkCmdSetCullModeEXT && p.vkCmdSetFrontFaceEXT &&
+        p.vkCmdSetPrimitiveTopologyEXT && p.vkCmdSetDepthTestEnableEXT &&
+        p.vkCmdSetDepthWriteEnableEXT && p.vkCmdSetDepthCompareOpEXT &&
+        p.vkCmdSetDepthBoundsTestEnableEXT && p.vkCmdSetStencilTestEnableEXT &&
+        p.vkCmdSetStencilOpEXT;
+  }
+  // The state 2 commands are only used together with the state 1 ones.
+  if (state2 && supports_extended_dynamic_state_) {
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetDepthBiasEnableEXT);
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetPrimitiveRestartEnableEXT);
+    AMBER_LOAD_DYNAMIC_STATE_FUNC(vkCmdSetRasterizerDiscardEnableEXT);
+    supports_extended_dynamic_state2_ =
+        p.vkCmdSetDepthBiasEnableEXT && p.vkCmdSetPrimitiveRestartEnableEXT &&
+        p.vkCmdSetRasterizerDiscardEnableEXT;
+  }
+
+#undef AMBER_LOAD_DYNAMIC_STATE_FUNC
+}
+
+uint32_t Device::GetHostPointerMemoryTypeBits(const void* host_ptr) const {
+  if (!get_memory_host_pointer_properties_)
+    return 0;
+
+  VkMemoryHostPointerPropertiesEXT properties =
+      VkMemoryHostPointerPropertiesEXT();
+  properties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+  if (get_memory_host_pointer_properties_(
+          device_, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT,
+          host_ptr, &properties) != VK_SUCCESS) {
+    return 0;
+  }
+  return properties.memoryTypeBits;
+}
+
+bool Device::IsPipelineCacheDataCompatible(
+    const std::vector<uint8_t>& data) const {
+  // The blob starts with a VkPipelineCacheHeaderVersionOne: header size,
+  // header version, vendor ID and device ID as uint32_t, followed by the
+  // pipeline cache UUID.
+  const size_t header_size = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+  if (data.size() < header_size)
+    return false;
+
+  uint32_t fields[4] = {};
+  std::memcpy(fields, data.data(), sizeof(fields));
+  if (fields[0] < header_size ||
+      fields[1] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+      fields[2] != physical_device_properties_.vendorID ||
+      fields[3] != physical_device_properties_.deviceID) {
+    return false;
+  }
+
+  return std::memcmp(data.data() + sizeof(fields),
+                     physical_device_properties_.pipelineCacheUUID,
+                     VK_UUID_SIZE) == 0;
+}
+
+Result Device::CreatePipelineCache(const std::vector<uint8_t>& initial_data) {
+  VkPipelineCacheCreateInfo info = VkPipelineCacheCreateInfo();
+  info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  if (IsPipelineCacheDataCompatible(initial_data)) {
+    info.initialDataSize = initial_data.size();
+    info.pInitialData = initial_data.data();
+  }
+
+  if (ptrs_.vkCreatePipelineCache(device_, &info, nullptr, &pipeline_cache_) !=
+      VK_SUCCESS) {
+    return Result("Vulkan::Calling vkCreatePipelineCache Fail");
+  }
+  return {};
+}
+
+Result Device::GetPipelineCacheData(std::vector<uint8_t>* data) const {
+  if (pipeline_cache_ == VK_NULL_HANDLE)
+    return Result("Vulkan::GetPipelineCacheData no pipeline cache");
+
+  size_t size = 0;
+  if (ptrs_.vkGetPipelineCacheData(device_, pipeline_cache_, &size, nullptr) !=
+      VK_SUCCESS) {
+    return Result("Vulkan::Calling vkGetPipelineCacheData Fail");
+  }
+
+  data->resize(size);
+  if (size == 0)
+    return {};
+
+  if (ptrs_.vkGetPipelineCacheData(device_, pipeline_cache_, &size,
+                                   data->data()) != VK_SUCCESS) {
+    data->clear();
+    return Result("Vulkan::Calling vkGetPipelineCacheData Fail");
+  }
+  data->resize(size);
+  return {};
+}
+
 uint32_t Device::GetMaxPushConstants() const {
   return physical_device_properties_.limits.maxPushConstantsSize;
 }
 
+float Device::GetTimestampPeriod() const {
+  return physical_device_properties_.limits.timestampPeriod;
+}
+
+uint32_t Device::GetTimestampValidBits() const {
+  uint32_t count = 0;
+  ptrs_.vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &count,
+                                                 nullptr);
+  std::vector<VkQueueFamilyProperties> properties(count);
+  ptrs_.vkGetPhysicalDeviceQueueFamilyProperties(physical_device_, &count,
+                                                 properties.data());
+  if (queue_family_index_ >= count)
+    return 0;
+  return properties[queue_family_index_].timestampValidBits;
+}
+
 bool Device::IsDescriptorSetInBounds(uint32_t descriptor_set) const {
   VkPhysicalDeviceProperties properties = VkPhysicalDeviceProperties();
   GetPtrs()->vkGetPhysicalDeviceProperties(physical_device_, &properties);
@@ -25,6 +25,9 @@
 #include "amber/vulkan_header.h"
 #include "src/buffer.h"
 #include "src/format.h"
+#include "src/vulkan/memory_allocator.h"
+#include "src/vulkan/object_cache.h"
+#include "src/vulkan/pipeline_library_cache.h"
 
 namespace amber {
 namespace vulkan {
@@ -33,6 +36,27 @@ struct VulkanPtrs {
 #include "vk-wrappers.h"  // NOLINT(build/include)
 };
 
+/// Entry points of VK_EXT_extended_dynamic_state and
+/// VK_EXT_extended_dynamic_state2. They are loaded separately from
+/// |VulkanPtrs| as the extensions are optional.
+struct DynamicStatePtrs {
+  PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT = nullptr;
+  PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT = nullptr;
+  PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT = nullptr;
+  PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT = nullptr;
+  PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT = nullptr;
+  PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT = nullptr;
+  PFN_vkCmdSetDepthBoundsTestEnableEXT vkCmdSetDepthBoundsTestEnableEXT =
+      nullptr;
+  PFN_vkCmdSetStencilTestEnableEXT vkCmdSetStencilTestEnableEXT = nullptr;
+  PFN_vkCmdSetStencilOpEXT vkCmdSetStencilOpEXT = nullptr;
+  PFN_vkCmdSetDepthBiasEnableEXT vkCmdSetDepthBiasEnableEXT = nullptr;
+  PFN_vkCmdSetPrimitiveRestartEnableEXT vkCmdSetPrimitiveRestartEnableEXT =
+      nullptr;
+  PFN_vkCmdSetRasterizerDiscardEnableEXT vkCmdSetRasterizerDiscardEnableEXT =
+      nullptr;
+};
+
 /// Wrapper around a Vulkan Device object.
 class Device {
  public:
@@ -61,6 +85,11 @@ class Device {
 
   uint32_t GetQueueFamilyIndex() const { return queue_family_index_; }
   uint32_t GetMaxPushConstants() const;
+  /// Returns the number of nanoseconds a timestamp query increments by.
+  float GetTimestampPeriod() const;
+  /// Returns the number of valid bits in timestamps written on the queue, 0
+  /// if the queue does not support timestamps.
+  uint32_t GetTimestampValidBits() const;
 
   /// Returns true if the given |descriptor_set| is within the bounds of
   /// this device.
@@ -74,11 +103,84 @@ class Device {
   /// Returns true if the memory at |memory_type_index| is host corherent.
   bool IsMemoryHostCoherent(uint32_t memory_type_index) const;
 
+  /// Returns the alignment host pointers imported as device memory need, or 0
+  /// if VK_EXT_external_memory_host was not requested for the device.
+  VkDeviceSize GetMinImportedHostPointerAlignment() const {
+    return min_imported_host_pointer_alignment_;
+  }
+  /// Returns the memory types the host memory at |host_ptr| can be imported
+  /// as, 0 if it cannot be imported.
+  uint32_t GetHostPointerMemoryTypeBits(const void* host_ptr) const;
+
   /// Returns the pointers to the Vulkan API methods.
   const VulkanPtrs* GetPtrs() const { return &ptrs_; }
 
+  /// Returns true if the extendedDynamicState feature of
+  /// VK_EXT_extended_dynamic_state is enabled on the device.
+  bool SupportsExtendedDynamicState() const {
+    return supports_extended_dynamic_state_;
+  }
+  /// Returns true if the extendedDynamicState2 feature of
+  /// VK_EXT_extended_dynamic_state2 is enabled on the device.
+  bool SupportsExtendedDynamicState2() const {
+    return supports_extended_dynamic_state2_;
+  }
+  /// Returns the pointers to the dynamic state commands. Only the commands of
+  /// the supported extensions are set.
+  const DynamicStatePtrs* GetDynamicStatePtrs() const {
+    return &dynamic_state_ptrs_;
+  }
+
+  /// Returns true if the graphicsPipelineLibrary feature of
+  /// VK_EXT_graphics_pipeline_library is enabled on the device.
+  bool SupportsGraphicsPipelineLibrary() const {
+    return supports_graphics_pipeline_library_;
+  }
+
+  /// Creates the pipeline cache shared by all pipelines created on this
+  /// device. The cache is seeded with |initial_data| if it holds a blob
+  /// previously returned by GetPipelineCacheData() for the same device and
+  /// driver. Any other blob is dropped and the cache starts out empty.
+  Result CreatePipelineCache(const std::vector<uint8_t>& initial_data);
+  /// Returns the pipeline cache, or VK_NULL_HANDLE if none was created.
+  VkPipelineCache GetVkPipelineCache() const { return pipeline_cache_; }
+  /// Serializes the current contents of the pipeline cache into |data|.
+  Result GetPipelineCacheData(std::vector<uint8_t>* data) const;
+
+  /// Returns the allocator all buffer and image memory of this device comes
+  /// from.
+  MemoryAllocator* GetMemoryAllocator() const {
+    return memory_allocator_.get();
+  }
+
+  /// Returns the cache sharing shader modules and samplers between all users
+  /// of this device.
+  ObjectCache* GetObjectCache() const { return object_cache_.get(); }
+
+  /// Returns the cache building graphics pipelines, from shared pipeline
+  /// libraries if supported.
+  PipelineLibraryCache* GetPipelineLibraryCache() const {
+    return pipeline_library_cache_.get();
+  }
+
  private:
   Result LoadVulkanPointers(PFN_vkGetInstanceProcAddr, Delegate* delegate);
+  /// Returns true if the header of the pipeline cache blob in |data| matches
+  /// the vendor, device and pipeline cache UUID of the physical device.
+  bool IsPipelineCacheDataCompatible(const std::vector<uint8_t>& data) const;
+  /// Loads the VK_EXT_external_memory_host entry point and queries the
+  /// alignment imported host pointers need.
+  void InitializeExternalMemoryHost(
+      PFN_vkGetInstanceProcAddr getInstanceProcAddr);
+  /// Loads the dynamic state commands if the features of the extended
+  /// dynamic state extensions are enabled in |enabled_features2|.
+  void InitializeExtendedDynamicState(
+      PFN_vkGetInstanceProcAddr getInstanceProcAddr,
+      const VkPhysicalDeviceFeatures2KHR& enabled_features2);
+  /// Returns true if the graphicsPipelineLibrary feature is enabled in
+  /// |enabled_features2|.
+  bool IsGraphicsPipelineLibraryEnabled(
+      const VkPhysicalDeviceFeatures2KHR& enabled_features2) const;
 
   VkInstance instance_ = VK_NULL_HANDLE;
   VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
@@ -87,8 +189,24 @@ class Device {
   VkDevice device_ = VK_NULL_HANDLE;
   VkQueue queue_ = VK_NULL_HANDLE;
   uint32_t queue_family_index_ = 0;
+  VkPipelineCache pipeline_cache_ = VK_NULL_HANDLE;
+  // Only set if VK_EXT_external_memory_host is enabled, the extension is not
+  // part of the wrappers as those are required to load.
+  PFN_vkGetMemoryHostPointerPropertiesEXT get_memory_host_pointer_properties_ =
+      nullptr;
+  VkDeviceSize min_imported_host_pointer_alignment_ = 0;
+  bool supports_extended_dynamic_state_ = false;
+  bool supports_extended_dynamic_state2_ = false;
+  DynamicStatePtrs dynamic_state_ptrs_;
+  bool supports_graphics_pipeline_library_ = false;
+
+  Delegate* delegate_ = nullptr;
 
   VulkanPtrs ptrs_;
+  // Declared after |ptrs_| as freeing the memory blocks needs them.
+  std::unique_ptr<MemoryAllocator> memory_allocator_;
+  std::unique_ptr<ObjectCache> object_cache_;
+  std::unique_ptr<PipelineLibraryCache> pipeline_library_cache_;
 };
 
 }  // namespace vulkan
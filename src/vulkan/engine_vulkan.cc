@@ -15,7 +15,9 @@
 #include "src/vulkan/engine_vulkan.h"
 
 #include <algorithm>
+#include <cassert>
 #include <set>
+#include <tuple>
 #include <utility>
 
 #include "amber/amber_vulkan.h"
@@ -30,6 +32,8 @@ namespace {
 
 const uint32_t kTrianglesPerCell = 2;
 const uint32_t kVerticesPerTriangle = 3;
+// The number of DRAW_RECT and DRAW_GRID geometries cached per pipeline.
+const size_t kMaxHelperGeometries = 64;
 
 Result ToVkShaderStage(ShaderType type, VkShaderStageFlagBits* ret) {
   switch (type) {
@@ -74,26 +78,94 @@ bool AreAllExtensionsSupported(
   return required_extension_set.empty();
 }
 
+std::vector<Buffer*> GetPipelineBuffers(const amber::Pipeline* pipeline) {
+  std::vector<Buffer*> buffers;
+  for (const auto& info : pipeline->GetColorAttachments())
+    buffers.push_back(info.buffer);
+  for (const auto& info : pipeline->GetVertexBuffers())
+    buffers.push_back(info.buffer);
+  for (const auto& info : pipeline->GetBuffers())
+    buffers.push_back(info.buffer);
+  if (pipeline->GetDepthBuffer().buffer)
+    buffers.push_back(pipeline->GetDepthBuffer().buffer);
+  if (pipeline->GetIndexBuffer())
+    buffers.push_back(pipeline->GetIndexBuffer());
+  if (pipeline->GetPushConstantBuffer().buffer)
+    buffers.push_back(pipeline->GetPushConstantBuffer().buffer);
+  return buffers;
+}
+
 }  // namespace
 
 EngineVulkan::EngineVulkan() : Engine() {}
 
 EngineVulkan::~EngineVulkan() {
+  WaitForPrecompiledPipelines();
+
+  // Commands in flight may still use the objects of all pipelines.
+  if (pending_pipeline_)
+    pending_pipeline_->WaitForCommandsInFlight();
+
+  StorePipelineCacheData();
+  DestroyShaderModules();
+}
+
+void EngineVulkan::StorePipelineCacheData() {
+  // Only write the pipeline cache back if this engine built any pipelines,
+  // a requirements check must not clobber the blob from a previous run.
+  if (device_ && GetPipelineCacheData() && !pipeline_map_.empty() &&
+      device_->GetVkPipelineCache() != VK_NULL_HANDLE) {
+    std::vector<uint8_t> data;
+    if (device_->GetPipelineCacheData(&data).IsSuccess())
+      *GetPipelineCacheData() = std::move(data);
+  }
+}
+
+void EngineVulkan::DestroyShaderModules() {
   for (auto it = pipeline_map_.begin(); it != pipeline_map_.end(); ++it) {
     auto& info = it->second;
 
     for (auto mod_it = info.shader_info.begin();
          mod_it != info.shader_info.end(); ++mod_it) {
-      auto vk_device = device_->GetVkDevice();
-      if (vk_device != VK_NULL_HANDLE &&
-          mod_it->second.shader != VK_NULL_HANDLE) {
-        device_->GetPtrs()->vkDestroyShaderModule(
-            vk_device, mod_it->second.shader, nullptr);
-      }
+      if (mod_it->second.shader != VK_NULL_HANDLE)
+        device_->GetObjectCache()->ReleaseShaderModule(mod_it->second.shader);
+      mod_it->second.shader = VK_NULL_HANDLE;
     }
   }
 }
 
+Result EngineVulkan::CreateGpuTimerIfNeeded() {
+  if (gpu_timer_ || !GetCommandTimings())
+    return {};
+
+  auto timer = MakeUnique<GpuTimer>(device_.get(), GetCommandTimings());
+  Result r = timer->Initialize();
+  if (!r.IsSuccess())
+    return r;
+
+  gpu_timer_ = std::move(timer);
+  return {};
+}
+
+Result EngineVulkan::Reset() {
+  if (!device_)
+    return Result("Vulkan::Reset engine is not initialized");
+
+  WaitForPrecompiledPipelines();
+  Result r = SubmitPendingCommands();
+
+  StorePipelineCacheData();
+  DestroyShaderModules();
+  debugger_ = nullptr;
+  pipeline_map_.clear();
+  pending_pipeline_ = nullptr;
+
+  // The timer writes to the list of the executed script, the next script
+  // gets a new one when its first pipeline is created.
+  gpu_timer_ = nullptr;
+  return r;
+}
+
 Result EngineVulkan::Initialize(
     EngineConfig* config,
     Delegate* delegate,
@@ -130,6 +202,12 @@ Result EngineVulkan::Initialize(
   if (!r.IsSuccess())
     return r;
 
+  const std::vector<uint8_t> no_cache_data;
+  auto* cache_data = GetPipelineCacheData();
+  r = device_->CreatePipelineCache(cache_data ? *cache_data : no_cache_data);
+  if (!r.IsSuccess())
+    return r;
+
   if (!pool_) {
     pool_ = MakeUnique<CommandPool>(device_.get());
     r = pool_->Initialize();
@@ -137,17 +215,20 @@ Result EngineVulkan::Initialize(
       return r;
   }
 
-  return {};
+  return CreateGpuTimerIfNeeded();
 }
 
 Result EngineVulkan::CreatePipeline(amber::Pipeline* pipeline) {
+  Result r = CreateGpuTimerIfNeeded();
+  if (!r.IsSuccess())
+    return r;
+
   // Create the pipeline data early so we can access them as needed.
   pipeline_map_[pipeline] = PipelineInfo();
   auto& info = pipeline_map_[pipeline];
 
   for (const auto& shader_info : pipeline->GetShaders()) {
-    Result r =
-        SetShader(pipeline, shader_info.GetShaderType(), shader_info.GetData());
+    r = SetShader(pipeline, shader_info.GetShaderType(), shader_info.GetData());
     if (!r.IsSuccess())
       return r;
   }
@@ -170,7 +251,7 @@ Result EngineVulkan::CreatePipeline(amber::Pipeline* pipeline) {
   }
 
   std::vector<VkPipelineShaderStageCreateInfo> stage_create_info;
-  Result r = GetVkShaderStageInfo(pipeline, &stage_create_info);
+  r = GetVkShaderStageInfo(pipeline, &stage_create_info);
   if (!r.IsSuccess())
     return r;
 
@@ -195,6 +276,12 @@ Result EngineVulkan::CreatePipeline(amber::Pipeline* pipeline) {
   }
 
   info.vk_pipeline = std::move(vk_pipeline);
+  info.vk_pipeline->SetBufferMemory(engine_data.buffer_memory);
+  info.vk_pipeline->SetGpuTimer(gpu_timer_.get());
+  if (pipeline->IsPipelineStatisticsEnabled()) {
+    info.vk_pipeline->SetStatisticsQueries(
+        MakeUnique<StatisticsQueries>(device_.get(), GetCommandStatistics()));
+  }
 
   // Set the entry point names for the pipeline.
   for (const auto& shader_info : pipeline->GetShaders()) {
@@ -212,8 +299,14 @@ Result EngineVulkan::CreatePipeline(amber::Pipeline* pipeline) {
     auto fmt = vtex_info.buffer->GetFormat();
     if (!device_->IsFormatSupportedByPhysicalDevice(*fmt, vtex_info.type))
       return Result("Vulkan vertex buffer format is not supported");
-    if (!info.vertex_buffer)
+    if (!info.vertex_buffer) {
       info.vertex_buffer = MakeUnique<VertexBuffer>(device_.get());
+      info.vertex_buffer->SetDeviceLocal(true);
+    }
+    // All attributes share one buffer, which is only device local if all of
+    // them ask for it.
+    if (!info.vk_pipeline->UseDeviceLocalMemory(vtex_info.buffer))
+      info.vertex_buffer->SetDeviceLocal(false);
 
     info.vertex_buffer->SetData(static_cast<uint8_t>(vtex_info.location),
                                 vtex_info.buffer);
@@ -271,6 +364,104 @@ Result EngineVulkan::CreatePipeline(amber::Pipeline* pipeline) {
   return {};
 }
 
+Result EngineVulkan::PrecompilePipelines(const std::vector<Command*>& commands,
+                                         uint32_t thread_count) {
+  WaitForPrecompiledPipelines();
+
+  // The layouts and the state of the VkPipelines are prepared here, only
+  // creating them runs on the workers.
+  for (auto* command : commands) {
+    std::function<Result()> job;
+    // A command which can not be prepared reports why when it executes.
+    if (PreparePipelineJob(command, &job).IsSuccess() && job)
+      precompile_jobs_.push_back(std::move(job));
+  }
+
+  auto run = [this]() {
+    for (size_t i = next_precompile_job_++; i < precompile_jobs_.size();
+         i = next_precompile_job_++) {
+      // A failed creation is retried by the command using the VkPipeline,
+      // which reports the failure.
+      precompile_jobs_[i]();
+    }
+  };
+
+  const size_t count =
+      std::min(static_cast<size_t>(thread_count), precompile_jobs_.size());
+  for (size_t i = 0; i < count; ++i)
+    precompile_workers_.emplace_back(run);
+  return {};
+}
+
+Result EngineVulkan::PreparePipelineJob(Command* command,
+                                        std::function<Result()>* job) {
+  amber::Pipeline* pipeline = nullptr;
+  if (command->IsDrawRect())
+    pipeline = command->AsDrawRect()->GetPipeline();
+  else if (command->IsDrawGrid())
+    pipeline = command->AsDrawGrid()->GetPipeline();
+  else if (command->IsDrawArrays())
+    pipeline = command->AsDrawArrays()->GetPipeline();
+  else if (command->IsCompute())
+    pipeline = command->AsCompute()->GetPipeline();
+
+  auto it = pipeline_map_.find(pipeline);
+  if (it == pipeline_map_.end() || !it->second.vk_pipeline)
+    return Result("Vulkan::PrecompilePipelines no Pipeline exists");
+  Pipeline* vk_pipeline = it->second.vk_pipeline.get();
+
+  if (command->IsCompute()) {
+    if (!vk_pipeline->IsCompute())
+      return Result("Vulkan: Compute called for graphics pipeline.");
+    return vk_pipeline->AsCompute()->PrepareVkComputePipeline(job);
+  }
+
+  if (!vk_pipeline->IsGraphics())
+    return Result("Vulkan::PrecompilePipelines draw for Non-Graphics Pipeline");
+  auto* graphics = vk_pipeline->AsGraphics();
+
+  if (command->IsDrawArrays()) {
+    auto* draw = command->AsDrawArrays();
+    return graphics->PrepareVkGraphicsPipeline(
+        draw->GetPipelineData(), draw->GetTopology(),
+        it->second.vertex_buffer.get(), job);
+  }
+
+  // The vertex layout of DRAW_RECT and DRAW_GRID only depends on the format
+  // of their vertices, so it is described without creating the geometry.
+  CreateHelperFormatsIfNeeded();
+  Buffer vertex_data;
+  vertex_data.SetFormat(vertex_format_.get());
+  VertexBuffer vertex_buffer(device_.get());
+  vertex_buffer.SetData(0, &vertex_data);
+
+  if (command->IsDrawRect()) {
+    auto* rect = command->AsDrawRect();
+    return graphics->PrepareVkGraphicsPipeline(
+        rect->GetPipelineData(),
+        rect->IsPatch() ? Topology::kPatchList : Topology::kTriangleStrip,
+        &vertex_buffer, job);
+  }
+
+  // A grid without cells draws nothing.
+  auto* grid = command->AsDrawGrid();
+  if (grid->GetColumns() == 0 || grid->GetRows() == 0)
+    return {};
+
+  PipelineData pipeline_data;
+  pipeline_data.SetPolygonMode(grid->GetPolygonMode());
+  return graphics->PrepareVkGraphicsPipeline(
+      &pipeline_data, Topology::kTriangleList, &vertex_buffer, job);
+}
+
+void EngineVulkan::WaitForPrecompiledPipelines() {
+  for (auto& worker : precompile_workers_)
+    worker.join();
+  precompile_workers_.clear();
+  precompile_jobs_.clear();
+  next_precompile_job_ = 0;
+}
+
 Result EngineVulkan::SetShader(amber::Pipeline* pipeline,
                                ShaderType type,
                                const std::vector<uint32_t>& data) {
@@ -280,17 +471,12 @@ Result EngineVulkan::SetShader(amber::Pipeline* pipeline,
   if (it != info.shader_info.end())
     return Result("Vulkan::Setting Duplicated Shader Types Fail");
 
-  VkShaderModuleCreateInfo create_info = VkShaderModuleCreateInfo();
-  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  create_info.codeSize = data.size() * sizeof(uint32_t);
-  create_info.pCode = data.data();
-
-  VkShaderModule shader;
-  if (device_->GetPtrs()->vkCreateShaderModule(device_->GetVkDevice(),
-                                               &create_info, nullptr,
-                                               &shader) != VK_SUCCESS) {
-    return Result("Vulkan::Calling vkCreateShaderModule Fail");
-  }
+  // Pipelines attaching the same SPIR-V, like derived pipelines, share one
+  // shader module.
+  VkShaderModule shader = VK_NULL_HANDLE;
+  Result r = device_->GetObjectCache()->AcquireShaderModule(data, &shader);
+  if (!r.IsSuccess())
+    return r;
 
   info.shader_info[type].shader = shader;
 
@@ -386,7 +572,12 @@ Result EngineVulkan::DoClear(const ClearCommand* command) {
   if (!info.vk_pipeline->IsGraphics())
     return Result("Vulkan::Clear Command for Non-Graphics Pipeline");
 
-  return info.vk_pipeline->AsGraphics()->Clear();
+  Result r = StartPipelineCommand(command->GetPipeline());
+  if (!r.IsSuccess())
+    return r;
+
+  r = info.vk_pipeline->AsGraphics()->Clear();
+  return FinishPipelineCommand(info.vk_pipeline.get(), r);
 }
 
 Result EngineVulkan::DoDrawRect(const DrawRectCommand* command) {
@@ -396,48 +587,25 @@ Result EngineVulkan::DoDrawRect(const DrawRectCommand* command) {
 
   auto* graphics = info.vk_pipeline->AsGraphics();
 
-  float x = command->GetX();
-  float y = command->GetY();
-  float width = command->GetWidth();
-  float height = command->GetHeight();
+  HelperGeometryKey key;
+  key.x = command->GetX();
+  key.y = command->GetY();
+  key.width = command->GetWidth();
+  key.height = command->GetHeight();
 
   if (command->IsOrtho()) {
     const float frame_width = static_cast<float>(graphics->GetWidth());
     const float frame_height = static_cast<float>(graphics->GetHeight());
-    x = ((x / frame_width) * 2.0f) - 1.0f;
-    y = ((y / frame_height) * 2.0f) - 1.0f;
-    width = (width / frame_width) * 2.0f;
-    height = (height / frame_height) * 2.0f;
-  }
-
-  std::vector<Value> values(8);
-  // Bottom left
-  values[0].SetDoubleValue(static_cast<double>(x));
-  values[1].SetDoubleValue(static_cast<double>(y + height));
-  // Top left
-  values[2].SetDoubleValue(static_cast<double>(x));
-  values[3].SetDoubleValue(static_cast<double>(y));
-  // Bottom right
-  values[4].SetDoubleValue(static_cast<double>(x + width));
-  values[5].SetDoubleValue(static_cast<double>(y + height));
-  // Top right
-  values[6].SetDoubleValue(static_cast<double>(x + width));
-  values[7].SetDoubleValue(static_cast<double>(y));
-
-  // |format| is not Format for frame buffer but for vertex buffer.
-  // Since draw rect command contains its vertex information and it
-  // does not include a format of vertex buffer, we can choose any
-  // one that is suitable. We use VK_FORMAT_R32G32_SFLOAT for it.
-  TypeParser parser;
-  auto type = parser.Parse("R32G32_SFLOAT");
-  Format fmt(type.get());
-
-  auto buf = MakeUnique<Buffer>();
-  buf->SetFormat(&fmt);
-  buf->SetData(std::move(values));
+    key.x = ((key.x / frame_width) * 2.0f) - 1.0f;
+    key.y = ((key.y / frame_height) * 2.0f) - 1.0f;
+    key.width = (key.width / frame_width) * 2.0f;
+    key.height = (key.height / frame_height) * 2.0f;
+  }
 
-  auto vertex_buffer = MakeUnique<VertexBuffer>(device_.get());
-  vertex_buffer->SetData(0, buf.get());
+  HelperGeometry* geometry = nullptr;
+  Result r = GetHelperGeometry(&info, key, &geometry);
+  if (!r.IsSuccess())
+    return r;
 
   DrawArraysCommand draw(command->GetPipeline(), *command->GetPipelineData());
   draw.SetTopology(command->IsPatch() ? Topology::kPatchList
@@ -446,11 +614,12 @@ Result EngineVulkan::DoDrawRect(const DrawRectCommand* command) {
   draw.SetVertexCount(4);
   draw.SetInstanceCount(1);
 
-  Result r = graphics->Draw(&draw, vertex_buffer.get());
+  r = StartPipelineCommand(command->GetPipeline());
   if (!r.IsSuccess())
     return r;
 
-  return {};
+  r = graphics->Draw(&draw, geometry->vertex_buffer.get(), nullptr);
+  return FinishPipelineCommand(graphics, r);
 }
 
 Result EngineVulkan::DoDrawGrid(const DrawGridCommand* command) {
@@ -458,85 +627,162 @@ Result EngineVulkan::DoDrawGrid(const DrawGridCommand* command) {
   if (!info.vk_pipeline->IsGraphics())
     return Result("Vulkan::DrawGrid for Non-Graphics Pipeline");
 
-  auto* graphics = info.vk_pipeline->AsGraphics();
+  // A grid without cells has no triangles to draw.
+  if (command->GetColumns() == 0 || command->GetRows() == 0)
+    return {};
 
-  float x = command->GetX();
-  float y = command->GetY();
-  float width = command->GetWidth();
-  float height = command->GetHeight();
-  const uint32_t columns = command->GetColumns();
-  const uint32_t rows = command->GetRows();
-  const uint32_t vertices =
-      columns * rows * kVerticesPerTriangle * kTrianglesPerCell;
+  auto* graphics = info.vk_pipeline->AsGraphics();
 
   // Ortho calculation
   const float frame_width = static_cast<float>(graphics->GetWidth());
   const float frame_height = static_cast<float>(graphics->GetHeight());
-  x = ((x / frame_width) * 2.0f) - 1.0f;
-  y = ((y / frame_height) * 2.0f) - 1.0f;
-  width = (width / frame_width) * 2.0f;
-  height = (height / frame_height) * 2.0f;
-
-  std::vector<Value> values(vertices * 2);
-
-  const float cell_width = width / static_cast<float>(columns);
-  const float cell_height = height / static_cast<float>(rows);
-
-  for (uint32_t i = 0, c = 0; i < rows; i++) {
-    for (uint32_t j = 0; j < columns; j++, c += 12) {
-      // Calculate corners
-      float x0 = x + cell_width * static_cast<float>(j);
-      float y0 = y + cell_height * static_cast<float>(i);
-      float x1 = x + cell_width * static_cast<float>(j + 1);
-      float y1 = y + cell_height * static_cast<float>(i + 1);
-
-      // Bottom right
-      values[c + 0].SetDoubleValue(static_cast<double>(x1));
-      values[c + 1].SetDoubleValue(static_cast<double>(y1));
-      // Bottom left
-      values[c + 2].SetDoubleValue(static_cast<double>(x0));
-      values[c + 3].SetDoubleValue(static_cast<double>(y1));
-      // Top left
-      values[c + 4].SetDoubleValue(static_cast<double>(x0));
-      values[c + 5].SetDoubleValue(static_cast<double>(y0));
-      // Bottom right
-      values[c + 6].SetDoubleValue(static_cast<double>(x1));
-      values[c + 7].SetDoubleValue(static_cast<double>(y1));
-      // Top left
-      values[c + 8].SetDoubleValue(static_cast<double>(x0));
-      values[c + 9].SetDoubleValue(static_cast<double>(y0));
-      // Top right
-      values[c + 10].SetDoubleValue(static_cast<double>(x1));
-      values[c + 11].SetDoubleValue(static_cast<double>(y0));
-    }
-  }
 
-  // |format| is not Format for frame buffer but for vertex buffer.
-  // Since draw rect command contains its vertex information and it
-  // does not include a format of vertex buffer, we can choose any
-  // one that is suitable. We use VK_FORMAT_R32G32_SFLOAT for it.
-  TypeParser parser;
-  auto type = parser.Parse("R32G32_SFLOAT");
-  Format fmt(type.get());
+  HelperGeometryKey key;
+  key.x = ((command->GetX() / frame_width) * 2.0f) - 1.0f;
+  key.y = ((command->GetY() / frame_height) * 2.0f) - 1.0f;
+  key.width = (command->GetWidth() / frame_width) * 2.0f;
+  key.height = (command->GetHeight() / frame_height) * 2.0f;
+  key.columns = command->GetColumns();
+  key.rows = command->GetRows();
 
-  auto buf = MakeUnique<Buffer>();
-  buf->SetFormat(&fmt);
-  buf->SetData(std::move(values));
-
-  auto vertex_buffer = MakeUnique<VertexBuffer>(device_.get());
-  vertex_buffer->SetData(0, buf.get());
+  HelperGeometry* geometry = nullptr;
+  Result r = GetHelperGeometry(&info, key, &geometry);
+  if (!r.IsSuccess())
+    return r;
 
   DrawArraysCommand draw(command->GetPipeline(), PipelineData{});
   draw.SetTopology(Topology::kTriangleList);
+  draw.EnableIndexed();
   draw.SetFirstVertexIndex(0);
-  draw.SetVertexCount(vertices);
+  draw.SetVertexCount(geometry->index_count);
   draw.SetInstanceCount(1);
   draw.SetPolygonMode(command->GetPolygonMode());
 
-  Result r = graphics->Draw(&draw, vertex_buffer.get());
+  r = StartPipelineCommand(command->GetPipeline());
   if (!r.IsSuccess())
     return r;
 
+  r = graphics->Draw(&draw, geometry->vertex_buffer.get(),
+                     geometry->index_buffer.get());
+  return FinishPipelineCommand(graphics, r);
+}
+
+bool EngineVulkan::HelperGeometryKey::operator<(
+    const HelperGeometryKey& other) const {
+  return std::tie(x, y, width, height, columns, rows) <
+         std::tie(other.x, other.y, other.width, other.height, other.columns,
+                  other.rows);
+}
+
+void EngineVulkan::CreateHelperFormatsIfNeeded() {
+  if (vertex_format_)
+    return;
+
+  // |format| is not Format for frame buffer but for vertex buffer.
+  // Since draw rect and draw grid commands contain their vertex information
+  // and do not include a format of vertex buffer, we can choose any
+  // one that is suitable. We use VK_FORMAT_R32G32_SFLOAT for it.
+  TypeParser parser;
+  vertex_type_ = parser.Parse("R32G32_SFLOAT");
+  vertex_format_ = MakeUnique<Format>(vertex_type_.get());
+  index_type_ = parser.Parse("R32_UINT");
+  index_format_ = MakeUnique<Format>(index_type_.get());
+}
+
+Result EngineVulkan::GetHelperGeometry(PipelineInfo* info,
+                                       const HelperGeometryKey& key,
+                                       HelperGeometry** geometry) {
+  auto it = info->helper_geometry.find(key);
+  if (it != info->helper_geometry.end()) {
+    *geometry = &it->second;
+    return {};
+  }
+
+  // Bound the memory kept for scripts drawing many different areas. The
+  // cached buffers may still be used by pending commands. Commands recorded
+  // for a replay can not be submitted early, so the cache grows until then.
+  if (info->helper_geometry.size() >= kMaxHelperGeometries &&
+      !repeat_pipeline_) {
+    Result r = SubmitPendingCommands();
+    if (!r.IsSuccess())
+      return r;
+    info->helper_geometry.clear();
+  }
+
+  CreateHelperFormatsIfNeeded();
+
+  HelperGeometry& entry = info->helper_geometry[key];
+  entry.vertex_data = MakeUnique<Buffer>();
+  entry.vertex_data->SetFormat(vertex_format_.get());
+
+  if (key.columns == 0) {
+    std::vector<Value> values(8);
+    // Bottom left
+    values[0].SetDoubleValue(static_cast<double>(key.x));
+    values[1].SetDoubleValue(static_cast<double>(key.y + key.height));
+    // Top left
+    values[2].SetDoubleValue(static_cast<double>(key.x));
+    values[3].SetDoubleValue(static_cast<double>(key.y));
+    // Bottom right
+    values[4].SetDoubleValue(static_cast<double>(key.x + key.width));
+    values[5].SetDoubleValue(static_cast<double>(key.y + key.height));
+    // Top right
+    values[6].SetDoubleValue(static_cast<double>(key.x + key.width));
+    values[7].SetDoubleValue(static_cast<double>(key.y));
+    entry.vertex_data->SetData(std::move(values));
+  } else {
+    // The cells share their corners, (columns + 1) * (rows + 1) vertices are
+    // indexed by the two triangles of each cell.
+    const uint32_t stride = key.columns + 1;
+    const float cell_width = key.width / static_cast<float>(key.columns);
+    const float cell_height = key.height / static_cast<float>(key.rows);
+
+    std::vector<Value> values(stride * (key.rows + 1) * 2);
+    for (uint32_t i = 0, c = 0; i <= key.rows; i++) {
+      for (uint32_t j = 0; j <= key.columns; j++, c += 2) {
+        values[c].SetDoubleValue(
+            static_cast<double>(key.x + cell_width * static_cast<float>(j)));
+        values[c + 1].SetDoubleValue(
+            static_cast<double>(key.y + cell_height * static_cast<float>(i)));
+      }
+    }
+    entry.vertex_data->SetData(std::move(values));
+
+    entry.index_count =
+        key.columns * key.rows * kVerticesPerTriangle * kTrianglesPerCell;
+    std::vector<Value> indices(entry.index_count);
+    for (uint32_t i = 0, c = 0; i < key.rows; i++) {
+      for (uint32_t j = 0; j < key.columns; j++, c += 6) {
+        const uint32_t top_left = i * stride + j;
+        const uint32_t top_right = top_left + 1;
+        const uint32_t bottom_left = top_left + stride;
+        const uint32_t bottom_right = bottom_left + 1;
+
+        indices[c + 0].SetIntValue(bottom_right);
+        indices[c + 1].SetIntValue(bottom_left);
+        indices[c + 2].SetIntValue(top_left);
+        indices[c + 3].SetIntValue(bottom_right);
+        indices[c + 4].SetIntValue(top_left);
+        indices[c + 5].SetIntValue(top_right);
+      }
+    }
+
+    entry.index_data = MakeUnique<Buffer>();
+    entry.index_data->SetFormat(index_format_.get());
+    entry.index_data->SetData(std::move(indices));
+
+    entry.index_buffer = MakeUnique<IndexBuffer>(device_.get());
+    entry.index_buffer->SetDeviceLocal(
+        info->vk_pipeline->UseDeviceLocalMemory(nullptr));
+    entry.index_buffer->SetData(entry.index_data.get());
+  }
+
+  entry.vertex_buffer = MakeUnique<VertexBuffer>(device_.get());
+  entry.vertex_buffer->SetDeviceLocal(
+      info->vk_pipeline->UseDeviceLocalMemory(nullptr));
+  entry.vertex_buffer->SetData(0, entry.vertex_data.get());
+
+  *geometry = &entry;
   return {};
 }
 
@@ -545,8 +791,13 @@ Result EngineVulkan::DoDrawArrays(const DrawArraysCommand* command) {
   if (!info.vk_pipeline)
     return Result("Vulkan::DrawArrays for Non-Graphics Pipeline");
 
-  return info.vk_pipeline->AsGraphics()->Draw(command,
-                                              info.vertex_buffer.get());
+  Result r = StartPipelineCommand(command->GetPipeline());
+  if (!r.IsSuccess())
+    return r;
+
+  r = info.vk_pipeline->AsGraphics()->Draw(command, info.vertex_buffer.get(),
+                                          nullptr);
+  return FinishPipelineCommand(info.vk_pipeline.get(), r);
 }
 
 Result EngineVulkan::DoCompute(const ComputeCommand* command) {
@@ -554,8 +805,13 @@ Result EngineVulkan::DoCompute(const ComputeCommand* command) {
   if (info.vk_pipeline->IsGraphics())
     return Result("Vulkan: Compute called for graphics pipeline.");
 
-  return info.vk_pipeline->AsCompute()->Compute(
-      command->GetX(), command->GetY(), command->GetZ());
+  Result r = StartPipelineCommand(command->GetPipeline());
+  if (!r.IsSuccess())
+    return r;
+
+  r = info.vk_pipeline->AsCompute()->Compute(command->GetX(), command->GetY(),
+                                             command->GetZ());
+  return FinishPipelineCommand(info.vk_pipeline.get(), r);
 }
 
 Result EngineVulkan::DoEntryPoint(const EntryPointCommand* command) {
@@ -563,8 +819,15 @@ Result EngineVulkan::DoEntryPoint(const EntryPointCommand* command) {
   if (!info.vk_pipeline)
     return Result("Vulkan::DoEntryPoint no Pipeline exists");
 
+  // Changing the entry point destroys VkPipelines the pending commands use,
+  // and the ones created ahead.
+  WaitForPrecompiledPipelines();
+  Result r = SubmitPendingCommands();
+  if (!r.IsSuccess())
+    return r;
+
   VkShaderStageFlagBits stage = VK_SHADER_STAGE_FLAG_BITS_MAX_ENUM;
-  Result r = ToVkShaderStage(command->GetShaderType(), &stage);
+  r = ToVkShaderStage(command->GetShaderType(), &stage);
   if (!r.IsSuccess())
     return r;
 
@@ -578,6 +841,7 @@ Result EngineVulkan::DoPatchParameterVertices(
   if (!info.vk_pipeline->IsGraphics())
     return Result("Vulkan::DoPatchParameterVertices for Non-Graphics Pipeline");
 
+  WaitForPrecompiledPipelines();
   info.vk_pipeline->AsGraphics()->SetPatchControlPoints(
       command->GetControlPointCount());
   return {};
@@ -589,9 +853,175 @@ Result EngineVulkan::DoBuffer(const BufferCommand* cmd) {
         "Vulkan::DoBuffer exceed maxBoundDescriptorSets limit of physical "
         "device");
   }
+  // New descriptors and push constants change the layout VkPipelines are
+  // created with.
+  WaitForPrecompiledPipelines();
+  // The buffer contents must not change under pending commands. Unless the
+  // written values fit the buffer and only buffer descriptors hold its
+  // contents, which upload just the written ranges, the latest contents must
+  // be on the host before they are modified.
+  Result r = IsInPlaceBufferUpdate(cmd) ? SubmitPendingCommands()
+                                        : ReadbackBuffer(cmd->GetBuffer());
+  if (!r.IsSuccess())
+    return r;
+
   auto& info = pipeline_map_[cmd->GetPipeline()];
   return info.vk_pipeline->AddBufferDescriptor(cmd);
 }
 
+bool EngineVulkan::IsInPlaceBufferUpdate(const BufferCommand* cmd) const {
+  const Buffer* buffer = cmd->GetBuffer();
+  const Format* fmt = buffer->GetFormat();
+  if (cmd->GetValues().empty() || !fmt || fmt->SizeInBytes() == 0 ||
+      (!cmd->IsSSBO() && !cmd->IsUniform())) {
+    return false;
+  }
+
+  // Matches how Buffer::SetDataWithOffset() decides to grow the buffer.
+  const size_t value_count =
+      cmd->GetOffset() / fmt->SizeInBytes() * fmt->InputNeededPerElement() +
+      cmd->GetValues().size();
+  if (value_count > buffer->ValueCount())
+    return false;
+
+  for (const auto& it : pipeline_map_) {
+    if (it.second.vk_pipeline &&
+        !it.second.vk_pipeline->CanUpdateBufferInPlace(buffer)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+Result EngineVulkan::SubmitPendingCommands() {
+  if (!pending_pipeline_)
+    return {};
+
+  Result r = pending_pipeline_->SubmitPendingCommands();
+  pending_pipeline_ = nullptr;
+  return r;
+}
+
+Result EngineVulkan::ReadbackBuffer(Buffer* buffer) {
+  Result r = SubmitPendingCommands();
+  if (!r.IsSuccess())
+    return r;
+
+  if (gpu_timer_)
+    gpu_timer_->SetLine(GetCurrentLine());
+
+  for (auto& it : pipeline_map_) {
+    if (!it.second.vk_pipeline)
+      continue;
+
+    r = it.second.vk_pipeline->ReadbackBuffer(buffer);
+    if (!r.IsSuccess())
+      return r;
+  }
+  return {};
+}
+
+bool EngineVulkan::BeginRepeat(amber::Pipeline* pipeline) {
+  assert(!repeat_pipeline_);
+
+  // Timings and statistics are reported per recorded command, replaying the
+  // commands would report them only once.
+  auto it = pipeline_map_.find(pipeline);
+  if (it == pipeline_map_.end() || !it->second.vk_pipeline || gpu_timer_ ||
+      it->second.vk_pipeline->GetStatisticsQueries() || pending_pipeline_) {
+    return false;
+  }
+
+  repeat_pipeline_ = it->second.vk_pipeline.get();
+  repeat_pipeline_->StartReplayRecording();
+  return true;
+}
+
+Result EngineVulkan::EndRepeat(uint32_t count) {
+  assert(repeat_pipeline_);
+
+  Result r = repeat_pipeline_->ReplayPendingCommands(count);
+  repeat_pipeline_ = nullptr;
+  pending_pipeline_ = nullptr;
+  return r;
+}
+
+Result EngineVulkan::GetPipelineStatistics(amber::Pipeline* pipeline,
+                                           CommandStatistics* statistics) {
+  Result r = SubmitPendingCommands();
+  if (!r.IsSuccess())
+    return r;
+
+  auto it = pipeline_map_.find(pipeline);
+  if (it == pipeline_map_.end() || !it->second.vk_pipeline)
+    return Result("Vulkan: unknown pipeline for pipeline statistics");
+
+  auto* queries = it->second.vk_pipeline->GetStatisticsQueries();
+  if (!queries) {
+    return Result("Vulkan: pipeline statistics are not collected for " +
+                  pipeline->GetName());
+  }
+  if (!queries->HasStatistics()) {
+    return Result("Vulkan: no draw or dispatch was executed on " +
+                  pipeline->GetName() + " yet");
+  }
+
+  *statistics = queries->GetLastStatistics();
+  return {};
+}
+
+Result EngineVulkan::StartPipelineCommand(amber::Pipeline* pipeline) {
+  Pipeline* vk_pipeline = pipeline_map_[pipeline].vk_pipeline.get();
+  if (repeat_pipeline_ && repeat_pipeline_ != vk_pipeline)
+    return Result("Vulkan::Repeated commands must use a single pipeline");
+  if (pending_pipeline_ && pending_pipeline_ != vk_pipeline) {
+    Result r = SubmitPendingCommands();
+    if (!r.IsSuccess())
+      return r;
+  }
+
+  if (gpu_timer_)
+    gpu_timer_->SetLine(GetCurrentLine());
+  if (vk_pipeline->GetStatisticsQueries())
+    vk_pipeline->GetStatisticsQueries()->SetLine(GetCurrentLine());
+
+  if (pipeline_map_.size() == 1)
+    return {};
+
+  // |pipeline| uploads its buffers from the host, so results other pipelines
+  // left on the device must be read back first.
+  const auto buffers = GetPipelineBuffers(pipeline);
+  for (auto& it : pipeline_map_) {
+    if (it.first == pipeline || !it.second.vk_pipeline)
+      continue;
+
+    for (auto* buffer : buffers) {
+      Result r = it.second.vk_pipeline->ReadbackBuffer(buffer);
+      if (!r.IsSuccess())
+        return r;
+    }
+  }
+  return {};
+}
+
+Result EngineVulkan::FinishPipelineCommand(Pipeline* pipeline,
+                                           const Result& result) {
+  // Repeated commands are submitted together by EndRepeat(). Otherwise the
+  // commands are submitted without waiting, the host only waits for them
+  // where it needs their results, in SubmitPendingCommands().
+  Result r = result;
+  if (!GetEngineData().batch_commands && !repeat_pipeline_) {
+    Result flush = pipeline->FlushPendingCommands();
+    if (r.IsSuccess())
+      r = flush;
+  }
+
+  pending_pipeline_ =
+      pipeline->HasPendingCommands() || pipeline->HasCommandsInFlight()
+          ? pipeline
+          : nullptr;
+  return r;
+}
+
 }  // namespace vulkan
 }  // namespace amber
@@ -15,9 +15,12 @@
 #ifndef SRC_VULKAN_ENGINE_VULKAN_H_
 #define SRC_VULKAN_ENGINE_VULKAN_H_
 
+#include <atomic>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -25,10 +28,13 @@
 #include "amber/vulkan_header.h"
 #include "src/cast_hash.h"
 #include "src/engine.h"
+#include "src/format.h"
 #include "src/pipeline.h"
 #include "src/vulkan/buffer_descriptor.h"
 #include "src/vulkan/command_pool.h"
 #include "src/vulkan/device.h"
+#include "src/vulkan/gpu_timer.h"
+#include "src/vulkan/index_buffer.h"
 #include "src/vulkan/pipeline.h"
 #include "src/vulkan/vertex_buffer.h"
 
@@ -49,7 +55,10 @@ class EngineVulkan : public Engine {
                     const std::vector<std::string>& features,
                     const std::vector<std::string>& instance_extensions,
                     const std::vector<std::string>& device_extensions) override;
+  Result Reset() override;
   Result CreatePipeline(amber::Pipeline* type) override;
+  Result PrecompilePipelines(const std::vector<Command*>& commands,
+                             uint32_t thread_count) override;
 
   Result DoClearColor(const ClearColorCommand* cmd) override;
   Result DoClearStencil(const ClearStencilCommand* cmd) override;
@@ -63,13 +72,44 @@ class EngineVulkan : public Engine {
   Result DoPatchParameterVertices(
       const PatchParameterVerticesCommand* cmd) override;
   Result DoBuffer(const BufferCommand* cmd) override;
+  Result SubmitPendingCommands() override;
+  Result ReadbackBuffer(Buffer* buffer) override;
+  bool BeginRepeat(amber::Pipeline* pipeline) override;
+  Result EndRepeat(uint32_t count) override;
+  Result GetPipelineStatistics(amber::Pipeline* pipeline,
+                               CommandStatistics* statistics) override;
 
   std::pair<Debugger*, Result> GetDebugger() override;
 
  private:
+  /// The area covered by a DRAW_RECT or DRAW_GRID, in normalized device
+  /// coordinates. |columns| and |rows| are 0 for a DRAW_RECT.
+  struct HelperGeometryKey {
+    float x = 0.f;
+    float y = 0.f;
+    float width = 0.f;
+    float height = 0.f;
+    uint32_t columns = 0;
+    uint32_t rows = 0;
+
+    bool operator<(const HelperGeometryKey& other) const;
+  };
+
+  /// The vertices of a DRAW_RECT or DRAW_GRID, and for a grid the indices of
+  /// its triangles. The data is uploaded by the first draw and reused by the
+  /// following ones. If the commands recording the upload are discarded, the
+  /// next draw uploads it again.
+  struct HelperGeometry {
+    std::unique_ptr<Buffer> vertex_data;
+    std::unique_ptr<VertexBuffer> vertex_buffer;
+    std::unique_ptr<Buffer> index_data;
+    std::unique_ptr<IndexBuffer> index_buffer;
+    uint32_t index_count = 0;
+  };
+
   struct PipelineInfo {
-    std::unique_ptr<Pipeline> vk_pipeline;
     std::unique_ptr<VertexBuffer> vertex_buffer;
+    std::map<HelperGeometryKey, HelperGeometry> helper_geometry;
     struct ShaderInfo {
       VkShaderModule shader;
       std::unique_ptr<std::vector<VkSpecializationMapEntry>>
@@ -79,8 +119,28 @@ class EngineVulkan : public Engine {
     };
     std::unordered_map<ShaderType, ShaderInfo, CastHash<ShaderType>>
         shader_info;
+    // Declared last so it is destroyed first, discarding its pending
+    // commands touches the vertex and index buffers above.
+    std::unique_ptr<Pipeline> vk_pipeline;
   };
 
+  /// Returns in |job| the creation of the VkPipeline |command| draws or
+  /// dispatches with. |job| is left empty for commands drawing nothing.
+  Result PreparePipelineJob(Command* command, std::function<Result()>* job);
+  /// Waits for the threads creating VkPipelines ahead of their commands.
+  /// Must be called before anything the VkPipelines are created from
+  /// changes or is destroyed.
+  void WaitForPrecompiledPipelines();
+  /// Creates the formats of the helper geometry if they do not exist yet.
+  void CreateHelperFormatsIfNeeded();
+
+  /// Writes the pipeline cache back into the pipeline cache data if any
+  /// pipelines were built.
+  void StorePipelineCacheData();
+  void DestroyShaderModules();
+  /// Creates the GPU timer if GPU time is measured and no timer exists yet.
+  Result CreateGpuTimerIfNeeded();
+
   Result GetVkShaderStageInfo(
       amber::Pipeline* pipeline,
       std::vector<VkPipelineShaderStageCreateInfo>* out);
@@ -89,12 +149,51 @@ class EngineVulkan : public Engine {
                    ShaderType type,
                    const std::vector<uint32_t>& data);
 
+  /// Prepares recording a draw, dispatch or clear on |pipeline|. Commands
+  /// pending on any other pipeline are submitted first, and the buffers used
+  /// by |pipeline| are read back from the other pipelines, as the new command
+  /// may read what they wrote.
+  Result StartPipelineCommand(amber::Pipeline* pipeline);
+  /// Tracks the commands left pending on |pipeline| by a command which
+  /// finished with |result|, and submits them without waiting unless
+  /// commands are batched.
+  Result FinishPipelineCommand(Pipeline* pipeline, const Result& result);
+  /// Returns the geometry for |key| drawn with |info|, creating it if it is
+  /// not cached yet.
+  Result GetHelperGeometry(PipelineInfo* info,
+                           const HelperGeometryKey& key,
+                           HelperGeometry** geometry);
+  /// Returns true if |cmd| writes values into its buffer which can be
+  /// uploaded on top of the contents the device holds, without reading the
+  /// buffer back first.
+  bool IsInPlaceBufferUpdate(const BufferCommand* cmd) const;
+
   std::unique_ptr<Device> device_;
   std::unique_ptr<CommandPool> pool_;
+  // Measures the GPU time of commands if requested. Declared before
+  // |pipeline_map_| as the pipelines use it until they are destroyed.
+  std::unique_ptr<GpuTimer> gpu_timer_;
+  // Formats of the vertices and indices of the helper geometry, created with
+  // the first one. Declared before |pipeline_map_| as the cached geometry
+  // refers to them.
+  std::unique_ptr<type::Type> vertex_type_;
+  std::unique_ptr<Format> vertex_format_;
+  std::unique_ptr<type::Type> index_type_;
+  std::unique_ptr<Format> index_format_;
 
   std::map<amber::Pipeline*, PipelineInfo> pipeline_map_;
+  Pipeline* pending_pipeline_ = nullptr;
+  // The pipeline recording commands for replay between BeginRepeat() and
+  // EndRepeat(), nullptr otherwise.
+  Pipeline* repeat_pipeline_ = nullptr;
 
   std::unique_ptr<Debugger> debugger_;
+
+  // The VkPipeline creations started by PrecompilePipelines(), the next one
+  // to run and the threads running them.
+  std::vector<std::function<Result()>> precompile_jobs_;
+  std::atomic<size_t> next_precompile_job_{0};
+  std::vector<std::thread> precompile_workers_;
 };
 
 }  // namespace vulkan
@@ -0,0 +1,146 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/vulkan/gpu_timer.h"
+
+#include "src/vulkan/command_buffer.h"
+#include "src/vulkan/device.h"
+
+namespace amber {
+namespace vulkan {
+namespace {
+
+// Each command uses two queries, so a pair never spans two pools.
+const uint32_t kQueriesPerPool = 256;
+
+}  // namespace
+
+GpuTimer::GpuTimer(Device* device, std::vector<CommandTiming>* timings)
+    : device_(device), timings_(timings) {}
+
+GpuTimer::~GpuTimer() {
+  for (auto pool : query_pools_) {
+    device_->GetPtrs()->vkDestroyQueryPool(device_->GetVkDevice(), pool,
+                                           nullptr);
+  }
+}
+
+Result GpuTimer::Initialize() {
+  const uint32_t valid_bits = device_->GetTimestampValidBits();
+  if (valid_bits == 0)
+    return Result("Vulkan: GPU timing requires a queue supporting timestamps");
+
+  timestamp_mask_ = valid_bits >= 64 ? ~0ULL : (1ULL << valid_bits) - 1ULL;
+  timestamp_period_ = static_cast<double>(device_->GetTimestampPeriod());
+  return {};
+}
+
+Result GpuTimer::GetQueryPool(uint32_t index,
+                              VkQueryPool* pool,
+                              uint32_t* pool_index) {
+  const size_t pool_count = index / kQueriesPerPool + 1;
+  while (query_pools_.size() < pool_count) {
+    VkQueryPoolCreateInfo info = VkQueryPoolCreateInfo();
+    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    info.queryCount = kQueriesPerPool;
+
+    VkQueryPool new_pool = VK_NULL_HANDLE;
+    if (device_->GetPtrs()->vkCreateQueryPool(device_->GetVkDevice(), &info,
+                                              nullptr,
+                                              &new_pool) != VK_SUCCESS) {
+      return Result("Vulkan::Calling vkCreateQueryPool Fail");
+    }
+    query_pools_.push_back(new_pool);
+  }
+
+  *pool = query_pools_[index / kQueriesPerPool];
+  *pool_index = index % kQueriesPerPool;
+  return {};
+}
+
+Result GpuTimer::Start(CommandBuffer* command) {
+  if (started_)
+    return {};
+
+  VkQueryPool pool = VK_NULL_HANDLE;
+  uint32_t pool_index = 0;
+  Result r = GetQueryPool(next_query_, &pool, &pool_index);
+  if (!r.IsSuccess())
+    return r;
+
+  device_->GetPtrs()->vkCmdResetQueryPool(command->GetVkCommandBuffer(), pool,
+                                          pool_index, 2);
+  device_->GetPtrs()->vkCmdWriteTimestamp(command->GetVkCommandBuffer(),
+                                          VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                                          pool, pool_index);
+  started_ = true;
+  return {};
+}
+
+void GpuTimer::Stop(CommandBuffer* command, const char* type) {
+  if (!started_)
+    return;
+
+  // The pool was created by Start().
+  VkQueryPool pool = query_pools_[next_query_ / kQueriesPerPool];
+  device_->GetPtrs()->vkCmdWriteTimestamp(
+      command->GetVkCommandBuffer(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+      pool, next_query_ % kQueriesPerPool + 1);
+
+  Query query;
+  query.index = next_query_;
+  query.line = line_;
+  query.type = type;
+  queries_.push_back(query);
+
+  next_query_ += 2;
+  started_ = false;
+}
+
+Result GpuTimer::Resolve() {
+  Result result;
+  for (const auto& query : queries_) {
+    uint64_t timestamps[2] = {0, 0};
+    if (device_->GetPtrs()->vkGetQueryPoolResults(
+            device_->GetVkDevice(), query_pools_[query.index / kQueriesPerPool],
+            query.index % kQueriesPerPool, 2, sizeof(timestamps), timestamps,
+            sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+      result = Result("Vulkan::Calling vkGetQueryPoolResults Fail");
+      break;
+    }
+
+    const uint64_t ticks = (timestamps[1] - timestamps[0]) & timestamp_mask_;
+    CommandTiming timing;
+    timing.line = query.line;
+    timing.type = query.type;
+    timing.gpu_time_ns = static_cast<double>(ticks) * timestamp_period_;
+    timings_->push_back(timing);
+  }
+
+  // The queries are reset before they are written again, so all of them can
+  // be re-used.
+  Discard();
+  return result;
+}
+
+void GpuTimer::Discard() {
+  queries_.clear();
+  next_query_ = 0;
+  started_ = false;
+}
+
+}  // namespace vulkan
+}  // namespace amber
@@ -0,0 +1,93 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_VULKAN_GPU_TIMER_H_
+#define SRC_VULKAN_GPU_TIMER_H_
+
+#include <string>
+#include <vector>
+
+#include "amber/amber.h"
+#include "amber/result.h"
+#include "amber/vulkan_header.h"
+
+namespace amber {
+namespace vulkan {
+
+class CommandBuffer;
+class Device;
+
+/// Measures the GPU execution time of recorded commands by writing a
+/// timestamp query before and after each of them. The queries of all
+/// commands recorded since the last Resolve() must belong to the same
+/// command buffer, which holds as commands are always submitted and waited
+/// for before another command buffer is recorded.
+class GpuTimer {
+ public:
+  /// Creates a timer appending its results to |timings|.
+  GpuTimer(Device* device, std::vector<CommandTiming>* timings);
+  ~GpuTimer();
+
+  /// Checks that the queue of the device supports timestamps.
+  Result Initialize();
+
+  /// Sets the script line the commands started from now on are attributed
+  /// to.
+  void SetLine(size_t line) { line_ = line; }
+
+  /// Records the start timestamp of a command into |command|. Does nothing
+  /// if a command is already being timed, so a command made of several
+  /// recording steps is measured as a whole. Must not be called inside a
+  /// render pass.
+  Result Start(CommandBuffer* command);
+  /// Records the end timestamp of the command being timed into |command|.
+  /// The command is reported as |type|.
+  void Stop(CommandBuffer* command, const char* type);
+
+  /// Appends the times of all stopped commands to the timings. The command
+  /// buffer they were recorded into must have completed.
+  Result Resolve();
+  /// Forgets all commands recorded since the last Resolve(), their command
+  /// buffer was dropped without being submitted.
+  void Discard();
+
+ private:
+  struct Query {
+    uint32_t index = 0;
+    size_t line = 0;
+    std::string type;
+  };
+
+  /// Returns the pool holding the query at |index| in |pool| and the index
+  /// of the query within the pool in |pool_index|. Pools are created as
+  /// needed.
+  Result GetQueryPool(uint32_t index,
+                      VkQueryPool* pool,
+                      uint32_t* pool_index);
+
+  Device* device_ = nullptr;
+  std::vector<CommandTiming>* timings_ = nullptr;
+  std::vector<VkQueryPool> query_pools_;
+  std::vector<Query> queries_;
+  uint32_t next_query_ = 0;
+  bool started_ = false;
+  size_t line_ = 0;
+  double timestamp_period_ = 1.0;
+  uint64_t timestamp_mask_ = 0;
+};
+
+}  // namespace vulkan
+}  // namespace amber
+
+#endif  // SRC_VULKAN_GPU_TIMER_H_
@@ -16,6 +16,7 @@
 
 #include <cassert>
 #include <cmath>
+#include <utility>
 
 #include "src/command.h"
 #include "src/make_unique.h"
@@ -344,6 +345,113 @@ VkBlendOp ToVkBlendOp(BlendOp op) {
   return VK_BLEND_OP_ADD;
 }
 
+// Returns the topology a pipeline with dynamic primitive topology is created
+// with to draw |topology|. The dynamic topology must be of the same class.
+VkPrimitiveTopology GetTopologyClass(VkPrimitiveTopology topology) {
+  switch (topology) {
+    case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+      return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+    case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+      return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+    case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+      return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+    default:
+      return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  }
+}
+
+// Resets the members of |data| set with dynamic state to their defaults, so
+// draws differing only in dynamic state share a pipeline.
+void ClearDynamicState(bool extended_dynamic_state2, PipelineData* data) {
+  const PipelineData defaults;
+
+  // Vulkan 1.0 dynamic state.
+  data->SetFrontCompareMask(defaults.GetFrontCompareMask());
+  data->SetFrontWriteMask(defaults.GetFrontWriteMask());
+  data->SetFrontReference(defaults.GetFrontReference());
+  data->SetBackCompareMask(defaults.GetBackCompareMask());
+  data->SetBackWriteMask(defaults.GetBackWriteMask());
+  data->SetBackReference(defaults.GetBackReference());
+  data->SetLineWidth(defaults.GetLineWidth());
+  data->SetDepthBiasConstantFactor(defaults.GetDepthBiasConstantFactor());
+  data->SetDepthBiasClamp(defaults.GetDepthBiasClamp());
+  data->SetDepthBiasSlopeFactor(defaults.GetDepthBiasSlopeFactor());
+  data->SetMinDepthBounds(defaults.GetMinDepthBounds());
+  data->SetMaxDepthBounds(defaults.GetMaxDepthBounds());
+
+  // VK_EXT_extended_dynamic_state.
+  data->SetCullMode(defaults.GetCullMode());
+  data->SetFrontFace(defaults.GetFrontFace());
+  data->SetEnableDepthTest(defaults.GetEnableDepthTest());
+  data->SetEnableDepthWrite(defaults.GetEnableDepthWrite());
+  data->SetDepthCompareOp(defaults.GetDepthCompareOp());
+  data->SetEnableDepthBoundsTest(defaults.GetEnableDepthBoundsTest());
+  data->SetEnableStencilTest(defaults.GetEnableStencilTest());
+  data->SetFrontFailOp(defaults.GetFrontFailOp());
+  data->SetFrontPassOp(defaults.GetFrontPassOp());
+  data->SetFrontDepthFailOp(defaults.GetFrontDepthFailOp());
+  data->SetFrontCompareOp(defaults.GetFrontCompareOp());
+  data->SetBackFailOp(defaults.GetBackFailOp());
+  data->SetBackPassOp(defaults.GetBackPassOp());
+  data->SetBackDepthFailOp(defaults.GetBackDepthFailOp());
+  data->SetBackCompareOp(defaults.GetBackCompareOp());
+
+  if (!extended_dynamic_state2)
+    return;
+
+  // VK_EXT_extended_dynamic_state2.
+  data->SetEnableDepthBias(defaults.GetEnableDepthBias());
+  data->SetEnablePrimitiveRestart(defaults.GetEnablePrimitiveRestart());
+  data->SetEnableRasterizerDiscard(defaults.GetEnableRasterizerDiscard());
+}
+
+// Adds the shader stage in |info| to |key|.
+void AddShaderStage(const VkPipelineShaderStageCreateInfo& info,
+                    PipelineLibraryCache::LibraryKey* key) {
+  key->modules.push_back(info.module);
+  key->entry_points.push_back(info.pName);
+  key->state.push_back(static_cast<uint32_t>(info.stage));
+
+  const VkSpecializationInfo* spec = info.pSpecializationInfo;
+  if (!spec) {
+    key->state.push_back(0);
+    return;
+  }
+  key->state.push_back(spec->mapEntryCount);
+  for (uint32_t i = 0; i < spec->mapEntryCount; ++i) {
+    key->state.push_back(spec->pMapEntries[i].constantID);
+    key->state.push_back(spec->pMapEntries[i].offset);
+    key->state.push_back(static_cast<uint32_t>(spec->pMapEntries[i].size));
+  }
+  const auto* data = static_cast<const uint8_t*>(spec->pData);
+  key->state.push_back(static_cast<uint32_t>(spec->dataSize));
+  key->state.insert(key->state.end(), data, data + spec->dataSize);
+}
+
+bool IsSameVertexBinding(const VkVertexInputBindingDescription& a,
+                         const VkVertexInputBindingDescription& b) {
+  return a.binding == b.binding && a.stride == b.stride &&
+         a.inputRate == b.inputRate;
+}
+
+bool IsSameVertexAttributes(
+    const std::vector<VkVertexInputAttributeDescription>& a,
+    const std::vector<VkVertexInputAttributeDescription>& b) {
+  if (a.size() != b.size())
+    return false;
+
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (a[i].location != b[i].location || a[i].binding != b[i].binding ||
+        a[i].format != b[i].format || a[i].offset != b[i].offset) {
+      return false;
+    }
+  }
+  return true;
+}
+
 class RenderPassGuard {
  public:
   explicit RenderPassGuard(GraphicsPipeline* pipeline) : pipeline_(pipeline) {
@@ -393,7 +501,19 @@ GraphicsPipeline::GraphicsPipeline(
     color_buffers_.push_back(&info);
 }
 
+bool GraphicsPipeline::PipelineKey::operator==(
+    const PipelineKey& other) const {
+  return topology == other.topology &&
+         patch_control_points == other.patch_control_points &&
+         IsSameVertexBinding(vertex_binding, other.vertex_binding) &&
+         IsSameVertexAttributes(vertex_attributes, other.vertex_attributes) &&
+         pipeline_data == other.pipeline_data;
+}
+
 GraphicsPipeline::~GraphicsPipeline() {
+  DiscardPendingCommands();
+  DestroyCachedVkPipelines();
+
   if (render_pass_) {
     device_->GetPtrs()->vkDestroyRenderPass(device_->GetVkDevice(),
                                             render_pass_, nullptr);
@@ -530,49 +650,29 @@ GraphicsPipeline::GetVkPipelineColorBlendAttachmentState(
 }
 
 Result GraphicsPipeline::CreateVkGraphicsPipeline(
-    const PipelineData* pipeline_data,
-    VkPrimitiveTopology topology,
-    const VertexBuffer* vertex_buffer,
-    const VkPipelineLayout& pipeline_layout,
+    const PipelineKey& key,
+    VkPipelineLayout pipeline_layout,
     VkPipeline* pipeline) {
-  if (!pipeline_data) {
-    return Result(
-        "Vulkan: GraphicsPipeline::CreateVkGraphicsPipeline PipelineData is "
-        "null");
-  }
+  const PipelineData* pipeline_data = &key.pipeline_data;
 
+  // Draws without a vertex buffer use the default, empty binding of the key.
   VkPipelineVertexInputStateCreateInfo vertex_input_info =
       VkPipelineVertexInputStateCreateInfo();
   vertex_input_info.sType =
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
   vertex_input_info.vertexBindingDescriptionCount = 1;
-
-  VkVertexInputBindingDescription vertex_binding_desc =
-      VkVertexInputBindingDescription();
-  if (vertex_buffer != nullptr) {
-    vertex_binding_desc = vertex_buffer->GetVkVertexInputBinding();
-    const auto& vertex_attr_desc = vertex_buffer->GetVkVertexInputAttr();
-
-    vertex_input_info.pVertexBindingDescriptions = &vertex_binding_desc;
-    vertex_input_info.vertexAttributeDescriptionCount =
-        static_cast<uint32_t>(vertex_attr_desc.size());
-    vertex_input_info.pVertexAttributeDescriptions = vertex_attr_desc.data();
-  } else {
-    vertex_binding_desc.binding = 0;
-    vertex_binding_desc.stride = 0;
-    vertex_binding_desc.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-
-    vertex_input_info.pVertexBindingDescriptions = &vertex_binding_desc;
-    vertex_input_info.vertexAttributeDescriptionCount = 0;
-    vertex_input_info.pVertexAttributeDescriptions = nullptr;
-  }
+  vertex_input_info.pVertexBindingDescriptions = &key.vertex_binding;
+  vertex_input_info.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(key.vertex_attributes.size());
+  vertex_input_info.pVertexAttributeDescriptions =
+      key.vertex_attributes.empty() ? nullptr : key.vertex_attributes.data();
 
   VkPipelineInputAssemblyStateCreateInfo input_assembly_info =
       VkPipelineInputAssemblyStateCreateInfo();
   input_assembly_info.sType =
       VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
   // TODO(jaebaek): Handle the given index if exists.
-  input_assembly_info.topology = topology;
+  input_assembly_info.topology = key.topology;
   input_assembly_info.primitiveRestartEnable =
       pipeline_data->GetEnablePrimitiveRestart();
 
@@ -645,7 +745,7 @@ Result GraphicsPipeline::CreateVkGraphicsPipeline(
       VkPipelineTessellationStateCreateInfo();
   if (is_tessellation_needed) {
     tess_info.sType = VK_STRUCTURE_TYPE_PIPELINE_TESSELLATION_STATE_CREATE_INFO;
-    tess_info.patchControlPoints = patch_control_points_;
+    tess_info.patchControlPoints = key.patch_control_points;
     pipeline_info.pTessellationState = &tess_info;
   }
 
@@ -670,16 +770,305 @@ Result GraphicsPipeline::CreateVkGraphicsPipeline(
   colorblend_info.pAttachments = colorblend_attachment.data();
   pipeline_info.pColorBlendState = &colorblend_info;
 
+  std::vector<VkDynamicState> dynamic_states;
+  if (device_->SupportsExtendedDynamicState()) {
+    dynamic_states = {
+        VK_DYNAMIC_STATE_LINE_WIDTH,
+        VK_DYNAMIC_STATE_DEPTH_BIAS,
+        VK_DYNAMIC_STATE_DEPTH_BOUNDS,
+        VK_DYNAMIC_STATE_STENCIL_COMPARE_MASK,
+        VK_DYNAMIC_STATE_STENCIL_WRITE_MASK,
+        VK_DYNAMIC_STATE_STENCIL_REFERENCE,
+        VK_DYNAMIC_STATE_CULL_MODE_EXT,
+        VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+        VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT,
+        VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+        VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+        VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT,
+        VK_DYNAMIC_STATE_DEPTH_BOUNDS_TEST_ENABLE_EXT,
+        VK_DYNAMIC_STATE_STENCIL_TEST_ENABLE_EXT,
+        VK_DYNAMIC_STATE_STENCIL_OP_EXT,
+    };
+  }
+  if (device_->SupportsExtendedDynamicState2()) {
+    dynamic_states.push_back(VK_DYNAMIC_STATE_DEPTH_BIAS_ENABLE_EXT);
+    dynamic_states.push_back(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT);
+    dynamic_states.push_back(VK_DYNAMIC_STATE_RASTERIZER_DISCARD_ENABLE_EXT);
+  }
+
+  VkPipelineDynamicStateCreateInfo dynamic_info =
+      VkPipelineDynamicStateCreateInfo();
+  if (!dynamic_states.empty()) {
+    dynamic_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamic_info.dynamicStateCount =
+        static_cast<uint32_t>(dynamic_states.size());
+    dynamic_info.pDynamicStates = dynamic_states.data();
+    pipeline_info.pDynamicState = &dynamic_info;
+  }
+
   pipeline_info.layout = pipeline_layout;
   pipeline_info.renderPass = render_pass_;
   pipeline_info.subpass = 0;
 
-  if (device_->GetPtrs()->vkCreateGraphicsPipelines(
-          device_->GetVkDevice(), VK_NULL_HANDLE, 1, &pipeline_info, nullptr,
-          pipeline) != VK_SUCCESS) {
-    return Result("Vulkan::Calling vkCreateGraphicsPipelines Fail");
+  // Fragment libraries can not be linked into a pipeline which statically
+  // discards all primitives.
+  if (device_->SupportsGraphicsPipelineLibrary() &&
+      (!pipeline_data->GetEnableRasterizerDiscard() ||
+       device_->SupportsExtendedDynamicState2())) {
+    return LinkVkGraphicsPipeline(pipeline_info, pipeline_data, pipeline);
+  }
+  return device_->GetPipelineLibraryCache()->CompilePipeline(pipeline_info,
+                                                             pipeline);
+}
+
+Result GraphicsPipeline::LinkVkGraphicsPipeline(
+    const VkGraphicsPipelineCreateInfo& pipeline_info,
+    const PipelineData* pipeline_data,
+    VkPipeline* pipeline) {
+  auto* cache = device_->GetPipelineLibraryCache();
+
+  PipelineLibraryCache::LayoutDesc layout;
+  GetPipelineLayoutDesc(&layout);
+
+  // Libraries are created with a render pass of the cache with the same
+  // formats, which is compatible with the render pass they are linked with.
+  PipelineLibraryCache::RenderPassDesc render_pass;
+  for (const auto* info : color_buffers_) {
+    render_pass.color_formats.push_back(
+        device_->GetVkFormat(*info->buffer->GetFormat()));
+  }
+  if (depth_stencil_format_ && depth_stencil_format_->IsFormatKnown()) {
+    render_pass.depth_stencil_format =
+        device_->GetVkFormat(*depth_stencil_format_);
+  }
+
+  std::vector<VkPipeline> libraries;
+  VkPipeline library = VK_NULL_HANDLE;
+
+  // Vertex input interface.
+  {
+    const auto* vertex_input = pipeline_info.pVertexInputState;
+    PipelineLibraryCache::LibraryKey key;
+    key.part = VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT;
+    for (uint32_t i = 0; i < vertex_input->vertexBindingDescriptionCount;
+         ++i) {
+      const auto& binding = vertex_input->pVertexBindingDescriptions[i];
+      key.state.push_back(binding.binding);
+      key.state.push_back(binding.stride);
+      key.state.push_back(static_cast<uint32_t>(binding.inputRate));
+    }
+    for (uint32_t i = 0; i < vertex_input->vertexAttributeDescriptionCount;
+         ++i) {
+      const auto& attr = vertex_input->pVertexAttributeDescriptions[i];
+      key.state.push_back(attr.location);
+      key.state.push_back(attr.binding);
+      key.state.push_back(static_cast<uint32_t>(attr.format));
+      key.state.push_back(attr.offset);
+    }
+    key.state.push_back(
+        static_cast<uint32_t>(pipeline_info.pInputAssemblyState->topology));
+    key.state.push_back(
+        pipeline_info.pInputAssemblyState->primitiveRestartEnable);
+
+    VkGraphicsPipelineCreateInfo info = VkGraphicsPipelineCreateInfo();
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.pVertexInputState = pipeline_info.pVertexInputState;
+    info.pInputAssemblyState = pipeline_info.pInputAssemblyState;
+    info.pDynamicState = pipeline_info.pDynamicState;
+
+    Result r = cache->GetLibrary(key, info, &library);
+    if (!r.IsSuccess())
+      return r;
+    libraries.push_back(library);
+  }
+
+  // Pre-rasterization shaders.
+  {
+    PipelineLibraryCache::LibraryKey key;
+    key.part = VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT;
+    key.layout = layout;
+    key.render_pass = render_pass;
+    key.pipeline_data = *pipeline_data;
+    key.state.push_back(frame_width_);
+    key.state.push_back(frame_height_);
+    if (pipeline_info.pTessellationState) {
+      key.state.push_back(
+          pipeline_info.pTessellationState->patchControlPoints);
+    }
+
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    for (uint32_t i = 0; i < pipeline_info.stageCount; ++i) {
+      if (pipeline_info.pStages[i].stage == VK_SHADER_STAGE_FRAGMENT_BIT)
+        continue;
+      stages.push_back(pipeline_info.pStages[i]);
+      AddShaderStage(stages.back(), &key);
+    }
+
+    VkGraphicsPipelineCreateInfo info = VkGraphicsPipelineCreateInfo();
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.stageCount = static_cast<uint32_t>(stages.size());
+    info.pStages = stages.data();
+    info.pViewportState = pipeline_info.pViewportState;
+    info.pRasterizationState = pipeline_info.pRasterizationState;
+    info.pTessellationState = pipeline_info.pTessellationState;
+    info.pDynamicState = pipeline_info.pDynamicState;
+
+    Result r = cache->GetLibrary(key, info, &library);
+    if (!r.IsSuccess())
+      return r;
+    libraries.push_back(library);
+  }
+
+  // Fragment shader.
+  {
+    PipelineLibraryCache::LibraryKey key;
+    key.part = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+    key.layout = layout;
+    key.render_pass = render_pass;
+    key.pipeline_data = *pipeline_data;
+
+    std::vector<VkPipelineShaderStageCreateInfo> stages;
+    for (uint32_t i = 0; i < pipeline_info.stageCount; ++i) {
+      if (pipeline_info.pStages[i].stage != VK_SHADER_STAGE_FRAGMENT_BIT)
+        continue;
+      stages.push_back(pipeline_info.pStages[i]);
+      AddShaderStage(stages.back(), &key);
+    }
+
+    VkGraphicsPipelineCreateInfo info = VkGraphicsPipelineCreateInfo();
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.stageCount = static_cast<uint32_t>(stages.size());
+    info.pStages = stages.data();
+    info.pMultisampleState = pipeline_info.pMultisampleState;
+    info.pDepthStencilState = pipeline_info.pDepthStencilState;
+    info.pDynamicState = pipeline_info.pDynamicState;
+
+    Result r = cache->GetLibrary(key, info, &library);
+    if (!r.IsSuccess())
+      return r;
+    libraries.push_back(library);
+  }
+
+  // Fragment output interface.
+  {
+    PipelineLibraryCache::LibraryKey key;
+    key.part = VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT;
+    key.render_pass = render_pass;
+    key.pipeline_data = *pipeline_data;
+
+    VkGraphicsPipelineCreateInfo info = VkGraphicsPipelineCreateInfo();
+    info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    info.pMultisampleState = pipeline_info.pMultisampleState;
+    info.pColorBlendState = pipeline_info.pColorBlendState;
+    info.pDynamicState = pipeline_info.pDynamicState;
+
+    Result r = cache->GetLibrary(key, info, &library);
+    if (!r.IsSuccess())
+      return r;
+    libraries.push_back(library);
+  }
+
+  return cache->LinkPipeline(libraries, pipeline_info.layout, render_pass_,
+                             pipeline);
+}
+
+void GraphicsPipeline::DestroyCachedVkPipelines() {
+  std::lock_guard<std::mutex> lock(vk_pipeline_mutex_);
+  for (auto& cached : pipeline_cache_) {
+    device_->GetPtrs()->vkDestroyPipeline(device_->GetVkDevice(),
+                                          cached.pipeline, nullptr);
+  }
+  pipeline_cache_.clear();
+}
+
+Result GraphicsPipeline::MakePipelineKey(const PipelineData* pipeline_data,
+                                         VkPrimitiveTopology topology,
+                                         const VertexBuffer* vertex_buffer,
+                                         PipelineKey* key) const {
+  if (!pipeline_data) {
+    return Result(
+        "Vulkan: GraphicsPipeline::GetVkGraphicsPipeline PipelineData is "
+        "null");
+  }
+
+  key->pipeline_data = *pipeline_data;
+  key->topology = topology;
+  if (device_->SupportsExtendedDynamicState()) {
+    const bool state2 = device_->SupportsExtendedDynamicState2();
+    ClearDynamicState(state2, &key->pipeline_data);
+    // A list topology can only be created with primitive restart if
+    // primitive restart is dynamic as well.
+    if (state2 || !pipeline_data->GetEnablePrimitiveRestart())
+      key->topology = GetTopologyClass(topology);
+  }
+  if (vertex_buffer != nullptr) {
+    key->vertex_binding = vertex_buffer->GetVkVertexInputBinding();
+    key->vertex_attributes = vertex_buffer->GetVkVertexInputAttr();
+  }
+  key->patch_control_points = patch_control_points_;
+  return {};
+}
+
+Result GraphicsPipeline::GetVkGraphicsPipeline(
+    const PipelineData* pipeline_data,
+    VkPrimitiveTopology topology,
+    const VertexBuffer* vertex_buffer,
+    const VkPipelineLayout& pipeline_layout,
+    VkPipeline* pipeline) {
+  PipelineKey key;
+  Result r = MakePipelineKey(pipeline_data, topology, vertex_buffer, &key);
+  if (!r.IsSuccess())
+    return r;
+  return FindOrCreateVkGraphicsPipeline(key, pipeline_layout, pipeline);
+}
+
+Result GraphicsPipeline::FindOrCreateVkGraphicsPipeline(
+    const PipelineKey& key,
+    VkPipelineLayout pipeline_layout,
+    VkPipeline* pipeline) {
+  // Held while creating, so a draw waits for the VkPipeline it needs when
+  // another thread is creating it.
+  std::lock_guard<std::mutex> lock(vk_pipeline_mutex_);
+  for (const auto& cached : pipeline_cache_) {
+    if (cached.key == key) {
+      RecordPipelineCacheHit();
+      *pipeline = cached.pipeline;
+      return {};
+    }
   }
 
+  Result r = CreateVkGraphicsPipeline(key, pipeline_layout, pipeline);
+  if (!r.IsSuccess())
+    return r;
+
+  RecordPipelineCacheMiss();
+  pipeline_cache_.emplace_back();
+  pipeline_cache_.back().key = key;
+  pipeline_cache_.back().pipeline = *pipeline;
+  return {};
+}
+
+Result GraphicsPipeline::PrepareVkGraphicsPipeline(
+    const PipelineData* pipeline_data,
+    Topology topology,
+    const VertexBuffer* vertex_buffer,
+    std::function<Result()>* job) {
+  // The layout is created here, creating the VkPipeline only reads it.
+  VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+  Result r = GetVkPipelineLayout(&pipeline_layout);
+  if (!r.IsSuccess())
+    return r;
+
+  PipelineKey key;
+  r = MakePipelineKey(pipeline_data, ToVkTopology(topology), vertex_buffer,
+                      &key);
+  if (!r.IsSuccess())
+    return r;
+
+  *job = [this, key, pipeline_layout]() {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    return FindOrCreateVkGraphicsPipeline(key, pipeline_layout, &pipeline);
+  };
   return {};
 }
 
@@ -709,7 +1098,20 @@ Result GraphicsPipeline::SendVertexBufferDataIfNeeded(
     VertexBuffer* vertex_buffer) {
   if (!vertex_buffer || vertex_buffer->VertexDataSent())
     return {};
-  return vertex_buffer->SendVertexData(command_.get());
+  Result r = vertex_buffer->SendVertexData(command_.get());
+  if (r.IsSuccess())
+    AddPendingUpload(vertex_buffer);
+  return r;
+}
+
+Result GraphicsPipeline::SendIndexBufferDataIfNeeded(
+    IndexBuffer* index_buffer) {
+  if (!index_buffer || index_buffer->IndexDataSent())
+    return {};
+  Result r = index_buffer->SendIndexData(command_.get());
+  if (r.IsSuccess())
+    AddPendingUpload(index_buffer);
+  return r;
 }
 
 Result GraphicsPipeline::SetIndexBuffer(Buffer* buffer) {
@@ -720,12 +1122,14 @@ Result GraphicsPipeline::SetIndexBuffer(Buffer* buffer) {
   }
 
   index_buffer_ = MakeUnique<IndexBuffer>(device_);
+  index_buffer_->SetDeviceLocal(UseDeviceLocalMemory(buffer));
 
   CommandBufferGuard guard(GetCommandBuffer());
   if (!guard.IsRecording())
     return guard.GetResult();
 
-  Result r = index_buffer_->SendIndexData(command_.get(), buffer);
+  index_buffer_->SetData(buffer);
+  Result r = index_buffer_->SendIndexData(command_.get());
   if (!r.IsSuccess())
     return r;
 
@@ -771,77 +1175,140 @@ Result GraphicsPipeline::Clear() {
   if (!r.IsSuccess())
     return r;
 
-  if (!depth_stencil_format_ || !depth_stencil_format_->IsFormatKnown())
-    return {};
+  if (depth_stencil_format_ && depth_stencil_format_->IsFormatKnown()) {
+    VkClearValue depth_clear;
+    depth_clear.depthStencil = {clear_depth_, clear_stencil_};
 
-  VkClearValue depth_clear;
-  depth_clear.depthStencil = {clear_depth_, clear_stencil_};
+    r = ClearBuffer(depth_clear, depth_stencil_format_->HasStencilComponent()
+                                     ? VK_IMAGE_ASPECT_DEPTH_BIT |
+                                           VK_IMAGE_ASPECT_STENCIL_BIT
+                                     : VK_IMAGE_ASPECT_DEPTH_BIT);
+    if (!r.IsSuccess())
+      return r;
+  }
 
-  return ClearBuffer(
-      depth_clear,
-      depth_stencil_format_ && depth_stencil_format_->HasStencilComponent()
-          ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT
-          : VK_IMAGE_ASPECT_DEPTH_BIT);
+  StopGpuTimer("clear");
+  return {};
 }
 
-Result GraphicsPipeline::ClearBuffer(const VkClearValue& clear_value,
-                                     VkImageAspectFlags aspect) {
-  CommandBufferGuard cmd_buf_guard(GetCommandBuffer());
-  if (!cmd_buf_guard.IsRecording())
-    return cmd_buf_guard.GetResult();
+Result GraphicsPipeline::StartRecordingFrameCommand() {
+  const bool has_pending_commands = HasPendingCommands();
+  Result r = StartRecordingCommand();
+  if (!r.IsSuccess())
+    return r;
+
+  if (has_pending_commands)
+    return {};
 
   frame_->ChangeFrameToWriteLayout(GetCommandBuffer());
-  frame_->CopyBuffersToImages();
-  frame_->TransferColorImagesToDevice(GetCommandBuffer());
+  // Until the attachments are read back the images hold their latest
+  // contents, only upload them when the host side buffers are up to date.
+  if (!color_attachments_readback_needed_) {
+    frame_->CopyBuffersToImages();
+    frame_->TransferColorImagesToDevice(GetCommandBuffer());
+    color_attachments_readback_needed_ = true;
+  }
+  return {};
+}
 
-  {
-    RenderPassGuard render_pass_guard(this);
+bool GraphicsPipeline::IsColorAttachment(const Buffer* buffer) const {
+  for (const auto* info : color_buffers_) {
+    if (info->buffer == buffer)
+      return true;
+  }
+  return false;
+}
 
-    std::vector<VkClearAttachment> clears;
-    for (size_t i = 0; i < color_buffers_.size(); ++i) {
-      VkClearAttachment clear_attachment = VkClearAttachment();
-      clear_attachment.aspectMask = aspect;
-      clear_attachment.colorAttachment = static_cast<uint32_t>(i);
-      clear_attachment.clearValue = clear_value;
+bool GraphicsPipeline::IsReadbackNeeded(const Buffer* buffer) const {
+  if (color_attachments_readback_needed_ && IsColorAttachment(buffer))
+    return true;
+  return Pipeline::IsReadbackNeeded(buffer);
+}
 
-      clears.push_back(clear_attachment);
-    }
+bool GraphicsPipeline::CanUpdateBufferInPlace(const Buffer* buffer) const {
+  if (color_attachments_readback_needed_ && IsColorAttachment(buffer))
+    return false;
+  return Pipeline::CanUpdateBufferInPlace(buffer);
+}
 
-    VkClearRect clear_rect;
-    clear_rect.rect = {{0, 0}, {frame_width_, frame_height_}};
-    clear_rect.baseArrayLayer = 0;
-    clear_rect.layerCount = 1;
+Result GraphicsPipeline::RecordCopyBufferToHost(const Buffer* buffer) {
+  Result r = Pipeline::RecordCopyBufferToHost(buffer);
+  if (!r.IsSuccess())
+    return r;
 
-    device_->GetPtrs()->vkCmdClearAttachments(
-        command_->GetVkCommandBuffer(), static_cast<uint32_t>(clears.size()),
-        clears.data(), 1, &clear_rect);
+  if (color_attachments_readback_needed_ && IsColorAttachment(buffer)) {
+    frame_->ChangeFrameToProbeLayout(command_.get());
+    frame_->TransferColorImagesToHost(command_.get());
   }
+  return {};
+}
 
-  frame_->TransferColorImagesToHost(command_.get());
-
-  Result r = cmd_buf_guard.Submit(GetFenceTimeout());
+Result GraphicsPipeline::CopyHostMemoryToBuffer(const Buffer* buffer) {
+  Result r = Pipeline::CopyHostMemoryToBuffer(buffer);
   if (!r.IsSuccess())
     return r;
 
-  frame_->CopyImagesToBuffers();
+  // All color attachments were copied, so they are all up to date now.
+  if (color_attachments_readback_needed_ && IsColorAttachment(buffer)) {
+    frame_->CopyImagesToBuffers();
+    color_attachments_readback_needed_ = false;
+  }
   return {};
 }
 
-Result GraphicsPipeline::Draw(const DrawArraysCommand* command,
-                              VertexBuffer* vertex_buffer) {
-  Result r = SendDescriptorDataToDeviceIfNeeded();
+Result GraphicsPipeline::ClearBuffer(const VkClearValue& clear_value,
+                                     VkImageAspectFlags aspect) {
+  Result r = StartRecordingFrameCommand();
   if (!r.IsSuccess())
     return r;
 
+  RenderPassGuard render_pass_guard(this);
+
+  std::vector<VkClearAttachment> clears;
+  for (size_t i = 0; i < color_buffers_.size(); ++i) {
+    VkClearAttachment clear_attachment = VkClearAttachment();
+    clear_attachment.aspectMask = aspect;
+    clear_attachment.colorAttachment = static_cast<uint32_t>(i);
+    clear_attachment.clearValue = clear_value;
+
+    clears.push_back(clear_attachment);
+  }
+
+  VkClearRect clear_rect;
+  clear_rect.rect = {{0, 0}, {frame_width_, frame_height_}};
+  clear_rect.baseArrayLayer = 0;
+  clear_rect.layerCount = 1;
+
+  device_->GetPtrs()->vkCmdClearAttachments(
+      command_->GetVkCommandBuffer(), static_cast<uint32_t>(clears.size()),
+      clears.data(), 1, &clear_rect);
+  return {};
+}
+
+Result GraphicsPipeline::Draw(const DrawArraysCommand* command,
+                              VertexBuffer* vertex_buffer,
+                              IndexBuffer* index_buffer) {
+  if (!index_buffer)
+    index_buffer = index_buffer_.get();
+
+  // Descriptor resources stay alive while commands are pending, so they only
+  // need to be created for the first command.
+  Result r;
+  if (!HasPendingCommands()) {
+    r = CreateDescriptorResourcesIfNeeded();
+    if (!r.IsSuccess())
+      return r;
+  }
+
   VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
-  r = CreateVkPipelineLayout(&pipeline_layout);
+  r = GetVkPipelineLayout(&pipeline_layout);
   if (!r.IsSuccess())
     return r;
 
   VkPipeline pipeline = VK_NULL_HANDLE;
-  r = CreateVkGraphicsPipeline(command->GetPipelineData(),
-                               ToVkTopology(command->GetTopology()),
-                               vertex_buffer, pipeline_layout, &pipeline);
+  r = GetVkGraphicsPipeline(command->GetPipelineData(),
+                            ToVkTopology(command->GetTopology()),
+                            vertex_buffer, pipeline_layout, &pipeline);
   if (!r.IsSuccess())
     return r;
 
@@ -850,84 +1317,147 @@ Result GraphicsPipeline::Draw(const DrawArraysCommand* command,
   // while updating it is not safe.
   UpdateDescriptorSetsIfNeeded();
 
-  {
-    CommandBufferGuard cmd_buf_guard(GetCommandBuffer());
-    if (!cmd_buf_guard.IsRecording())
-      return cmd_buf_guard.GetResult();
-
-    r = SendVertexBufferDataIfNeeded(vertex_buffer);
-    if (!r.IsSuccess())
-      return r;
+  r = StartRecordingFrameCommand();
+  if (!r.IsSuccess())
+    return r;
 
-    frame_->ChangeFrameToWriteLayout(GetCommandBuffer());
-    frame_->CopyBuffersToImages();
-    frame_->TransferColorImagesToDevice(GetCommandBuffer());
+  r = SendVertexBufferDataIfNeeded(vertex_buffer);
+  if (r.IsSuccess() && command->IsIndexed())
+    r = SendIndexBufferDataIfNeeded(index_buffer);
+  if (r.IsSuccess())
+    r = BeginStatisticsQuery();
+  if (r.IsSuccess()) {
+    r = RecordDraw(command, vertex_buffer, index_buffer, pipeline_layout,
+                   pipeline);
+  }
+  if (!r.IsSuccess()) {
+    DiscardPendingCommands();
+    return r;
+  }
 
-    {
-      RenderPassGuard render_pass_guard(this);
-
-      BindVkDescriptorSets(pipeline_layout);
-
-      r = RecordPushConstant(pipeline_layout);
-      if (!r.IsSuccess())
-        return r;
-
-      device_->GetPtrs()->vkCmdBindPipeline(command_->GetVkCommandBuffer(),
-                                            VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                            pipeline);
-
-      if (vertex_buffer != nullptr)
-        vertex_buffer->BindToCommandBuffer(command_.get());
-
-      uint32_t instance_count = command->GetInstanceCount();
-      if (instance_count == 0 && command->GetVertexCount() != 0)
-        instance_count = 1;
-
-      if (command->IsIndexed()) {
-        if (!index_buffer_)
-          return Result("Vulkan: Draw indexed is used without given indices");
-
-        r = index_buffer_->BindToCommandBuffer(command_.get());
-        if (!r.IsSuccess())
-          return r;
-
-        // VkRunner spec says
-        //   "vertexCount will be used as the index count, firstVertex
-        //    becomes the vertex offset and firstIndex will always be zero."
-        device_->GetPtrs()->vkCmdDrawIndexed(
-            command_->GetVkCommandBuffer(),
-            command->GetVertexCount(), /* indexCount */
-            instance_count,            /* instanceCount */
-            0,                         /* firstIndex */
-            static_cast<int32_t>(
-                command->GetFirstVertexIndex()), /* vertexOffset */
-            0 /* firstInstance */);
-      } else {
-        device_->GetPtrs()->vkCmdDraw(command_->GetVkCommandBuffer(),
-                                      command->GetVertexCount(), instance_count,
-                                      command->GetFirstVertexIndex(), 0);
-      }
-    }
+  EndStatisticsQuery("draw");
+  StopGpuTimer("draw");
+  return {};
+}
 
-    frame_->TransferColorImagesToHost(command_.get());
+Result GraphicsPipeline::RecordDraw(const DrawArraysCommand* command,
+                                    VertexBuffer* vertex_buffer,
+                                    IndexBuffer* index_buffer,
+                                    VkPipelineLayout pipeline_layout,
+                                    VkPipeline pipeline) {
+  RenderPassGuard render_pass_guard(this);
 
-    r = cmd_buf_guard.Submit(GetFenceTimeout());
-    if (!r.IsSuccess())
-      return r;
-  }
+  BindVkDescriptorSets(pipeline_layout);
 
-  r = ReadbackDescriptorsToHostDataQueue();
+  Result r = RecordPushConstant(pipeline_layout);
   if (!r.IsSuccess())
     return r;
 
-  frame_->CopyImagesToBuffers();
+  device_->GetPtrs()->vkCmdBindPipeline(command_->GetVkCommandBuffer(),
+                                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                        pipeline);
+  RecordDynamicState(command->GetPipelineData(),
+                     ToVkTopology(command->GetTopology()));
+
+  if (vertex_buffer != nullptr)
+    vertex_buffer->BindToCommandBuffer(command_.get());
 
-  device_->GetPtrs()->vkDestroyPipeline(device_->GetVkDevice(), pipeline,
-                                        nullptr);
-  device_->GetPtrs()->vkDestroyPipelineLayout(device_->GetVkDevice(),
-                                              pipeline_layout, nullptr);
+  uint32_t instance_count = command->GetInstanceCount();
+  if (instance_count == 0 && command->GetVertexCount() != 0)
+    instance_count = 1;
+
+  if (command->IsIndexed()) {
+    if (!index_buffer)
+      return Result("Vulkan: Draw indexed is used without given indices");
+
+    r = index_buffer->BindToCommandBuffer(command_.get());
+    if (!r.IsSuccess())
+      return r;
+
+    // VkRunner spec says
+    //   "vertexCount will be used as the index count, firstVertex
+    //    becomes the vertex offset and firstIndex will always be zero."
+    device_->GetPtrs()->vkCmdDrawIndexed(
+        command_->GetVkCommandBuffer(),
+        command->GetVertexCount(), /* indexCount */
+        instance_count,            /* instanceCount */
+        0,                         /* firstIndex */
+        static_cast<int32_t>(
+            command->GetFirstVertexIndex()), /* vertexOffset */
+        0 /* firstInstance */);
+  } else {
+    device_->GetPtrs()->vkCmdDraw(command_->GetVkCommandBuffer(),
+                                  command->GetVertexCount(), instance_count,
+                                  command->GetFirstVertexIndex(), 0);
+  }
   return {};
 }
 
+void GraphicsPipeline::RecordDynamicState(const PipelineData* pipeline_data,
+                                          VkPrimitiveTopology topology) {
+  if (!device_->SupportsExtendedDynamicState())
+    return;
+
+  VkCommandBuffer cmd = command_->GetVkCommandBuffer();
+  const auto* ptrs = device_->GetPtrs();
+  const auto* dynamic = device_->GetDynamicStatePtrs();
+
+  ptrs->vkCmdSetLineWidth(cmd, pipeline_data->GetLineWidth());
+  ptrs->vkCmdSetDepthBias(cmd, pipeline_data->GetDepthBiasConstantFactor(),
+                          pipeline_data->GetDepthBiasClamp(),
+                          pipeline_data->GetDepthBiasSlopeFactor());
+  ptrs->vkCmdSetDepthBounds(cmd, pipeline_data->GetMinDepthBounds(),
+                            pipeline_data->GetMaxDepthBounds());
+  ptrs->vkCmdSetStencilCompareMask(cmd, VK_STENCIL_FACE_FRONT_BIT,
+                                   pipeline_data->GetFrontCompareMask());
+  ptrs->vkCmdSetStencilCompareMask(cmd, VK_STENCIL_FACE_BACK_BIT,
+                                   pipeline_data->GetBackCompareMask());
+  ptrs->vkCmdSetStencilWriteMask(cmd, VK_STENCIL_FACE_FRONT_BIT,
+                                 pipeline_data->GetFrontWriteMask());
+  ptrs->vkCmdSetStencilWriteMask(cmd, VK_STENCIL_FACE_BACK_BIT,
+                                 pipeline_data->GetBackWriteMask());
+  ptrs->vkCmdSetStencilReference(cmd, VK_STENCIL_FACE_FRONT_BIT,
+                                 pipeline_data->GetFrontReference());
+  ptrs->vkCmdSetStencilReference(cmd, VK_STENCIL_FACE_BACK_BIT,
+                                 pipeline_data->GetBackReference());
+
+  dynamic->vkCmdSetCullModeEXT(cmd,
+                               ToVkCullMode(pipeline_data->GetCullMode()));
+  dynamic->vkCmdSetFrontFaceEXT(cmd,
+                                ToVkFrontFace(pipeline_data->GetFrontFace()));
+  dynamic->vkCmdSetPrimitiveTopologyEXT(cmd, topology);
+  dynamic->vkCmdSetDepthTestEnableEXT(cmd,
+                                      pipeline_data->GetEnableDepthTest());
+  dynamic->vkCmdSetDepthWriteEnableEXT(cmd,
+                                       pipeline_data->GetEnableDepthWrite());
+  dynamic->vkCmdSetDepthCompareOpEXT(
+      cmd, ToVkCompareOp(pipeline_data->GetDepthCompareOp()));
+  dynamic->vkCmdSetDepthBoundsTestEnableEXT(
+      cmd, pipeline_data->GetEnableDepthBoundsTest());
+  dynamic->vkCmdSetStencilTestEnableEXT(cmd,
+                                        pipeline_data->GetEnableStencilTest());
+  dynamic->vkCmdSetStencilOpEXT(
+      cmd, VK_STENCIL_FACE_FRONT_BIT,
+      ToVkStencilOp(pipeline_data->GetFrontFailOp()),
+      ToVkStencilOp(pipeline_data->GetFrontPassOp()),
+      ToVkStencilOp(pipeline_data->GetFrontDepthFailOp()),
+      ToVkCompareOp(pipeline_data->GetFrontCompareOp()));
+  dynamic->vkCmdSetStencilOpEXT(
+      cmd, VK_STENCIL_FACE_BACK_BIT,
+      ToVkStencilOp(pipeline_data->GetBackFailOp()),
+      ToVkStencilOp(pipeline_data->GetBackPassOp()),
+      ToVkStencilOp(pipeline_data->GetBackDepthFailOp()),
+      ToVkCompareOp(pipeline_data->GetBackCompareOp()));
+
+  if (!device_->SupportsExtendedDynamicState2())
+    return;
+
+  dynamic->vkCmdSetDepthBiasEnableEXT(cmd, pipeline_data->GetEnableDepthBias());
+  dynamic->vkCmdSetPrimitiveRestartEnableEXT(
+      cmd, pipeline_data->GetEnablePrimitiveRestart());
+  dynamic->vkCmdSetRasterizerDiscardEnableEXT(
+      cmd, pipeline_data->GetEnableRasterizerDiscard());
+}
+
 }  // namespace vulkan
 }  // namespace amber
@@ -15,6 +15,7 @@
 #ifndef SRC_VULKAN_GRAPHICS_PIPELINE_H_
 #define SRC_VULKAN_GRAPHICS_PIPELINE_H_
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -51,6 +52,8 @@ class GraphicsPipeline : public Pipeline {
 
   Result SetIndexBuffer(Buffer* buffer);
 
+  /// Records clearing the attachments. Like draws, clears stay pending until
+  /// SubmitPendingCommands() is called.
   Result Clear();
   Result ClearBuffer(const VkClearValue& clear_value,
                      VkImageAspectFlags aspect);
@@ -59,7 +62,24 @@ class GraphicsPipeline : public Pipeline {
   Result SetClearStencil(uint32_t stencil);
   Result SetClearDepth(float depth);
 
-  Result Draw(const DrawArraysCommand* command, VertexBuffer* vertex_buffer);
+  /// Records a draw. The draw stays pending until SubmitPendingCommands() or
+  /// FlushPendingCommands() is called. |vertex_buffer| must stay alive until
+  /// the draw completed, see RetainUntilExecuted(). Indexed draws use
+  /// |index_buffer|, or the index buffer of the pipeline if it is nullptr.
+  /// The data of either buffer is uploaded by the first draw using it.
+  Result Draw(const DrawArraysCommand* command,
+              VertexBuffer* vertex_buffer,
+              IndexBuffer* index_buffer);
+
+  /// Prepares creating the VkPipeline a draw of |pipeline_data| and
+  /// |topology| with the vertex layout of |vertex_buffer| uses. Returns in
+  /// |job| the creation, which may run on another thread as long as the
+  /// layout, the entry points and the patch control points do not change.
+  /// Draws using the VkPipeline wait for a running |job|.
+  Result PrepareVkGraphicsPipeline(const PipelineData* pipeline_data,
+                                   Topology topology,
+                                   const VertexBuffer* vertex_buffer,
+                                   std::function<Result()>* job);
 
   VkRenderPass GetVkRenderPass() const { return render_pass_; }
   FrameBuffer* GetFrameBuffer() const { return frame_.get(); }
@@ -71,14 +91,77 @@ class GraphicsPipeline : public Pipeline {
     patch_control_points_ = points;
   }
 
+  bool CanUpdateBufferInPlace(const Buffer* buffer) const override;
+
+ protected:
+  void DestroyCachedVkPipelines() override;
+  bool IsReadbackNeeded(const Buffer* buffer) const override;
+  Result RecordCopyBufferToHost(const Buffer* buffer) override;
+  Result CopyHostMemoryToBuffer(const Buffer* buffer) override;
+
  private:
-  Result CreateVkGraphicsPipeline(const PipelineData* pipeline_data,
-                                  VkPrimitiveTopology topology,
-                                  const VertexBuffer* vertex_buffer,
-                                  const VkPipelineLayout& pipeline_layout,
+  /// The draw state baked into a VkPipeline. Draws with an equal key re-use
+  /// the same VkPipeline.
+  struct PipelineKey {
+    PipelineData pipeline_data;
+    VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+    VkVertexInputBindingDescription vertex_binding =
+        VkVertexInputBindingDescription();
+    std::vector<VkVertexInputAttributeDescription> vertex_attributes;
+    uint32_t patch_control_points = 0;
+
+    bool operator==(const PipelineKey& other) const;
+  };
+
+  struct CachedPipeline {
+    PipelineKey key;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+  };
+
+  /// Returns in |key| the state of a draw baked into its VkPipeline.
+  Result MakePipelineKey(const PipelineData* pipeline_data,
+                         VkPrimitiveTopology topology,
+                         const VertexBuffer* vertex_buffer,
+                         PipelineKey* key) const;
+  /// Returns the VkPipeline matching the given draw state in |pipeline|,
+  /// creating and caching it if this state has not been seen before.
+  Result GetVkGraphicsPipeline(const PipelineData* pipeline_data,
+                               VkPrimitiveTopology topology,
+                               const VertexBuffer* vertex_buffer,
+                               const VkPipelineLayout& pipeline_layout,
+                               VkPipeline* pipeline);
+  /// Returns the cached VkPipeline for |key| in |pipeline|, creating it if
+  /// it does not exist yet.
+  Result FindOrCreateVkGraphicsPipeline(const PipelineKey& key,
+                                        VkPipelineLayout pipeline_layout,
+                                        VkPipeline* pipeline);
+  Result CreateVkGraphicsPipeline(const PipelineKey& key,
+                                  VkPipelineLayout pipeline_layout,
                                   VkPipeline* pipeline);
+  /// Links the pipeline described by |pipeline_info| from the pipeline
+  /// libraries of its parts, creating the libraries not shared with earlier
+  /// pipelines.
+  Result LinkVkGraphicsPipeline(
+      const VkGraphicsPipelineCreateInfo& pipeline_info,
+      const PipelineData* pipeline_data,
+      VkPipeline* pipeline);
   Result CreateRenderPass();
   Result SendVertexBufferDataIfNeeded(VertexBuffer* vertex_buffer);
+  Result SendIndexBufferDataIfNeeded(IndexBuffer* index_buffer);
+  /// Starts recording a command which renders to the frame buffer. The
+  /// attachments are uploaded if no commands are pending and the host side
+  /// buffers hold their latest contents.
+  Result StartRecordingFrameCommand();
+  bool IsColorAttachment(const Buffer* buffer) const;
+  /// Records the state of |pipeline_data| and |topology| which pipelines
+  /// created with dynamic state leave to the draw.
+  void RecordDynamicState(const PipelineData* pipeline_data,
+                          VkPrimitiveTopology topology);
+  Result RecordDraw(const DrawArraysCommand* command,
+                    VertexBuffer* vertex_buffer,
+                    IndexBuffer* index_buffer,
+                    VkPipelineLayout pipeline_layout,
+                    VkPipeline pipeline);
 
   VkPipelineDepthStencilStateCreateInfo GetVkPipelineDepthStencilInfo(
       const PipelineData* pipeline_data);
@@ -92,9 +175,13 @@ class GraphicsPipeline : public Pipeline {
   std::vector<const amber::Pipeline::BufferInfo*> color_buffers_;
   Format* depth_stencil_format_;
   std::unique_ptr<IndexBuffer> index_buffer_;
+  std::vector<CachedPipeline> pipeline_cache_;
 
   uint32_t frame_width_ = 0;
   uint32_t frame_height_ = 0;
+  // Set once commands rendering to the frame buffer were recorded, cleared
+  // when the color attachments are read back.
+  bool color_attachments_readback_needed_ = false;
 
   float clear_color_r_ = 0;
   float clear_color_g_ = 0;
@@ -43,11 +43,9 @@ void ImageDescriptor::RecordCopyDataToResourceIfNeeded(CommandBuffer* command) {
 }
 
 Result ImageDescriptor::CreateResourceIfNeeded() {
-  if (transfer_image_) {
-    return Result(
-        "Vulkan: ImageDescriptor::CreateResourceIfNeeded() must be called "
-        "only when |transfer_image| is empty");
-  }
+  // The resource still holds the results of previous commands.
+  if (transfer_image_)
+    return {};
 
   auto amber_buffer = getAmberBuffer();
 
@@ -27,26 +27,30 @@ IndexBuffer::IndexBuffer(Device* device) : device_(device) {}
 
 IndexBuffer::~IndexBuffer() = default;
 
-Result IndexBuffer::SendIndexData(CommandBuffer* command, Buffer* buffer) {
-  if (transfer_buffer_) {
-    return Result(
-        "IndexBuffer::SendIndexData must be called once when it is created");
-  }
+Result IndexBuffer::SendIndexData(CommandBuffer* command) {
+  if (!is_index_data_pending_)
+    return Result("IndexBuffer::SendIndexData indices were already sent");
 
-  if (buffer->ElementCount() == 0)
+  if (!data_ || data_->ElementCount() == 0)
     return Result("IndexBuffer::SendIndexData |buffer| is empty");
 
-  transfer_buffer_ =
-      MakeUnique<TransferBuffer>(device_, buffer->GetSizeInBytes());
-  Result r = transfer_buffer_->Initialize(VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-                                          VK_BUFFER_USAGE_TRANSFER_DST_BIT);
-  if (!r.IsSuccess())
-    return r;
+  if (!transfer_buffer_) {
+    transfer_buffer_ =
+        MakeUnique<TransferBuffer>(device_, data_->GetSizeInBytes());
+    Result r = transfer_buffer_->Initialize(
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        device_local_, nullptr);
+    if (!r.IsSuccess()) {
+      transfer_buffer_ = nullptr;
+      return r;
+    }
+  }
 
   std::memcpy(transfer_buffer_->HostAccessibleMemoryPtr(),
-              buffer->ValuePtr()->data(), buffer->GetSizeInBytes());
+              data_->ValuePtr()->data(), data_->GetSizeInBytes());
 
   transfer_buffer_->CopyToDevice(command);
+  is_index_data_pending_ = false;
   return {};
 }
 
@@ -37,15 +37,29 @@ class IndexBuffer {
   explicit IndexBuffer(Device* device);
   ~IndexBuffer();
 
-  /// Copy the data in this index buffer to the device.
-  Result SendIndexData(CommandBuffer* command, Buffer* buffer);
+  /// Sets the indices to upload. |buffer| is _not_ owned and must stay
+  /// alive until the indices were sent.
+  void SetData(Buffer* buffer) { data_ = buffer; }
+
+  /// Records copying the indices given to SetData() to the device.
+  Result SendIndexData(CommandBuffer* command);
+  bool IndexDataSent() const { return !is_index_data_pending_; }
+  /// Makes the next SendIndexData() copy the indices again, for when the
+  /// commands recording the previous copy were discarded.
+  void MarkIndexDataPending() { is_index_data_pending_ = true; }
 
   /// Bind the index buffer if needed.
   Result BindToCommandBuffer(CommandBuffer* command);
 
+  /// Sets if the index buffer is placed in device local memory.
+  void SetDeviceLocal(bool device_local) { device_local_ = device_local; }
+
  private:
   Device* device_ = nullptr;
+  Buffer* data_ = nullptr;
   std::unique_ptr<TransferBuffer> transfer_buffer_;
+  bool is_index_data_pending_ = true;
+  bool device_local_ = false;
 };
 
 }  // namespace vulkan
@@ -0,0 +1,249 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/vulkan/memory_allocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <utility>
+
+#include "src/make_unique.h"
+#include "src/vulkan/device.h"
+
+namespace amber {
+namespace vulkan {
+namespace {
+
+VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment) {
+  if (alignment <= 1)
+    return value;
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace
+
+const VkDeviceSize MemoryAllocator::kDefaultBlockSize = 16 * 1024 * 1024;
+
+uint32_t MemoryAllocator::Stats::GetFragmentationPercent() const {
+  const VkDeviceSize free_bytes = block_bytes - used_bytes;
+  if (free_bytes == 0)
+    return 0;
+  return static_cast<uint32_t>(100 - largest_free_range * 100 / free_bytes);
+}
+
+MemoryAllocator::MemoryAllocator(Device* device, VkDeviceSize block_size)
+    : device_(device), block_size_(block_size) {}
+
+MemoryAllocator::~MemoryAllocator() {
+  for (auto& block : blocks_)
+    DestroyBlock(block.get());
+}
+
+Result MemoryAllocator::Allocate(const VkMemoryRequirements& requirements,
+                                 uint32_t memory_type_index,
+                                 bool is_image,
+                                 MemoryAllocation* allocation) {
+  if (allocation == nullptr)
+    return Result("Vulkan::Given MemoryAllocation pointer is nullptr");
+
+  // Zero sized buffers still need memory to bind.
+  const VkDeviceSize size = std::max<VkDeviceSize>(requirements.size, 1);
+
+  Block* block = nullptr;
+  VkDeviceSize offset = 0;
+  for (auto& candidate : blocks_) {
+    if (candidate->memory_type_index != memory_type_index ||
+        candidate->is_image != is_image) {
+      continue;
+    }
+    if (AllocateFromBlock(candidate.get(), size, requirements.alignment,
+                          &offset)) {
+      block = candidate.get();
+      break;
+    }
+  }
+
+  if (!block) {
+    // Ranges larger than a block get a block of their own. If the heap has
+    // no room for a whole block, fall back to a block of just |size|.
+    Result r = CreateBlock(std::max(block_size_, size), memory_type_index,
+                           is_image, &block);
+    if (!r.IsSuccess() && size < block_size_)
+      r = CreateBlock(size, memory_type_index, is_image, &block);
+    if (!r.IsSuccess())
+      return r;
+
+    if (!AllocateFromBlock(block, size, requirements.alignment, &offset))
+      return Result("Vulkan::MemoryAllocator new block is too small");
+  }
+
+  ++block->allocation_count;
+  ++allocation_count_;
+  used_bytes_ += size;
+  peak_used_bytes_ = std::max(peak_used_bytes_, used_bytes_);
+
+  allocation->memory = block->memory;
+  allocation->offset = offset;
+  allocation->size = size;
+  allocation->host_ptr =
+      block->host_ptr ? static_cast<uint8_t*>(block->host_ptr) + offset
+                      : nullptr;
+  return {};
+}
+
+void MemoryAllocator::Free(MemoryAllocation* allocation) {
+  if (allocation->memory == VK_NULL_HANDLE)
+    return;
+
+  auto it = std::find_if(blocks_.begin(), blocks_.end(),
+                         [allocation](const std::unique_ptr<Block>& block) {
+                           return block->memory == allocation->memory;
+                         });
+  assert(it != blocks_.end());
+  Block* block = it->get();
+
+  VkDeviceSize offset = allocation->offset;
+  VkDeviceSize size = allocation->size;
+
+  // Merge with the free ranges directly after and before the freed one.
+  auto next = block->free_ranges.find(offset + size);
+  if (next != block->free_ranges.end()) {
+    size += next->second;
+    block->free_ranges.erase(next);
+  }
+  auto prev = block->free_ranges.lower_bound(offset);
+  if (prev != block->free_ranges.begin()) {
+    --prev;
+    if (prev->first + prev->second == offset) {
+      offset = prev->first;
+      size += prev->second;
+    }
+  }
+  block->free_ranges[offset] = size;
+
+  --block->allocation_count;
+  --allocation_count_;
+  used_bytes_ -= allocation->size;
+  *allocation = MemoryAllocation();
+
+  // Keep one empty block per memory type around, so a resource which is
+  // recreated on every run does not allocate a new block each time.
+  if (block->allocation_count == 0 &&
+      (block->size > block_size_ || HasOtherEmptyBlock(block))) {
+    DestroyBlock(block);
+    blocks_.erase(it);
+  }
+}
+
+MemoryAllocator::Stats MemoryAllocator::GetStats() const {
+  Stats stats;
+  stats.block_count = static_cast<uint32_t>(blocks_.size());
+  stats.allocation_count = allocation_count_;
+  stats.used_bytes = used_bytes_;
+  stats.peak_used_bytes = peak_used_bytes_;
+  for (const auto& block : blocks_) {
+    stats.block_bytes += block->size;
+    stats.free_range_count += static_cast<uint32_t>(block->free_ranges.size());
+    for (const auto& range : block->free_ranges) {
+      stats.largest_free_range =
+          std::max(stats.largest_free_range, range.second);
+    }
+  }
+  return stats;
+}
+
+bool MemoryAllocator::AllocateFromBlock(Block* block,
+                                        VkDeviceSize size,
+                                        VkDeviceSize alignment,
+                                        VkDeviceSize* offset) {
+  for (auto it = block->free_ranges.begin(); it != block->free_ranges.end();
+       ++it) {
+    const VkDeviceSize range_offset = it->first;
+    const VkDeviceSize range_end = it->first + it->second;
+    const VkDeviceSize aligned = AlignUp(range_offset, alignment);
+    if (aligned + size > range_end)
+      continue;
+
+    // The padding in front of the aligned offset stays free.
+    block->free_ranges.erase(it);
+    if (aligned > range_offset)
+      block->free_ranges[range_offset] = aligned - range_offset;
+    if (aligned + size < range_end)
+      block->free_ranges[aligned + size] = range_end - aligned - size;
+
+    *offset = aligned;
+    return true;
+  }
+  return false;
+}
+
+Result MemoryAllocator::CreateBlock(VkDeviceSize size,
+                                    uint32_t memory_type_index,
+                                    bool is_image,
+                                    Block** block) {
+  auto new_block = MakeUnique<Block>();
+  new_block->size = size;
+  new_block->memory_type_index = memory_type_index;
+  new_block->is_image = is_image;
+
+  VkMemoryAllocateInfo alloc_info = VkMemoryAllocateInfo();
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.allocationSize = size;
+  alloc_info.memoryTypeIndex = memory_type_index;
+  if (device_->GetPtrs()->vkAllocateMemory(device_->GetVkDevice(), &alloc_info,
+                                           nullptr, &new_block->memory) !=
+      VK_SUCCESS) {
+    return Result("Vulkan::Calling vkAllocateMemory Fail");
+  }
+
+  // Optimally tiled images are never accessed by the host.
+  if (!is_image && device_->IsMemoryHostAccessible(memory_type_index) &&
+      device_->GetPtrs()->vkMapMemory(device_->GetVkDevice(),
+                                      new_block->memory, 0, VK_WHOLE_SIZE, 0,
+                                      &new_block->host_ptr) != VK_SUCCESS) {
+    DestroyBlock(new_block.get());
+    return Result("Vulkan::Calling vkMapMemory Fail");
+  }
+
+  new_block->free_ranges[0] = size;
+  blocks_.push_back(std::move(new_block));
+  *block = blocks_.back().get();
+  return {};
+}
+
+void MemoryAllocator::DestroyBlock(Block* block) {
+  if (block->memory == VK_NULL_HANDLE)
+    return;
+
+  if (block->host_ptr)
+    device_->GetPtrs()->vkUnmapMemory(device_->GetVkDevice(), block->memory);
+  device_->GetPtrs()->vkFreeMemory(device_->GetVkDevice(), block->memory,
+                                   nullptr);
+  block->memory = VK_NULL_HANDLE;
+  block->host_ptr = nullptr;
+}
+
+bool MemoryAllocator::HasOtherEmptyBlock(const Block* block) const {
+  for (const auto& other : blocks_) {
+    if (other.get() != block && other->allocation_count == 0 &&
+        other->memory_type_index == block->memory_type_index &&
+        other->is_image == block->is_image) {
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace vulkan
+}  // namespace amber
@@ -0,0 +1,126 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_VULKAN_MEMORY_ALLOCATOR_H_
+#define SRC_VULKAN_MEMORY_ALLOCATOR_H_
+
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "amber/result.h"
+#include "amber/vulkan_header.h"
+
+namespace amber {
+namespace vulkan {
+
+class Device;
+
+/// A range of device memory handed out by a MemoryAllocator.
+struct MemoryAllocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  /// Points to the start of the range if the memory is host visible,
+  /// nullptr otherwise.
+  void* host_ptr = nullptr;
+};
+
+/// Sub-allocates buffer and image memory from large VkDeviceMemory blocks, so
+/// the number of vkAllocateMemory calls does not grow with the number of
+/// resources. Blocks are kept per memory type, and separately for buffers and
+/// images so linear and optimal resources never share a block and
+/// bufferImageGranularity does not have to be taken into account. Host
+/// visible buffer blocks are mapped once for their whole lifetime.
+class MemoryAllocator {
+ public:
+  /// Usage statistics of the allocator.
+  struct Stats {
+    /// The number of VkDeviceMemory blocks currently allocated.
+    uint32_t block_count = 0;
+    /// The total size of all blocks, in bytes.
+    VkDeviceSize block_bytes = 0;
+    /// The number of live allocations.
+    uint32_t allocation_count = 0;
+    /// The size of all live allocations, in bytes.
+    VkDeviceSize used_bytes = 0;
+    /// The largest value |used_bytes| reached.
+    VkDeviceSize peak_used_bytes = 0;
+    /// The number of free ranges in all blocks.
+    uint32_t free_range_count = 0;
+    /// The size of the largest free range, in bytes.
+    VkDeviceSize largest_free_range = 0;
+
+    /// Returns 0 if the free memory is a single range, approaching 100 as it
+    /// is split into more and smaller ranges.
+    uint32_t GetFragmentationPercent() const;
+  };
+
+  static const VkDeviceSize kDefaultBlockSize;
+
+  MemoryAllocator(Device* device, VkDeviceSize block_size);
+  ~MemoryAllocator();
+
+  /// Allocates a range satisfying |requirements| from the memory type at
+  /// |memory_type_index|. |is_image| must be true if the range is bound to an
+  /// optimally tiled image.
+  Result Allocate(const VkMemoryRequirements& requirements,
+                  uint32_t memory_type_index,
+                  bool is_image,
+                  MemoryAllocation* allocation);
+  /// Returns the range in |allocation| to its block and resets |allocation|.
+  void Free(MemoryAllocation* allocation);
+
+  Stats GetStats() const;
+
+ private:
+  struct Block {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    uint32_t memory_type_index = 0;
+    bool is_image = false;
+    void* host_ptr = nullptr;
+    uint32_t allocation_count = 0;
+    /// The free ranges of the block, from offset to size. Adjacent ranges are
+    /// always merged.
+    std::map<VkDeviceSize, VkDeviceSize> free_ranges;
+  };
+
+  /// Takes a range of |size| bytes aligned to |alignment| from |block|.
+  /// Returns false if no free range of |block| is large enough.
+  bool AllocateFromBlock(Block* block,
+                         VkDeviceSize size,
+                         VkDeviceSize alignment,
+                         VkDeviceSize* offset);
+  Result CreateBlock(VkDeviceSize size,
+                     uint32_t memory_type_index,
+                     bool is_image,
+                     Block** block);
+  void DestroyBlock(Block* block);
+  /// Returns true if a block other than |block| with the same memory type and
+  /// resource kind has no allocations.
+  bool HasOtherEmptyBlock(const Block* block) const;
+
+  Device* device_ = nullptr;
+  VkDeviceSize block_size_ = 0;
+  std::vector<std::unique_ptr<Block>> blocks_;
+  VkDeviceSize used_bytes_ = 0;
+  VkDeviceSize peak_used_bytes_ = 0;
+  uint32_t allocation_count_ = 0;
+};
+
+}  // namespace vulkan
+}  // namespace amber
+
+#endif  // SRC_VULKAN_MEMORY_ALLOCATOR_H_
@@ -0,0 +1,190 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/vulkan/object_cache.h"
+
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+#include "src/vulkan/device.h"
+
+namespace amber {
+namespace vulkan {
+namespace {
+
+const uint64_t kFnvOffsetBasis = 0xcbf29ce484222325ULL;
+
+// 64-bit FNV-1a, one 32-bit word at a time.
+uint64_t HashWord(uint64_t hash, uint32_t word) {
+  for (uint32_t i = 0; i < 4; ++i) {
+    hash ^= (word >> (i * 8)) & 0xff;
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+uint32_t FloatBits(float value) {
+  uint32_t bits = 0;
+  std::memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+// The state of a sampler, without the members which only describe the
+// structure.
+using SamplerState = std::array<uint32_t, 16>;
+
+SamplerState GetSamplerState(const VkSamplerCreateInfo& info) {
+  return {{static_cast<uint32_t>(info.flags),
+           static_cast<uint32_t>(info.magFilter),
+           static_cast<uint32_t>(info.minFilter),
+           static_cast<uint32_t>(info.mipmapMode),
+           static_cast<uint32_t>(info.addressModeU),
+           static_cast<uint32_t>(info.addressModeV),
+           static_cast<uint32_t>(info.addressModeW),
+           FloatBits(info.mipLodBias),
+           static_cast<uint32_t>(info.anisotropyEnable),
+           FloatBits(info.maxAnisotropy),
+           static_cast<uint32_t>(info.compareEnable),
+           static_cast<uint32_t>(info.compareOp),
+           FloatBits(info.minLod),
+           FloatBits(info.maxLod),
+           static_cast<uint32_t>(info.borderColor),
+           static_cast<uint32_t>(info.unnormalizedCoordinates)}};
+}
+
+}  // namespace
+
+ObjectCache::ObjectCache(Device* device) : device_(device) {}
+
+ObjectCache::~ObjectCache() {
+  // Every user should have released its objects, destroy anything left over
+  // so the device can be destroyed.
+  for (auto& it : shader_modules_) {
+    device_->GetPtrs()->vkDestroyShaderModule(device_->GetVkDevice(),
+                                              it.second.module, nullptr);
+  }
+  for (auto& it : samplers_) {
+    device_->GetPtrs()->vkDestroySampler(device_->GetVkDevice(),
+                                         it.second.sampler, nullptr);
+  }
+}
+
+Result ObjectCache::AcquireShaderModule(const std::vector<uint32_t>& code,
+                                        VkShaderModule* module) {
+  uint64_t hash = kFnvOffsetBasis;
+  for (uint32_t word : code)
+    hash = HashWord(hash, word);
+
+  auto range = shader_modules_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.code == code) {
+      ++it->second.ref_count;
+      ++stats_.reused_count;
+      *module = it->second.module;
+      return {};
+    }
+  }
+
+  VkShaderModuleCreateInfo create_info = VkShaderModuleCreateInfo();
+  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  create_info.codeSize = code.size() * sizeof(uint32_t);
+  create_info.pCode = code.data();
+
+  ShaderModuleEntry entry;
+  if (device_->GetPtrs()->vkCreateShaderModule(device_->GetVkDevice(),
+                                               &create_info, nullptr,
+                                               &entry.module) != VK_SUCCESS) {
+    return Result("Vulkan::Calling vkCreateShaderModule Fail");
+  }
+  entry.code = code;
+  entry.ref_count = 1;
+  ++stats_.created_count;
+
+  *module = entry.module;
+  shader_modules_.emplace(hash, std::move(entry));
+  return {};
+}
+
+void ObjectCache::ReleaseShaderModule(VkShaderModule module) {
+  for (auto it = shader_modules_.begin(); it != shader_modules_.end(); ++it) {
+    if (it->second.module != module)
+      continue;
+
+    assert(it->second.ref_count > 0);
+    if (--it->second.ref_count == 0) {
+      // A module created later may get the same handle, so libraries keyed
+      // by this one must go.
+      if (device_->GetPipelineLibraryCache())
+        device_->GetPipelineLibraryCache()->ForgetShaderModule(module);
+      device_->GetPtrs()->vkDestroyShaderModule(device_->GetVkDevice(), module,
+                                                nullptr);
+      shader_modules_.erase(it);
+    }
+    return;
+  }
+}
+
+Result ObjectCache::AcquireSampler(const VkSamplerCreateInfo& info,
+                                   VkSampler* sampler) {
+  assert(info.pNext == nullptr);
+
+  const SamplerState state = GetSamplerState(info);
+  uint64_t hash = kFnvOffsetBasis;
+  for (uint32_t word : state)
+    hash = HashWord(hash, word);
+
+  auto range = samplers_.equal_range(hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (GetSamplerState(it->second.info) == state) {
+      ++it->second.ref_count;
+      ++stats_.reused_count;
+      *sampler = it->second.sampler;
+      return {};
+    }
+  }
+
+  SamplerEntry entry;
+  if (device_->GetPtrs()->vkCreateSampler(device_->GetVkDevice(), &info,
+                                          nullptr,
+                                          &entry.sampler) != VK_SUCCESS) {
+    return Result("Vulkan::Calling vkCreateSampler Fail");
+  }
+  entry.info = info;
+  entry.ref_count = 1;
+  ++stats_.created_count;
+
+  *sampler = entry.sampler;
+  samplers_.emplace(hash, entry);
+  return {};
+}
+
+void ObjectCache::ReleaseSampler(VkSampler sampler) {
+  for (auto it = samplers_.begin(); it != samplers_.end(); ++it) {
+    if (it->second.sampler != sampler)
+      continue;
+
+    assert(it->second.ref_count > 0);
+    if (--it->second.ref_count == 0) {
+      device_->GetPtrs()->vkDestroySampler(device_->GetVkDevice(), sampler,
+                                           nullptr);
+      samplers_.erase(it);
+    }
+    return;
+  }
+}
+
+}  // namespace vulkan
+}  // namespace amber
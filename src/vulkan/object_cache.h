@@ -0,0 +1,84 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_VULKAN_OBJECT_CACHE_H_
+#define SRC_VULKAN_OBJECT_CACHE_H_
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "amber/result.h"
+#include "amber/vulkan_header.h"
+
+namespace amber {
+namespace vulkan {
+
+class Device;
+
+/// Shares immutable Vulkan objects between all users on a device, so
+/// pipelines attaching the same SPIR-V or binding samplers with the same
+/// state create the object once. Objects are reference counted and
+/// destroyed when their last user releases them.
+class ObjectCache {
+ public:
+  /// Usage statistics of the cache.
+  struct Stats {
+    /// The number of shader modules and samplers created.
+    uint32_t created_count = 0;
+    /// The number of requests served by an existing object.
+    uint32_t reused_count = 0;
+  };
+
+  explicit ObjectCache(Device* device);
+  ~ObjectCache();
+
+  /// Returns in |module| a shader module for the SPIR-V in |code|. The module
+  /// must be given back with ReleaseShaderModule().
+  Result AcquireShaderModule(const std::vector<uint32_t>& code,
+                             VkShaderModule* module);
+  void ReleaseShaderModule(VkShaderModule module);
+
+  /// Returns in |sampler| a sampler created with |info|. The sampler must be
+  /// given back with ReleaseSampler(). |info| must not have a pNext chain.
+  Result AcquireSampler(const VkSamplerCreateInfo& info, VkSampler* sampler);
+  void ReleaseSampler(VkSampler sampler);
+
+  const Stats& GetStats() const { return stats_; }
+
+ private:
+  struct ShaderModuleEntry {
+    std::vector<uint32_t> code;
+    VkShaderModule module = VK_NULL_HANDLE;
+    uint32_t ref_count = 0;
+  };
+
+  struct SamplerEntry {
+    VkSamplerCreateInfo info;
+    VkSampler sampler = VK_NULL_HANDLE;
+    uint32_t ref_count = 0;
+  };
+
+  Device* device_ = nullptr;
+  // Keyed by the hash of the SPIR-V and of the sampler state. Entries with
+  // colliding hashes are told apart by comparing the full key.
+  std::unordered_multimap<uint64_t, ShaderModuleEntry> shader_modules_;
+  std::unordered_multimap<uint64_t, SamplerEntry> samplers_;
+  Stats stats_;
+};
+
+}  // namespace vulkan
+}  // namespace amber
+
+#endif  // SRC_VULKAN_OBJECT_CACHE_H_
@@ -15,6 +15,7 @@
 #include "src/vulkan/pipeline.h"
 
 #include <algorithm>
+#include <cassert>
 #include <limits>
 #include <utility>
 
@@ -24,9 +25,12 @@
 #include "src/vulkan/buffer_descriptor.h"
 #include "src/vulkan/compute_pipeline.h"
 #include "src/vulkan/device.h"
+#include "src/vulkan/gpu_timer.h"
 #include "src/vulkan/graphics_pipeline.h"
 #include "src/vulkan/image_descriptor.h"
+#include "src/vulkan/index_buffer.h"
 #include "src/vulkan/sampler_descriptor.h"
+#include "src/vulkan/vertex_buffer.h"
 
 namespace amber {
 namespace vulkan {
@@ -34,6 +38,10 @@ namespace {
 
 const char* kDefaultEntryPointName = "main";
 
+// The number of submissions a pipeline keeps executing while the host records
+// the next command.
+const size_t kMaxSubmissionsInFlight = 3;
+
 }  // namespace
 
 Pipeline::Pipeline(
@@ -49,8 +57,17 @@ Pipeline::Pipeline(
 Pipeline::~Pipeline() {
   // Command must be reset before we destroy descriptors or we get a validation
   // error.
+  WaitForCommandsInFlight();
+  in_flight_.clear();
+  spare_commands_.clear();
+  pending_guard_ = nullptr;
   command_ = nullptr;
 
+  if (pipeline_layout_ != VK_NULL_HANDLE) {
+    device_->GetPtrs()->vkDestroyPipelineLayout(device_->GetVkDevice(),
+                                                pipeline_layout_, nullptr);
+  }
+
   for (auto& info : descriptor_set_info_) {
     if (info.layout != VK_NULL_HANDLE) {
       device_->GetPtrs()->vkDestroyDescriptorSetLayout(device_->GetVkDevice(),
@@ -78,7 +95,8 @@ ComputePipeline* Pipeline::AsCompute() {
 Result Pipeline::Initialize(CommandPool* pool) {
   push_constant_ = MakeUnique<PushConstant>(device_);
 
-  command_ = MakeUnique<CommandBuffer>(device_, pool);
+  pool_ = pool;
+  command_ = MakeUnique<CommandBuffer>(device_, pool_);
   return command_->Initialize();
 }
 
@@ -171,11 +189,53 @@ Result Pipeline::CreateDescriptorSets() {
   return {};
 }
 
-Result Pipeline::CreateVkPipelineLayout(VkPipelineLayout* pipeline_layout) {
+Result Pipeline::GetVkPipelineLayout(VkPipelineLayout* pipeline_layout) {
   Result r = CreateVkDescriptorRelatedObjectsIfNeeded();
   if (!r.IsSuccess())
     return r;
 
+  VkPushConstantRange push_const_range =
+      push_constant_->GetVkPushConstantRange();
+  if (pipeline_layout_ != VK_NULL_HANDLE) {
+    if (push_const_range.stageFlags ==
+            pipeline_layout_push_constant_range_.stageFlags &&
+        push_const_range.offset ==
+            pipeline_layout_push_constant_range_.offset &&
+        push_const_range.size == pipeline_layout_push_constant_range_.size) {
+      *pipeline_layout = pipeline_layout_;
+      return {};
+    }
+
+    // Cached pipelines reference the old layout so they must go first.
+    DestroyCachedVkPipelines();
+    device_->GetPtrs()->vkDestroyPipelineLayout(device_->GetVkDevice(),
+                                                pipeline_layout_, nullptr);
+    pipeline_layout_ = VK_NULL_HANDLE;
+  }
+
+  r = CreateVkPipelineLayout(&pipeline_layout_);
+  if (!r.IsSuccess())
+    return r;
+
+  pipeline_layout_push_constant_range_ = push_const_range;
+  *pipeline_layout = pipeline_layout_;
+  return {};
+}
+
+void Pipeline::GetPipelineLayoutDesc(
+    PipelineLibraryCache::LayoutDesc* desc) const {
+  desc->sets.clear();
+  for (const auto& info : descriptor_set_info_) {
+    desc->sets.emplace_back();
+    for (const auto& descriptor : info.descriptors) {
+      desc->sets.back().emplace_back(descriptor->GetBinding(),
+                                     descriptor->GetVkDescriptorType());
+    }
+  }
+  desc->push_constant_range = pipeline_layout_push_constant_range_;
+}
+
+Result Pipeline::CreateVkPipelineLayout(VkPipelineLayout* pipeline_layout) {
   std::vector<VkDescriptorSetLayout> descriptor_set_layouts;
   for (const auto& desc_set : descriptor_set_info_)
     descriptor_set_layouts.push_back(desc_set.layout);
@@ -314,6 +374,8 @@ Result Pipeline::AddBufferDescriptor(const BufferCommand* cmd) {
       auto buffer_desc = MakeUnique<BufferDescriptor>(
           cmd->GetBuffer(), desc_type, device_, cmd->GetDescriptorSet(),
           cmd->GetBinding());
+      buffer_desc->SetDeviceLocal(UseDeviceLocalMemory(cmd->GetBuffer()));
+      MarkSharedHostStorage(buffer_desc.get());
       descriptors.push_back(std::move(buffer_desc));
     }
 
@@ -347,6 +409,23 @@ Result Pipeline::AddBufferDescriptor(const BufferCommand* cmd) {
   return {};
 }
 
+void Pipeline::MarkSharedHostStorage(BufferDescriptor* buffer_desc) {
+  for (auto& info : descriptor_set_info_) {
+    for (auto& desc : info.descriptors) {
+      // Storage and uniform buffers are always bound by a BufferDescriptor.
+      if (!desc->IsStorageBuffer() && !desc->IsUniformBuffer())
+        continue;
+
+      auto* other = static_cast<BufferDescriptor*>(desc.get());
+      if (other->getAmberBuffer() != buffer_desc->getAmberBuffer())
+        continue;
+
+      other->SetHostStorageShared(true);
+      buffer_desc->SetHostStorageShared(true);
+    }
+  }
+}
+
 Result Pipeline::AddSamplerDescriptor(const SamplerCommand* cmd) {
   if (cmd == nullptr)
     return Result("Pipeline::AddSamplerDescriptor SamplerCommand is nullptr");
@@ -371,83 +450,352 @@ Result Pipeline::AddSamplerDescriptor(const SamplerCommand* cmd) {
   return {};
 }
 
-Result Pipeline::SendDescriptorDataToDeviceIfNeeded() {
-  {
-    CommandBufferGuard guard(GetCommandBuffer());
-    if (!guard.IsRecording())
-      return guard.GetResult();
+Result Pipeline::CreateDescriptorResourcesIfNeeded() {
+  assert(!HasPendingCommands());
 
-    for (auto& info : descriptor_set_info_) {
-      for (auto& desc : info.descriptors) {
-        Result r = desc->CreateResourceIfNeeded();
-        if (!r.IsSuccess())
-          return r;
-      }
+  // Creating the resources records no commands, their data is copied when
+  // recording starts. Submitting here would make the host wait for the
+  // commands still in flight.
+  for (auto& info : descriptor_set_info_) {
+    for (auto& desc : info.descriptors) {
+      Result r = desc->CreateResourceIfNeeded();
+      if (!r.IsSuccess())
+        return r;
     }
-
-    // Note that if a buffer for a descriptor is host accessible and
-    // does not need to record a command to copy data to device, it
-    // directly writes data to the buffer. The direct write must be
-    // done after resizing backed buffer i.e., copying data to the new
-    // buffer from the old one. Thus, we must submit commands here to
-    // guarantee this.
-    Result r = guard.Submit(GetFenceTimeout());
-    if (!r.IsSuccess())
-      return r;
   }
+  return {};
+}
 
-  CommandBufferGuard guard(GetCommandBuffer());
-  if (!guard.IsRecording())
-    return guard.GetResult();
-
+void Pipeline::RecordCopyDescriptorDataToDevice() {
   for (auto& info : descriptor_set_info_) {
     for (auto& desc : info.descriptors)
       desc->RecordCopyDataToResourceIfNeeded(command_.get());
   }
-  return guard.Submit(GetFenceTimeout());
+  for (auto& info : descriptor_set_info_) {
+    for (auto& desc : info.descriptors)
+      desc->ReleaseUploadedHostData();
+  }
 }
 
-void Pipeline::BindVkDescriptorSets(const VkPipelineLayout& pipeline_layout) {
-  for (size_t i = 0; i < descriptor_set_info_.size(); ++i) {
-    if (descriptor_set_info_[i].empty)
-      continue;
+void Pipeline::RecordMemoryBarrier() {
+  VkMemoryBarrier barrier = VkMemoryBarrier();
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+  device_->GetPtrs()->vkCmdPipelineBarrier(
+      command_->GetVkCommandBuffer(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+      VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0,
+      nullptr);
+}
 
-    device_->GetPtrs()->vkCmdBindDescriptorSets(
-        command_->GetVkCommandBuffer(),
-        IsGraphics() ? VK_PIPELINE_BIND_POINT_GRAPHICS
-                     : VK_PIPELINE_BIND_POINT_COMPUTE,
-        pipeline_layout, static_cast<uint32_t>(i), 1,
-        &descriptor_set_info_[i].vk_desc_set, 0, nullptr);
+Result Pipeline::StartRecordingCommand() {
+  if (pending_guard_) {
+    // Make the writes of the pending commands visible to the new one.
+    RecordMemoryBarrier();
+    return gpu_timer_ ? gpu_timer_->Start(command_.get()) : Result();
   }
+
+  auto guard =
+      MakeUnique<CommandBufferGuard>(GetCommandBuffer(), record_for_replay_);
+  if (!guard->IsRecording())
+    return guard->GetResult();
+
+  pending_guard_ = std::move(guard);
+
+  // A replayed recording must see the writes of the previous replay, and any
+  // recording the writes of the submissions still in flight.
+  if (record_for_replay_ || HasCommandsInFlight())
+    RecordMemoryBarrier();
+
+  // The descriptor uploads are part of the measured command.
+  if (gpu_timer_) {
+    Result r = gpu_timer_->Start(command_.get());
+    if (!r.IsSuccess()) {
+      DiscardPendingCommands();
+      return r;
+    }
+  }
+  RecordCopyDescriptorDataToDevice();
+  return {};
 }
 
-Result Pipeline::ReadbackDescriptorsToHostDataQueue() {
-  {
-    CommandBufferGuard guard(GetCommandBuffer());
-    if (!guard.IsRecording())
-      return guard.GetResult();
+void Pipeline::DiscardPendingCommands() {
+  record_for_replay_ = false;
+  if (!pending_guard_)
+    return;
+
+  pending_guard_ = nullptr;
+  ReleasePendingResources(false);
+  if (gpu_timer_)
+    gpu_timer_->Discard();
+  if (statistics_queries_)
+    statistics_queries_->Discard();
+}
+
+void Pipeline::AddPendingUpload(VertexBuffer* vertex_buffer) {
+  pending_vertex_uploads_.push_back(vertex_buffer);
+}
+
+void Pipeline::AddPendingUpload(IndexBuffer* index_buffer) {
+  pending_index_uploads_.push_back(index_buffer);
+}
+
+void Pipeline::ReleasePendingResources(bool executed) {
+  if (!executed) {
+    for (auto* vertex_buffer : pending_vertex_uploads_)
+      vertex_buffer->MarkVertexDataPending();
+    for (auto* index_buffer : pending_index_uploads_)
+      index_buffer->MarkIndexDataPending();
+  }
+  pending_vertex_uploads_.clear();
+  pending_index_uploads_.clear();
+  pending_vertex_buffers_.clear();
+}
 
-    for (auto& desc_set : descriptor_set_info_) {
-      for (auto& desc : desc_set.descriptors)
-        desc->RecordCopyDataToHost(command_.get());
+void Pipeline::StopGpuTimer(const char* type) {
+  if (gpu_timer_)
+    gpu_timer_->Stop(command_.get(), type);
+}
+
+Result Pipeline::BeginStatisticsQuery() {
+  if (!statistics_queries_)
+    return {};
+  return statistics_queries_->Begin(command_.get());
+}
+
+void Pipeline::EndStatisticsQuery(const char* type) {
+  if (statistics_queries_)
+    statistics_queries_->End(command_.get(), type);
+}
+
+bool Pipeline::IsReadbackNeeded(const Buffer* buffer) const {
+  for (const auto& desc_set : descriptor_set_info_) {
+    for (const auto& desc : desc_set.descriptors) {
+      if (desc->IsReadbackNeeded(buffer))
+        return true;
     }
+  }
+  return false;
+}
 
-    Result r = guard.Submit(GetFenceTimeout());
-    if (!r.IsSuccess())
-      return r;
+bool Pipeline::CanUpdateBufferInPlace(const Buffer* buffer) const {
+  for (const auto& desc_set : descriptor_set_info_) {
+    for (const auto& desc : desc_set.descriptors) {
+      if (desc->IsReadbackNeeded(buffer) && !desc->CanUploadRanges())
+        return false;
+    }
   }
+  return true;
+}
 
+Result Pipeline::RecordCopyBufferToHost(const Buffer* buffer) {
   for (auto& desc_set : descriptor_set_info_) {
     for (auto& desc : desc_set.descriptors) {
+      if (!desc->IsReadbackNeeded(buffer))
+        continue;
+
+      Result r = desc->RecordCopyDataToHost(command_.get());
+      if (!r.IsSuccess())
+        return r;
+    }
+  }
+  return {};
+}
+
+Result Pipeline::CopyHostMemoryToBuffer(const Buffer* buffer) {
+  for (auto& desc_set : descriptor_set_info_) {
+    for (auto& desc : desc_set.descriptors) {
+      if (!desc->IsReadbackNeeded(buffer))
+        continue;
+
       Result r = desc->MoveResourceToBufferOutput();
       if (!r.IsSuccess())
         return r;
     }
   }
+  return {};
+}
+
+Result Pipeline::SubmitPendingCommands() {
+  // The fence of the pending commands does not cover earlier submissions.
+  Result r = WaitForCommandsInFlight();
+  if (!r.IsSuccess()) {
+    DiscardPendingCommands();
+    return r;
+  }
+  if (!pending_guard_)
+    return {};
+
+  r = pending_guard_->Submit(GetFenceTimeout());
+  pending_guard_ = nullptr;
+  ReleasePendingResources(r.IsSuccess());
+  if (gpu_timer_) {
+    if (!r.IsSuccess())
+      gpu_timer_->Discard();
+    else
+      r = gpu_timer_->Resolve();
+  }
+  if (statistics_queries_) {
+    if (!r.IsSuccess())
+      statistics_queries_->Discard();
+    else
+      r = statistics_queries_->Resolve();
+  }
+  return r;
+}
+
+Result Pipeline::FlushPendingCommands() {
+  if (!pending_guard_)
+    return {};
+  // Timings and statistics are resolved once their commands completed.
+  if (gpu_timer_ || statistics_queries_)
+    return SubmitPendingCommands();
+
+  if (in_flight_.size() >= kMaxSubmissionsInFlight) {
+    Result r = WaitForOldestSubmission();
+    if (!r.IsSuccess()) {
+      DiscardPendingCommands();
+      return r;
+    }
+  }
 
+  std::unique_ptr<CommandBuffer> next;
+  if (!spare_commands_.empty()) {
+    next = std::move(spare_commands_.back());
+    spare_commands_.pop_back();
+  } else {
+    next = MakeUnique<CommandBuffer>(device_, pool_);
+    Result r = next->Initialize();
+    if (!r.IsSuccess()) {
+      DiscardPendingCommands();
+      return r;
+    }
+  }
+
+  Result r = pending_guard_->SubmitWithoutWaiting();
+  pending_guard_ = nullptr;
+  if (!r.IsSuccess()) {
+    ReleasePendingResources(false);
+    spare_commands_.push_back(std::move(next));
+    return r;
+  }
+
+  Submission submission;
+  submission.command = std::move(command_);
+  submission.vertex_buffers = std::move(pending_vertex_buffers_);
+  ReleasePendingResources(true);
+  in_flight_.push_back(std::move(submission));
+  command_ = std::move(next);
   return {};
 }
 
+Result Pipeline::WaitForOldestSubmission() {
+  Submission submission = std::move(in_flight_.front());
+  in_flight_.pop_front();
+
+  Result r = submission.command->WaitAndReset(GetFenceTimeout());
+  // A command buffer which did not complete can not be recorded again.
+  if (r.IsSuccess())
+    spare_commands_.push_back(std::move(submission.command));
+  return r;
+}
+
+Result Pipeline::WaitForCommandsInFlight() {
+  Result result;
+  while (!in_flight_.empty()) {
+    Result r = WaitForOldestSubmission();
+    if (result.IsSuccess())
+      result = r;
+  }
+  return result;
+}
+
+void Pipeline::RetainUntilExecuted(
+    std::unique_ptr<VertexBuffer> vertex_buffer) {
+  if (HasPendingCommands())
+    pending_vertex_buffers_.push_back(std::move(vertex_buffer));
+}
+
+void Pipeline::StartReplayRecording() {
+  assert(!HasPendingCommands());
+  record_for_replay_ = true;
+}
+
+Result Pipeline::ReplayPendingCommands(uint32_t count) {
+  if (count == 0 || !pending_guard_) {
+    DiscardPendingCommands();
+    return {};
+  }
+
+  Result r = pending_guard_->SubmitRepeatedly(count, GetFenceTimeout());
+  pending_guard_ = nullptr;
+  ReleasePendingResources(r.IsSuccess());
+  record_for_replay_ = false;
+  return r;
+}
+
+Result Pipeline::ReadbackBuffer(const Buffer* buffer) {
+  assert(!HasPendingCommands() && !HasCommandsInFlight());
+
+  if (!IsReadbackNeeded(buffer))
+    return {};
+
+  {
+    CommandBufferGuard guard(GetCommandBuffer());
+    if (!guard.IsRecording())
+      return guard.GetResult();
+
+    Result r;
+    if (gpu_timer_)
+      r = gpu_timer_->Start(command_.get());
+    if (r.IsSuccess())
+      r = RecordCopyBufferToHost(buffer);
+    if (!r.IsSuccess()) {
+      if (gpu_timer_)
+        gpu_timer_->Discard();
+      return r;
+    }
+    StopGpuTimer("readback");
+
+    r = guard.Submit(GetFenceTimeout());
+    if (gpu_timer_) {
+      if (!r.IsSuccess())
+        gpu_timer_->Discard();
+      else
+        r = gpu_timer_->Resolve();
+    }
+    if (!r.IsSuccess())
+      return r;
+  }
+  return CopyHostMemoryToBuffer(buffer);
+}
+
+void Pipeline::BindVkDescriptorSets(const VkPipelineLayout& pipeline_layout) {
+  for (size_t i = 0; i < descriptor_set_info_.size(); ++i) {
+    if (descriptor_set_info_[i].empty)
+      continue;
+
+    device_->GetPtrs()->vkCmdBindDescriptorSets(
+        command_->GetVkCommandBuffer(),
+        IsGraphics() ? VK_PIPELINE_BIND_POINT_GRAPHICS
+                     : VK_PIPELINE_BIND_POINT_COMPUTE,
+        pipeline_layout, static_cast<uint32_t>(i), 1,
+        &descriptor_set_info_[i].vk_desc_set, 0, nullptr);
+  }
+}
+
+void Pipeline::SetEntryPointName(VkShaderStageFlagBits stage,
+                                 const std::string& entry) {
+  auto it = entry_points_.find(stage);
+  if (it != entry_points_.end() && it->second == entry)
+    return;
+
+  // The entry point is baked into the VkPipeline.
+  DestroyCachedVkPipelines();
+  entry_points_[stage] = entry;
+}
+
 const char* Pipeline::GetEntryPointName(VkShaderStageFlagBits stage) const {
   auto it = entry_points_.find(stage);
   if (it != entry_points_.end())
@@ -15,9 +15,12 @@
 #ifndef SRC_VULKAN_PIPELINE_H_
 #define SRC_VULKAN_PIPELINE_H_
 
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "amber/result.h"
@@ -26,7 +29,9 @@
 #include "src/engine.h"
 #include "src/vulkan/buffer_backed_descriptor.h"
 #include "src/vulkan/command_buffer.h"
+#include "src/vulkan/pipeline_library_cache.h"
 #include "src/vulkan/push_constant.h"
+#include "src/vulkan/statistics_queries.h"
 
 namespace amber {
 
@@ -34,9 +39,13 @@ class BufferCommand;
 
 namespace vulkan {
 
+class BufferDescriptor;
 class ComputePipeline;
 class Device;
+class GpuTimer;
 class GraphicsPipeline;
+class IndexBuffer;
+class VertexBuffer;
 
 /// Base class for a pipeline in Vulkan.
 class Pipeline {
@@ -55,18 +64,87 @@ class Pipeline {
   /// Add |buffer| data to the push constants at |offset|.
   Result AddPushConstantBuffer(const Buffer* buf, uint32_t offset);
 
-  /// Reads back the contents of resources of all descriptors to a
-  /// buffer data object and put it into buffer data queue in host.
-  Result ReadbackDescriptorsToHostDataQueue();
+  /// Returns true if commands were recorded into the command buffer but not
+  /// submitted yet.
+  bool HasPendingCommands() const { return pending_guard_ != nullptr; }
+
+  /// Returns true if commands were submitted without waiting for them and
+  /// may still be executing.
+  bool HasCommandsInFlight() const { return !in_flight_.empty(); }
+
+  /// Submits the pending commands and waits for them and all commands in
+  /// flight to complete. The results stay on the device until
+  /// ReadbackBuffer() is called.
+  Result SubmitPendingCommands();
+  /// Submits the pending commands without waiting for them, so the next
+  /// command can be recorded while they execute. At most
+  /// kMaxSubmissionsInFlight submissions are in flight, beyond that the
+  /// oldest one is waited for first. If GPU time or statistics are measured
+  /// this waits like SubmitPendingCommands().
+  Result FlushPendingCommands();
+  /// Waits for all commands in flight to complete.
+  Result WaitForCommandsInFlight();
+  /// Keeps |vertex_buffer| alive until the pending commands, which use it,
+  /// completed.
+  void RetainUntilExecuted(std::unique_ptr<VertexBuffer> vertex_buffer);
+
+  /// Records the following draws, dispatches and clears so they can be
+  /// executed several times with ReplayPendingCommands(). Must not be called
+  /// while commands are pending.
+  void StartReplayRecording();
+  /// Submits the commands recorded since StartReplayRecording() |count| times
+  /// and waits for them to complete. Each execution sees the results of the
+  /// previous one. A |count| of 0 drops the commands.
+  Result ReplayPendingCommands(uint32_t count);
+
+  /// Copies the contents the device holds for |buffer| back into |buffer| if
+  /// commands of this pipeline wrote them since the last readback. Must not
+  /// be called while commands are pending.
+  Result ReadbackBuffer(const Buffer* buffer);
+  /// Returns true if values can be written into |buffer| on the host without
+  /// reading back the contents the device holds for it first. The written
+  /// ranges are then uploaded on top of the device contents.
+  virtual bool CanUpdateBufferInPlace(const Buffer* buffer) const;
 
   void SetEntryPointName(VkShaderStageFlagBits stage,
-                         const std::string& entry) {
-    entry_points_[stage] = entry;
-  }
+                         const std::string& entry);
 
   CommandBuffer* GetCommandBuffer() const { return command_.get(); }
   Device* GetDevice() const { return device_; }
 
+  /// Sets the timer measuring the GPU time of the recorded commands, nullptr
+  /// if GPU time is not measured. The |timer| is _not_ owned by the pipeline.
+  void SetGpuTimer(GpuTimer* timer) { gpu_timer_ = timer; }
+
+  /// Sets where buffers without a placement of their own are placed.
+  void SetBufferMemory(MemoryPlacement placement) {
+    buffer_memory_ = placement;
+  }
+  /// Returns true if the memory of |buffer| is placed in device local memory.
+  bool UseDeviceLocalMemory(const Buffer* buffer) const {
+    MemoryPlacement placement =
+        buffer ? buffer->GetMemoryPlacement() : MemoryPlacement::kDefault;
+    if (placement == MemoryPlacement::kDefault)
+      placement = buffer_memory_;
+    return placement == MemoryPlacement::kDeviceLocal;
+  }
+
+  /// Sets the queries collecting the pipeline statistics of the recorded
+  /// draws or dispatches, nullptr if statistics are not collected.
+  void SetStatisticsQueries(std::unique_ptr<StatisticsQueries> queries) {
+    statistics_queries_ = std::move(queries);
+  }
+  StatisticsQueries* GetStatisticsQueries() const {
+    return statistics_queries_.get();
+  }
+
+  /// Returns the number of draws, dispatches or precompilations of them
+  /// which re-used a previously created VkPipeline.
+  uint32_t GetPipelineCacheHitCount() const { return pipeline_cache_hits_; }
+  /// Returns the number of draws, dispatches or precompilations of them which
+  /// had to create a new VkPipeline.
+  uint32_t GetPipelineCacheMissCount() const { return pipeline_cache_misses_; }
+
  protected:
   Pipeline(
       PipelineType type,
@@ -82,7 +160,50 @@ class Pipeline {
                            Descriptor** desc);
   void UpdateDescriptorSetsIfNeeded();
 
-  Result SendDescriptorDataToDeviceIfNeeded();
+  /// Creates the resources backing the descriptors. Must not be called while
+  /// commands are pending.
+  Result CreateDescriptorResourcesIfNeeded();
+
+  /// Prepares the command buffer for recording a draw, dispatch or clear.
+  /// If no commands are pending, recording starts and the descriptor data is
+  /// copied to the device first. Otherwise a barrier is recorded so the new
+  /// command sees the results of the pending ones. The command stays pending
+  /// until SubmitPendingCommands() is called. If GPU time is measured, the
+  /// measurement of the command starts here and must be ended with
+  /// StopGpuTimer().
+  Result StartRecordingCommand();
+
+  /// Drops the pending commands without submitting them.
+  void DiscardPendingCommands();
+
+  /// Records that the pending commands upload the data of |vertex_buffer|,
+  /// which is sent again by the next command if they are discarded.
+  void AddPendingUpload(VertexBuffer* vertex_buffer);
+  /// Records that the pending commands upload the indices of |index_buffer|,
+  /// which are sent again by the next command if they are discarded.
+  void AddPendingUpload(IndexBuffer* index_buffer);
+
+  /// Records the end of the GPU time measurement of the command started with
+  /// the last StartRecordingCommand(), reporting it as |type|.
+  void StopGpuTimer(const char* type);
+
+  /// Begins the pipeline statistics query of a draw or dispatch if
+  /// statistics are collected. Must be called outside a render pass.
+  Result BeginStatisticsQuery();
+  /// Ends the query begun by BeginStatisticsQuery(), reporting the command as
+  /// |type|.
+  void EndStatisticsQuery(const char* type);
+
+  /// Returns true if the device holds contents for |buffer| which were not
+  /// read back yet. Derived pipelines extend this with their own attachments.
+  virtual bool IsReadbackNeeded(const Buffer* buffer) const;
+  /// Records copying the device contents of |buffer| to host accessible
+  /// memory.
+  virtual Result RecordCopyBufferToHost(const Buffer* buffer);
+  /// Copies the contents of |buffer| from host accessible memory into
+  /// |buffer| once the recorded copies completed.
+  virtual Result CopyHostMemoryToBuffer(const Buffer* buffer);
+
   void BindVkDescriptorSets(const VkPipelineLayout& pipeline_layout);
 
   /// Records a Vulkan command for push contant.
@@ -96,9 +217,27 @@ class Pipeline {
   const char* GetEntryPointName(VkShaderStageFlagBits stage) const;
   uint32_t GetFenceTimeout() const { return fence_timeout_ms_; }
 
-  Result CreateVkPipelineLayout(VkPipelineLayout* pipeline_layout);
+  /// Returns the pipeline layout in |pipeline_layout|. The layout is created
+  /// on first use and re-used by later draws and dispatches. If the push
+  /// constant range changed since the layout was created, the layout and all
+  /// cached VkPipelines built against it are destroyed and recreated.
+  Result GetVkPipelineLayout(VkPipelineLayout* pipeline_layout);
+  /// Returns in |desc| the description of the layout returned by
+  /// GetVkPipelineLayout(), which must have been called first.
+  void GetPipelineLayoutDesc(PipelineLibraryCache::LayoutDesc* desc) const;
+
+  /// Destroys all VkPipelines cached by the derived pipeline. Called when
+  /// state baked into those pipelines, e.g. the layout or an entry point,
+  /// changes.
+  virtual void DestroyCachedVkPipelines() = 0;
+
+  void RecordPipelineCacheHit() { ++pipeline_cache_hits_; }
+  void RecordPipelineCacheMiss() { ++pipeline_cache_misses_; }
 
   Device* device_ = nullptr;
+  // Guards the VkPipelines cached by the derived pipeline and the cache
+  // statistics, as precompiled VkPipelines are created on other threads.
+  std::mutex vk_pipeline_mutex_;
   std::unique_ptr<CommandBuffer> command_;
 
  private:
@@ -115,6 +254,21 @@ class Pipeline {
   Result CreateDescriptorSetLayouts();
   Result CreateDescriptorPools();
   Result CreateDescriptorSets();
+  Result CreateVkPipelineLayout(VkPipelineLayout* pipeline_layout);
+  /// Marks |buffer_desc| and the descriptors bound to the same buffer as
+  /// sharing its host storage.
+  void MarkSharedHostStorage(BufferDescriptor* buffer_desc);
+  void RecordCopyDescriptorDataToDevice();
+  /// Records a barrier making all memory writes of the commands recorded
+  /// before it visible to the commands recorded after it.
+  void RecordMemoryBarrier();
+  /// Waits for the oldest submission in flight and makes its command buffer
+  /// available for recording again.
+  Result WaitForOldestSubmission();
+  /// Forgets the vertex buffers and uploads of the pending commands once
+  /// they were submitted or dropped. Unless |executed|, the uploads are
+  /// marked as not sent.
+  void ReleasePendingResources(bool executed);
 
   PipelineType pipeline_type_;
   std::vector<DescriptorSetInfo> descriptor_set_info_;
@@ -128,6 +282,34 @@ class Pipeline {
       entry_points_;
 
   std::unique_ptr<PushConstant> push_constant_;
+
+  VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
+  VkPushConstantRange pipeline_layout_push_constant_range_ =
+      VkPushConstantRange();
+  uint32_t pipeline_cache_hits_ = 0;
+  uint32_t pipeline_cache_misses_ = 0;
+
+  struct Submission {
+    std::unique_ptr<CommandBuffer> command;
+    std::vector<std::unique_ptr<VertexBuffer>> vertex_buffers;
+  };
+
+  CommandPool* pool_ = nullptr;
+  // Submissions which may still be executing, oldest first.
+  std::deque<Submission> in_flight_;
+  // Command buffers whose submissions completed, reused before new ones are
+  // allocated.
+  std::vector<std::unique_ptr<CommandBuffer>> spare_commands_;
+  // Vertex buffers used by the pending commands.
+  std::vector<std::unique_ptr<VertexBuffer>> pending_vertex_buffers_;
+  // Vertex and index buffers whose data the pending commands upload.
+  std::vector<VertexBuffer*> pending_vertex_uploads_;
+  std::vector<IndexBuffer*> pending_index_uploads_;
+  std::unique_ptr<CommandBufferGuard> pending_guard_;
+  bool record_for_replay_ = false;
+  GpuTimer* gpu_timer_ = nullptr;
+  std::unique_ptr<StatisticsQueries> statistics_queries_;
+  MemoryPlacement buffer_memory_ = MemoryPlacement::kDeviceLocal;
 };
 
 }  // namespace vulkan
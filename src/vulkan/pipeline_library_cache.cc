@@ -0,0 +1,353 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/vulkan/pipeline_library_cache.h"
+
+#include <algorithm>
+
+#include "src/vulkan/device.h"
+
+namespace amber {
+namespace vulkan {
+
+bool PipelineLibraryCache::LayoutDesc::operator==(
+    const LayoutDesc& other) const {
+  return sets == other.sets &&
+         push_constant_range.stageFlags ==
+             other.push_constant_range.stageFlags &&
+         push_constant_range.offset == other.push_constant_range.offset &&
+         push_constant_range.size == other.push_constant_range.size;
+}
+
+bool PipelineLibraryCache::RenderPassDesc::operator==(
+    const RenderPassDesc& other) const {
+  return color_formats == other.color_formats &&
+         depth_stencil_format == other.depth_stencil_format;
+}
+
+bool PipelineLibraryCache::LibraryKey::operator==(
+    const LibraryKey& other) const {
+  return part == other.part && layout == other.layout &&
+         modules == other.modules && entry_points == other.entry_points &&
+         render_pass == other.render_pass && state == other.state &&
+         pipeline_data == other.pipeline_data;
+}
+
+PipelineLibraryCache::PipelineLibraryCache(Device* device, Delegate* delegate)
+    : device_(device), delegate_(delegate) {}
+
+PipelineLibraryCache::~PipelineLibraryCache() {
+  for (auto& entry : libraries_) {
+    device_->GetPtrs()->vkDestroyPipeline(device_->GetVkDevice(),
+                                          entry.library, nullptr);
+  }
+  for (auto& entry : layouts_) {
+    device_->GetPtrs()->vkDestroyPipelineLayout(device_->GetVkDevice(),
+                                                entry.layout, nullptr);
+    for (auto set_layout : entry.set_layouts) {
+      device_->GetPtrs()->vkDestroyDescriptorSetLayout(device_->GetVkDevice(),
+                                                       set_layout, nullptr);
+    }
+  }
+  for (auto& entry : render_passes_) {
+    device_->GetPtrs()->vkDestroyRenderPass(device_->GetVkDevice(),
+                                            entry.render_pass, nullptr);
+  }
+}
+
+uint64_t PipelineLibraryCache::GetTimestampNs() const {
+  return delegate_ ? delegate_->GetTimestampNs() : 0;
+}
+
+Result PipelineLibraryCache::GetLayout(const LayoutDesc& desc,
+                                       VkPipelineLayout* layout) {
+  for (const auto& entry : layouts_) {
+    if (entry.desc == desc) {
+      *layout = entry.layout;
+      return {};
+    }
+  }
+
+  LayoutEntry entry;
+  entry.desc = desc;
+  // Added before creating anything so the destructor cleans up after a
+  // failure.
+  layouts_.push_back(entry);
+  LayoutEntry& added = layouts_.back();
+
+  for (const auto& set : desc.sets) {
+    std::vector<VkDescriptorSetLayoutBinding> bindings;
+    for (const auto& desc_binding : set) {
+      bindings.emplace_back();
+      bindings.back().binding = desc_binding.first;
+      bindings.back().descriptorType = desc_binding.second;
+      bindings.back().descriptorCount = 1;
+      bindings.back().stageFlags = VK_SHADER_STAGE_ALL;
+    }
+
+    VkDescriptorSetLayoutCreateInfo set_info =
+        VkDescriptorSetLayoutCreateInfo();
+    set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    set_info.bindingCount = static_cast<uint32_t>(bindings.size());
+    set_info.pBindings = bindings.data();
+
+    VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+    if (device_->GetPtrs()->vkCreateDescriptorSetLayout(
+            device_->GetVkDevice(), &set_info, nullptr, &set_layout) !=
+        VK_SUCCESS) {
+      return Result("Vulkan::Calling vkCreateDescriptorSetLayout Fail");
+    }
+    added.set_layouts.push_back(set_layout);
+  }
+
+  VkPipelineLayoutCreateInfo layout_info = VkPipelineLayoutCreateInfo();
+  layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layout_info.setLayoutCount =
+      static_cast<uint32_t>(added.set_layouts.size());
+  layout_info.pSetLayouts = added.set_layouts.data();
+  if (desc.push_constant_range.size > 0) {
+    layout_info.pushConstantRangeCount = 1U;
+    layout_info.pPushConstantRanges = &desc.push_constant_range;
+  }
+
+  if (device_->GetPtrs()->vkCreatePipelineLayout(device_->GetVkDevice(),
+                                                 &layout_info, nullptr,
+                                                 &added.layout) != VK_SUCCESS) {
+    return Result("Vulkan::Calling vkCreatePipelineLayout Fail");
+  }
+
+  *layout = added.layout;
+  return {};
+}
+
+Result PipelineLibraryCache::GetRenderPass(const RenderPassDesc& desc,
+                                           VkRenderPass* render_pass) {
+  for (const auto& entry : render_passes_) {
+    if (entry.desc == desc) {
+      *render_pass = entry.render_pass;
+      return {};
+    }
+  }
+
+  // Only the formats and sample counts matter for compatibility, the load
+  // and store operations and the layouts are those of the graphics
+  // pipelines.
+  VkAttachmentDescription attachment = VkAttachmentDescription();
+  attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+  attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+  attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+  std::vector<VkAttachmentDescription> attachment_desc;
+  std::vector<VkAttachmentReference> color_refer;
+  for (auto format : desc.color_formats) {
+    attachment_desc.push_back(attachment);
+    attachment_desc.back().format = format;
+    attachment_desc.back().initialLayout =
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    attachment_desc.back().finalLayout =
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+    VkAttachmentReference ref = VkAttachmentReference();
+    ref.attachment = static_cast<uint32_t>(attachment_desc.size() - 1);
+    ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    color_refer.push_back(ref);
+  }
+
+  VkSubpassDescription subpass_desc = VkSubpassDescription();
+  subpass_desc.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass_desc.colorAttachmentCount = static_cast<uint32_t>(color_refer.size());
+  subpass_desc.pColorAttachments = color_refer.data();
+
+  VkAttachmentReference depth_refer = VkAttachmentReference();
+  if (desc.depth_stencil_format != VK_FORMAT_UNDEFINED) {
+    attachment_desc.push_back(attachment);
+    attachment_desc.back().format = desc.depth_stencil_format;
+    attachment_desc.back().initialLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    attachment_desc.back().finalLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+    depth_refer.attachment = static_cast<uint32_t>(attachment_desc.size() - 1);
+    depth_refer.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    subpass_desc.pDepthStencilAttachment = &depth_refer;
+  }
+
+  VkRenderPassCreateInfo render_pass_info = VkRenderPassCreateInfo();
+  render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+  render_pass_info.attachmentCount =
+      static_cast<uint32_t>(attachment_desc.size());
+  render_pass_info.pAttachments = attachment_desc.data();
+  render_pass_info.subpassCount = 1;
+  render_pass_info.pSubpasses = &subpass_desc;
+
+  RenderPassEntry entry;
+  entry.desc = desc;
+  if (device_->GetPtrs()->vkCreateRenderPass(device_->GetVkDevice(),
+                                             &render_pass_info, nullptr,
+                                             &entry.render_pass) !=
+      VK_SUCCESS) {
+    return Result("Vulkan::Calling vkCreateRenderPass Fail");
+  }
+
+  *render_pass = entry.render_pass;
+  render_passes_.push_back(std::move(entry));
+  return {};
+}
+
+bool PipelineLibraryCache::FindLibrary(const LibraryKey& key,
+                                       VkPipeline* library) const {
+  for (const auto& entry : libraries_) {
+    if (entry.key == key) {
+      *library = entry.library;
+      return true;
+    }
+  }
+  return false;
+}
+
+Result PipelineLibraryCache::GetLibrary(const LibraryKey& key,
+                                        VkGraphicsPipelineCreateInfo info,
+                                        VkPipeline* library) {
+  VkGraphicsPipelineLibraryCreateInfoEXT library_info =
+      VkGraphicsPipelineLibraryCreateInfoEXT();
+  library_info.sType =
+      VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+  library_info.pNext = info.pNext;
+  library_info.flags = key.part;
+
+  info.pNext = &library_info;
+  info.flags |= VK_PIPELINE_CREATE_LIBRARY_BIT_KHR;
+  // Only the parts with shaders use a layout.
+  const VkGraphicsPipelineLibraryFlagsEXT shader_parts =
+      VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT |
+      VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT;
+  info.layout = VK_NULL_HANDLE;
+  // All parts but the vertex input use a render pass. The one of the cache
+  // outlives the libraries, unlike the render pass of a graphics pipeline.
+  info.renderPass = VK_NULL_HANDLE;
+  info.subpass = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (FindLibrary(key, library))
+      return {};
+
+    if (key.part & shader_parts) {
+      Result r = GetLayout(key.layout, &info.layout);
+      if (!r.IsSuccess())
+        return r;
+    }
+    if (key.part !=
+        VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT) {
+      Result r = GetRenderPass(key.render_pass, &info.renderPass);
+      if (!r.IsSuccess())
+        return r;
+    }
+  }
+
+  // Created without holding the lock, so other threads can build pipelines
+  // meanwhile.
+  LibraryEntry entry;
+  entry.key = key;
+
+  const uint64_t start = GetTimestampNs();
+  if (device_->GetPtrs()->vkCreateGraphicsPipelines(
+          device_->GetVkDevice(), device_->GetVkPipelineCache(), 1, &info,
+          nullptr, &entry.library) != VK_SUCCESS) {
+    return Result("Vulkan::Calling vkCreateGraphicsPipelines Fail");
+  }
+  const uint64_t elapsed = GetTimestampNs() - start;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.library_ns += elapsed;
+  ++stats_.library_count;
+
+  // Another thread may have created the same library meanwhile.
+  if (FindLibrary(key, library)) {
+    device_->GetPtrs()->vkDestroyPipeline(device_->GetVkDevice(),
+                                          entry.library, nullptr);
+    return {};
+  }
+
+  *library = entry.library;
+  libraries_.push_back(std::move(entry));
+  return {};
+}
+
+Result PipelineLibraryCache::LinkPipeline(
+    const std::vector<VkPipeline>& libraries,
+    VkPipelineLayout layout,
+    VkRenderPass render_pass,
+    VkPipeline* pipeline) {
+  VkPipelineLibraryCreateInfoKHR link_info = VkPipelineLibraryCreateInfoKHR();
+  link_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+  link_info.libraryCount = static_cast<uint32_t>(libraries.size());
+  link_info.pLibraries = libraries.data();
+
+  VkGraphicsPipelineCreateInfo info = VkGraphicsPipelineCreateInfo();
+  info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  info.pNext = &link_info;
+  info.layout = layout;
+  info.renderPass = render_pass;
+  info.subpass = 0;
+
+  const uint64_t start = GetTimestampNs();
+  if (device_->GetPtrs()->vkCreateGraphicsPipelines(
+          device_->GetVkDevice(), device_->GetVkPipelineCache(), 1, &info,
+          nullptr, pipeline) != VK_SUCCESS) {
+    return Result("Vulkan::Calling vkCreateGraphicsPipelines Fail");
+  }
+  const uint64_t elapsed = GetTimestampNs() - start;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.link_ns += elapsed;
+  ++stats_.linked_count;
+  return {};
+}
+
+Result PipelineLibraryCache::CompilePipeline(
+    const VkGraphicsPipelineCreateInfo& info,
+    VkPipeline* pipeline) {
+  const uint64_t start = GetTimestampNs();
+  if (device_->GetPtrs()->vkCreateGraphicsPipelines(
+          device_->GetVkDevice(), device_->GetVkPipelineCache(), 1, &info,
+          nullptr, pipeline) != VK_SUCCESS) {
+    return Result("Vulkan::Calling vkCreateGraphicsPipelines Fail");
+  }
+  const uint64_t elapsed = GetTimestampNs() - start;
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  stats_.compile_ns += elapsed;
+  ++stats_.compiled_count;
+  return {};
+}
+
+void PipelineLibraryCache::ForgetShaderModule(VkShaderModule module) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto end = std::remove_if(
+      libraries_.begin(), libraries_.end(), [this, module](LibraryEntry& e) {
+        if (std::find(e.key.modules.begin(), e.key.modules.end(), module) ==
+            e.key.modules.end()) {
+          return false;
+        }
+        device_->GetPtrs()->vkDestroyPipeline(device_->GetVkDevice(),
+                                              e.library, nullptr);
+        return true;
+      });
+  libraries_.erase(end, libraries_.end());
+}
+
+}  // namespace vulkan
+}  // namespace amber
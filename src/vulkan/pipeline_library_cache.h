@@ -0,0 +1,170 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_VULKAN_PIPELINE_LIBRARY_CACHE_H_
+#define SRC_VULKAN_PIPELINE_LIBRARY_CACHE_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "amber/amber.h"
+#include "amber/result.h"
+#include "amber/vulkan_header.h"
+#include "src/pipeline_data.h"
+
+namespace amber {
+namespace vulkan {
+
+class Device;
+
+/// Builds graphics pipelines, sharing the parts of them between all graphics
+/// pipelines on a device. If VK_EXT_graphics_pipeline_library is enabled,
+/// the vertex input, pre-rasterization, fragment shader and fragment output
+/// parts are each created once as a pipeline library, and pipelines are
+/// linked from those. Otherwise pipelines are compiled in full. Pipelines
+/// may be built from several threads at once.
+class PipelineLibraryCache {
+ public:
+  /// The descriptor set layouts and push constant range of a pipeline
+  /// layout. Libraries are created with a layout owned by the cache, which
+  /// is identically defined to the layout of the pipelines linking them.
+  struct LayoutDesc {
+    /// The binding and type of each descriptor, per descriptor set.
+    std::vector<std::vector<std::pair<uint32_t, VkDescriptorType>>> sets;
+    VkPushConstantRange push_constant_range = VkPushConstantRange();
+
+    bool operator==(const LayoutDesc& other) const;
+  };
+
+  /// The attachment formats of a render pass. Libraries are created with a
+  /// render pass owned by the cache, which is compatible with the render
+  /// pass of the pipelines linking them.
+  struct RenderPassDesc {
+    std::vector<VkFormat> color_formats;
+    /// VK_FORMAT_UNDEFINED if there is no depth/stencil attachment.
+    VkFormat depth_stencil_format = VK_FORMAT_UNDEFINED;
+
+    bool operator==(const RenderPassDesc& other) const;
+  };
+
+  /// The state a library is created from. Libraries with an equal key are
+  /// shared.
+  struct LibraryKey {
+    /// The VkGraphicsPipelineLibraryFlagBitsEXT of the part.
+    VkGraphicsPipelineLibraryFlagsEXT part = 0;
+    /// The layout of the part, empty for parts not using one.
+    LayoutDesc layout;
+    /// The shader modules and their entry points.
+    std::vector<VkShaderModule> modules;
+    std::vector<std::string> entry_points;
+    /// The render pass of the part, empty for the vertex input part.
+    RenderPassDesc render_pass;
+    /// Any other state of the part, e.g. the vertex attributes or
+    /// specialization constants, flattened into words.
+    std::vector<uint32_t> state;
+    PipelineData pipeline_data;
+
+    bool operator==(const LibraryKey& other) const;
+  };
+
+  /// Usage statistics of the cache.
+  struct Stats {
+    /// The number of libraries created and the time spent creating them.
+    uint32_t library_count = 0;
+    uint64_t library_ns = 0;
+    /// The number of pipelines linked from libraries and the time spent
+    /// linking them.
+    uint32_t linked_count = 0;
+    uint64_t link_ns = 0;
+    /// The number of pipelines compiled in full and the time spent compiling
+    /// them.
+    uint32_t compiled_count = 0;
+    uint64_t compile_ns = 0;
+  };
+
+  PipelineLibraryCache(Device* device, Delegate* delegate);
+  ~PipelineLibraryCache();
+
+  /// Returns in |library| the library for |key|, creating it from |info| if
+  /// it does not exist yet. |info| must hold the state of the part, it is
+  /// completed with the library flags, and the layout and render pass of the
+  /// cache.
+  Result GetLibrary(const LibraryKey& key,
+                    VkGraphicsPipelineCreateInfo info,
+                    VkPipeline* library);
+
+  /// Links |libraries| into a complete pipeline created with |layout| and
+  /// |render_pass|.
+  Result LinkPipeline(const std::vector<VkPipeline>& libraries,
+                      VkPipelineLayout layout,
+                      VkRenderPass render_pass,
+                      VkPipeline* pipeline);
+
+  /// Creates a complete pipeline from |info| without libraries.
+  Result CompilePipeline(const VkGraphicsPipelineCreateInfo& info,
+                         VkPipeline* pipeline);
+
+  /// Destroys the libraries created with |module|. Called before |module| is
+  /// destroyed, as a new module may re-use its handle.
+  void ForgetShaderModule(VkShaderModule module);
+
+  /// Must not be called while pipelines are being built.
+  const Stats& GetStats() const { return stats_; }
+
+ private:
+  struct LibraryEntry {
+    LibraryKey key;
+    VkPipeline library = VK_NULL_HANDLE;
+  };
+
+  struct LayoutEntry {
+    LayoutDesc desc;
+    std::vector<VkDescriptorSetLayout> set_layouts;
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+  };
+
+  struct RenderPassEntry {
+    RenderPassDesc desc;
+    VkRenderPass render_pass = VK_NULL_HANDLE;
+  };
+
+  /// Returns in |layout| a pipeline layout created from |desc|. Must be
+  /// called with |mutex_| held.
+  Result GetLayout(const LayoutDesc& desc, VkPipelineLayout* layout);
+  /// Returns in |render_pass| a render pass created from |desc|. Must be
+  /// called with |mutex_| held.
+  Result GetRenderPass(const RenderPassDesc& desc, VkRenderPass* render_pass);
+  uint64_t GetTimestampNs() const;
+
+  /// Returns the library for |key| in |library| if it exists. Must be
+  /// called with |mutex_| held.
+  bool FindLibrary(const LibraryKey& key, VkPipeline* library) const;
+
+  Device* device_ = nullptr;
+  Delegate* delegate_ = nullptr;
+  // Guards the libraries, the layouts, the render passes and the statistics.
+  std::mutex mutex_;
+  std::vector<LibraryEntry> libraries_;
+  std::vector<LayoutEntry> layouts_;
+  std::vector<RenderPassEntry> render_passes_;
+  Stats stats_;
+};
+
+}  // namespace vulkan
+}  // namespace amber
+
+#endif  // SRC_VULKAN_PIPELINE_LIBRARY_CACHE_H_
@@ -14,6 +14,7 @@
 
 #include "src/vulkan/resource.h"
 
+#include <algorithm>
 #include <cstring>
 #include <limits>
 
@@ -99,7 +100,7 @@ uint32_t Resource::ChooseMemory(uint32_t memory_type_bits,
   return first_non_zero;
 }
 Result Resource::AllocateAndBindMemoryToVkBuffer(VkBuffer buffer,
-                                                 VkDeviceMemory* memory,
+                                                 MemoryAllocation* allocation,
                                                  VkMemoryPropertyFlags flags,
                                                  bool require_flags_found,
                                                  uint32_t* memory_type_index) {
@@ -113,8 +114,8 @@ Result Resource::AllocateAndBindMemoryToVkBuffer(VkBuffer buffer,
 
   if (buffer == VK_NULL_HANDLE)
     return Result("Vulkan::Given VkBuffer is VK_NULL_HANDLE");
-  if (memory == nullptr)
-    return Result("Vulkan::Given VkDeviceMemory pointer is nullptr");
+  if (allocation == nullptr)
+    return Result("Vulkan::Given MemoryAllocation pointer is nullptr");
 
   VkMemoryRequirements requirement;
   device_->GetPtrs()->vkGetBufferMemoryRequirements(device_->GetVkDevice(),
@@ -125,53 +126,63 @@ Result Resource::AllocateAndBindMemoryToVkBuffer(VkBuffer buffer,
   if (*memory_type_index == std::numeric_limits<uint32_t>::max())
     return Result("Vulkan::Find Proper Memory Fail");
 
-  Result r = AllocateMemory(memory, requirement.size, *memory_type_index);
+  Result r = AllocateMemory(allocation, requirement, *memory_type_index, false);
   if (!r.IsSuccess())
     return r;
 
-  if (device_->GetPtrs()->vkBindBufferMemory(device_->GetVkDevice(), buffer,
-                                             *memory, 0) != VK_SUCCESS) {
+  if (device_->GetPtrs()->vkBindBufferMemory(
+          device_->GetVkDevice(), buffer, allocation->memory,
+          allocation->offset) != VK_SUCCESS) {
     return Result("Vulkan::Calling vkBindBufferMemory Fail");
   }
 
   return {};
 }
 
-Result Resource::AllocateMemory(VkDeviceMemory* memory,
-                                VkDeviceSize size,
-                                uint32_t memory_type_index) {
-  VkMemoryAllocateInfo alloc_info = VkMemoryAllocateInfo();
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  alloc_info.allocationSize = size;
-  alloc_info.memoryTypeIndex = memory_type_index;
-  if (device_->GetPtrs()->vkAllocateMemory(device_->GetVkDevice(), &alloc_info,
-                                           nullptr, memory) != VK_SUCCESS) {
-    return Result("Vulkan::Calling vkAllocateMemory Fail");
-  }
-
-  return {};
+Result Resource::AllocateMemory(MemoryAllocation* allocation,
+                                const VkMemoryRequirements& requirement,
+                                uint32_t memory_type_index,
+                                bool is_image) {
+  return device_->GetMemoryAllocator()->Allocate(requirement, memory_type_index,
+                                                 is_image, allocation);
 }
 
-Result Resource::MapMemory(VkDeviceMemory memory) {
-  if (device_->GetPtrs()->vkMapMemory(device_->GetVkDevice(), memory, 0,
-                                      VK_WHOLE_SIZE, 0,
-                                      &memory_ptr_) != VK_SUCCESS) {
-    return Result("Vulkan::Calling vkMapMemory Fail");
-  }
+void Resource::FreeMemory(MemoryAllocation* allocation) {
+  if (allocation->memory == VK_NULL_HANDLE)
+    return;
 
-  return {};
+  if (memory_ptr_ == allocation->host_ptr)
+    memory_ptr_ = nullptr;
+  device_->GetMemoryAllocator()->Free(allocation);
 }
 
-void Resource::UnMapMemory(VkDeviceMemory memory) {
-  device_->GetPtrs()->vkUnmapMemory(device_->GetVkDevice(), memory);
+Result Resource::MapMemory(const MemoryAllocation& allocation) {
+  if (!allocation.host_ptr)
+    return Result("Vulkan::Memory is not host accessible");
+
+  memory_ptr_ = allocation.host_ptr;
+  return {};
 }
 
-void Resource::UpdateMemoryWithRawData(const std::vector<uint8_t>& raw_data) {
+void Resource::UpdateMemoryWithRawData(const BufferStorage& raw_data) {
   size_t effective_size =
       raw_data.size() > GetSizeInBytes() ? GetSizeInBytes() : raw_data.size();
   std::memcpy(HostAccessibleMemoryPtr(), raw_data.data(), effective_size);
 }
 
+void Resource::UpdateMemoryWithRawData(
+    const BufferStorage& raw_data,
+    const std::vector<BufferRange>& ranges) {
+  const size_t size = std::min<size_t>(raw_data.size(), GetSizeInBytes());
+  for (const auto& range : ranges) {
+    if (range.offset >= size)
+      break;
+    std::memcpy(static_cast<uint8_t*>(HostAccessibleMemoryPtr()) + range.offset,
+                raw_data.data() + range.offset,
+                std::min<size_t>(range.size, size - range.offset));
+  }
+}
+
 void Resource::MemoryBarrier(CommandBuffer* command_buffer) {
   // TODO(jaebaek): Current memory barrier is natively implemented.
   // Update it with the following access flags:
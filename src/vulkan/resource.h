@@ -21,6 +21,8 @@
 #include "amber/result.h"
 #include "amber/value.h"
 #include "amber/vulkan_header.h"
+#include "src/buffer.h"
+#include "src/vulkan/memory_allocator.h"
 
 namespace amber {
 namespace vulkan {
@@ -40,24 +42,41 @@ class Resource {
   /// Records a command on |command_buffer| to copy the buffer contents from the
   /// device to the host.
   virtual void CopyToHost(CommandBuffer* command_buffer) = 0;
+  /// Records commands on |command_buffer| to copy only the |ranges| of the
+  /// buffer contents from the host to the device. Resources which cannot
+  /// copy ranges copy everything.
+  virtual void CopyRangesToDevice(CommandBuffer* command_buffer,
+                                  const std::vector<BufferRange>&) {
+    CopyToDevice(command_buffer);
+  }
 
   void* HostAccessibleMemoryPtr() const { return memory_ptr_; }
 
   uint32_t GetSizeInBytes() const { return size_in_bytes_; }
-  void UpdateMemoryWithRawData(const std::vector<uint8_t>& raw_data);
+  void UpdateMemoryWithRawData(const BufferStorage& raw_data);
+  /// Copies only the |ranges| of |raw_data| into the host accessible memory.
+  void UpdateMemoryWithRawData(const BufferStorage& raw_data,
+                               const std::vector<BufferRange>& ranges);
+
+  /// Moves the host storage the resource took over when it was created back
+  /// into |storage|. Returns false if the resource does not own host storage,
+  /// the contents then have to be copied out of HostAccessibleMemoryPtr().
+  /// The resource must only be destroyed afterwards.
+  virtual bool ReleaseHostStorage(BufferStorage*) { return false; }
 
  protected:
   Resource(Device* device, uint32_t size);
   Result CreateVkBuffer(VkBuffer* buffer, VkBufferUsageFlags usage);
 
   Result AllocateAndBindMemoryToVkBuffer(VkBuffer buffer,
-                                         VkDeviceMemory* memory,
+                                         MemoryAllocation* allocation,
                                          VkMemoryPropertyFlags flags,
                                          bool force_flags,
                                          uint32_t* memory_type_index);
 
-  Result MapMemory(VkDeviceMemory memory);
-  void UnMapMemory(VkDeviceMemory memory);
+  /// Makes the host accessible memory of |allocation| the memory returned by
+  /// HostAccessibleMemoryPtr(). The memory stays mapped until it is freed.
+  Result MapMemory(const MemoryAllocation& allocation);
   void SetMemoryPtr(void* ptr) { memory_ptr_ = ptr; }
 
   /// Records a memory barrier on |command_buffer|, to ensure prior writes to
@@ -73,9 +92,14 @@ class Resource {
   uint32_t ChooseMemory(uint32_t memory_type_bits,
                         VkMemoryPropertyFlags flags,
                         bool require_flags_found);
-  Result AllocateMemory(VkDeviceMemory* memory,
-                        VkDeviceSize size,
-                        uint32_t memory_type_index);
+  /// Allocates memory for |requirement| from the device's memory allocator.
+  /// |is_image| must be true if the memory is bound to an image.
+  Result AllocateMemory(MemoryAllocation* allocation,
+                        const VkMemoryRequirements& requirement,
+                        uint32_t memory_type_index,
+                        bool is_image);
+  /// Returns the memory in |allocation| to the device's memory allocator.
+  void FreeMemory(MemoryAllocation* allocation);
 
   Device* device_ = nullptr;
 
@@ -57,6 +57,10 @@ VkBorderColor GetVkBorderColor(BorderColor color) {
 Sampler::Sampler(Device* device) : device_(device) {}
 
 Result Sampler::CreateSampler(amber::Sampler* sampler) {
+  // The state of |sampler| does not change once the script is parsed.
+  if (sampler_ != VK_NULL_HANDLE)
+    return {};
+
   VkSamplerCreateInfo sampler_info = VkSamplerCreateInfo();
   sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
   sampler_info.magFilter = sampler->GetMagFilter() == FilterType::kLinear
@@ -77,19 +81,13 @@ Result Sampler::CreateSampler(amber::Sampler* sampler) {
   sampler_info.unnormalizedCoordinates =
       (sampler->GetNormalizedCoords() ? VK_FALSE : VK_TRUE);
 
-  if (device_->GetPtrs()->vkCreateSampler(device_->GetVkDevice(), &sampler_info,
-                                          nullptr, &sampler_) != VK_SUCCESS) {
-    return Result("Vulkan::Calling vkCreateSampler Fail");
-  }
-
-  return {};
+  // Bindings with the same sampler state share one VkSampler.
+  return device_->GetObjectCache()->AcquireSampler(sampler_info, &sampler_);
 }
 
 Sampler::~Sampler() {
-  if (sampler_ != VK_NULL_HANDLE) {
-    device_->GetPtrs()->vkDestroySampler(device_->GetVkDevice(), sampler_,
-                                         nullptr);
-  }
+  if (sampler_ != VK_NULL_HANDLE)
+    device_->GetObjectCache()->ReleaseSampler(sampler_);
 }
 
 }  // namespace vulkan
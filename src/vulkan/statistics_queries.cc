@@ -0,0 +1,143 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "src/vulkan/statistics_queries.h"
+
+#include "src/vulkan/command_buffer.h"
+#include "src/vulkan/device.h"
+
+namespace amber {
+namespace vulkan {
+namespace {
+
+const uint32_t kQueriesPerPool = 256;
+
+// The results are written in the order of the bits, so the counters come
+// out as vertex invocations, clipping primitives, fragment invocations and
+// compute invocations. Counters of stages a command does not use stay 0.
+const VkQueryPipelineStatisticFlags kStatisticFlags =
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+const uint32_t kCounterCount = 4;
+
+}  // namespace
+
+StatisticsQueries::StatisticsQueries(Device* device,
+                                     std::vector<CommandStatistics>* report)
+    : device_(device), report_(report) {}
+
+StatisticsQueries::~StatisticsQueries() {
+  for (auto pool : query_pools_) {
+    device_->GetPtrs()->vkDestroyQueryPool(device_->GetVkDevice(), pool,
+                                           nullptr);
+  }
+}
+
+Result StatisticsQueries::GetQueryPool(uint32_t index,
+                                       VkQueryPool* pool,
+                                       uint32_t* pool_index) {
+  const size_t pool_count = index / kQueriesPerPool + 1;
+  while (query_pools_.size() < pool_count) {
+    VkQueryPoolCreateInfo info = VkQueryPoolCreateInfo();
+    info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+    info.queryCount = kQueriesPerPool;
+    info.pipelineStatistics = kStatisticFlags;
+
+    VkQueryPool new_pool = VK_NULL_HANDLE;
+    if (device_->GetPtrs()->vkCreateQueryPool(device_->GetVkDevice(), &info,
+                                              nullptr,
+                                              &new_pool) != VK_SUCCESS) {
+      return Result("Vulkan::Calling vkCreateQueryPool Fail");
+    }
+    query_pools_.push_back(new_pool);
+  }
+
+  *pool = query_pools_[index / kQueriesPerPool];
+  *pool_index = index % kQueriesPerPool;
+  return {};
+}
+
+Result StatisticsQueries::Begin(CommandBuffer* command) {
+  VkQueryPool pool = VK_NULL_HANDLE;
+  uint32_t pool_index = 0;
+  Result r = GetQueryPool(next_query_, &pool, &pool_index);
+  if (!r.IsSuccess())
+    return r;
+
+  device_->GetPtrs()->vkCmdResetQueryPool(command->GetVkCommandBuffer(), pool,
+                                          pool_index, 1);
+  device_->GetPtrs()->vkCmdBeginQuery(command->GetVkCommandBuffer(), pool,
+                                      pool_index, 0);
+  begun_ = true;
+  return {};
+}
+
+void StatisticsQueries::End(CommandBuffer* command, const char* type) {
+  if (!begun_)
+    return;
+
+  // The pool was created by Begin().
+  device_->GetPtrs()->vkCmdEndQuery(command->GetVkCommandBuffer(),
+                                    query_pools_[next_query_ / kQueriesPerPool],
+                                    next_query_ % kQueriesPerPool);
+
+  Query query;
+  query.index = next_query_;
+  query.line = line_;
+  query.type = type;
+  queries_.push_back(query);
+
+  ++next_query_;
+  begun_ = false;
+}
+
+Result StatisticsQueries::Resolve() {
+  Result result;
+  for (const auto& query : queries_) {
+    uint64_t counters[kCounterCount] = {};
+    if (device_->GetPtrs()->vkGetQueryPoolResults(
+            device_->GetVkDevice(), query_pools_[query.index / kQueriesPerPool],
+            query.index % kQueriesPerPool, 1, sizeof(counters), counters,
+            sizeof(counters),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) != VK_SUCCESS) {
+      result = Result("Vulkan::Calling vkGetQueryPoolResults Fail");
+      break;
+    }
+
+    last_statistics_.line = query.line;
+    last_statistics_.type = query.type;
+    last_statistics_.vertex_invocations = counters[0];
+    last_statistics_.clipping_primitives = counters[1];
+    last_statistics_.fragment_invocations = counters[2];
+    last_statistics_.compute_invocations = counters[3];
+    has_last_statistics_ = true;
+    if (report_)
+      report_->push_back(last_statistics_);
+  }
+
+  Discard();
+  return result;
+}
+
+void StatisticsQueries::Discard() {
+  queries_.clear();
+  next_query_ = 0;
+  begun_ = false;
+}
+
+}  // namespace vulkan
+}  // namespace amber
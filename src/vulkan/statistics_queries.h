@@ -0,0 +1,95 @@
+// Copyright 2020 The Amber Authors.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SRC_VULKAN_STATISTICS_QUERIES_H_
+#define SRC_VULKAN_STATISTICS_QUERIES_H_
+
+#include <string>
+#include <vector>
+
+#include "amber/amber.h"
+#include "amber/result.h"
+#include "amber/vulkan_header.h"
+
+namespace amber {
+namespace vulkan {
+
+class CommandBuffer;
+class Device;
+
+/// Counts the vertex and fragment shader invocations, the clipped primitives
+/// and the compute shader invocations of the draws and dispatches recorded
+/// for a pipeline with a pipeline statistics query around each of them. Like
+/// the GpuTimer, all queries recorded since the last Resolve() must belong to
+/// the same command buffer.
+class StatisticsQueries {
+ public:
+  /// Creates queries appending their results to |report|, which may be
+  /// nullptr if the results are only needed for GetLastStatistics().
+  StatisticsQueries(Device* device, std::vector<CommandStatistics>* report);
+  ~StatisticsQueries();
+
+  /// Sets the script line the commands begun from now on are attributed to.
+  void SetLine(size_t line) { line_ = line; }
+
+  /// Records the start of the query for a draw or dispatch into |command|.
+  /// Must not be called inside a render pass.
+  Result Begin(CommandBuffer* command);
+  /// Records the end of the query begun last into |command|. The command is
+  /// reported as |type|.
+  void End(CommandBuffer* command, const char* type);
+
+  /// Reads the results of all ended queries. The command buffer they were
+  /// recorded into must have completed.
+  Result Resolve();
+  /// Forgets all queries recorded since the last Resolve(), their command
+  /// buffer was dropped without being submitted.
+  void Discard();
+
+  /// Returns true if a query was resolved.
+  bool HasStatistics() const { return has_last_statistics_; }
+  /// Returns the statistics of the last resolved query.
+  const CommandStatistics& GetLastStatistics() const {
+    return last_statistics_;
+  }
+
+ private:
+  struct Query {
+    uint32_t index = 0;
+    size_t line = 0;
+    std::string type;
+  };
+
+  /// Returns the pool holding the query at |index| in |pool| and the index
+  /// of the query within the pool in |pool_index|. Pools are created as
+  /// needed.
+  Result GetQueryPool(uint32_t index,
+                      VkQueryPool* pool,
+                      uint32_t* pool_index);
+
+  Device* device_ = nullptr;
+  std::vector<CommandStatistics>* report_ = nullptr;
+  std::vector<VkQueryPool> query_pools_;
+  std::vector<Query> queries_;
+  uint32_t next_query_ = 0;
+  bool begun_ = false;
+  size_t line_ = 0;
+  CommandStatistics last_statistics_;
+  bool has_last_statistics_ = false;
+};
+
+}  // namespace vulkan
+}  // namespace amber
+
+#endif  // SRC_VULKAN_STATISTICS_QUERIES_H_
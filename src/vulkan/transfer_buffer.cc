@@ -13,6 +13,11 @@
 // limitations under the License.
 
 #include "src/vulkan/transfer_buffer.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
 #include "src/vulkan/command_buffer.h"
 #include "src/vulkan/device.h"
 
@@ -23,29 +28,66 @@ TransferBuffer::TransferBuffer(Device* device, uint32_t size_in_bytes)
     : Resource(device, size_in_bytes) {}
 
 TransferBuffer::~TransferBuffer() {
-  if (memory_ != VK_NULL_HANDLE) {
-    UnMapMemory(memory_);
-    device_->GetPtrs()->vkFreeMemory(device_->GetVkDevice(), memory_, nullptr);
-  }
-
   if (buffer_ != VK_NULL_HANDLE)
     device_->GetPtrs()->vkDestroyBuffer(device_->GetVkDevice(), buffer_,
                                         nullptr);
+  if (staging_buffer_ != VK_NULL_HANDLE) {
+    device_->GetPtrs()->vkDestroyBuffer(device_->GetVkDevice(),
+                                        staging_buffer_, nullptr);
+  }
+
+  // The memory is only returned once the buffer bound to it is destroyed.
+  FreeMemory(&allocation_);
+  FreeMemory(&staging_allocation_);
+  // The imported memory is freed before |host_storage_| is.
+  if (imported_memory_ != VK_NULL_HANDLE) {
+    device_->GetPtrs()->vkFreeMemory(device_->GetVkDevice(), imported_memory_,
+                                     nullptr);
+  }
 }
 
-Result TransferBuffer::Initialize(const VkBufferUsageFlags usage) {
-  Result r = CreateVkBuffer(&buffer_, usage);
+Result TransferBuffer::Initialize(const VkBufferUsageFlags usage,
+                                  bool device_local,
+                                  BufferStorage* host_storage) {
+  if (!device_local && ImportHostStorage(&buffer_, usage, host_storage))
+    return {};
+
+  const VkBufferUsageFlags transfer_usage =
+      VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  Result r = CreateVkBuffer(&buffer_,
+                            device_local ? usage | transfer_usage : usage);
   if (!r.IsSuccess())
     return r;
 
+  const VkMemoryPropertyFlags host_flags =
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+      VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
   uint32_t memory_type_index = 0;
-  r = AllocateAndBindMemoryToVkBuffer(buffer_, &memory_,
-                                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                          VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                      true, &memory_type_index);
+  r = AllocateAndBindMemoryToVkBuffer(
+      buffer_, &allocation_,
+      device_local ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : host_flags,
+      !device_local, &memory_type_index);
   if (!r.IsSuccess())
     return r;
 
+  // Devices with unified memory may offer device local memory the host can
+  // access directly, which needs no staging.
+  if (device_local &&
+      (!device_->IsMemoryHostAccessible(memory_type_index) ||
+       !device_->IsMemoryHostCoherent(memory_type_index))) {
+    if (ImportHostStorage(&staging_buffer_, transfer_usage, host_storage))
+      return {};
+
+    r = CreateVkBuffer(&staging_buffer_, transfer_usage);
+    if (!r.IsSuccess())
+      return r;
+
+    r = AllocateAndBindMemoryToVkBuffer(staging_buffer_, &staging_allocation_,
+                                        host_flags, true, &memory_type_index);
+    if (!r.IsSuccess())
+      return r;
+  }
+
   if (!device_->IsMemoryHostAccessible(memory_type_index) ||
       !device_->IsMemoryHostCoherent(memory_type_index)) {
     return Result(
@@ -53,18 +95,162 @@ Result TransferBuffer::Initialize(const VkBufferUsageFlags usage) {
         " not host coherent.");
   }
 
-  return MapMemory(memory_);
+  return MapMemory(staging_buffer_ != VK_NULL_HANDLE ? staging_allocation_
+                                                     : allocation_);
+}
+
+bool TransferBuffer::ImportHostStorage(VkBuffer* buffer,
+                                      VkBufferUsageFlags usage,
+                                      BufferStorage* host_storage) {
+  const VkDeviceSize alignment = device_->GetMinImportedHostPointerAlignment();
+  if (!host_storage || alignment == 0 ||
+      alignment > kBufferStorageImportAlignment ||
+      host_storage->size() != GetSizeInBytes() ||
+      host_storage->size() < kBufferStorageImportThreshold ||
+      reinterpret_cast<uintptr_t>(host_storage->data()) % alignment != 0) {
+    return false;
+  }
+
+  VkExternalMemoryBufferCreateInfo external_info =
+      VkExternalMemoryBufferCreateInfo();
+  external_info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+  external_info.handleTypes =
+      VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+  VkBufferCreateInfo buffer_info = VkBufferCreateInfo();
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.pNext = &external_info;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  buffer_info.size = GetSizeInBytes();
+  buffer_info.usage = usage;
+  if (device_->GetPtrs()->vkCreateBuffer(device_->GetVkDevice(), &buffer_info,
+                                         nullptr, buffer) != VK_SUCCESS) {
+    *buffer = VK_NULL_HANDLE;
+    return false;
+  }
+
+  VkMemoryRequirements requirement;
+  device_->GetPtrs()->vkGetBufferMemoryRequirements(device_->GetVkDevice(),
+                                                    *buffer, &requirement);
+
+  // The imported range has to be a multiple of the alignment, which the
+  // padding of large buffer storage leaves room for.
+  const VkDeviceSize import_size =
+      (requirement.size + alignment - 1) / alignment * alignment;
+  uint32_t memory_type_index = std::numeric_limits<uint32_t>::max();
+  if (import_size <= BufferStorageAllocator<uint8_t>::GetPaddedSize(
+                         host_storage->capacity())) {
+    memory_type_index = ChooseMemory(
+        requirement.memoryTypeBits &
+            device_->GetHostPointerMemoryTypeBits(host_storage->data()),
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+        true);
+  }
+
+  if (memory_type_index != std::numeric_limits<uint32_t>::max()) {
+    VkImportMemoryHostPointerInfoEXT import_info =
+        VkImportMemoryHostPointerInfoEXT();
+    import_info.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+    import_info.handleType =
+        VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+    import_info.pHostPointer = host_storage->data();
+
+    VkMemoryAllocateInfo alloc_info = VkMemoryAllocateInfo();
+    alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    alloc_info.pNext = &import_info;
+    alloc_info.allocationSize = import_size;
+    alloc_info.memoryTypeIndex = memory_type_index;
+    if (device_->GetPtrs()->vkAllocateMemory(device_->GetVkDevice(),
+                                             &alloc_info, nullptr,
+                                             &imported_memory_) == VK_SUCCESS &&
+        device_->GetPtrs()->vkBindBufferMemory(device_->GetVkDevice(), *buffer,
+                                               imported_memory_,
+                                               0) == VK_SUCCESS) {
+      host_storage_.swap(*host_storage);
+      SetMemoryPtr(host_storage_.data());
+      return true;
+    }
+  }
+
+  device_->GetPtrs()->vkDestroyBuffer(device_->GetVkDevice(), *buffer,
+                                      nullptr);
+  *buffer = VK_NULL_HANDLE;
+  if (imported_memory_ != VK_NULL_HANDLE) {
+    device_->GetPtrs()->vkFreeMemory(device_->GetVkDevice(), imported_memory_,
+                                     nullptr);
+    imported_memory_ = VK_NULL_HANDLE;
+  }
+  return false;
+}
+
+bool TransferBuffer::ReleaseHostStorage(BufferStorage* storage) {
+  if (imported_memory_ == VK_NULL_HANDLE)
+    return false;
+
+  storage->swap(host_storage_);
+  SetMemoryPtr(nullptr);
+  return true;
+}
+
+void TransferBuffer::CopyBuffer(CommandBuffer* command_buffer,
+                                VkBuffer src,
+                                VkBuffer dst) {
+  if (GetSizeInBytes() == 0)
+    return;
+
+  VkBufferCopy region = VkBufferCopy();
+  region.size = GetSizeInBytes();
+  device_->GetPtrs()->vkCmdCopyBuffer(command_buffer->GetVkCommandBuffer(), src,
+                                      dst, 1, &region);
 }
 
 void TransferBuffer::CopyToDevice(CommandBuffer* command_buffer) {
-  // This is redundant because this buffer is always host visible
+  if (staging_buffer_ != VK_NULL_HANDLE) {
+    // Earlier commands must be done with the buffer before it is
+    // overwritten.
+    MemoryBarrier(command_buffer);
+    CopyBuffer(command_buffer, staging_buffer_, buffer_);
+  }
+
+  // Without staging this is redundant because the buffer is host visible
   // and coherent and vkQueueSubmit will make writes from host
   // available (See chapter 6.9. "Host Write Ordering Guarantees" in
   // Vulkan spec), but we prefer to keep it to simplify our own code.
   MemoryBarrier(command_buffer);
 }
 
+void TransferBuffer::CopyRangesToDevice(
+    CommandBuffer* command_buffer,
+    const std::vector<BufferRange>& ranges) {
+  if (staging_buffer_ != VK_NULL_HANDLE) {
+    std::vector<VkBufferCopy> regions;
+    for (const auto& range : ranges) {
+      if (range.offset >= GetSizeInBytes())
+        break;
+
+      VkBufferCopy region = VkBufferCopy();
+      region.srcOffset = range.offset;
+      region.dstOffset = range.offset;
+      region.size = std::min(range.size, GetSizeInBytes() - range.offset);
+      regions.push_back(region);
+    }
+
+    if (!regions.empty()) {
+      MemoryBarrier(command_buffer);
+      device_->GetPtrs()->vkCmdCopyBuffer(
+          command_buffer->GetVkCommandBuffer(), staging_buffer_, buffer_,
+          static_cast<uint32_t>(regions.size()), regions.data());
+    }
+  }
+  MemoryBarrier(command_buffer);
+}
+
 void TransferBuffer::CopyToHost(CommandBuffer* command_buffer) {
+  if (staging_buffer_ != VK_NULL_HANDLE) {
+    MemoryBarrier(command_buffer);
+    CopyBuffer(command_buffer, buffer_, staging_buffer_);
+  }
   MemoryBarrier(command_buffer);
 }
 
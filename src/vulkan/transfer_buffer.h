@@ -33,7 +33,20 @@ class TransferBuffer : public Resource {
   TransferBuffer(Device* device, uint32_t size_in_bytes);
   ~TransferBuffer() override;
 
-  Result Initialize(const VkBufferUsageFlags usage);
+  /// Creates the buffer. If |device_local| is true the buffer is placed in
+  /// device local memory. Unless that memory is also host visible, the host
+  /// accessible memory is then a separate staging buffer which CopyToDevice()
+  /// and CopyToHost() transfer from and to.
+  ///
+  /// If |host_storage| is not nullptr and holds the initial contents of the
+  /// buffer, the storage is imported as the host accessible memory when the
+  /// device has VK_EXT_external_memory_host enabled. The buffer then takes
+  /// over the storage, leaving |host_storage| empty, until
+  /// ReleaseHostStorage() moves it back. Otherwise |host_storage| is left
+  /// untouched.
+  Result Initialize(const VkBufferUsageFlags usage,
+                    bool device_local,
+                    BufferStorage* host_storage);
 
   VkBuffer GetVkBuffer() const { return buffer_; }
 
@@ -43,10 +56,32 @@ class TransferBuffer : public Resource {
   /// Records a command on |command_buffer| to copy the buffer contents from the
   /// device to the host.
   void CopyToHost(CommandBuffer* command_buffer) override;
+  /// Records commands on |command_buffer| to copy the |ranges| of the buffer
+  /// contents from the host to the device.
+  void CopyRangesToDevice(CommandBuffer* command_buffer,
+                          const std::vector<BufferRange>& ranges) override;
+
+  bool ReleaseHostStorage(BufferStorage* storage) override;
 
  private:
+  /// Creates |buffer| with |usage| on top of the memory of |host_storage|
+  /// and takes over the storage. Returns false if the storage cannot be
+  /// imported, nothing is created then.
+  bool ImportHostStorage(VkBuffer* buffer,
+                         VkBufferUsageFlags usage,
+                         BufferStorage* host_storage);
+
+  /// Records a copy of the whole buffer from |src| to |dst|.
+  void CopyBuffer(CommandBuffer* command_buffer, VkBuffer src, VkBuffer dst);
+
   VkBuffer buffer_ = VK_NULL_HANDLE;
-  VkDeviceMemory memory_ = VK_NULL_HANDLE;
+  MemoryAllocation allocation_;
+  VkBuffer staging_buffer_ = VK_NULL_HANDLE;
+  MemoryAllocation staging_allocation_;
+  // The imported memory of |host_storage_|, which backs |buffer_|, or
+  // |staging_buffer_| if there is one.
+  VkDeviceMemory imported_memory_ = VK_NULL_HANDLE;
+  BufferStorage host_storage_;
 };
 
 }  // namespace vulkan
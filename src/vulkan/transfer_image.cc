@@ -76,19 +76,13 @@ TransferImage::~TransferImage() {
   if (image_ != VK_NULL_HANDLE)
     device_->GetPtrs()->vkDestroyImage(device_->GetVkDevice(), image_, nullptr);
 
-  if (memory_ != VK_NULL_HANDLE)
-    device_->GetPtrs()->vkFreeMemory(device_->GetVkDevice(), memory_, nullptr);
-
-  if (host_accessible_memory_ != VK_NULL_HANDLE) {
-    UnMapMemory(host_accessible_memory_);
-    device_->GetPtrs()->vkFreeMemory(device_->GetVkDevice(),
-                                     host_accessible_memory_, nullptr);
-  }
-
   if (host_accessible_buffer_ != VK_NULL_HANDLE) {
     device_->GetPtrs()->vkDestroyBuffer(device_->GetVkDevice(),
                                         host_accessible_buffer_, nullptr);
   }
+
+  FreeMemory(&allocation_);
+  FreeMemory(&host_accessible_allocation_);
 }
 
 Result TransferImage::Initialize(VkImageUsageFlags usage) {
@@ -103,7 +97,7 @@ Result TransferImage::Initialize(VkImageUsageFlags usage) {
   }
 
   uint32_t memory_type_index = 0;
-  Result r = AllocateAndBindMemoryToVkImage(image_, &memory_,
+  Result r = AllocateAndBindMemoryToVkImage(image_, &allocation_,
                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                                             false, &memory_type_index);
   if (!r.IsSuccess())
@@ -125,14 +119,14 @@ Result TransferImage::Initialize(VkImageUsageFlags usage) {
 
   memory_type_index = 0;
   r = AllocateAndBindMemoryToVkBuffer(host_accessible_buffer_,
-                                      &host_accessible_memory_,
+                                      &host_accessible_allocation_,
                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
                                           VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
                                       true, &memory_type_index);
   if (!r.IsSuccess())
     return r;
 
-  return MapMemory(host_accessible_memory_);
+  return MapMemory(host_accessible_allocation_);
 }
 
 VkImageViewType TransferImage::GetImageViewType() const {
@@ -310,7 +304,7 @@ void TransferImage::ImageBarrier(CommandBuffer* command_buffer,
 
 Result TransferImage::AllocateAndBindMemoryToVkImage(
     VkImage image,
-    VkDeviceMemory* memory,
+    MemoryAllocation* allocation,
     VkMemoryPropertyFlags flags,
     bool force_flags,
     uint32_t* memory_type_index) {
@@ -325,8 +319,8 @@ Result TransferImage::AllocateAndBindMemoryToVkImage(
 
   if (image == VK_NULL_HANDLE)
     return Result("Vulkan::Given VkImage is VK_NULL_HANDLE");
-  if (memory == nullptr)
-    return Result("Vulkan::Given VkDeviceMemory pointer is nullptr");
+  if (allocation == nullptr)
+    return Result("Vulkan::Given MemoryAllocation pointer is nullptr");
 
   VkMemoryRequirements requirement;
   device_->GetPtrs()->vkGetImageMemoryRequirements(device_->GetVkDevice(),
@@ -337,12 +331,13 @@ Result TransferImage::AllocateAndBindMemoryToVkImage(
   if (*memory_type_index == std::numeric_limits<uint32_t>::max())
     return Result("Vulkan::Find Proper Memory Fail");
 
-  Result r = AllocateMemory(memory, requirement.size, *memory_type_index);
+  Result r = AllocateMemory(allocation, requirement, *memory_type_index, true);
   if (!r.IsSuccess())
     return r;
 
-  if (device_->GetPtrs()->vkBindImageMemory(device_->GetVkDevice(), image,
-                                            *memory, 0) != VK_SUCCESS) {
+  if (device_->GetPtrs()->vkBindImageMemory(
+          device_->GetVkDevice(), image, allocation->memory,
+          allocation->offset) != VK_SUCCESS) {
     return Result("Vulkan::Calling vkBindImageMemory Fail");
   }
 
@@ -58,7 +58,7 @@ class TransferImage : public Resource {
  private:
   Result CreateVkImageView();
   Result AllocateAndBindMemoryToVkImage(VkImage image,
-                                        VkDeviceMemory* memory,
+                                        MemoryAllocation* allocation,
                                         VkMemoryPropertyFlags flags,
                                         bool force_flags,
                                         uint32_t* memory_type_index);
@@ -69,14 +69,14 @@ class TransferImage : public Resource {
   /// An extra `VkBuffer` is used to facilitate the transfer of data from the
   /// host into the `VkImage` on the device.
   VkBuffer host_accessible_buffer_ = VK_NULL_HANDLE;
-  VkDeviceMemory host_accessible_memory_ = VK_NULL_HANDLE;
+  MemoryAllocation host_accessible_allocation_;
 
   VkImageCreateInfo image_info_;
   VkImageAspectFlags aspect_;
 
   VkImage image_ = VK_NULL_HANDLE;
   VkImageView view_ = VK_NULL_HANDLE;
-  VkDeviceMemory memory_ = VK_NULL_HANDLE;
+  MemoryAllocation allocation_;
 
   VkImageLayout layout_ = VK_IMAGE_LAYOUT_UNDEFINED;
   VkPipelineStageFlags stage_ = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
@@ -80,8 +80,9 @@ Result VertexBuffer::SendVertexData(CommandBuffer* command) {
 
   if (!transfer_buffer_) {
     transfer_buffer_ = MakeUnique<TransferBuffer>(device_, bytes);
-    Result r = transfer_buffer_->Initialize(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                                            VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    Result r = transfer_buffer_->Initialize(
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        device_local_, nullptr);
     if (!r.IsSuccess())
       return r;
   }
@@ -39,6 +39,9 @@ class VertexBuffer {
 
   Result SendVertexData(CommandBuffer* command);
   bool VertexDataSent() const { return !is_vertex_data_pending_; }
+  /// Makes the next SendVertexData() copy the data again, for when the
+  /// commands recording the previous copy were discarded.
+  void MarkVertexDataPending() { is_vertex_data_pending_ = true; }
 
   void SetData(uint8_t location, Buffer* buffer);
 
@@ -64,6 +67,9 @@ class VertexBuffer {
 
   void BindToCommandBuffer(CommandBuffer* command);
 
+  /// Sets if the vertex buffer is placed in device local memory.
+  void SetDeviceLocal(bool device_local) { device_local_ = device_local; }
+
   void SetBufferForTest(std::unique_ptr<TransferBuffer> buffer);
 
  private:
@@ -76,6 +82,7 @@ class VertexBuffer {
   Device* device_ = nullptr;
 
   bool is_vertex_data_pending_ = true;
+  bool device_local_ = false;
 
   std::unique_ptr<TransferBuffer> transfer_buffer_;
   uint32_t stride_in_bytes_ = 0;